@@ -31,6 +31,7 @@
 #include "certificategenerator.h"
 
 #include "openssl/ssl.h"
+#include "openssl/ec.h"
 
 #include <QRegExp>
 #include <QFileInfo>
@@ -44,11 +45,12 @@ Q_DECLARE_LOGGING_CATEGORY(dcServerManager)
 
 namespace nymeaserver {
 
-void CertificateGenerator::generate(const QString &certificateFilename, const QString &keyFilename)
+void CertificateGenerator::generate(const QString &certificateFilename, const QString &keyFilename, KeyType keyType)
 {
     EVP_PKEY * pkey = nullptr;
     BIGNUM          *bne = NULL;
     RSA * rsa = nullptr;
+    EC_KEY * ecKey = nullptr;
     X509 * x509 = nullptr;
     X509_NAME * name = nullptr;
     BIO * bp_public = nullptr, * bp_private = nullptr;
@@ -75,14 +77,23 @@ void CertificateGenerator::generate(const QString &certificateFilename, const QS
     BN_set_word(bne, RSA_F4);
     q_check_ptr(bne);
 
-    rsa = RSA_new();
-    RSA_generate_key_ex(rsa, 2048, bne, nullptr);
-    q_check_ptr(rsa);
-
     pkey = EVP_PKEY_new();
     q_check_ptr(pkey);
 
-    EVP_PKEY_assign_RSA(pkey, rsa);
+    if (keyType == KeyTypeEcdsa) {
+        ecKey = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+        q_check_ptr(ecKey);
+        // Store the curve name instead of the explicit parameters, clients may only accept named curves
+        EC_KEY_set_asn1_flag(ecKey, OPENSSL_EC_NAMED_CURVE);
+        EC_KEY_generate_key(ecKey);
+        EVP_PKEY_assign_EC_KEY(pkey, ecKey);
+    } else {
+        rsa = RSA_new();
+        RSA_generate_key_ex(rsa, 2048, bne, nullptr);
+        q_check_ptr(rsa);
+        EVP_PKEY_assign_RSA(pkey, rsa);
+    }
+
     x509 = X509_new();
     q_check_ptr(x509);
     // Randomize serial number in case a previous one is stuck in a browser (Chromium
@@ -134,7 +145,7 @@ void CertificateGenerator::generate(const QString &certificateFilename, const QS
     if (certfile.write(certBuffer, pubSize) == pubSize && keyFile.write(keyBuffer, privSize) == privSize) {
         certfile.commit();
         keyFile.commit();
-        qCDebug(dcServerManager()) << "Generated new SSL certificate";
+        qCDebug(dcServerManager()) << "Generated new SSL certificate" << (keyType == KeyTypeEcdsa ? "(ECDSA)" : "(RSA)");
     } else {
         qCWarning(dcServerManager()) << "Error writing SSL certificate files" << certificateFilename << keyFilename;
         certfile.cancelWriting();
@@ -142,7 +153,7 @@ void CertificateGenerator::generate(const QString &certificateFilename, const QS
     }
 
     BN_free(bne);
-    EVP_PKEY_free(pkey); // this will also free the rsa key
+    EVP_PKEY_free(pkey); // this will also free the rsa or ec key
     X509_free(x509);
     BIO_free_all(bp_public);
     BIO_free_all(bp_private);
@@ -38,7 +38,14 @@ namespace nymeaserver {
 class CertificateGenerator
 {
 public:
-    static void generate(const QString &certificateFilename, const QString &keyFilename);
+    enum KeyType {
+        KeyTypeRsa,
+        KeyTypeEcdsa
+    };
+
+    // ECDSA (P-256) keys are much cheaper to use in handshakes than RSA-2048, while
+    // RSA still works with older clients.
+    static void generate(const QString &certificateFilename, const QString &keyFilename, KeyType keyType = KeyTypeRsa);
 };
 
 }
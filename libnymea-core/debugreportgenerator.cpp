@@ -59,9 +59,14 @@ DebugReportGenerator::~DebugReportGenerator()
     cleanupReport();
 }
 
-QByteArray DebugReportGenerator::reportFileData() const
+QString DebugReportGenerator::reportFilePath() const
 {
-    return m_reportFileData;
+    return QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + m_reportFileName;
+}
+
+qint64 DebugReportGenerator::reportFileSize() const
+{
+    return m_reportFileSize;
 }
 
 QString DebugReportGenerator::reportFileName()
@@ -325,16 +330,19 @@ void DebugReportGenerator::onCompressProcessFinished(int exitCode, QProcess::Exi
     }
 
     // Read the file
-    QFile reportFile(QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + m_reportFileName);
+    QFile reportFile(reportFilePath());
     if (!reportFile.open(QIODevice::ReadOnly)) {
         qCWarning(dcDebugServer()) << "Could not open report file name for reading" << reportFile.fileName();
         m_isReady = true;
         m_isValid = false;
         emit finished(false);
     } else {
-        m_reportFileData = reportFile.readAll();
-        m_md5Sum =  QString::fromUtf8(QCryptographicHash::hash(m_reportFileData, QCryptographicHash::Md5).toHex());
-        qCDebug(dcDebugServer()) << "File generated successfully" << reportFile.fileName() << m_reportFileData.size() << "B" << m_md5Sum;
+        // The report gets streamed from disk when downloaded, don't keep it in memory
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        hash.addData(&reportFile);
+        m_reportFileSize = reportFile.size();
+        m_md5Sum = QString::fromUtf8(hash.result().toHex());
+        qCDebug(dcDebugServer()) << "File generated successfully" << reportFile.fileName() << m_reportFileSize << "B" << m_md5Sum;
         m_isReady = true;
         m_isValid = true;
         emit finished(true);
@@ -37,6 +37,7 @@
 #include "nymeaconfiguration.h"
 #include "stdio.h"
 #include "version.h"
+#include "jsonrpc/jsonrpcserverimplementation.h"
 
 #include <QXmlStreamWriter>
 #include <QCoreApplication>
@@ -457,6 +458,16 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
         }
     }
 
+    if (requestPath.startsWith("/debug/sendqueues")) {
+        qCDebug(dcDebugServer()) << "Request send queue statistics";
+        QVariantMap dataMap;
+        dataMap.insert("clients", NymeaCore::instance()->jsonRPCServer()->sendQueueStatistics());
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/json");
+        reply->setPayload(QJsonDocument::fromVariant(dataMap).toJson(QJsonDocument::Indented));
+        return reply;
+    }
+
     if (requestPath.startsWith("/debug/report")) {
 
         // The client can poll this url in order to get information about the current report generating process.
@@ -482,8 +493,9 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
 
             // Everything looks good, send the requested debug report
             HttpReply *downloadReportReply = HttpReply::createSuccessReply();
-            downloadReportReply->setPayload(m_debugReportGenerator->reportFileData());
+            downloadReportReply->setPayloadFile(m_debugReportGenerator->reportFilePath());
             downloadReportReply->setHeader(HttpReply::ContentTypeHeader, "application/tar+gzip;");
+            downloadReportReply->setRawHeader("ETag", '"' + m_debugReportGenerator->md5Sum().toUtf8() + '"');
             return downloadReportReply;
         } else {
             // Generate or poll request
@@ -506,7 +518,7 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
                         // Success, the debug report is ready and valid
                         QVariantMap reportInformation;
                         reportInformation.insert("fileName", m_debugReportGenerator->reportFileName());
-                        reportInformation.insert("fileSize", m_debugReportGenerator->reportFileData().size());
+                        reportInformation.insert("fileSize", m_debugReportGenerator->reportFileSize());
                         reportInformation.insert("md5sum", m_debugReportGenerator->md5Sum());
 
                         HttpReply * httpReply = HttpReply::createSuccessReply();
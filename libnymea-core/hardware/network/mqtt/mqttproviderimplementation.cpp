@@ -120,8 +120,10 @@ MqttChannel *MqttProviderImplementation::createChannel(const QString &clientId,
     policy.username = channel->username();
     policy.password = channel->password();
     foreach (const QString &topicPrefix, channel->m_topicPrefixList) {
-        policy.allowedPublishTopicFilters.append(QString("%1/#").arg(topicPrefix));
-        policy.allowedSubscribeTopicFilters.append(QString("%1/#").arg(topicPrefix));
+        QString topicFilter = QString("%1/#").arg(topicPrefix);
+        policy.allowedPublishTopicFilters.append(topicFilter);
+        policy.allowedSubscribeTopicFilters.append(topicFilter);
+        m_channelTopics.insert(topicFilter, channel->clientId());
     }
     m_broker->updatePolicy(policy);
 
@@ -135,6 +137,9 @@ void MqttProviderImplementation::releaseChannel(MqttChannel *channel)
         return;
     }
     m_createdChannels.take(channel->clientId());
+    foreach (const QString &topicPrefix, channel->topicPrefixList()) {
+        m_channelTopics.remove(QString("%1/#").arg(topicPrefix), channel->clientId());
+    }
     m_broker->removePolicy(channel->clientId());
     qCDebug(dcMqtt) << "Released MQTT channel for client ID" << channel->clientId();
     delete channel;
@@ -220,25 +225,20 @@ void MqttProviderImplementation::onClientDisconnected(const QString &clientId)
 
 void MqttProviderImplementation::onPublishReceived(const QString &clientId, const QString &topic, const QByteArray &payload)
 {
-    if (m_createdChannels.contains(clientId)) {
-        MqttChannel* channel = m_createdChannels.value(clientId);
-        emit channel->publishReceived(channel, topic, payload);
+    // A channel only receives what its own client publishes within the channel's topic prefixes
+    MqttChannel *channel = m_createdChannels.value(clientId);
+    if (!channel || !m_channelTopics.matches(topic, clientId)) {
+        return;
     }
+    emit channel->publishReceived(channel, topic, payload);
 }
 
 void MqttProviderImplementation::onPluginPublished(const QString &topic, const QByteArray &payload)
 {
     MqttChannelImplementation *channel = static_cast<MqttChannelImplementation*>(sender());
-    bool found = false;
-    foreach (const QString &topicPrefix, channel->topicPrefixList()) {
-        if (topicPrefix.startsWith(topicPrefix)) {
-            found = true;
-            break;
-        }
-
-    }
-    if (!found) {
+    if (!m_channelTopics.matches(topic, channel->clientId())) {
         qCWarning(dcMqtt) << "Attempt to publish to MQTT channel for client" << channel->clientId() << "but topic is not within allowed topic prefix. Discarding message.";
+        return;
     }
     m_broker->publish(topic, payload);
 }
@@ -34,6 +34,7 @@
 #include <QObject>
 
 #include "servers/mqttbroker.h"
+#include "servers/mqtttopictrie.h"
 
 #include "network/mqtt/mqttprovider.h"
 namespace nymeaserver {
@@ -65,6 +66,8 @@ private:
     MqttBroker* m_broker = nullptr;
 
     QHash<QString, MqttChannel *> m_createdChannels;
+    // The topic filters of all channels, keyed by the channel client id
+    MqttTopicTrie m_channelTopics;
 };
 
 }
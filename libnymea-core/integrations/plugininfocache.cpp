@@ -30,40 +30,143 @@
 
 #include "plugininfocache.h"
 
-#include <QSettings>
 #include <QStandardPaths>
 #include <QDir>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
 #include <QJsonDocument>
 #include <QJsonObject>
 
 #include "loggingcategories.h"
 
-PluginInfoCache::PluginInfoCache()
+static const quint32 cacheMagic = 0x6e504943; // "nPIC"
+static const quint32 cacheVersion = 2;
+
+PluginInfoCache::PluginInfoCache(const QString &cacheFile):
+    m_cacheFile(cacheFile)
 {
+    if (m_cacheFile.isEmpty()) {
+        m_cacheFile = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/plugininfo.cache";
+    }
+    load();
+}
 
+QJsonObject PluginInfoCache::pluginInfo(const PluginId &pluginId) const
+{
+    if (!m_entries.contains(pluginId)) {
+        return loadLegacyPluginInfo(pluginId);
+    }
+    return QJsonObject::fromVariantMap(m_entries.value(pluginId).metaData);
 }
 
-void PluginInfoCache::cachePluginInfo(const QJsonObject &metaData)
+QJsonObject PluginInfoCache::pluginInfo(const QFileInfo &pluginFile) const
 {
-    QString fileName = metaData.value("id").toString().remove(QRegExp("[{}]")) + ".cache";
-    QDir path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/plugininfo/";
+    PluginId pluginId = m_fileIndex.value(pluginFile.absoluteFilePath());
+    if (pluginId.isNull()) {
+        return QJsonObject();
+    }
+
+    // Only hand out the cached metadata if the plugin file has not been touched since
+    const CacheEntry &entry = m_entries[pluginId];
+    QPair<qint64, qint64> stamp = fileStamp(pluginFile);
+    if (entry.lastModified != stamp.first || entry.size != stamp.second) {
+        return QJsonObject();
+    }
+    return QJsonObject::fromVariantMap(entry.metaData);
+}
+
+void PluginInfoCache::cachePluginInfo(const QFileInfo &pluginFile, const QJsonObject &metaData)
+{
+    PluginId pluginId = PluginId(metaData.value("id").toString());
+    QString fileName = pluginFile.absoluteFilePath();
+    QPair<qint64, qint64> stamp = fileStamp(pluginFile);
+
+    // Fast path: Same file, unchanged on disk. Nothing to do.
+    if (m_entries.contains(pluginId)) {
+        const CacheEntry &entry = m_entries[pluginId];
+        if (entry.fileName == fileName && entry.lastModified == stamp.first && entry.size == stamp.second) {
+            return;
+        }
+    }
+
+    qCDebug(dcThingManager()) << "Updating plugin info cache for" << metaData.value("name").toString();
+    CacheEntry &entry = m_entries[pluginId];
+    if (!entry.fileName.isEmpty() && entry.fileName != fileName) {
+        m_fileIndex.remove(entry.fileName);
+    }
+    entry.metaData = metaData.toVariantMap();
+    entry.pluginId = pluginId;
+    entry.fileName = fileName;
+    entry.lastModified = stamp.first;
+    entry.size = stamp.second;
+    m_fileIndex.insert(fileName, pluginId);
+    m_dirty = true;
+}
+
+bool PluginInfoCache::save(const QList<PluginId> &pluginsInUse)
+{
+    foreach (const CacheEntry &entry, m_entries.values()) {
+        if (QFileInfo::exists(entry.fileName) || pluginsInUse.contains(entry.pluginId)) {
+            continue;
+        }
+        qCDebug(dcThingManager()) << "Removing plugin" << entry.metaData.value("name").toString() << "from the plugin info cache. The plugin is gone and not used anymore.";
+        m_fileIndex.remove(entry.fileName);
+        m_entries.remove(entry.pluginId);
+        m_dirty = true;
+    }
+
+    if (!m_dirty) {
+        return true;
+    }
+
+    QDir path = QFileInfo(m_cacheFile).absoluteDir();
     if (!path.exists()) {
         if (!path.mkpath(path.absolutePath())) {
-            qCWarning(dcThingManager()) << "Error creating thing class cache dir at" << path.absolutePath();
+            qCWarning(dcThingManager()) << "Error creating plugin info cache dir at" << path.absolutePath();
+            return false;
         }
     }
-    QFile file(path.absoluteFilePath(fileName));
+
+    QSaveFile file(m_cacheFile);
     if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
-        qCWarning(dcThingManager()) << "Error opening thing class cache for writing at" << path.absoluteFilePath(fileName);
-        return;
+        qCWarning(dcThingManager()) << "Error opening plugin info cache for writing at" << m_cacheFile;
+        return false;
     }
 
-    file.write(QJsonDocument::fromVariant(metaData.toVariantMap()).toJson(QJsonDocument::Compact));
-    file.close();
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << cacheMagic << cacheVersion << static_cast<quint32>(m_entries.count());
+    foreach (const CacheEntry &entry, m_entries) {
+        stream << entry.pluginId << entry.fileName << entry.lastModified << entry.size << entry.metaData;
+    }
+
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        qCWarning(dcThingManager()) << "Error writing plugin info cache to" << m_cacheFile;
+        return false;
+    }
+    m_dirty = false;
+    return true;
 }
 
-QJsonObject PluginInfoCache::loadPluginInfo(const PluginId &pluginId)
+QPair<qint64, qint64> PluginInfoCache::fileStamp(const QFileInfo &pluginFile)
 {
+    QFileInfo fileInfo(pluginFile.absoluteFilePath());
+    qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    qint64 size = fileInfo.size();
+
+    // Script based plugins keep their metadata in a separate JSON file next to the script
+    if (fileInfo.suffix() != "so") {
+        QFileInfo jsonFileInfo(fileInfo.absolutePath() + "/" + fileInfo.baseName() + ".json");
+        lastModified = qMax(lastModified, jsonFileInfo.lastModified().toMSecsSinceEpoch());
+        size += jsonFileInfo.size();
+    }
+    return qMakePair(lastModified, size);
+}
+
+QJsonObject PluginInfoCache::loadLegacyPluginInfo(const PluginId &pluginId)
+{
+    // nymea used to write one JSON file per plugin
     QString fileName = pluginId.toString().remove(QRegExp("[{}]")) + ".cache";
     QDir path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/plugininfo/";
     QFile file(path.absoluteFilePath(fileName));
@@ -80,3 +183,38 @@ QJsonObject PluginInfoCache::loadPluginInfo(const PluginId &pluginId)
     }
     return QJsonObject::fromVariantMap(jsonDoc.toVariant().toMap());
 }
+
+void PluginInfoCache::load()
+{
+    QFile file(m_cacheFile);
+    if (!file.open(QFile::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    quint32 magic = 0, version = 0, count = 0;
+    stream >> magic >> version >> count;
+    if (magic != cacheMagic || version != cacheVersion) {
+        qCInfo(dcThingManager()) << "Discarding plugin info cache of incompatible format:" << m_cacheFile;
+        return;
+    }
+
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        CacheEntry entry;
+        stream >> entry.pluginId >> entry.fileName >> entry.lastModified >> entry.size >> entry.metaData;
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+        m_entries.insert(entry.pluginId, entry);
+        if (!entry.fileName.isEmpty()) {
+            m_fileIndex.insert(entry.fileName, entry.pluginId);
+        }
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcThingManager()) << "Plugin info cache is corrupt. Discarding it:" << m_cacheFile;
+        m_entries.clear();
+        m_fileIndex.clear();
+    }
+}
@@ -34,13 +34,44 @@
 #include "types/thingclass.h"
 #include "integrations/integrationplugin.h"
 
+#include <QFileInfo>
+#include <QHash>
+
+// Keeps the metadata of all plugins seen so far in a single binary index file. Entries are
+// stamped with the plugin file's modification time and size, so unchanged plugins are neither
+// serialized nor written again on startup. Entries of plugins which have been removed from disk
+// are kept as long as a configured thing still needs them.
 class PluginInfoCache
 {
 public:
-    PluginInfoCache();
+    explicit PluginInfoCache(const QString &cacheFile = QString());
+
+    QJsonObject pluginInfo(const PluginId &pluginId) const;
+    QJsonObject pluginInfo(const QFileInfo &pluginFile) const;
+
+    void cachePluginInfo(const QFileInfo &pluginFile, const QJsonObject &metaData);
+    // Writes the cache if anything changed. Entries whose plugin file is gone are dropped,
+    // unless the plugin is listed in pluginsInUse.
+    bool save(const QList<PluginId> &pluginsInUse);
+
+private:
+    class CacheEntry {
+    public:
+        PluginId pluginId;
+        QString fileName;
+        qint64 lastModified = 0;
+        qint64 size = 0;
+        QVariantMap metaData;
+    };
+
+    static QPair<qint64, qint64> fileStamp(const QFileInfo &pluginFile);
+    static QJsonObject loadLegacyPluginInfo(const PluginId &pluginId);
+    void load();
 
-    static void cachePluginInfo(const QJsonObject &metaData);
-    static QJsonObject loadPluginInfo(const PluginId &pluginId);
+    QString m_cacheFile;
+    QHash<PluginId, CacheEntry> m_entries;
+    QHash<QString, PluginId> m_fileIndex;
+    bool m_dirty = false;
 };
 
 #endif // PLUGININFOCACHE_H
@@ -42,6 +42,7 @@
 #include "nymeasettings.h"
 #include "version.h"
 #include "plugininfocache.h"
+#include "thingsetupscheduler.h"
 
 #include "integrations/thingdiscoveryinfo.h"
 #include "integrations/thingpairinginfo.h"
@@ -94,6 +95,26 @@ ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardware
     }
 
     m_apiKeysProvidersLoader = new ApiKeysProvidersLoader(this);
+    m_pluginInfoCache = new PluginInfoCache();
+
+    // When enabled, plugins are only registered with their metadata at startup and the plugin binary is loaded
+    // once a configured thing, a discovery, a pairing or a plugin configuration change actually requires it.
+    NymeaSettings globalSettings(NymeaSettings::SettingsRoleGlobal);
+    globalSettings.beginGroup("ThingManager");
+    m_lazyPluginLoading = globalSettings.value("lazyPluginLoading", false).toBool();
+
+    // Limits how many things of the same plugin are set up at the same time on startup. 0 means unlimited.
+    m_setupScheduler = new ThingSetupScheduler(this);
+    m_setupScheduler->setMaxConcurrentSetups(globalSettings.value("maxConcurrentSetups", 8).toInt());
+    globalSettings.beginGroup("MaxConcurrentSetups");
+    foreach (const QString &pluginIdString, globalSettings.childKeys()) {
+        m_setupScheduler->setMaxConcurrentSetups(PluginId(pluginIdString), globalSettings.value(pluginIdString).toInt());
+    }
+    globalSettings.endGroup(); // MaxConcurrentSetups
+    globalSettings.endGroup(); // ThingManager
+    connect(m_setupScheduler, &ThingSetupScheduler::setupThing, this, &ThingManagerImplementation::trySetupThing);
+    connect(m_setupScheduler, &ThingSetupScheduler::progress, this, &ThingManagerImplementation::thingSetupProgressChanged);
+    connect(m_setupScheduler, &ThingSetupScheduler::ready, this, &ThingManagerImplementation::thingsSetUpFinished);
 
     // Give hardware a chance to start up before loading plugins etc.
     QMetaObject::invokeMethod(this, "loadPlugins", Qt::QueuedConnection);
@@ -102,16 +123,13 @@ ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardware
 
     // Make sure this is always emitted after plugins and things are loaded
     QMetaObject::invokeMethod(this, "onLoaded", Qt::QueuedConnection);
-
-#ifdef WITH_PYTHON
-    PythonIntegrationPlugin::initPython();
-#endif
 }
 
 ThingManagerImplementation::~ThingManagerImplementation()
 {
 
     delete m_translator;
+    delete m_pluginInfoCache;
 
     foreach (Thing *thing, m_configuredThings) {
         storeThingStates(thing);
@@ -127,8 +145,14 @@ ThingManagerImplementation::~ThingManagerImplementation()
         }
     }
 
+    foreach (const InactivePlugin &inactivePlugin, m_inactivePlugins) {
+        delete inactivePlugin.placeholder;
+    }
+
 #ifdef WITH_PYTHON
-    PythonIntegrationPlugin::deinitPython();
+    if (m_pythonInitialized) {
+        PythonIntegrationPlugin::deinitPython();
+    }
 #endif
 }
 
@@ -180,29 +204,12 @@ QList<QJsonObject> ThingManagerImplementation::pluginsMetadata()
     foreach (const QString &path, searchDirs) {
         QDir dir(path);
         foreach (const QString &entry, dir.entryList({"*.so", "*.js", "*.py"}, QDir::Files)) {
-
-            QFileInfo fi(path + '/' + entry);
-            if (entry.startsWith("libnymea_integrationplugin") && entry.endsWith(".so")) {
-                QPluginLoader loader(fi.absoluteFilePath());
-                pluginList.append(loader.metaData().value("MetaData").toObject());
-#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
-            } else if (entry.startsWith("integrationplugin") && entry.endsWith(".js")) {
-                QFile jsonFile(fi.absolutePath() + "/" + fi.baseName() + ".json");
-                if (!jsonFile.open(QFile::ReadOnly)) {
-                    qCDebug(dcThingManager()) << "Failed to open json file for:" << entry;
-                    continue;
-                }
-                QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonFile.readAll());
-                pluginList.append(jsonDoc.object());
-#endif
-            } else if (entry.startsWith("integrationplugin") && entry.endsWith(".py")) {
-                QFile jsonFile(fi.absolutePath() + "/" + fi.baseName() + ".json");
-                if (!jsonFile.open(QFile::ReadOnly)) {
-                    qCDebug(dcThingManager()) << "Failed to open json file for:" << entry;
-                    continue;
-                }
-                QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonFile.readAll());
-                pluginList.append(jsonDoc.object());
+            if (!isPluginFile(entry)) {
+                continue;
+            }
+            QJsonObject metaData = readPluginMetadata(QFileInfo(path + '/' + entry));
+            if (!metaData.isEmpty()) {
+                pluginList.append(metaData);
             }
         }
     }
@@ -220,17 +227,30 @@ void ThingManagerImplementation::registerStaticPlugin(IntegrationPlugin *plugin)
 
 IntegrationPlugins ThingManagerImplementation::plugins() const
 {
-    return m_integrationPlugins.values();
+    IntegrationPlugins plugins = m_integrationPlugins.values();
+    foreach (const InactivePlugin &inactivePlugin, m_inactivePlugins) {
+        plugins.append(inactivePlugin.placeholder);
+    }
+    return plugins;
 }
 
 IntegrationPlugin *ThingManagerImplementation::plugin(const PluginId &pluginId) const
 {
+    if (m_inactivePlugins.contains(pluginId)) {
+        return m_inactivePlugins.value(pluginId).placeholder;
+    }
     return m_integrationPlugins.value(pluginId);
 }
 
+// False while a plugin is only registered with its metadata and its binary has not been loaded yet
+bool ThingManagerImplementation::isPluginActive(const PluginId &pluginId) const
+{
+    return m_integrationPlugins.contains(pluginId);
+}
+
 Thing::ThingError ThingManagerImplementation::setPluginConfig(const PluginId &pluginId, const ParamList &pluginConfig)
 {
-    IntegrationPlugin *plugin = m_integrationPlugins.value(pluginId);
+    IntegrationPlugin *plugin = activatePlugin(pluginId);
     if (!plugin) {
         qCWarning(dcThingManager()) << "Could not set plugin configuration. There is no plugin with id" << pluginId.toString();
         return Thing::ThingErrorPluginNotFound;
@@ -301,7 +321,7 @@ ThingDiscoveryInfo* ThingManagerImplementation::discoverThings(const ThingClassI
         discoveryInfo->finish(Thing::ThingErrorCreationMethodNotSupported);
         return discoveryInfo;
     }
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager) << "Thing discovery failed. Plugin not found for" << thingClass;
         ThingDiscoveryInfo *discoveryInfo = new ThingDiscoveryInfo(thingClassId, params, this);
@@ -438,7 +458,7 @@ ThingSetupInfo *ThingManagerImplementation::reconfigureThing(const ThingDescript
 
 ThingSetupInfo *ThingManagerImplementation::reconfigureThingInternal(Thing *thing, const ParamList &params, const QString &name)
 {
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thing->thingClass().pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thing->thingClass().pluginId());
     if (!plugin) {
         qCWarning(dcThingManager()) << "Cannot reconfigure thing. Plugin for ThingClass" << thing->thingClassId().toString() << "not found.";
         ThingSetupInfo *info = new ThingSetupInfo(this);
@@ -728,7 +748,7 @@ ThingPairingInfo *ThingManagerImplementation::confirmPairing(const PairingTransa
     ThingClassId thingClassId = context.thingClassId;
 
     ThingClass thingClass = m_supportedThings.value(thingClassId);
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager) << "Can't find a plugin for this" << thingClass;
         ThingPairingInfo *info = new ThingPairingInfo(pairingTransactionId, thingClassId, context.thingId, context.thingName, context.params, context.parentId, this, false);
@@ -850,7 +870,7 @@ ThingSetupInfo* ThingManagerImplementation::addConfiguredThingInternal(const Thi
         thingId = ThingId::createThingId();
     }
 
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager()) << "Cannot add thing. Plugin for thing class" << thingClass << "not found.";
         ThingSetupInfo *info = new ThingSetupInfo(this);
@@ -933,13 +953,24 @@ void ThingManagerImplementation::removeConfiguredThingInternal(Thing *thing)
     while (!toBeRemoved.isEmpty()) {
         Thing *t = m_configuredThings.take(toBeRemoved.takeFirst()->id());
 
+        m_setupScheduler->unschedule(t->id());
+
+        foreach (const CoalescedActions &coalescedActions, m_coalescedActions.take(t->id())) {
+            if (coalescedActions.pending && !coalescedActions.pending->isFinished()) {
+                coalescedActions.pending->finish(Thing::ThingErrorThingNotFound);
+            }
+        }
+
         IntegrationPlugin *plugin = m_integrationPlugins.value(t->pluginId());
         if (!plugin) {
             qCWarning(dcThingManager()).nospace() << "Plugin not loaded for thing " << t << ". Not calling thingRemoved on plugin.";
         } else if (thing->setupStatus() == Thing::ThingSetupStatusInProgress) {
             qCWarning(dcThingManager()).nospace() << "Thing " << thing << " is still being set up. Aborting setup.";
+            // Might still be waiting in the setup queue, in which case there is nothing to abort
             ThingSetupInfo *setupInfo = m_pendingSetups.value(t->id());
-            emit setupInfo->aborted();
+            if (setupInfo) {
+                emit setupInfo->aborted();
+            }
         } else if (thing->setupStatus() == Thing::ThingSetupStatusComplete) {
             plugin->thingRemoved(t);
         }
@@ -1316,7 +1347,7 @@ ThingClass ThingManagerImplementation::translateThingClass(const ThingClass &thi
 Vendor ThingManagerImplementation::translateVendor(const Vendor &vendor, const QLocale &locale)
 {
     IntegrationPlugin *plugin = nullptr;
-    foreach (IntegrationPlugin *p, m_integrationPlugins) {
+    foreach (IntegrationPlugin *p, plugins()) {
         if (p->supportedVendors().contains(vendor)) {
             plugin = p;
         }
@@ -1330,6 +1361,21 @@ Vendor ThingManagerImplementation::translateVendor(const Vendor &vendor, const Q
     return translatedVendor;
 }
 
+int ThingManagerImplementation::thingSetupProgress() const
+{
+    return m_setupScheduler->completed();
+}
+
+int ThingManagerImplementation::thingSetupTotal() const
+{
+    return m_setupScheduler->total();
+}
+
+bool ThingManagerImplementation::thingsSetUp() const
+{
+    return m_setupScheduler->isReady();
+}
+
 Thing *ThingManagerImplementation::findConfiguredThing(const ThingId &id) const
 {
     return m_configuredThings.value(id);
@@ -1442,9 +1488,13 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
     finalAction.setParams(finalParams);
 
     ThingActionInfo *info = new ThingActionInfo(thing, finalAction, this, 15000);
-    connect(info, &ThingActionInfo::finished, this, [=](){
+    // Many actions may be in flight at a time, keep the captures small and look up the rest only when needed
+    connect(info, &ThingActionInfo::finished, this, [this, info](){
+        Thing *thing = info->thing();
+        const Action &action = info->action();
 
-        if (thing->loggedActionTypeIds().contains(actionType.id())) {
+        if (thing->loggedActionTypeIds().contains(action.actionTypeId())) {
+            ActionType actionType = m_supportedThings.value(thing->thingClassId()).actionTypes().findById(action.actionTypeId());
             QVariantMap params;
             foreach (const ParamType &paramType, actionType.paramTypes()) {
                 params.insert(paramType.name(), action.paramValue(paramType.id()));
@@ -1461,11 +1511,59 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
         emit actionExecuted(action, info->status());
     });
 
-    plugin->executeAction(info);
+    if (!actionType.coalesce()) {
+        plugin->executeAction(info);
+        return info;
+    }
+
+    CoalescedActions &coalescedActions = m_coalescedActions[thing->id()][actionType.id()];
+    if (coalescedActions.inFlight) {
+        if (coalescedActions.pending) {
+            qCDebug(dcThingManager()) << "Superseding pending action" << actionType.name() << "on" << thing;
+            coalescedActions.pending->finish(Thing::ThingErrorActionSuperseded);
+        }
+        coalescedActions.pending = info;
+        return info;
+    }
 
+    executeCoalescedAction(plugin, info);
     return info;
 }
 
+void ThingManagerImplementation::executeCoalescedAction(IntegrationPlugin *plugin, ThingActionInfo *info)
+{
+    ThingId thingId = info->thing()->id();
+    ActionTypeId actionTypeId = info->action().actionTypeId();
+    m_coalescedActions[thingId][actionTypeId].inFlight = info;
+
+    connect(info, &ThingActionInfo::finished, this, [this, plugin, info, thingId, actionTypeId](){
+        // The thing might have been removed in the meantime
+        if (!m_coalescedActions.value(thingId).contains(actionTypeId)) {
+            return;
+        }
+        CoalescedActions &coalescedActions = m_coalescedActions[thingId][actionTypeId];
+        if (coalescedActions.inFlight != info) {
+            return;
+        }
+        ThingActionInfo *next = coalescedActions.pending;
+        coalescedActions.inFlight = nullptr;
+        coalescedActions.pending = nullptr;
+
+        // A pending action may have timed out while waiting
+        if (next && !next->isFinished()) {
+            executeCoalescedAction(plugin, next);
+            return;
+        }
+
+        m_coalescedActions[thingId].remove(actionTypeId);
+        if (m_coalescedActions.value(thingId).isEmpty()) {
+            m_coalescedActions.remove(thingId);
+        }
+    });
+
+    plugin->executeAction(info);
+}
+
 void ThingManagerImplementation::loadPlugins()
 {    
     QStringList searchDirs;
@@ -1482,42 +1580,18 @@ void ThingManagerImplementation::loadPlugins()
         QDir dir(path);
         qCDebug(dcThingManager) << "Loading plugins from:" << dir.absolutePath();
         foreach (const QString &entry, dir.entryList({"*.so", "*.js", "*.py"}, QDir::Files)) {
-
-            IntegrationPlugin *plugin = nullptr;
+            if (!isPluginFile(entry)) {
+                // Not a known plugin type
+                continue;
+            }
 
             QFileInfo fi(path + '/' + entry);
-            if (entry.startsWith("libnymea_integrationplugin") && entry.endsWith(".so")) {
-                plugin = createCppIntegrationPlugin(fi.absoluteFilePath());
-
-            } else if (entry.startsWith("integrationplugin") && entry.endsWith(".js")) {
-#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
-                ScriptIntegrationPlugin *p = new ScriptIntegrationPlugin(this);
-                bool ok = p->loadScript(fi.absoluteFilePath());
-                if (ok) {
-                    plugin = p;
-                } else {
-                    delete p;
-                }
-#else
-                qCWarning(dcThingManager()) << "Not loading JS plugin as JS plugin support is not included in this nymea instance.";
-#endif
-            } else if (entry.startsWith("integrationplugin") && entry.endsWith(".py")) {
-#ifdef WITH_PYTHON
-                PythonIntegrationPlugin *p = new PythonIntegrationPlugin(this);
-                bool ok = p->loadScript(fi.absoluteFilePath());
-                if (ok) {
-                    plugin = p;
-                } else {
-                    delete p;
-                }
-#else
-                qCWarning(dcThingManager()) << "Not loading Python plugin as Python plugin support is not included in this nymea instance.";
-#endif
-            } else {
-                // Not a known plugin type
+            if (m_lazyPluginLoading) {
+                registerInactivePlugin(fi);
                 continue;
             }
 
+            IntegrationPlugin *plugin = createIntegrationPlugin(fi);
             if (!plugin) {
                 qCWarning(dcThingManager()) << "Error loading plugin:" << fi.absoluteFilePath();
                 continue;
@@ -1533,9 +1607,140 @@ void ThingManagerImplementation::loadPlugins()
                 continue;
             }
             loadPlugin(plugin);
-            PluginInfoCache::cachePluginInfo(plugin->metadata().jsonObject());
+            m_pluginInfoCache->cachePluginInfo(fi, plugin->metadata().jsonObject());
+        }
+    }
+}
+
+bool ThingManagerImplementation::isPluginFile(const QString &fileName)
+{
+    if (fileName.startsWith("libnymea_integrationplugin") && fileName.endsWith(".so")) {
+        return true;
+    }
+    return fileName.startsWith("integrationplugin") && (fileName.endsWith(".js") || fileName.endsWith(".py"));
+}
+
+QJsonObject ThingManagerImplementation::readPluginMetadata(const QFileInfo &fileInfo)
+{
+    if (fileInfo.suffix() == "so") {
+        // QPluginLoader reads the metadata section from the file without actually loading the library
+        QPluginLoader loader(fileInfo.absoluteFilePath());
+        return loader.metaData().value("MetaData").toObject();
+    }
+
+    QFile jsonFile(fileInfo.absolutePath() + "/" + fileInfo.baseName() + ".json");
+    if (!jsonFile.open(QFile::ReadOnly)) {
+        qCDebug(dcThingManager()) << "Failed to open json file for:" << fileInfo.fileName();
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(jsonFile.readAll()).object();
+}
+
+IntegrationPlugin *ThingManagerImplementation::createIntegrationPlugin(const QFileInfo &fileInfo)
+{
+    IntegrationPlugin *plugin = nullptr;
+
+    if (fileInfo.suffix() == "so") {
+        plugin = createCppIntegrationPlugin(fileInfo.absoluteFilePath());
+
+    } else if (fileInfo.suffix() == "js") {
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+        ScriptIntegrationPlugin *p = new ScriptIntegrationPlugin(this);
+        bool ok = p->loadScript(fileInfo.absoluteFilePath());
+        if (ok) {
+            plugin = p;
+        } else {
+            delete p;
+        }
+#else
+        qCWarning(dcThingManager()) << "Not loading JS plugin as JS plugin support is not included in this nymea instance.";
+#endif
+    } else if (fileInfo.suffix() == "py") {
+#ifdef WITH_PYTHON
+        // The Python engine is only fired up once the first Python plugin is actually needed
+        if (!m_pythonInitialized) {
+            PythonIntegrationPlugin::initPython();
+            m_pythonInitialized = true;
+        }
+        PythonIntegrationPlugin *p = new PythonIntegrationPlugin(this);
+        bool ok = p->loadScript(fileInfo.absoluteFilePath());
+        if (ok) {
+            plugin = p;
+        } else {
+            delete p;
         }
+#else
+        qCWarning(dcThingManager()) << "Not loading Python plugin as Python plugin support is not included in this nymea instance.";
+#endif
     }
+
+    return plugin;
+}
+
+void ThingManagerImplementation::registerInactivePlugin(const QFileInfo &fileInfo)
+{
+    // Use the cached metadata if the plugin file has not changed since it was cached
+    QJsonObject pluginInfo = m_pluginInfoCache->pluginInfo(fileInfo);
+    if (pluginInfo.isEmpty()) {
+        pluginInfo = readPluginMetadata(fileInfo);
+    }
+
+    PluginMetadata metadata(pluginInfo, false, false);
+    if (!metadata.isValid()) {
+        qCWarning(dcThingManager()) << "Invalid plugin metadata in" << fileInfo.absoluteFilePath() << "Not registering plugin.";
+        foreach (const QString &error, metadata.validationErrors()) {
+            qCWarning(dcThingManager()) << error;
+        }
+        return;
+    }
+
+    if (m_integrationPlugins.contains(metadata.pluginId()) || m_inactivePlugins.contains(metadata.pluginId())) {
+        qCWarning(dcThingManager()) << "A plugin with this ID is already registered. Not registering" << fileInfo.fileName() << metadata.pluginId();
+        return;
+    }
+
+    InactivePlugin inactivePlugin;
+    inactivePlugin.fileName = fileInfo.absoluteFilePath();
+    inactivePlugin.placeholder = new IntegrationPlugin();
+    inactivePlugin.placeholder->setMetaData(metadata);
+    m_inactivePlugins.insert(metadata.pluginId(), inactivePlugin);
+
+    qCDebug(dcThingManager()) << "**** Registered plugin" << metadata.pluginName() << "(not loaded yet)";
+    registerPluginTypes(inactivePlugin.placeholder);
+    loadPluginConfiguration(inactivePlugin.placeholder);
+
+    m_pluginInfoCache->cachePluginInfo(fileInfo, metadata.jsonObject());
+}
+
+IntegrationPlugin *ThingManagerImplementation::activatePlugin(const PluginId &pluginId)
+{
+    IntegrationPlugin *plugin = m_integrationPlugins.value(pluginId);
+    if (plugin || !m_inactivePlugins.contains(pluginId)) {
+        return plugin;
+    }
+
+    InactivePlugin inactivePlugin = m_inactivePlugins.take(pluginId);
+    qCInfo(dcThingManager()) << "Activating plugin" << inactivePlugin.placeholder->pluginName() << "from" << inactivePlugin.fileName;
+    delete inactivePlugin.placeholder;
+
+    plugin = createIntegrationPlugin(QFileInfo(inactivePlugin.fileName));
+    if (!plugin) {
+        qCWarning(dcThingManager()) << "Error loading plugin:" << inactivePlugin.fileName;
+        return nullptr;
+    }
+    if (plugin->pluginId() != pluginId) {
+        qCWarning(dcThingManager()) << "The plugin in" << inactivePlugin.fileName << "has changed its ID from" << pluginId << "to" << plugin->pluginId() << "Not loading it.";
+        delete plugin;
+        return nullptr;
+    }
+
+    loadPlugin(plugin);
+
+    if (m_autoThingsMonitoringStarted) {
+        plugin->startMonitoringAutoThings();
+    }
+    emit pluginActivated(pluginId);
+    return plugin;
 }
 
 void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface)
@@ -1564,7 +1769,22 @@ void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface)
     pluginIface->initPlugin(this, m_hardwareManager, apiKeyStorage);
 
     qCDebug(dcThingManager) << "**** Loaded plugin" << pluginIface->pluginName();
-    foreach (const Vendor &vendor, pluginIface->supportedVendors()) {
+    registerPluginTypes(pluginIface);
+    loadPluginConfiguration(pluginIface);
+
+    // Call the init method of the plugin
+    pluginIface->init();
+
+    m_integrationPlugins.insert(pluginIface->pluginId(), pluginIface);
+
+    connect(pluginIface, &IntegrationPlugin::emitEvent, this, &ThingManagerImplementation::onEventTriggered, Qt::QueuedConnection);
+    connect(pluginIface, &IntegrationPlugin::autoThingsAppeared, this, &ThingManagerImplementation::onAutoThingsAppeared, Qt::QueuedConnection);
+    connect(pluginIface, &IntegrationPlugin::autoThingDisappeared, this, &ThingManagerImplementation::onAutoThingDisappeared, Qt::QueuedConnection);
+}
+
+void ThingManagerImplementation::registerPluginTypes(IntegrationPlugin *plugin)
+{
+    foreach (const Vendor &vendor, plugin->supportedVendors()) {
         qCDebug(dcThingManager) << "* Loaded vendor:" << vendor.name() << vendor.id().toString();
         if (m_supportedVendors.contains(vendor.id()))
             continue;
@@ -1572,22 +1792,28 @@ void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface)
         m_supportedVendors.insert(vendor.id(), vendor);
     }
 
-    foreach (const ThingClass &thingClass, pluginIface->supportedThings()) {
+    foreach (const ThingClass &thingClass, plugin->supportedThings()) {
         if (!m_supportedVendors.contains(thingClass.vendorId())) {
             qCWarning(dcThingManager) << "Vendor not found. Ignoring thing. VendorId:" << thingClass.vendorId().toString() << "ThingClass:" << thingClass.name() << thingClass.id().toString();
             continue;
         }
-        m_vendorThingMap[thingClass.vendorId()].append(thingClass.id());
+        // Might have been registered already when the plugin was registered without loading it
+        if (!m_vendorThingMap.value(thingClass.vendorId()).contains(thingClass.id())) {
+            m_vendorThingMap[thingClass.vendorId()].append(thingClass.id());
+        }
         m_supportedThings.insert(thingClass.id(), thingClass);
         qCDebug(dcThingManager) << "* Loaded thing class:" << thingClass.name();
     }
+}
 
+void ThingManagerImplementation::loadPluginConfiguration(IntegrationPlugin *plugin)
+{
     NymeaSettings settings(NymeaSettings::SettingsRolePlugins);
     settings.beginGroup("PluginConfig");
     ParamList params;
 
-    settings.beginGroup(pluginIface->pluginId().toString());
-    foreach (const ParamType &paramType, pluginIface->configurationDescription()) {
+    settings.beginGroup(plugin->pluginId().toString());
+    foreach (const ParamType &paramType, plugin->configurationDescription()) {
         QVariant value = paramType.defaultValue();
         if (settings.contains(paramType.id().toString())) {
             value = settings.value(paramType.id().toString());
@@ -1606,20 +1832,11 @@ void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface)
     settings.endGroup(); // PluginConfig
 
     if (params.count() > 0) {
-        Thing::ThingError status = pluginIface->setConfiguration(params);
+        Thing::ThingError status = plugin->setConfiguration(params);
         if (status != Thing::ThingErrorNoError) {
-            qCWarning(dcThingManager) << "Error setting params to plugin" << pluginIface->pluginId().toString() << pluginIface->pluginDisplayName() << ". Broken configuration?";
+            qCWarning(dcThingManager) << "Error setting params to plugin" << plugin->pluginId().toString() << plugin->pluginDisplayName() << ". Broken configuration?";
         }
     }
-
-    // Call the init method of the plugin
-    pluginIface->init();
-
-    m_integrationPlugins.insert(pluginIface->pluginId(), pluginIface);
-
-    connect(pluginIface, &IntegrationPlugin::emitEvent, this, &ThingManagerImplementation::onEventTriggered, Qt::QueuedConnection);
-    connect(pluginIface, &IntegrationPlugin::autoThingsAppeared, this, &ThingManagerImplementation::onAutoThingsAppeared, Qt::QueuedConnection);
-    connect(pluginIface, &IntegrationPlugin::autoThingDisappeared, this, &ThingManagerImplementation::onAutoThingDisappeared, Qt::QueuedConnection);
 }
 
 void ThingManagerImplementation::loadConfiguredThings()
@@ -1646,7 +1863,7 @@ void ThingManagerImplementation::loadConfiguredThings()
             settings.setValue("pluginid", pluginId);
         }
 
-        IntegrationPlugin *plugin = m_integrationPlugins.value(pluginId);
+        IntegrationPlugin *plugin = activatePlugin(pluginId);
         if (!plugin) {
             qCWarning(dcThingManager()) << "Plugin for thing" << thingName << idString << "not found. This thing will not be functional until the plugin can be loaded.";
         }
@@ -1654,7 +1871,7 @@ void ThingManagerImplementation::loadConfiguredThings()
         ThingClass thingClass = findThingClass(thingClassId);
         if (!thingClass.isValid()) {
             // Try to load the thing class from the cache
-            QJsonObject pluginInfo = PluginInfoCache::loadPluginInfo(pluginId);
+            QJsonObject pluginInfo = m_pluginInfoCache->pluginInfo(pluginId);
             if (!pluginInfo.empty()) {
                 PluginMetadata pluginMetadata(pluginInfo, false, false);
                 thingClass = pluginMetadata.thingClasses().findById(thingClassId);
@@ -1786,6 +2003,24 @@ void ThingManagerImplementation::loadConfiguredThings()
         settings.remove("DeviceConfig");
     }
 
+    // Only writes the cache if any plugin has changed. Plugins which are gone stay cached as long as things need them.
+    QList<PluginId> pluginsInUse;
+    foreach (Thing *thing, m_configuredThings) {
+        pluginsInUse.append(thing->pluginId());
+    }
+    m_pluginInfoCache->save(pluginsInUse);
+
+
+    // Things with children are prioritized in the setup queue, the more descendants, the earlier.
+    QHash<ThingId, int> descendants;
+    foreach (Thing *thing, m_configuredThings) {
+        ThingId parentId = thing->parentId();
+        int depth = 0;
+        while (!parentId.isNull() && m_configuredThings.contains(parentId) && depth++ < m_configuredThings.count()) {
+            descendants[parentId]++;
+            parentId = m_configuredThings.value(parentId)->parentId();
+        }
+    }
 
     QHash<ThingId, Thing*> setupList = m_configuredThings;
     while (!setupList.isEmpty()) {
@@ -1799,7 +2034,11 @@ void ThingManagerImplementation::loadConfiguredThings()
         }
         Q_ASSERT(thing != nullptr);
 
-        trySetupThing(thing);
+        thing->setSetupStatus(Thing::ThingSetupStatusInProgress, Thing::ThingErrorNoError);
+        m_setupScheduler->schedule(thing, descendants.value(thing->id()));
+    }
+    if (m_configuredThings.isEmpty()) {
+        emit thingsSetUpFinished();
     }
 
     loadIOConnections();
@@ -1855,9 +2094,21 @@ void ThingManagerImplementation::storeConfiguredThings()
 
 void ThingManagerImplementation::startMonitoringAutoThings()
 {
+    // Plugins which can create things on their own need to be running in order to detect them.
+    foreach (const PluginId &pluginId, m_inactivePlugins.keys()) {
+        foreach (const ThingClass &thingClass, m_inactivePlugins.value(pluginId).placeholder->supportedThings()) {
+            if (thingClass.createMethods().testFlag(ThingClass::CreateMethodAuto)) {
+                qCDebug(dcThingManager()) << "Activating plugin" << m_inactivePlugins.value(pluginId).placeholder->pluginName() << "as it provides auto things.";
+                activatePlugin(pluginId);
+                break;
+            }
+        }
+    }
+
     foreach (IntegrationPlugin *plugin, m_integrationPlugins) {
         plugin->startMonitoringAutoThings();
     }
+    m_autoThingsMonitoringStarted = true;
 }
 
 void ThingManagerImplementation::onAutoThingsAppeared(const ThingDescriptors &thingDescriptors)
@@ -2201,7 +2452,7 @@ void ThingManagerImplementation::pairThingInternal(ThingPairingInfo *info)
         return;
     }
 
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager) << "Cannot pair thing class" << thingClass << "because no plugin for it is loaded.";
         info->finish(Thing::ThingErrorPluginNotFound);
@@ -2232,7 +2483,7 @@ void ThingManagerImplementation::pairThingInternal(ThingPairingInfo *info)
 ThingSetupInfo* ThingManagerImplementation::setupThing(Thing *thing, bool initialSetup)
 {
     ThingClass thingClass = findThingClass(thing->thingClassId());
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
 
     ThingSetupInfo *info = new ThingSetupInfo(thing, this, initialSetup, false, 30000);
 
@@ -2470,18 +2721,13 @@ void ThingManagerImplementation::trySetupThing(Thing *thing)
     // it in the meantime... In that case we don't want to call postsetup on it.
     connect(info, &ThingSetupInfo::finished, thing, [this, info, thing](){
 
+        // We know this used to work at some point... The scheduler will try again in a bit unless we don't have a plugin for it...
+        m_setupScheduler->setupFinished(thing, info->status());
+
         if (info->status() != Thing::ThingErrorNoError) {
             qCWarning(dcThingManager()) << "Error setting up" << info->thing() << info->status() << info->displayMessage();
             info->thing()->setSetupStatus(Thing::ThingSetupStatusFailed, info->status(), info->displayMessage());
             emit thingChanged(info->thing());
-
-            // We know this used to work at some point... try again in a bit unless we don't have a plugin for it...
-            if (info->status() != Thing::ThingErrorPluginNotFound) {
-                QTimer::singleShot(10000, thing, [this, thing]() {
-                    trySetupThing(thing);
-                });
-            }
-
             return;
         }
 
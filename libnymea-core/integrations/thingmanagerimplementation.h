@@ -35,6 +35,7 @@
 
 #include "integrations/thing.h"
 #include "integrations/thingdescriptor.h"
+#include "integrations/thingactioninfo.h"
 #include "integrations/pluginmetadata.h"
 #include "integrations/ioconnection.h"
 
@@ -49,6 +50,8 @@
 #include <QLocale>
 #include <QPluginLoader>
 #include <QTranslator>
+#include <QFileInfo>
+#include <QPointer>
 
 #include "hardwaremanager.h"
 
@@ -60,6 +63,8 @@ class ThingPairingInfo;
 class HardwareManager;
 class Translator;
 class ApiKeysProvidersLoader;
+class PluginInfoCache;
+class ThingSetupScheduler;
 class LogEngine;
 class Logger;
 
@@ -79,6 +84,7 @@ public:
 
     IntegrationPlugins plugins() const override;
     IntegrationPlugin *plugin(const PluginId &pluginId) const override;
+    bool isPluginActive(const PluginId &pluginId) const;
     Thing::ThingError setPluginConfig(const PluginId &pluginId, const ParamList &pluginConfig) override;
 
     Vendors supportedVendors() const override;
@@ -134,6 +140,14 @@ public:
     ThingClass translateThingClass(const ThingClass &thingClass, const QLocale &locale) override;
     Vendor translateVendor(const Vendor &vendor, const QLocale &locale) override;
 
+    int thingSetupProgress() const;
+    int thingSetupTotal() const;
+    bool thingsSetUp() const;
+
+signals:
+    void thingSetupProgressChanged(int completed, int total);
+    void thingsSetUpFinished();
+
 private slots:
     void loadPlugins();
     void loadPlugin(IntegrationPlugin *pluginIface);
@@ -180,7 +194,16 @@ private:
     void registerActionLogger(Thing *thing, const ActionTypeId &actionTypeId);
     void unregisterActionLogger(Thing *thing, const ActionTypeId &actionTypeId);
 
+    void executeCoalescedAction(IntegrationPlugin *plugin, ThingActionInfo *info);
+
+    static bool isPluginFile(const QString &fileName);
+    static QJsonObject readPluginMetadata(const QFileInfo &fileInfo);
+    IntegrationPlugin *createIntegrationPlugin(const QFileInfo &fileInfo);
     IntegrationPlugin *createCppIntegrationPlugin(const QString &absoluteFilePath);
+    void registerInactivePlugin(const QFileInfo &fileInfo);
+    IntegrationPlugin *activatePlugin(const PluginId &pluginId);
+    void registerPluginTypes(IntegrationPlugin *plugin);
+    void loadPluginConfiguration(IntegrationPlugin *plugin);
 
 private:
     HardwareManager *m_hardwareManager;
@@ -200,6 +223,18 @@ private:
 
     QHash<PluginId, IntegrationPlugin*> m_integrationPlugins;
 
+    // Plugins which have been found on disk but are not loaded yet. The placeholder only carries
+    // the metadata and configuration so the plugin can be listed and configured without loading it.
+    class InactivePlugin {
+    public:
+        QString fileName;
+        IntegrationPlugin *placeholder = nullptr;
+    };
+    QHash<PluginId, InactivePlugin> m_inactivePlugins;
+    bool m_lazyPluginLoading = false;
+    bool m_autoThingsMonitoringStarted = false;
+    bool m_pythonInitialized = false;
+
     class PairingContext {
     public:
         ThingId thingId;
@@ -211,9 +246,20 @@ private:
     QHash<PairingTransactionId, PairingContext> m_pendingPairings;
     QHash<ThingId, ThingSetupInfo*> m_pendingSetups;
 
+    // For action types marked to coalesce, at most one action is executed by the plugin at a time.
+    // Only the most recent action issued in the meantime is kept pending.
+    class CoalescedActions {
+    public:
+        QPointer<ThingActionInfo> inFlight;
+        QPointer<ThingActionInfo> pending;
+    };
+    QHash<ThingId, QHash<ActionTypeId, CoalescedActions> > m_coalescedActions;
+
     QHash<IOConnectionId, IOConnection> m_ioConnections;
 
     ApiKeysProvidersLoader *m_apiKeysProvidersLoader = nullptr;
+    PluginInfoCache *m_pluginInfoCache = nullptr;
+    ThingSetupScheduler *m_setupScheduler = nullptr;
 };
 
 #endif // THINGMANAGERIMPLEMENTATION_H
@@ -0,0 +1,185 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "thingsetupscheduler.h"
+#include "loggingcategories.h"
+
+#include <QTimer>
+#include <QPointer>
+
+ThingSetupScheduler::ThingSetupScheduler(QObject *parent) : QObject(parent)
+{
+
+}
+
+int ThingSetupScheduler::maxConcurrentSetups(const PluginId &pluginId) const
+{
+    return m_maxConcurrentSetups.value(pluginId, m_defaultMaxConcurrentSetups);
+}
+
+void ThingSetupScheduler::setMaxConcurrentSetups(int maxConcurrentSetups)
+{
+    m_defaultMaxConcurrentSetups = qMax(0, maxConcurrentSetups);
+}
+
+void ThingSetupScheduler::setMaxConcurrentSetups(const PluginId &pluginId, int maxConcurrentSetups)
+{
+    m_maxConcurrentSetups.insert(pluginId, qMax(0, maxConcurrentSetups));
+}
+
+void ThingSetupScheduler::schedule(Thing *thing, int priority)
+{
+    if (m_runningThings.contains(thing->id()) || m_queuedThings.contains(thing->id())) {
+        qCDebug(dcThingManager()) << "Setup for" << thing << "is already scheduled.";
+        return;
+    }
+
+    if (m_pending.isEmpty()) {
+        m_completed = 0;
+        m_total = 0;
+        m_elapsed.start();
+    }
+    m_pending.insert(thing->id());
+    m_total++;
+
+    QueueEntry entry;
+    entry.thing = thing;
+    entry.pluginId = thing->pluginId();
+    entry.priority = priority;
+    enqueue(entry);
+    dispatch(entry.pluginId);
+}
+
+void ThingSetupScheduler::unschedule(const ThingId &thingId)
+{
+    m_attempts.remove(thingId);
+    if (m_queuedThings.contains(thingId)) {
+        QPair<PluginId, QueueKey> queued = m_queuedThings.take(thingId);
+        m_queues[queued.first].remove(queued.second);
+    }
+
+    if (m_runningThings.contains(thingId)) {
+        PluginId pluginId = m_runningThings.take(thingId).pluginId;
+        m_running[pluginId]--;
+        dispatch(pluginId);
+    }
+
+    if (m_pending.remove(thingId)) {
+        m_total--;
+        reportProgress();
+    }
+}
+
+void ThingSetupScheduler::setupFinished(Thing *thing, Thing::ThingError status)
+{
+    if (!m_runningThings.contains(thing->id())) {
+        return;
+    }
+    QueueEntry running = m_runningThings.take(thing->id());
+    m_running[running.pluginId]--;
+
+    if (m_pending.remove(thing->id())) {
+        m_completed++;
+        reportProgress();
+    }
+
+    if (status == Thing::ThingErrorNoError || status == Thing::ThingErrorPluginNotFound) {
+        // Either done, or retrying won't help unless the plugin appears
+        m_attempts.remove(thing->id());
+    } else {
+        int attempts = ++m_attempts[thing->id()];
+        int delay = retryDelay(attempts);
+        qCDebug(dcThingManager()) << "Retrying setup for" << thing << "in" << delay << "ms (attempt" << attempts + 1 << ")";
+        // The retry is dropped if the thing is removed or unscheduled in the meantime
+        QPointer<Thing> guard(thing);
+        QTimer::singleShot(delay, this, [this, running, guard](){
+            if (!guard || !m_attempts.contains(guard->id())) {
+                return;
+            }
+            enqueue(running);
+            dispatch(running.pluginId);
+        });
+    }
+
+    dispatch(running.pluginId);
+}
+
+int ThingSetupScheduler::completed() const
+{
+    return m_completed;
+}
+
+int ThingSetupScheduler::total() const
+{
+    return m_total;
+}
+
+bool ThingSetupScheduler::isReady() const
+{
+    return m_pending.isEmpty();
+}
+
+void ThingSetupScheduler::enqueue(const ThingSetupScheduler::QueueEntry &entry)
+{
+    // Entries with the same priority are set up in the order they have been scheduled
+    QueueKey key = qMakePair(-entry.priority, m_sequence++);
+    m_queues[entry.pluginId].insert(key, entry);
+    m_queuedThings.insert(entry.thing->id(), qMakePair(entry.pluginId, key));
+}
+
+void ThingSetupScheduler::dispatch(const PluginId &pluginId)
+{
+    int maxConcurrent = maxConcurrentSetups(pluginId);
+    // Not holding on to the queue, setupThing() may finish a setup and dispatch again right away
+    while (!m_queues.value(pluginId).isEmpty() && (maxConcurrent == 0 || m_running.value(pluginId) < maxConcurrent)) {
+        QMap<QueueKey, QueueEntry> &queue = m_queues[pluginId];
+        QueueEntry entry = queue.take(queue.firstKey());
+        m_queuedThings.remove(entry.thing->id());
+        m_running[pluginId]++;
+        m_runningThings.insert(entry.thing->id(), entry);
+        emit setupThing(entry.thing);
+    }
+}
+
+void ThingSetupScheduler::reportProgress()
+{
+    qCDebug(dcThingManager()) << "Thing setup progress:" << m_completed << "of" << m_total;
+    emit progress(m_completed, m_total);
+    if (m_pending.isEmpty()) {
+        qCInfo(dcThingManager()) << "Initial setup of" << m_total << "things finished after" << m_elapsed.elapsed() << "ms";
+        emit ready();
+    }
+}
+
+int ThingSetupScheduler::retryDelay(int attempts) const
+{
+    // 10s, 20s, 40s, ... up to 5 minutes
+    return qMin(300000, 10000 * (1 << qMin(attempts - 1, 5)));
+}
@@ -0,0 +1,102 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef THINGSETUPSCHEDULER_H
+#define THINGSETUPSCHEDULER_H
+
+#include "integrations/thing.h"
+
+#include <QObject>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QElapsedTimer>
+
+// Schedules the setup of things loaded from the configuration at startup. The number of setups
+// running at the same time is limited per plugin, things with children are set up first and failed
+// setups are retried with an exponential backoff.
+class ThingSetupScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThingSetupScheduler(QObject *parent = nullptr);
+
+    int maxConcurrentSetups(const PluginId &pluginId = PluginId()) const;
+    void setMaxConcurrentSetups(int maxConcurrentSetups);
+    void setMaxConcurrentSetups(const PluginId &pluginId, int maxConcurrentSetups);
+
+    void schedule(Thing *thing, int priority = 0);
+    void unschedule(const ThingId &thingId);
+    void setupFinished(Thing *thing, Thing::ThingError status);
+
+    // Progress of the current setup run. Every scheduled thing counts once, regardless of retries.
+    int completed() const;
+    int total() const;
+    bool isReady() const;
+
+signals:
+    void setupThing(Thing *thing);
+    void progress(int completed, int total);
+    // Every thing scheduled in the current run had its first setup attempt, or has been unscheduled
+    void ready();
+
+private:
+    class QueueEntry {
+    public:
+        Thing *thing = nullptr;
+        PluginId pluginId;
+        int priority = 0;
+    };
+    // Orders the queue by descending priority, then by the order things have been scheduled in
+    typedef QPair<int, quint64> QueueKey;
+
+    void enqueue(const QueueEntry &entry);
+    void dispatch(const PluginId &pluginId);
+    int retryDelay(int attempts) const;
+    void reportProgress();
+
+    int m_defaultMaxConcurrentSetups = 0;
+    QHash<PluginId, int> m_maxConcurrentSetups;
+
+    QHash<PluginId, QMap<QueueKey, QueueEntry>> m_queues;
+    QHash<ThingId, QPair<PluginId, QueueKey>> m_queuedThings;
+    quint64 m_sequence = 0;
+    QHash<PluginId, int> m_running;
+    QHash<ThingId, QueueEntry> m_runningThings;
+    QHash<ThingId, int> m_attempts;
+
+    // Progress of the initial setup run. Every thing counts once, regardless of retries.
+    QSet<ThingId> m_pending;
+    int m_completed = 0;
+    int m_total = 0;
+    QElapsedTimer m_elapsed;
+};
+
+#endif // THINGSETUPSCHEDULER_H
@@ -0,0 +1,154 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "clientsendqueue.h"
+
+namespace nymeaserver {
+
+ClientSendQueue::ClientSendQueue(qint64 maxBytes):
+    m_maxBytes(maxBytes)
+{
+
+}
+
+void ClientSendQueue::enqueue(const QByteArray &data, Priority priority, const QString &key)
+{
+    if (priority == PriorityReply) {
+        m_replies.append(data);
+        m_queuedBytes += data.size();
+    } else if (!key.isEmpty() && m_notificationKeys.contains(key)) {
+        // Keep the position of the older notification, but send the latest data
+        Entry &entry = m_notifications[static_cast<int>(m_notificationKeys.value(key) - m_firstSequence)];
+        m_queuedBytes += data.size() - entry.data.size();
+        entry.data = data;
+        m_droppedNotifications++;
+    } else {
+        Entry entry;
+        entry.data = data;
+        entry.key = key;
+        if (!key.isEmpty()) {
+            m_notificationKeys.insert(key, m_firstSequence + static_cast<quint64>(m_notifications.count()));
+        }
+        m_notifications.append(entry);
+        m_queuedBytes += data.size();
+    }
+
+    if (m_queuedBytes > m_maxBytes) {
+        dropOldNotifications();
+    }
+}
+
+QByteArray ClientSendQueue::takeNext()
+{
+    if (!m_replies.isEmpty()) {
+        QByteArray data = m_replies.takeFirst();
+        m_queuedBytes -= data.size();
+        return data;
+    }
+    if (m_notifications.isEmpty()) {
+        return QByteArray();
+    }
+
+    Entry entry = m_notifications.takeFirst();
+    m_queuedBytes -= entry.data.size();
+    m_firstSequence++;
+    if (!entry.key.isEmpty()) {
+        m_notificationKeys.remove(entry.key);
+    }
+    return entry.data;
+}
+
+QList<QByteArray> ClientSendQueue::takeAll()
+{
+    QList<QByteArray> all = m_replies;
+    foreach (const Entry &entry, m_notifications) {
+        all.append(entry.data);
+    }
+    m_firstSequence += static_cast<quint64>(m_notifications.count());
+    m_replies.clear();
+    m_notifications.clear();
+    m_notificationKeys.clear();
+    m_queuedBytes = 0;
+    return all;
+}
+
+bool ClientSendQueue::isEmpty() const
+{
+    return m_replies.isEmpty() && m_notifications.isEmpty();
+}
+
+bool ClientSendQueue::overBudget() const
+{
+    return m_queuedBytes > m_maxBytes;
+}
+
+qint64 ClientSendQueue::queuedBytes() const
+{
+    return m_queuedBytes;
+}
+
+int ClientSendQueue::queuedReplies() const
+{
+    return m_replies.count();
+}
+
+int ClientSendQueue::queuedNotifications() const
+{
+    return m_notifications.count();
+}
+
+quint64 ClientSendQueue::droppedNotifications() const
+{
+    return m_droppedNotifications;
+}
+
+void ClientSendQueue::dropOldNotifications()
+{
+    int dropCount = 0;
+    qint64 dropBytes = 0;
+    while (dropCount < m_notifications.count() && m_queuedBytes - dropBytes > m_maxBytes) {
+        const Entry &entry = m_notifications.at(dropCount);
+        dropBytes += entry.data.size();
+        if (!entry.key.isEmpty()) {
+            m_notificationKeys.remove(entry.key);
+        }
+        dropCount++;
+    }
+    if (dropCount == 0) {
+        return;
+    }
+
+    m_notifications.erase(m_notifications.begin(), m_notifications.begin() + dropCount);
+    m_firstSequence += static_cast<quint64>(dropCount);
+    m_queuedBytes -= dropBytes;
+    m_droppedNotifications += static_cast<quint64>(dropCount);
+}
+
+}
@@ -0,0 +1,90 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef CLIENTSENDQUEUE_H
+#define CLIENTSENDQUEUE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QHash>
+
+namespace nymeaserver {
+
+// Outgoing data held back for a client whose transport doesn't keep up. Replies are sent before
+// notifications. A notification queued with a key replaces an older one with the same key, so a
+// stalled client only receives the latest value once it catches up. When the queue exceeds its
+// byte budget, the oldest notifications are dropped. Replies are never dropped.
+class ClientSendQueue
+{
+public:
+    enum Priority {
+        PriorityReply,
+        PriorityNotification
+    };
+
+    explicit ClientSendQueue(qint64 maxBytes = 4 * 1024 * 1024);
+
+    void enqueue(const QByteArray &data, Priority priority, const QString &key = QString());
+    QByteArray takeNext();
+    QList<QByteArray> takeAll();
+
+    bool isEmpty() const;
+    // True if the queue is over its byte budget even after dropping all notifications
+    bool overBudget() const;
+
+    qint64 queuedBytes() const;
+    int queuedReplies() const;
+    int queuedNotifications() const;
+    quint64 droppedNotifications() const;
+
+private:
+    class Entry {
+    public:
+        QByteArray data;
+        QString key;
+    };
+
+    void dropOldNotifications();
+
+    qint64 m_maxBytes;
+    qint64 m_queuedBytes = 0;
+    QList<QByteArray> m_replies;
+    QList<Entry> m_notifications;
+    // Notifications are numbered in the order they are queued. The key index holds those sequence
+    // numbers, so taking from the front only needs to move the sequence number of the first entry.
+    quint64 m_firstSequence = 0;
+    QHash<QString, quint64> m_notificationKeys;
+    quint64 m_droppedNotifications = 0;
+};
+
+}
+
+#endif // CLIENTSENDQUEUE_H
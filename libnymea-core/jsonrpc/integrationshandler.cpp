@@ -47,13 +47,21 @@
 #include <QDebug>
 #include <QJsonDocument>
 #include <QCryptographicHash>
+#include <QSet>
 
 namespace nymeaserver {
 
+// Number of locales for which the vendor, thing class and plugin lists are kept
+static const int maxCachedLocales = 8;
+
 IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *parent) :
     JsonHandler(parent),
     m_thingManager(thingManager)
 {
+    m_vendorsCache.setMaxCost(maxCachedLocales);
+    m_thingClassesCache.setMaxCost(maxCachedLocales);
+    m_pluginsCache.setMaxCost(maxCachedLocales);
+
     // Enums
     registerEnum<Thing::ThingError>();
     registerEnum<Thing::ThingSetupStatus>();
@@ -195,9 +203,16 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     registerMethod("ConfirmPairing", description, params, returns, Types::PermissionScopeConfigureThings);
 
     params.clear(); returns.clear();
-    description = "Returns a list of configured things, optionally filtered by thingId.";
+    description = "Returns a list of configured things, optionally filtered by thingId. "
+                  "The returned revision can be passed as sinceRevision in a later call to only fetch the things which "
+                  "have been added or changed since, along with the ids of the things removed in the meantime. Such "
+                  "a delta reply is indicated by the presence of removedThingIds. If the server can't provide the changes "
+                  "since the given revision, the full list of things is returned instead.";
     params.insert("o:thingId", enumValueName(Uuid));
+    params.insert("o:sinceRevision", enumValueName(String));
     returns.insert("o:things", objectRef<Things>());
+    returns.insert("o:removedThingIds", QVariantList() << enumValueName(Uuid));
+    returns.insert("o:revision", enumValueName(String));
     returns.insert("thingError", enumRef<Thing::ThingError>());
     registerMethod("GetThings", description, params, returns, Types::PermissionScopeNone);
 
@@ -478,49 +493,8 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     connect(m_thingManager, &ThingManager::thingChanged, this, &IntegrationsHandler::thingChangedNotification);
     connect(m_thingManager, &ThingManager::thingSettingChanged, this, &IntegrationsHandler::thingSettingChangedNotification);
 
-    connect(m_thingManager, &ThingManager::loaded, this, [=](){
-        // Generating cache hashes.
-        // NOTE: We need to sort the lists to get a stable result
-        QHash<ThingClassId, ThingClass> thingClassesMap;
-        foreach (const ThingClass &tc, m_thingManager->supportedThings()) {
-            thingClassesMap.insert(tc.id(), tc);
-        }
-        QList<ThingClassId> thingClassIds = thingClassesMap.keys();
-        std::sort(thingClassIds.begin(), thingClassIds.end());
-        QVariantList thingClasses;
-        foreach (const ThingClassId &id, thingClassIds) {
-            thingClasses.append(pack(thingClassesMap.value(id)));
-        }
-        QByteArray hash = QCryptographicHash::hash(QJsonDocument::fromVariant(thingClasses).toJson(), QCryptographicHash::Md5).toHex();
-        m_cacheHashes.insert("GetThingClasses", hash);
-
-        QHash<VendorId, Vendor> vendorsMap;
-        foreach (const Vendor &v, m_thingManager->supportedVendors()) {
-            vendorsMap.insert(v.id(), v);
-        }
-        QList<VendorId> vendorIds = vendorsMap.keys();
-        std::sort(vendorIds.begin(), vendorIds.end());
-        QVariantList vendors;
-        foreach (const VendorId &id, vendorIds) {
-            vendors.append(pack(vendorsMap.value(id)));
-        }
-        hash = QCryptographicHash::hash(QJsonDocument::fromVariant(vendors).toJson(), QCryptographicHash::Md5).toHex();
-        m_cacheHashes.insert("GetVendors", hash);
-
-        QHash<PluginId, IntegrationPlugin*> pluginsMap;
-
-        foreach (IntegrationPlugin *p, m_thingManager->plugins()) {
-            pluginsMap.insert(p->pluginId(), p);
-        }
-        QList<PluginId> pluginIds = pluginsMap.keys();
-        std::sort(pluginIds.begin(), pluginIds.end());
-        QVariantList pluginList;
-        foreach (const PluginId &pluginId, pluginIds) {
-            pluginList.append(pack(*(pluginsMap.value(pluginId))));
-        }
-        hash = QCryptographicHash::hash(QJsonDocument::fromVariant(pluginList).toJson(), QCryptographicHash::Md5).toHex();
-        m_cacheHashes.insert("GetPlugins", hash);
-    });
+    connect(m_thingManager, &ThingManager::loaded, this, &IntegrationsHandler::pluginsChanged);
+    connect(m_thingManager, &ThingManager::pluginActivated, this, &IntegrationsHandler::pluginsChanged);
 }
 
 QString IntegrationsHandler::name() const
@@ -536,44 +510,60 @@ QHash<QString, QString> IntegrationsHandler::cacheHashes() const
 JsonReply* IntegrationsHandler::GetVendors(const QVariantMap &params, const JsonContext &context) const
 {
     Q_UNUSED(params)
-    QVariantList vendors;
-    foreach (const Vendor &vendor, m_thingManager->supportedVendors()) {
-        Vendor translatedVendor = m_thingManager->translateVendor(vendor, context.locale());
-        vendors.append(pack(translatedVendor));
+    QString localeName = context.locale().name();
+    QVariantList *vendors = m_vendorsCache.object(localeName);
+    if (!vendors) {
+        vendors = new QVariantList();
+        foreach (const Vendor &vendor, m_thingManager->supportedVendors()) {
+            Vendor translatedVendor = m_thingManager->translateVendor(vendor, context.locale());
+            vendors->append(pack(translatedVendor));
+        }
+        m_vendorsCache.insert(localeName, vendors);
     }
 
     QVariantMap returns;
-    returns.insert("vendors", vendors);
-    return createReply(returns);
+    returns.insert("vendors", *vendors);
+    return createCachedReply("GetVendors", localeName, returns);
 }
 
 JsonReply* IntegrationsHandler::GetThingClasses(const QVariantMap &params, const JsonContext &context) const
 {
+    QString localeName = context.locale().name();
+    QVariantList *cachedThingClasses = m_thingClassesCache.object(localeName);
+    if (!cachedThingClasses) {
+        cachedThingClasses = new QVariantList();
+        foreach (const ThingClass &thingClass, m_thingManager->supportedThings()) {
+            ThingClass translatedThingClass = m_thingManager->translateThingClass(thingClass, context.locale());
+            cachedThingClasses->append(pack(translatedThingClass));
+        }
+        m_thingClassesCache.insert(localeName, cachedThingClasses);
+    }
+
     QVariantMap returns;
-    QVariantList thingClasses;
+    returns.insert("thingError", enumValueName(Thing::ThingErrorNoError));
+
+    if (!params.contains("vendorId") && !params.contains("thingClassIds")) {
+        returns.insert("thingClasses", *cachedThingClasses);
+        return createCachedReply("GetThingClasses", localeName, returns);
+    }
+
+    QSet<ThingClassId> thingClassIds;
+    foreach (const QString &tcString, params.value("thingClassIds").toStringList()) {
+        thingClassIds.insert(ThingClassId(tcString));
+    }
 
-    foreach (const ThingClass &thingClass, m_thingManager->supportedThings()) {
-        if (params.contains("vendorId") && thingClass.vendorId() != VendorId(params.value("vendorId").toUuid())) {
+    QVariantList thingClasses;
+    foreach (const QVariant &packedThingClass, *cachedThingClasses) {
+        QVariantMap thingClassMap = packedThingClass.toMap();
+        if (params.contains("vendorId") && thingClassMap.value("vendorId").toUuid() != params.value("vendorId").toUuid()) {
             continue;
         }
-        if (params.contains("thingClassIds")) {
-            bool found = false;
-            foreach (const QString &tcString, params.value("thingClassIds").toStringList()) {
-                if (ThingClassId(tcString) == thingClass.id()) {
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                continue;
-            }
+        if (params.contains("thingClassIds") && !thingClassIds.contains(ThingClassId(thingClassMap.value("id").toUuid()))) {
+            continue;
         }
-
-        ThingClass translatedThingClass = m_thingManager->translateThingClass(thingClass, context.locale());
-        thingClasses.append(pack(translatedThingClass));
+        thingClasses.append(packedThingClass);
     }
 
-    returns.insert("thingError", enumValueName(Thing::ThingErrorNoError));
     returns.insert("thingClasses", thingClasses);
     return createReply(returns);
 }
@@ -615,16 +605,21 @@ JsonReply *IntegrationsHandler::DiscoverThings(const QVariantMap &params, const
 JsonReply* IntegrationsHandler::GetPlugins(const QVariantMap &params, const JsonContext &context) const
 {
     Q_UNUSED(params)
-    QVariantList plugins;
-    foreach (IntegrationPlugin* plugin, m_thingManager->plugins()) {
-        QVariantMap packedPlugin = pack(*plugin).toMap();
-        packedPlugin["displayName"] = m_thingManager->translate(plugin->pluginId(), plugin->pluginDisplayName(), context.locale());
-        plugins.append(packedPlugin);
+    QString localeName = context.locale().name();
+    QVariantList *plugins = m_pluginsCache.object(localeName);
+    if (!plugins) {
+        plugins = new QVariantList();
+        foreach (IntegrationPlugin* plugin, m_thingManager->plugins()) {
+            QVariantMap packedPlugin = pack(*plugin).toMap();
+            packedPlugin["displayName"] = m_thingManager->translate(plugin->pluginId(), plugin->pluginDisplayName(), context.locale());
+            plugins->append(packedPlugin);
+        }
+        m_pluginsCache.insert(localeName, plugins);
     }
 
     QVariantMap returns;
-    returns.insert("plugins", plugins);
-    return createReply(returns);
+    returns.insert("plugins", *plugins);
+    return createCachedReply("GetPlugins", localeName, returns);
 }
 
 JsonReply *IntegrationsHandler::GetPluginConfiguration(const QVariantMap &params) const
@@ -780,26 +775,34 @@ JsonReply* IntegrationsHandler::GetThings(const QVariantMap &params, const JsonC
         if (!thing) {
             returns.insert("thingError", enumValueName<Thing::ThingError>(Thing::ThingErrorThingNotFound));
             return createReply(returns);
-        } else {
-            QVariantMap packedThing = pack(thing).toMap();
-            QString translatedSetupStatus = m_thingManager->translate(thing->pluginId(), thing->setupDisplayMessage(), context.locale());
-            if (!translatedSetupStatus.isEmpty()) {
-                packedThing["setupDisplayMessage"] = translatedSetupStatus;
+        }
+        things.append(packThing(thing, context.locale()));
+        returns.insert("thingError", enumValueName<Thing::ThingError>(Thing::ThingErrorNoError));
+        returns.insert("things", things);
+        returns.insert("revision", m_changeJournal.revision());
+        return createReply(returns);
+    }
+
+    QList<ThingId> changedThingIds;
+    if (params.contains("sinceRevision") && m_changeJournal.changesSince(params.value("sinceRevision").toString(), &changedThingIds)) {
+        QVariantList removedThingIds;
+        foreach (const ThingId &thingId, changedThingIds) {
+            Thing *thing = m_thingManager->findConfiguredThing(thingId);
+            if (thing) {
+                things.append(packThing(thing, context.locale()));
+            } else {
+                removedThingIds.append(thingId);
             }
-            things.append(packedThing);
         }
+        returns.insert("removedThingIds", removedThingIds);
     } else {
         foreach (Thing *thing, m_thingManager->configuredThings()) {
-            QVariantMap packedThing = pack(thing).toMap();
-            QString translatedSetupStatus = m_thingManager->translate(thing->pluginId(), thing->setupDisplayMessage(), context.locale());
-            if (!translatedSetupStatus.isEmpty()) {
-                packedThing["setupDisplayMessage"] = translatedSetupStatus;
-            }
-            things.append(packedThing);
+            things.append(packThing(thing, context.locale()));
         }
     }
     returns.insert("thingError", enumValueName<Thing::ThingError>(Thing::ThingErrorNoError));
     returns.insert("things", things);
+    returns.insert("revision", m_changeJournal.revision());
     return createReply(returns);
 }
 
@@ -1152,6 +1155,8 @@ void IntegrationsHandler::pluginConfigChanged(const PluginId &id, const ParamLis
 
 void IntegrationsHandler::thingStateChanged(Thing *thing, const QUuid &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue, const QVariantList &possibleValues)
 {
+    m_changeJournal.record(thing->id());
+
     QVariantMap params;
     params.insert("thingId", thing->id());
     params.insert("stateTypeId", stateTypeId);
@@ -1164,6 +1169,8 @@ void IntegrationsHandler::thingStateChanged(Thing *thing, const QUuid &stateType
 
 void IntegrationsHandler::thingRemovedNotification(const ThingId &thingId)
 {
+    m_changeJournal.record(thingId);
+
     QVariantMap params;
     params.insert("thingId", thingId);
     emit ThingRemoved(params);
@@ -1171,6 +1178,8 @@ void IntegrationsHandler::thingRemovedNotification(const ThingId &thingId)
 
 void IntegrationsHandler::thingAddedNotification(Thing *thing)
 {
+    m_changeJournal.record(thing->id());
+
     QVariantMap params;
     params.insert("thing", pack(thing));
     emit ThingAdded(params);
@@ -1178,6 +1187,8 @@ void IntegrationsHandler::thingAddedNotification(Thing *thing)
 
 void IntegrationsHandler::thingChangedNotification(Thing *thing)
 {
+    m_changeJournal.record(thing->id());
+
     QVariantMap params;
     params.insert("thing", pack(thing));
     emit ThingChanged(params);
@@ -1185,6 +1196,8 @@ void IntegrationsHandler::thingChangedNotification(Thing *thing)
 
 void IntegrationsHandler::thingSettingChangedNotification(const ThingId &thingId, const ParamTypeId &paramTypeId, const QVariant &value)
 {
+    m_changeJournal.record(thingId);
+
     QVariantMap params;
     params.insert("thingId", thingId);
     params.insert("paramTypeId", paramTypeId.toString());
@@ -1192,6 +1205,73 @@ void IntegrationsHandler::thingSettingChangedNotification(const ThingId &thingId
     emit ThingSettingChanged(params);
 }
 
+void IntegrationsHandler::pluginsChanged()
+{
+    m_vendorsCache.clear();
+    m_thingClassesCache.clear();
+    m_pluginsCache.clear();
+    m_cacheGeneration++;
+
+    // Generating cache hashes.
+    // NOTE: We need to sort the lists to get a stable result
+    QHash<ThingClassId, ThingClass> thingClassesMap;
+    foreach (const ThingClass &tc, m_thingManager->supportedThings()) {
+        thingClassesMap.insert(tc.id(), tc);
+    }
+    QList<ThingClassId> thingClassIds = thingClassesMap.keys();
+    std::sort(thingClassIds.begin(), thingClassIds.end());
+    QVariantList thingClasses;
+    foreach (const ThingClassId &id, thingClassIds) {
+        thingClasses.append(pack(thingClassesMap.value(id)));
+    }
+    QByteArray hash = QCryptographicHash::hash(QJsonDocument::fromVariant(thingClasses).toJson(), QCryptographicHash::Md5).toHex();
+    m_cacheHashes.insert("GetThingClasses", hash);
+
+    QHash<VendorId, Vendor> vendorsMap;
+    foreach (const Vendor &v, m_thingManager->supportedVendors()) {
+        vendorsMap.insert(v.id(), v);
+    }
+    QList<VendorId> vendorIds = vendorsMap.keys();
+    std::sort(vendorIds.begin(), vendorIds.end());
+    QVariantList vendors;
+    foreach (const VendorId &id, vendorIds) {
+        vendors.append(pack(vendorsMap.value(id)));
+    }
+    hash = QCryptographicHash::hash(QJsonDocument::fromVariant(vendors).toJson(), QCryptographicHash::Md5).toHex();
+    m_cacheHashes.insert("GetVendors", hash);
+
+    QHash<PluginId, IntegrationPlugin*> pluginsMap;
+
+    foreach (IntegrationPlugin *p, m_thingManager->plugins()) {
+        pluginsMap.insert(p->pluginId(), p);
+    }
+    QList<PluginId> pluginIds = pluginsMap.keys();
+    std::sort(pluginIds.begin(), pluginIds.end());
+    QVariantList pluginList;
+    foreach (const PluginId &pluginId, pluginIds) {
+        pluginList.append(pack(*(pluginsMap.value(pluginId))));
+    }
+    hash = QCryptographicHash::hash(QJsonDocument::fromVariant(pluginList).toJson(), QCryptographicHash::Md5).toHex();
+    m_cacheHashes.insert("GetPlugins", hash);
+}
+
+JsonReply *IntegrationsHandler::createCachedReply(const QString &method, const QString &localeName, const QVariantMap &data) const
+{
+    JsonReply *reply = createReply(data);
+    reply->setCacheKey(QString("%1.%2/%3/%4").arg(name(), method, localeName).arg(m_cacheGeneration));
+    return reply;
+}
+
+QVariantMap IntegrationsHandler::packThing(Thing *thing, const QLocale &locale) const
+{
+    QVariantMap packedThing = pack(thing).toMap();
+    QString translatedSetupStatus = m_thingManager->translate(thing->pluginId(), thing->setupDisplayMessage(), locale);
+    if (!translatedSetupStatus.isEmpty()) {
+        packedThing["setupDisplayMessage"] = translatedSetupStatus;
+    }
+    return packedThing;
+}
+
 QVariantMap IntegrationsHandler::statusToReply(Thing::ThingError status) const
 {
     QVariantMap returns;
@@ -33,6 +33,9 @@
 
 #include "jsonrpc/jsonhandler.h"
 #include "integrations/thingmanager.h"
+#include "thingchangejournal.h"
+
+#include <QCache>
 
 namespace nymeaserver {
 
@@ -107,11 +110,25 @@ private slots:
 
     void thingSettingChangedNotification(const ThingId &thingId, const ParamTypeId &paramTypeId, const QVariant &value);
 
+    void pluginsChanged();
+
 private:
     ThingManager *m_thingManager = nullptr;
     QVariantMap statusToReply(Thing::ThingError status) const;
+    QVariantMap packThing(Thing *thing, const QLocale &locale) const;
 
     QHash<QString, QString> m_cacheHashes;
+    ThingChangeJournal m_changeJournal;
+
+    // Packed and translated vendors, thing classes and plugins per locale name, for the most recently
+    // used locales. Those only change when plugins are loaded or activated, together with the cache hashes.
+    mutable QCache<QString, QVariantList> m_vendorsCache;
+    mutable QCache<QString, QVariantList> m_thingClassesCache;
+    mutable QCache<QString, QVariantList> m_pluginsCache;
+    // Part of the reply cache keys, so the server drops its serialized replies along with the caches above
+    int m_cacheGeneration = 0;
+
+    JsonReply *createCachedReply(const QString &method, const QString &localeName, const QVariantMap &data) const;
 };
 
 }
@@ -0,0 +1,191 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "jsonframer.h"
+
+#include <QPair>
+
+namespace nymeaserver {
+
+static inline bool isJsonWhitespace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+JsonFramer::JsonFramer(int maxFrameSize):
+    m_maxFrameSize(maxFrameSize)
+{
+
+}
+
+QList<QByteArray> JsonFramer::feed(const QByteArray &data)
+{
+    if (m_buffer.isEmpty()) {
+        m_buffer = data;
+    } else {
+        m_buffer.append(data);
+    }
+
+    const char *buffer = m_buffer.constData();
+    const int size = m_buffer.size();
+
+    // Everything before consumed belongs to completed frames or whitespace and can be dropped
+    int consumed = 0;
+    bool skipped = false;
+    QList<QPair<int, int> > frames;
+
+    for (int i = m_scanPosition; i < size; i++) {
+        char c = buffer[i];
+
+        if (m_skipLine) {
+            // The start of this line has been handed out as garbage already
+            m_skipLine = c != '\n';
+            consumed = i + 1;
+            skipped = true;
+            continue;
+        }
+
+        if (m_frameStart < 0) {
+            if (isJsonWhitespace(c)) {
+                consumed = i + 1;
+                continue;
+            }
+            m_frameStart = i;
+            m_depth = 1;
+            // Anything else than an object or array is garbage up to the end of the line
+            m_garbage = c != '{' && c != '[';
+            continue;
+        }
+
+        if (m_garbage || (m_inString && c == '\n')) {
+            // Raw newlines are not allowed in JSON strings either. Hand out what we have
+            // and resync on the next line.
+            if (c == '\n') {
+                frames.append(qMakePair(m_frameStart, i + 1 - m_frameStart));
+                consumed = i + 1;
+                m_frameStart = -1;
+                m_garbage = false;
+                m_inString = false;
+                m_escaped = false;
+            }
+            continue;
+        }
+
+        if (m_inString) {
+            if (m_escaped) {
+                m_escaped = false;
+            } else if (c == '\\') {
+                m_escaped = true;
+            } else if (c == '"') {
+                m_inString = false;
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            m_inString = true;
+            break;
+        case '{':
+        case '[':
+            m_depth++;
+            break;
+        case '}':
+        case ']':
+            m_depth--;
+            if (m_depth == 0) {
+                frames.append(qMakePair(m_frameStart, i + 1 - m_frameStart));
+                m_frameStart = -1;
+                consumed = i + 1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Garbage can't turn into a valid message, don't wait for the end of its line to report it
+    if (m_frameStart >= 0 && m_garbage) {
+        frames.append(qMakePair(m_frameStart, size - m_frameStart));
+        consumed = size;
+        m_frameStart = -1;
+        m_garbage = false;
+        m_skipLine = true;
+    }
+    m_scanPosition = size;
+
+    QList<QByteArray> ret;
+    if (frames.count() == 1 && consumed == size && !skipped) {
+        // The common case of one message per read. Surrounding whitespace is fine for the
+        // parser, so hand out the buffer itself instead of copying.
+        ret.append(m_buffer);
+    } else {
+        for (int i = 0; i < frames.count(); i++) {
+            ret.append(m_buffer.mid(frames.at(i).first, frames.at(i).second));
+        }
+    }
+
+    if (consumed == size) {
+        m_buffer.clear();
+        m_scanPosition = 0;
+    } else if (consumed > 0) {
+        m_buffer.remove(0, consumed);
+        m_scanPosition -= consumed;
+        if (m_frameStart >= 0) {
+            m_frameStart -= consumed;
+        }
+    }
+
+    return ret;
+}
+
+bool JsonFramer::overflow() const
+{
+    return m_buffer.size() > m_maxFrameSize;
+}
+
+int JsonFramer::bufferedSize() const
+{
+    return m_buffer.size();
+}
+
+void JsonFramer::reset()
+{
+    m_buffer.clear();
+    m_scanPosition = 0;
+    m_frameStart = -1;
+    m_depth = 0;
+    m_inString = false;
+    m_escaped = false;
+    m_garbage = false;
+    m_skipLine = false;
+}
+
+}
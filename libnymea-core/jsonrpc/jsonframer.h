@@ -0,0 +1,74 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef JSONFRAMER_H
+#define JSONFRAMER_H
+
+#include <QByteArray>
+#include <QList>
+
+namespace nymeaserver {
+
+// Incrementally splits a stream of concatenated JSON objects (or arrays) into single messages.
+// Brackets inside strings are ignored. The scan state is kept between calls so every byte
+// is looked at only once, regardless of how the stream is fragmented.
+class JsonFramer
+{
+public:
+    explicit JsonFramer(int maxFrameSize = 1024 * 1024);
+
+    // Appends data and returns all top level JSON values completed by it. Data containing a raw
+    // newline within a string is returned up to the end of the line as a frame of its own so the
+    // parser can report the error. Data not starting with an object or array is returned right
+    // away, the rest of its line is dropped without waiting for more.
+    QList<QByteArray> feed(const QByteArray &data);
+
+    // True if the buffered incomplete data exceeds the maximum frame size
+    bool overflow() const;
+    int bufferedSize() const;
+
+    void reset();
+
+private:
+    int m_maxFrameSize;
+
+    QByteArray m_buffer;
+    int m_scanPosition = 0;
+    int m_frameStart = -1;
+    int m_depth = 0;
+    bool m_inString = false;
+    bool m_escaped = false;
+    bool m_garbage = false;
+    bool m_skipLine = false;
+};
+
+}
+
+#endif // JSONFRAMER_H
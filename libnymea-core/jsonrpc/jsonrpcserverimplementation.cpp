@@ -76,9 +76,22 @@
 #include <QJsonDocument>
 #include <QStringList>
 #include <QSslConfiguration>
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#include <QCborStreamReader>
+#endif
 
 namespace nymeaserver {
 
+// Outgoing data is queued once a transport has more than the high watermark pending, and written
+// again when it drops below the low watermark. Clients over budget for the grace period are dropped.
+static const qint64 sendQueueHighWatermark = 256 * 1024;
+static const qint64 sendQueueLowWatermark = 64 * 1024;
+static const qint64 sendQueueMaxBytes = 4 * 1024 * 1024;
+static const qint64 sendQueueGracePeriod = 30000;
+// Serialized replies kept for the cacheable methods, one per method, locale and encoding
+static const int maxCachedReplies = 32;
+
 /*! Constructs a \l{JsonRPCServer} with the given \a sslConfiguration and \a parent. */
 JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration &sslConfiguration, QObject *parent):
     JsonHandler(parent),
@@ -90,6 +103,8 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     // Enums
     registerEnum<BasicType>();
     registerEnum<UserManager::UserError>();
+    registerEnum<Encoding>();
+    registerEnum<Compression>();
     registerFlag<Types::PermissionScope, Types::PermissionScopes>();
 
     // Objects
@@ -105,6 +120,19 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     cacheHash.insert("hash", enumValueName(String));
     registerObject("CacheHash", cacheHash);
 
+    QVariantMap notificationFilter;
+    notificationFilter.insert("o:notifications", enumValueName(StringList));
+    notificationFilter.insert("o:thingIds", QVariantList() << enumValueName(Uuid));
+    notificationFilter.insert("o:stateTypeIds", QVariantList() << enumValueName(Uuid));
+    notificationFilter.insert("o:interfaces", enumValueName(StringList));
+    registerObject("NotificationFilter", notificationFilter);
+
+    QVariantMap notificationThrottlingRule;
+    notificationThrottlingRule.insert("o:thingId", enumValueName(Uuid));
+    notificationThrottlingRule.insert("o:stateTypeId", enumValueName(Uuid));
+    notificationThrottlingRule.insert("interval", enumValueName(Int));
+    registerObject("NotificationThrottlingRule", notificationThrottlingRule);
+
     // Methods
     QString description; QVariantMap returns; QVariantMap params;
     description = "Initiates a connection. Use this method to perform an initial handshake of the "
@@ -120,8 +148,19 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
                             "a method does not change, a client may use a previously cached copy of the call instead of "
                             "fetching the content again. While the Hello call doesn't necessarily require a token, this "
                             "can be called with a token. If a token is provided, it will be verified and the reply contains "
-                            "information about the tokens validity and the user and permissions for the given token.";
+                            "information about the tokens validity and the user and permissions for the given token.\n "
+                            "The optional encoding parameter allows to switch this connection to CBOR encoding on transports "
+                            "supporting binary data. The reply to this call is still sent in the current encoding, all following "
+                            "messages in both directions use the encoding returned in the reply. UUIDs are encoded as binary UUIDs "
+                            "in CBOR messages. Clients must wait for the reply before sending data in the new encoding.\n "
+                            "The optional compression parameter allows to enable compression of the data sent by the server on "
+                            "transports supporting it. As with the encoding, the reply to this call is still sent uncompressed. "
+                            "With CompressionDeflate, all following data is sent as one continuous zlib stream which is flushed "
+                            "after each message. On WebSocket connections each message is sent in a binary frame containing the "
+                            "next segment of that stream. Data sent by the client is never compressed.";
     params.insert("o:locale", enumValueName(String));
+    params.insert("o:encoding", enumRef<Encoding>());
+    params.insert("o:compression", enumRef<Compression>());
     returns.insert("server", enumValueName(String));
     returns.insert("name", enumValueName(String));
     returns.insert("version", enumValueName(String));
@@ -132,6 +171,8 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     returns.insert("initialSetupRequired", enumValueName(Bool));
     returns.insert("authenticationRequired", enumValueName(Bool));
     returns.insert("pushButtonAuthAvailable", enumValueName(Bool));
+    returns.insert("encoding", enumRef<Encoding>());
+    returns.insert("compression", enumRef<Compression>());
     returns.insert("o:experiences", QVariantList() << objectRef("Experience"));
     returns.insert("o:cacheHashes", QVariantList() << objectRef("CacheHash"));
     returns.insert("o:authenticated", enumValueName(Bool));
@@ -169,6 +210,31 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     returns.insert("d:enabled", enumValueName(Bool));
     registerMethod("SetNotificationStatus", description, params, returns, Types::PermissionScopeNone);
 
+    params.clear(); returns.clear();
+    description = "Limit the notifications sent to this connection to those matching any of the given filters. "
+                  "This is applied in addition to the namespaces enabled with SetNotificationStatus. A filter "
+                  "matches a notification if all of its given fields match: \"notifications\" lists full "
+                  "notification names (e.g. \"Integrations.StateChanged\"), \"thingIds\" and \"interfaces\" "
+                  "select the thing the notification is about and \"stateTypeIds\" limits notifications "
+                  "carrying a stateTypeId. Notifications not related to any thing will only match filters "
+                  "without \"thingIds\" and \"interfaces\". An empty list removes all filters.";
+    params.insert("filters", QVariantList() << objectRef("NotificationFilter"));
+    returns.insert("filters", QVariantList() << objectRef("NotificationFilter"));
+    registerMethod("SetNotificationFilters", description, params, returns, Types::PermissionScopeNone);
+
+    params.clear(); returns.clear();
+    description = "Limit the rate of state change notifications sent to this connection. \"interval\" gives the "
+                  "minimum time in milliseconds between two notifications for the same state of a thing. State "
+                  "changes happening faster are coalesced and only the latest value is sent once the interval "
+                  "has passed, so no final value is lost. \"rules\" allow overriding the interval for specific "
+                  "things, states or states of a thing. The most specific rule applies. An interval of 0 disables "
+                  "throttling.";
+    params.insert("o:interval", enumValueName(Int));
+    params.insert("o:rules", QVariantList() << objectRef("NotificationThrottlingRule"));
+    returns.insert("interval", enumValueName(Int));
+    returns.insert("rules", QVariantList() << objectRef("NotificationThrottlingRule"));
+    registerMethod("SetNotificationThrottling", description, params, returns, Types::PermissionScopeNone);
+
     params.clear(); returns.clear();
     description = "Create a new user in the API. This is only allowed to be called when the initial setup is required. "
                   "To create additional users, use Users.CreateUser instead. Call Authenticate after this to obtain a "
@@ -234,6 +300,19 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
 
     m_connectionLockdownTimer.setSingleShot(true);
     m_connectionLockdownTimer.setInterval(3000);
+
+    m_notificationClock.start();
+    m_notificationFlushTimer.setInterval(50);
+    connect(&m_notificationFlushTimer, &QTimer::timeout, this, &JsonRPCServerImplementation::flushThrottledNotifications);
+    m_sendQueueTimer.setInterval(1000);
+    connect(&m_sendQueueTimer, &QTimer::timeout, this, &JsonRPCServerImplementation::checkSendQueues);
+    m_replyCache.setMaxCost(maxCachedReplies);
+
+    // Replies and notifications are generated by the server itself. Validating them is a development aid
+    // which is always enabled in debug builds and can be enabled in release builds for troubleshooting.
+#ifdef QT_NO_DEBUG
+    m_validateOutgoing = qEnvironmentVariableIsSet("NYMEA_JSONRPC_VALIDATE_OUTGOING");
+#endif
 }
 
 /*! Returns the \e namespace of \l{JsonHandler}. */
@@ -252,6 +331,36 @@ JsonReply *JsonRPCServerImplementation::Hello(const QVariantMap &params, const J
         m_clientLocales.insert(clientId, QLocale(params.value("locale").toString()));
     }
 
+    Encoding encoding = m_clientEncodings.value(clientId, EncodingJson);
+    if (params.contains("encoding")) {
+        encoding = enumNameToValue<Encoding>(params.value("encoding").toString());
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+        if (encoding == EncodingCbor) {
+            qCDebug(dcJsonRpc()) << "Client" << clientId << "requested CBOR encoding but it requires Qt 5.12.";
+            encoding = EncodingJson;
+        }
+#endif
+        if (encoding == EncodingCbor && !interface->supportsBinaryData()) {
+            qCDebug(dcJsonRpc()) << "Client" << clientId << "requested CBOR encoding but the transport does not support binary data.";
+            encoding = EncodingJson;
+        }
+        if (encoding != m_clientEncodings.value(clientId, EncodingJson)) {
+            m_pendingEncodings.insert(clientId, encoding);
+        }
+    }
+
+    Compression compression = m_clientCompressions.value(clientId, CompressionNone);
+    if (params.contains("compression")) {
+        compression = enumNameToValue<Compression>(params.value("compression").toString());
+        if (compression == CompressionDeflate && !interface->supportsCompression()) {
+            qCDebug(dcJsonRpc()) << "Client" << clientId << "requested compression but the transport does not support it.";
+            compression = CompressionNone;
+        }
+        if (compression != m_clientCompressions.value(clientId, CompressionNone)) {
+            m_pendingCompressions.insert(clientId, compression);
+        }
+    }
+
     qCDebug(dcJsonRpc()) << "Client" << clientId << "initiated handshake." << m_clientLocales.value(clientId);
 
     // If we waited for the handshake, here it is. Remove the timer...
@@ -272,6 +381,8 @@ JsonReply *JsonRPCServerImplementation::Hello(const QVariantMap &params, const J
     handshake.insert("initialSetupRequired", (interface->configuration().authenticationEnabled ? NymeaCore::instance()->userManager()->initRequired() : false));
     handshake.insert("authenticationRequired", interface->configuration().authenticationEnabled);
     handshake.insert("pushButtonAuthAvailable", NymeaCore::instance()->userManager()->pushButtonAuthAvailable());
+    handshake.insert("encoding", enumValueName(encoding));
+    handshake.insert("compression", enumValueName(compression));
     if (!m_experiences.isEmpty()) {
         QVariantList experiences;
         foreach (JsonHandler* handler, m_experiences.keys()) {
@@ -360,7 +471,15 @@ JsonReply* JsonRPCServerImplementation::SetNotificationStatus(const QVariantMap
         }
     }
     qCDebug(dcJsonRpc()) << "Notification settings for client" << clientId << ":" << enabledNamespaces;
+    foreach (const QString &namespaceName, m_clientNotifications.value(clientId)) {
+        m_notificationSubscribers[namespaceName].remove(clientId);
+        m_unfilteredSubscribers[namespaceName].remove(clientId);
+    }
+    foreach (const QString &namespaceName, enabledNamespaces) {
+        m_notificationSubscribers[namespaceName].insert(clientId);
+    }
     m_clientNotifications[clientId] = enabledNamespaces;
+    updateUnfilteredSubscriber(clientId);
 
     QVariantMap returns;
     returns.insert("namespaces", m_clientNotifications[clientId]);
@@ -369,6 +488,60 @@ JsonReply* JsonRPCServerImplementation::SetNotificationStatus(const QVariantMap
     return createReply(returns);
 }
 
+JsonReply *JsonRPCServerImplementation::SetNotificationFilters(const QVariantMap &params, const JsonContext &context)
+{
+    QUuid clientId = context.clientId();
+
+    QList<NotificationSubscriptions::Filter> filters;
+    foreach (const QVariant &filterVariant, params.value("filters").toList()) {
+        filters.append(NotificationSubscriptions::Filter::fromMap(filterVariant.toMap()));
+    }
+    m_notificationSubscriptions.setFilters(clientId, filters);
+    updateUnfilteredSubscriber(clientId);
+    qCDebug(dcJsonRpc()) << "Notification filters for client" << clientId << ":" << params.value("filters").toList();
+
+    QVariantList filterList;
+    foreach (const NotificationSubscriptions::Filter &filter, m_notificationSubscriptions.filters(clientId)) {
+        filterList.append(filter.toMap());
+    }
+    QVariantMap returns;
+    returns.insert("filters", filterList);
+    return createReply(returns);
+}
+
+JsonReply *JsonRPCServerImplementation::SetNotificationThrottling(const QVariantMap &params, const JsonContext &context)
+{
+    QUuid clientId = context.clientId();
+
+    NotificationThrottle throttle = m_notificationThrottles.value(clientId);
+    throttle.setInterval(params.value("interval").toInt());
+    QList<NotificationThrottle::Rule> rules;
+    foreach (const QVariant &ruleVariant, params.value("rules").toList()) {
+        rules.append(NotificationThrottle::Rule::fromMap(ruleVariant.toMap()));
+    }
+    throttle.setRules(rules);
+
+    // Don't hold back anything when throttling is disabled
+    if (!throttle.isEnabled()) {
+        foreach (const QByteArray &data, throttle.takePending(m_notificationClock.elapsed())) {
+            sendClientData(m_clientTransports.value(clientId), clientId, data, ClientSendQueue::PriorityNotification);
+        }
+        m_notificationThrottles.remove(clientId);
+    } else {
+        m_notificationThrottles.insert(clientId, throttle);
+    }
+    qCDebug(dcJsonRpc()) << "Notification throttling for client" << clientId << ":" << throttle.interval() << "ms," << rules.count() << "rules";
+
+    QVariantList ruleList;
+    foreach (const NotificationThrottle::Rule &rule, throttle.rules()) {
+        ruleList.append(rule.toMap());
+    }
+    QVariantMap returns;
+    returns.insert("interval", throttle.interval());
+    returns.insert("rules", ruleList);
+    return createReply(returns);
+}
+
 JsonReply *JsonRPCServerImplementation::CreateUser(const QVariantMap &params)
 {
     QString username = params.value("username").toString();
@@ -457,6 +630,7 @@ void JsonRPCServerImplementation::registerTransportInterface(TransportInterface
     connect(interface, &TransportInterface::clientConnected, this, &JsonRPCServerImplementation::clientConnected);
     connect(interface, &TransportInterface::clientDisconnected, this, &JsonRPCServerImplementation::clientDisconnected);
     connect(interface, &TransportInterface::dataAvailable, this, &JsonRPCServerImplementation::processData);
+    connect(interface, &TransportInterface::bytesWritten, this, &JsonRPCServerImplementation::drainSendQueue);
 }
 
 void JsonRPCServerImplementation::unregisterTransportInterface(TransportInterface *interface)
@@ -464,6 +638,7 @@ void JsonRPCServerImplementation::unregisterTransportInterface(TransportInterfac
     disconnect(interface, &TransportInterface::clientConnected, this, &JsonRPCServerImplementation::clientConnected);
     disconnect(interface, &TransportInterface::clientDisconnected, this, &JsonRPCServerImplementation::clientDisconnected);
     disconnect(interface, &TransportInterface::dataAvailable, this, &JsonRPCServerImplementation::processData);
+    disconnect(interface, &TransportInterface::bytesWritten, this, &JsonRPCServerImplementation::drainSendQueue);
     foreach (const QUuid &clientId, m_clientTransports.keys(interface)) {
         interface->terminateClientConnection(clientId);
         clientDisconnected(clientId);
@@ -493,9 +668,7 @@ void JsonRPCServerImplementation::sendResponse(TransportInterface *interface, co
         response.insert("deprecationWarning", deprecationWarning);
     }
 
-    QByteArray data = QJsonDocument::fromVariant(response).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendResponseData(interface, clientId, response);
 }
 
 /*! Send a JSON error response to the client with the given \a clientId,
@@ -508,9 +681,7 @@ void JsonRPCServerImplementation::sendErrorResponse(TransportInterface *interfac
     errorResponse.insert("status", "error");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendResponseData(interface, clientId, errorResponse);
 }
 
 void JsonRPCServerImplementation::sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error)
@@ -520,9 +691,222 @@ void JsonRPCServerImplementation::sendUnauthorizedResponse(TransportInterface *i
     errorResponse.insert("status", "unauthorized");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
+    sendResponseData(interface, clientId, errorResponse);
+}
+
+void JsonRPCServerImplementation::sendResponseData(TransportInterface *interface, const QUuid &clientId, const QVariantMap &response)
+{
+    // Responses to batched requests are collected and sent as one array
+    if (m_currentBatch) {
+        QSharedPointer<Batch> batch = m_currentBatch;
+        if (batch->finished) {
+            return;
+        }
+        batch->responses[m_currentBatchIndex] = response;
+        batch->pending--;
+        // The connection will be dropped after an unauthorized response, send out what we have right away
+        if (batch->pending == 0 || response.value("status").toString() == "unauthorized") {
+            finishBatch(batch);
+        }
+        return;
+    }
+
+    QByteArray data = serialize(clientId, response);
     qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendClientData(interface, clientId, data);
+    applyPendingEncoding(interface, clientId);
+}
+
+void JsonRPCServerImplementation::sendCachedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, JsonReply *reply, const QString &method)
+{
+    // Replies with the same cache key only differ in their id. Validate and serialize the params once
+    // per encoding and put the response together around them, the same way serialize() would.
+    Encoding encoding = m_clientEncodings.value(clientId, EncodingJson);
+    QString key = reply->cacheKey() + '/' + QString::number(encoding);
+    QByteArray *params = m_replyCache.object(key);
+    if (!params) {
+        if (m_validateOutgoing) {
+            validateOutgoing(m_validator.validateReturns(reply->data(), method), reply->data());
+        }
+        params = new QByteArray(serialize(clientId, reply->data()));
+        m_replyCache.insert(key, params);
+    }
+
+    QByteArray data;
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    if (encoding == EncodingCbor) {
+        // A map of 3 pairs, with the keys in the same order as QVariantMap keeps them
+        data.append(static_cast<char>(0xa3));
+        data.append(QCborValue(QStringLiteral("id")).toCbor());
+        data.append(QCborValue(commandId).toCbor());
+        data.append(QCborValue(QStringLiteral("params")).toCbor());
+        data.append(*params);
+        data.append(QCborValue(QStringLiteral("status")).toCbor());
+        data.append(QCborValue(QStringLiteral("success")).toCbor());
+    }
+#endif
+    if (encoding == EncodingJson) {
+        data.reserve(params->size() + 48);
+        data.append("{\"id\":");
+        data.append(QByteArray::number(commandId));
+        data.append(",\"params\":");
+        data.append(*params);
+        data.append(",\"status\":\"success\"}");
+    }
+
+    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
+    sendClientData(interface, clientId, data);
+    applyPendingEncoding(interface, clientId);
+}
+
+void JsonRPCServerImplementation::finishBatch(const QSharedPointer<Batch> &batch)
+{
+    batch->finished = true;
+    if (!m_clientTransports.contains(batch->clientId)) {
+        qCDebug(dcJsonRpc()) << "Client" << batch->clientId << "has disconnected. Dropping batch response.";
+        return;
+    }
+
+    QVariantList responses;
+    foreach (const QVariant &response, batch->responses) {
+        if (response.isValid()) {
+            responses.append(response);
+        }
+    }
+    QByteArray data = serialize(batch->clientId, responses);
+    qCDebug(dcJsonRpcTraffic()) << "Sending batch data:" << data;
+    sendClientData(batch->interface, batch->clientId, data);
+    applyPendingEncoding(batch->interface, batch->clientId);
+}
+
+QByteArray JsonRPCServerImplementation::serialize(const QUuid &clientId, const QVariant &data) const
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    if (m_clientEncodings.value(clientId, EncodingJson) == EncodingCbor) {
+        return QCborValue::fromVariant(data).toCbor();
+    }
+#endif
+    return QJsonDocument::fromVariant(data).toJson(QJsonDocument::Compact);
+}
+
+void JsonRPCServerImplementation::sendClientData(TransportInterface *interface, const QUuid &clientId, const QByteArray &data, ClientSendQueue::Priority priority, const QString &key)
+{
+    // Hold data back while the transport still has plenty to write, or older data is waiting already
+    QHash<QUuid, ClientSendQueue>::iterator queue = m_sendQueues.find(clientId);
+    if ((queue != m_sendQueues.end() && !queue->isEmpty()) || interface->bytesToWrite(clientId) > sendQueueHighWatermark) {
+        if (queue == m_sendQueues.end()) {
+            queue = m_sendQueues.insert(clientId, ClientSendQueue(sendQueueMaxBytes));
+        }
+        queue->enqueue(data, priority, key);
+        if (!queue->overBudget()) {
+            m_sendQueueOverBudgetSince.remove(clientId);
+        } else if (!m_sendQueueOverBudgetSince.contains(clientId)) {
+            qCWarning(dcJsonRpc()) << "Client" << clientId << "is not keeping up with its data. Send queue over budget:" << queue->queuedBytes() << "bytes";
+            m_sendQueueOverBudgetSince.insert(clientId, m_notificationClock.elapsed());
+        }
+        if (!m_sendQueueTimer.isActive()) {
+            m_sendQueueTimer.start();
+        }
+        return;
+    }
+    writeClientData(interface, clientId, data);
+}
+
+void JsonRPCServerImplementation::writeClientData(TransportInterface *interface, const QUuid &clientId, const QByteArray &data)
+{
+    if (m_clientEncodings.value(clientId, EncodingJson) == EncodingCbor) {
+        interface->sendBinaryData(clientId, data);
+    } else {
+        interface->sendData(clientId, data);
+    }
+}
+
+void JsonRPCServerImplementation::applyPendingEncoding(TransportInterface *interface, const QUuid &clientId)
+{
+    // The reply to the JSONRPC.Hello call requesting an encoding or compression is still sent in the previous one.
+    // So is everything queued before, it can't be held back any longer.
+    if (m_pendingCompressions.contains(clientId) || m_pendingEncodings.contains(clientId)) {
+        flushSendQueue(interface, clientId);
+    }
+    if (m_pendingCompressions.contains(clientId)) {
+        Compression compression = m_pendingCompressions.take(clientId);
+        qCDebug(dcJsonRpc()) << "Client" << clientId << "switched to" << compression;
+        interface->setCompressionEnabled(clientId, compression == CompressionDeflate);
+        m_clientCompressions.insert(clientId, compression);
+    }
+    if (m_pendingEncodings.contains(clientId)) {
+        Encoding encoding = m_pendingEncodings.take(clientId);
+        qCDebug(dcJsonRpc()) << "Client" << clientId << "switched to" << encoding;
+        m_clientEncodings.insert(clientId, encoding);
+        m_clientFramers[clientId].reset();
+        m_clientCborBuffers.remove(clientId);
+        interface->setBinaryDataEnabled(clientId, encoding == EncodingCbor);
+    }
+}
+
+/*! Returns the state of the outgoing data of all connected clients, for debugging purposes. */
+QVariantList JsonRPCServerImplementation::sendQueueStatistics() const
+{
+    QVariantList statistics;
+    foreach (const QUuid &clientId, m_clientTransports.keys()) {
+        ClientSendQueue queue = m_sendQueues.value(clientId);
+        QVariantMap entry;
+        entry.insert("clientId", clientId);
+        entry.insert("bytesToWrite", m_clientTransports.value(clientId)->bytesToWrite(clientId));
+        entry.insert("queuedBytes", queue.queuedBytes());
+        entry.insert("queuedReplies", queue.queuedReplies());
+        entry.insert("queuedNotifications", queue.queuedNotifications());
+        entry.insert("droppedNotifications", queue.droppedNotifications());
+        entry.insert("overBudget", m_sendQueueOverBudgetSince.contains(clientId));
+        statistics.append(entry);
+    }
+    return statistics;
+}
+
+void JsonRPCServerImplementation::flushSendQueue(TransportInterface *interface, const QUuid &clientId)
+{
+    if (m_sendQueues.contains(clientId)) {
+        foreach (const QByteArray &data, m_sendQueues[clientId].takeAll()) {
+            writeClientData(interface, clientId, data);
+        }
+        m_sendQueueOverBudgetSince.remove(clientId);
+    }
+}
+
+void JsonRPCServerImplementation::drainSendQueue(const QUuid &clientId)
+{
+    QHash<QUuid, ClientSendQueue>::iterator queue = m_sendQueues.find(clientId);
+    TransportInterface *interface = m_clientTransports.value(clientId);
+    if (queue == m_sendQueues.end() || !interface) {
+        return;
+    }
+    while (!queue->isEmpty() && interface->bytesToWrite(clientId) < sendQueueLowWatermark) {
+        writeClientData(interface, clientId, queue->takeNext());
+    }
+    if (!queue->overBudget()) {
+        m_sendQueueOverBudgetSince.remove(clientId);
+    }
+}
+
+void JsonRPCServerImplementation::checkSendQueues()
+{
+    bool pending = false;
+    qint64 now = m_notificationClock.elapsed();
+    foreach (const QUuid &clientId, m_sendQueues.keys()) {
+        drainSendQueue(clientId);
+        if (m_sendQueueOverBudgetSince.contains(clientId) && now - m_sendQueueOverBudgetSince.value(clientId) > sendQueueGracePeriod) {
+            qCWarning(dcJsonRpc()) << "Client" << clientId << "stayed over its send budget for too long. Dropping client connection.";
+            m_sendQueueOverBudgetSince.remove(clientId);
+            if (m_clientTransports.contains(clientId)) {
+                m_clientTransports.value(clientId)->terminateClientConnection(clientId);
+            }
+            continue;
+        }
+        pending |= m_sendQueues.contains(clientId) && !m_sendQueues.value(clientId).isEmpty();
+    }
+    if (!pending) {
+        m_sendQueueTimer.stop();
+    }
 }
 
 void JsonRPCServerImplementation::setup()
@@ -548,25 +932,81 @@ void JsonRPCServerImplementation::processData(const QUuid &clientId, const QByte
 
     TransportInterface *interface = qobject_cast<TransportInterface *>(sender());
 
+    if (m_clientEncodings.value(clientId, EncodingJson) == EncodingCbor) {
+        processCborData(interface, clientId, data);
+        return;
+    }
+
     // Handle packet fragmentation
-    QByteArray buffer = m_clientBuffers[clientId];
+    JsonFramer &framer = m_clientFramers[clientId];
+    QList<QByteArray> packets = framer.feed(data);
+    // Processing a packet might drop the client, don't touch the framer afterwards
+    bool overflow = framer.overflow();
+
+    foreach (const QByteArray &packet, packets) {
+        processJsonPacket(interface, clientId, packet);
+    }
+
+    if (overflow) {
+        qCWarning(dcJsonRpc()) << "Client buffer larger than 1MB and no valid data. Dropping client connection.";
+        interface->terminateClientConnection(clientId);
+    }
+}
+
+void JsonRPCServerImplementation::processCborData(TransportInterface *interface, const QUuid &clientId, const QByteArray &data)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    // CBOR items are self-delimiting, collect data until there is a complete one
+    QByteArray &buffer = m_clientCborBuffers[clientId];
     buffer.append(data);
-    int splitIndex = buffer.indexOf("}\n{");
-    while (splitIndex > -1) {
-        processJsonPacket(interface, clientId, buffer.left(splitIndex + 1));
-        buffer = buffer.right(buffer.length() - splitIndex - 2);
-        splitIndex = buffer.indexOf("}\n{");
+
+    QVariantList messages;
+    bool parseError = false;
+    int offset = 0;
+    while (offset < buffer.size()) {
+        QCborStreamReader reader(buffer.constData() + offset, buffer.size() - offset);
+        QCborValue value = QCborValue::fromCbor(reader);
+        if (reader.lastError() == QCborError::EndOfFile) {
+            break;
+        }
+        if (reader.lastError() != QCborError::NoError) {
+            qCWarning(dcJsonRpc()) << "Failed to parse CBOR data from client" << clientId << ":" << reader.lastError().toString();
+            buffer.clear();
+            offset = 0;
+            parseError = true;
+            break;
+        }
+        offset += static_cast<int>(reader.currentOffset());
+        messages.append(value.toVariant());
     }
-    if (buffer.trimmed().endsWith("}")) {
-        processJsonPacket(interface, clientId, buffer);
-        buffer.clear();
+    // Drop all complete messages at once, only the start of an incomplete one remains
+    buffer.remove(0, offset);
+
+    // Processing a message might drop the client, don't touch the buffer afterwards
+    bool overflow = buffer.size() > 1024 * 1024;
+
+    if (parseError) {
+        sendErrorResponse(interface, clientId, -1, "Failed to parse CBOR data");
     }
-    m_clientBuffers[clientId] = buffer;
 
-    if (buffer.size() > 1024 * 1024) {
+    foreach (const QVariant &message, messages) {
+        if (message.type() == QVariant::List) {
+            processBatch(interface, clientId, message.toList());
+        } else {
+            processRequest(interface, clientId, message.toMap());
+        }
+    }
+
+    if (overflow) {
         qCWarning(dcJsonRpc()) << "Client buffer larger than 1MB and no valid data. Dropping client connection.";
         interface->terminateClientConnection(clientId);
     }
+#else
+    // Clients can't switch to CBOR without QCborValue
+    Q_UNUSED(data)
+    qCWarning(dcJsonRpc()) << "Received CBOR data from client" << clientId << "but CBOR is not supported with this Qt version.";
+    interface->terminateClientConnection(clientId);
+#endif
 }
 
 void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data)
@@ -580,8 +1020,46 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         return;
     }
 
-    QVariantMap message = jsonDoc.toVariant().toMap();
+    if (jsonDoc.isArray()) {
+        processBatch(interface, clientId, jsonDoc.toVariant().toList());
+        return;
+    }
+
+    processRequest(interface, clientId, jsonDoc.toVariant().toMap());
+}
+
+void JsonRPCServerImplementation::processBatch(TransportInterface *interface, const QUuid &clientId, const QVariantList &requests)
+{
+    if (requests.isEmpty()) {
+        sendErrorResponse(interface, clientId, -1, "Empty batch request");
+        return;
+    }
+
+    qCDebug(dcJsonRpc()) << "Processing batch of" << requests.count() << "requests from client" << clientId;
+
+    QSharedPointer<Batch> batch(new Batch());
+    batch->interface = interface;
+    batch->clientId = clientId;
+    batch->pending = requests.count();
+    for (int i = 0; i < requests.count(); i++) {
+        batch->responses.append(QVariant());
+    }
+
+    // Requests are dispatched in order. Responses of async calls are filled in when they finish.
+    for (int i = 0; i < requests.count(); i++) {
+        if (batch->finished || !m_clientTransports.contains(clientId)) {
+            break;
+        }
+        m_currentBatch = batch;
+        m_currentBatchIndex = i;
+        processRequest(interface, clientId, requests.at(i).toMap());
+        m_currentBatch.clear();
+        m_currentBatchIndex = -1;
+    }
+}
 
+void JsonRPCServerImplementation::processRequest(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message)
+{
     bool success;
     int commandId = message.value("id").toInt(&success);
     if (!success) {
@@ -620,7 +1098,7 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         QStringList authExemptMethodsWithUser = {"JSONRPC.Hello", "JSONRPC.Authenticate", "JSONRPC.RequestPushButtonAuth"};
         // if there is no user in the system yet, let's fail unless this is a special method for authentication itself
         if (NymeaCore::instance()->userManager()->initRequired()) {
-            if (!authExemptMethodsNoUser.contains(methodString) && (token.isEmpty() || !NymeaCore::instance()->userManager()->verifyToken(token))) {
+            if (!authExemptMethodsNoUser.contains(methodString) && !verifyToken(token)) {
                 sendUnauthorizedResponse(interface, clientId, commandId, "Initial setup required. Call Users.CreateUser first.");
                 qCWarning(dcJsonRpc()) << "Initial setup required but client does not call the setup. Dropping connection.";
                 interface->terminateClientConnection(clientId);
@@ -631,7 +1109,7 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         } else {
             // ok, we have a user. if there isn't a valid token, let's fail unless this is a Authenticate, Introspect  Hello call
             if (!authExemptMethodsWithUser.contains(methodString)) {
-                if (token.isEmpty() || !NymeaCore::instance()->userManager()->verifyToken(token)) {
+                if (!verifyToken(token)) {
                     sendUnauthorizedResponse(interface, clientId, commandId, "Forbidden: Invalid token.");
                     qCWarning(dcJsonRpc()) << "Client did not not present a valid token. Dropping connection.";
                     interface->terminateClientConnection(clientId);
@@ -667,9 +1145,7 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
 
     QVariantMap params = message.value("params").toMap();
 
-    QVariantMap definition = handler->jsonMethods().value(method).toMap().value("params").toMap();
-    JsonValidator validator;
-    JsonValidator::Result validationResult = validator.validateParams(params, targetNamespace + '.' + method, m_api);
+    JsonValidator::Result validationResult = m_validator.validateParams(params, targetNamespace + '.' + method);
     if (!validationResult.success()) {
         qCWarning(dcJsonRpc()) << "JSON RPC parameter verification failed for method" << targetNamespace + '.' + method;
         qCWarning(dcJsonRpc()) << validationResult.errorString() << "in" << validationResult.where();
@@ -707,16 +1183,14 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
 
     if (reply->type() == JsonReply::TypeAsync) {
         m_asyncReplies.insert(reply, interface);
+        if (m_currentBatch) {
+            m_batchReplies.insert(reply, qMakePair(m_currentBatch, m_currentBatchIndex));
+        }
         reply->setClientId(clientId);
         reply->setCommandId(commandId);
         connect(reply, &JsonReply::finished, this, &JsonRPCServerImplementation::asyncReplyFinished);
         reply->startWait();
     } else {
-        JsonValidator validator;
-        Q_ASSERT_X((targetNamespace == "JSONRPC" && method == "Introspect") || validator.validateReturns(reply->data(), targetNamespace + '.' + method, m_api).success(),
-                   validator.result().where().toUtf8(),
-                   validator.result().errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(reply->data()).toJson());
-
         QString deprecationWarning;
         if (m_api.value("methods").toMap().value(targetNamespace + '.' + method).toMap().contains("deprecated")) {
             deprecationWarning = m_api.value("methods").toMap().value(targetNamespace + '.' + method).toMap().value("deprecated").toString();
@@ -724,6 +1198,17 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
             qCWarning(dcJsonRpc()) << targetNamespace + '.' + method + ':' << deprecationWarning;
         }
 
+        // Batched responses are collected as maps, only single responses can be put together from cached data
+        if (!reply->cacheKey().isEmpty() && !m_currentBatch && deprecationWarning.isEmpty()) {
+            sendCachedResponse(interface, clientId, commandId, reply, targetNamespace + '.' + method);
+            reply->deleteLater();
+            return;
+        }
+
+        if (m_validateOutgoing && !(targetNamespace == "JSONRPC" && method == "Introspect")) {
+            validateOutgoing(m_validator.validateReturns(reply->data(), targetNamespace + '.' + method), reply->data());
+        }
+
         sendResponse(interface, clientId, commandId, reply->data(), deprecationWarning);
         reply->deleteLater();
     }
@@ -733,42 +1218,161 @@ void JsonRPCServerImplementation::sendNotification(const QVariantMap &params)
 {
     JsonHandler *handler = qobject_cast<JsonHandler *>(sender());
     QMetaMethod method = handler->metaObject()->method(senderSignalIndex());
+    QString notificationName = handler->name() + '.' + method.name();
 
     QVariantMap notification;
     notification.insert("id", m_notificationId++);
-    notification.insert("notification", handler->name() + "." + method.name());
+    notification.insert("notification", notificationName);
 
-    foreach (const QUuid &clientId, m_clientNotifications.keys()) {
+    // Add deprecation warning if necessary
+    QVariantMap notificationDefinition = m_api.value("notifications").toMap().value(notificationName).toMap();
+    if (notificationDefinition.contains("deprecated")) {
+        QString deprecationMessage = notificationDefinition.value("deprecated").toString();
+        notification.insert("deprecationWarning", deprecationMessage);
+    }
 
-        // Check if this client wants to be notified
-        if (!m_clientNotifications.value(clientId).contains(handler->name())) {
-            continue;
+    // Resolve what this notification is about once for matching it against client filters
+    NotificationSubscriptions::Notification subscriptionInfo(notificationName, params);
+    if (!subscriptionInfo.thingId.isNull() && m_notificationSubscriptions.hasInterfaceFilters()) {
+        if (m_thingInterfaces.contains(subscriptionInfo.thingId)) {
+            subscriptionInfo.interfaces = m_thingInterfaces.value(subscriptionInfo.thingId);
+        } else {
+            Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(subscriptionInfo.thingId);
+            if (thing) {
+                subscriptionInfo.interfaces = thing->thingClass().interfaces();
+                m_thingInterfaces.insert(subscriptionInfo.thingId, subscriptionInfo.interfaces);
+            } else {
+                // The thing is gone already and wasn't seen before, rather send it to too many clients than to too few
+                subscriptionInfo.interfacesUnknown = true;
+            }
+        }
+    }
+    if (notificationName == "Integrations.ThingRemoved") {
+        m_thingInterfaces.remove(subscriptionInfo.thingId);
+        // Held back states of the thing must not follow its removal
+        for (QHash<QUuid, NotificationThrottle>::iterator it = m_notificationThrottles.begin(); it != m_notificationThrottles.end(); ++it) {
+            it.value().removeThing(subscriptionInfo.thingId);
+        }
+    }
+
+    // The payload only depends on the locale and the encoding. Translate it once per locale,
+    // serialize it once per encoding and share the resulting data between all clients using those.
+    QHash<QString, QVariantMap> translatedNotifications;
+    QHash<QString, QByteArray> payloads;
+
+    auto deliver = [&](const QUuid &clientId) {
+        QLocale locale = m_clientLocales.value(clientId);
+        if (!translatedNotifications.contains(locale.name())) {
+            QVariantMap translatedParams = handler->translateNotification(method.name(), params, locale);
+
+            if (m_validateOutgoing) {
+                validateOutgoing(m_validator.validateNotificationParams(translatedParams, notificationName), translatedParams);
+            }
+
+            notification.insert("params", translatedParams);
+            translatedNotifications.insert(locale.name(), notification);
+        }
+        QString payloadKey = locale.name() + '/' + QString::number(m_clientEncodings.value(clientId, EncodingJson));
+        if (!payloads.contains(payloadKey)) {
+            payloads.insert(payloadKey, serialize(clientId, translatedNotifications.value(locale.name())));
+            qCDebug(dcJsonRpcTraffic()) << "Notification content:" << payloads.value(payloadKey);
         }
 
-        // Add deprecation warning if necessary
-        if (m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().contains("deprecated")) {
-            QString deprecationMessage = m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().value("deprecated").toString();
+        if (notification.contains("deprecationWarning")) {
             qCWarning(dcJsonRpc()) << "Client" << clientId << "uses deprecated API. Please update client implementation!";
-            qCWarning(dcJsonRpc()) << handler->name() + '.' + method.name() + ':' << deprecationMessage;
-            notification.insert("deprecationWarning", deprecationMessage);
+            qCWarning(dcJsonRpc()) << notificationName + ':' << notification.value("deprecationWarning").toString();
         }
 
-        QLocale locale = m_clientLocales.value(clientId);
-        QVariantMap translatedParams = handler->translateNotification(method.name(), params, locale);
+        qCDebug(dcJsonRpc()) << "Sending notification" << notificationName << "to client" << clientId;
+        sendNotificationData(clientId, payloads.value(payloadKey), subscriptionInfo);
+    };
+
+    // Clients without filters get everything of the namespaces they enabled
+    foreach (const QUuid &clientId, m_unfilteredSubscribers.value(handler->name())) {
+        deliver(clientId);
+    }
 
-        JsonValidator validator;
-        Q_ASSERT_X(validator.validateNotificationParams(translatedParams, handler->name() + '.' + method.name(), m_api).success(),
-                   validator.result().where().toUtf8(),
-                   validator.result().errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(translatedParams).toJson(QJsonDocument::Indented));
+    // Filtered clients are only looked at if the index says they might want this notification
+    const QSet<QUuid> subscribers = m_notificationSubscribers.value(handler->name());
+    const QSet<QUuid> &unindexedClients = m_notificationSubscriptions.unindexedClients();
+    foreach (const QUuid &clientId, m_notificationSubscriptions.thingClients(subscriptionInfo.thingId)) {
+        // Handled with the unindexed clients below
+        if (unindexedClients.contains(clientId)) {
+            continue;
+        }
+        if (subscribers.contains(clientId) && m_notificationSubscriptions.matches(clientId, subscriptionInfo)) {
+            deliver(clientId);
+        }
+    }
+    foreach (const QUuid &clientId, unindexedClients) {
+        if (subscribers.contains(clientId) && m_notificationSubscriptions.matches(clientId, subscriptionInfo)) {
+            deliver(clientId);
+        }
+    }
+}
 
-        notification.insert("params", translatedParams);
+void JsonRPCServerImplementation::updateUnfilteredSubscriber(const QUuid &clientId)
+{
+    bool filtered = m_notificationSubscriptions.hasFilters(clientId);
+    foreach (const QString &namespaceName, m_clientNotifications.value(clientId)) {
+        if (filtered) {
+            m_unfilteredSubscribers[namespaceName].remove(clientId);
+        } else {
+            m_unfilteredSubscribers[namespaceName].insert(clientId);
+        }
+    }
+}
 
-        QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
+void JsonRPCServerImplementation::sendNotificationData(const QUuid &clientId, const QByteArray &data, const NotificationSubscriptions::Notification &notification)
+{
+    TransportInterface *transport = m_clientTransports.value(clientId);
+    if (m_notificationThrottles.contains(clientId)) {
+        NotificationThrottle &throttle = m_notificationThrottles[clientId];
+        qint64 now = m_notificationClock.elapsed();
+
+        // Only notifications about a single state can be coalesced
+        if (!notification.thingId.isNull() && !notification.stateTypeId.isNull()) {
+            int interval = throttle.interval(notification.thingId, notification.stateTypeId);
+            QString key = notification.name + notification.thingId.toString() + notification.stateTypeId.toString();
+            if (interval > 0) {
+                if (!throttle.submit(key, interval, data, now)) {
+                    if (!m_notificationFlushTimer.isActive()) {
+                        m_notificationFlushTimer.start();
+                    }
+                    return;
+                }
+            } else {
+                // The rules changed since this state was held back, keep its values in order. Other
+                // held back states are left to flushThrottledNotifications().
+                QByteArray pending = throttle.takePending(key, now);
+                if (!pending.isEmpty()) {
+                    sendClientData(transport, clientId, pending, ClientSendQueue::PriorityNotification);
+                }
+            }
+        }
+    }
 
-        qCDebug(dcJsonRpc()) << "Sending notification" << handler->name() + "." + method.name() << "to client" << clientId;
-        qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
+    // Should the client fall behind, only the latest value of a state is worth sending
+    QString key;
+    if (!notification.thingId.isNull() && !notification.stateTypeId.isNull()) {
+        key = notification.name + notification.thingId.toString() + notification.stateTypeId.toString();
+    }
+    sendClientData(transport, clientId, data, ClientSendQueue::PriorityNotification, key);
+}
 
-        m_clientTransports.value(clientId)->sendData(clientId, data);
+void JsonRPCServerImplementation::flushThrottledNotifications()
+{
+    qint64 now = m_notificationClock.elapsed();
+    bool pending = false;
+    foreach (const QUuid &clientId, m_notificationThrottles.keys()) {
+        NotificationThrottle &throttle = m_notificationThrottles[clientId];
+        foreach (const QByteArray &data, throttle.takeDue(now)) {
+            sendClientData(m_clientTransports.value(clientId), clientId, data, ClientSendQueue::PriorityNotification);
+        }
+        pending |= throttle.hasPending();
+    }
+    if (!pending) {
+        m_notificationFlushTimer.stop();
     }
 }
 
@@ -787,10 +1391,9 @@ void JsonRPCServerImplementation::sendClientNotification(const QUuid &clientId,
     notification.insert("notification", handler->name() + "." + method.name());
     notification.insert("params", params);
 
-    JsonValidator validator;
-    Q_ASSERT_X(validator.validateNotificationParams(params, handler->name() + '.' + method.name(), m_api).success(),
-               validator.result().where().toUtf8(),
-               validator.result().errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(params).toJson(QJsonDocument::Indented));
+    if (m_validateOutgoing) {
+        validateOutgoing(m_validator.validateNotificationParams(params, handler->name() + '.' + method.name()), params);
+    }
 
     if (m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().contains("deprecated")) {
         QString deprecationMessage = m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().value("deprecated").toString();
@@ -799,27 +1402,43 @@ void JsonRPCServerImplementation::sendClientNotification(const QUuid &clientId,
         notification.insert("deprecationWarning", deprecationMessage);
     }
 
-    QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
+    QByteArray data = serialize(clientId, notification);
     qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
     qCDebug(dcJsonRpc()) << "Sending notification:" << handler->name() + "." + method.name();
-    m_clientTransports.value(clientId)->sendData(clientId, data);
+    sendClientData(m_clientTransports.value(clientId), clientId, data, ClientSendQueue::PriorityNotification);
+}
+
+void JsonRPCServerImplementation::validateOutgoing(const JsonValidator::Result &result, const QVariantMap &data) const
+{
+    if (result.success()) {
+        return;
+    }
+    qCWarning(dcJsonRpc()) << "Outgoing data does not match the API description:" << result.errorString() << "in" << result.where();
+    qCWarning(dcJsonRpc()) << "Data:" << qUtf8Printable(QJsonDocument::fromVariant(data).toJson(QJsonDocument::Indented));
+    Q_ASSERT_X(false, result.where().toUtf8(), result.errorString().toUtf8());
 }
 
 void JsonRPCServerImplementation::asyncReplyFinished()
 {
     JsonReply *reply = qobject_cast<JsonReply *>(sender());
     TransportInterface *interface = m_asyncReplies.take(reply);
+    QPair<QSharedPointer<Batch>, int> batchEntry = m_batchReplies.take(reply);
     if (!interface) {
         qCWarning(dcJsonRpc()) << "Got an async reply but the requesting connection has vanished.";
         reply->deleteLater();
         return;
     }
+
+    // Responses for batched requests go into their batch
+    QSharedPointer<Batch> previousBatch = m_currentBatch;
+    int previousBatchIndex = m_currentBatchIndex;
+    m_currentBatch = batchEntry.first;
+    m_currentBatchIndex = batchEntry.second;
     if (!reply->timedOut()) {
-        JsonValidator validator;
         QString method = reply->handler()->name() + '.' + reply->method();
-        Q_ASSERT_X(validator.validateReturns(reply->data(), method, m_api).success()
-                   ,validator.result().where().toUtf8()
-                   ,validator.result().errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(reply->data()).toJson());
+        if (m_validateOutgoing) {
+            validateOutgoing(m_validator.validateReturns(reply->data(), method), reply->data());
+        }
 
         QString deprecationWarning;
         if (m_api.value("methods").toMap().value(method).toMap().contains("deprecated")) {
@@ -834,9 +1453,28 @@ void JsonRPCServerImplementation::asyncReplyFinished()
         sendErrorResponse(interface, reply->clientId(), reply->commandId(), "Command timed out");
     }
 
+    m_currentBatch = previousBatch;
+    m_currentBatchIndex = previousBatchIndex;
+
     reply->deleteLater();
 }
 
+bool JsonRPCServerImplementation::verifyToken(const QByteArray &token)
+{
+    if (token.isEmpty()) {
+        return false;
+    }
+    // All requests in a batch share the same token, verify it only once
+    if (m_currentBatch && m_currentBatch->verifiedToken == token) {
+        return true;
+    }
+    bool valid = NymeaCore::instance()->userManager()->verifyToken(token);
+    if (valid && m_currentBatch) {
+        m_currentBatch->verifiedToken = token;
+    }
+    return valid;
+}
+
 void JsonRPCServerImplementation::onPushButtonAuthFinished(int transactionId, bool success, const QByteArray &token)
 {
     QUuid clientId = m_pushButtonTransactions.take(transactionId);
@@ -951,6 +1589,15 @@ bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
     qCDebug(dcJsonRpc()) << "Registering JSON RPC handler:" << handler->name();
     m_api = apiIncludingThis;
 
+    // Only compile what this handler adds, the rest of the API is compiled already
+    QVariantMap handlerApi;
+    handlerApi.insert("enums", handler->jsonEnums());
+    handlerApi.insert("flags", handler->jsonFlags());
+    handlerApi.insert("types", handler->jsonObjects());
+    handlerApi.insert("methods", newMethods);
+    handlerApi.insert("notifications", newNotifications);
+    m_validator.addApi(handlerApi);
+
     m_handlers.insert(handler->name(), handler);
     for (int i = 0; i < handler->metaObject()->methodCount(); ++i) {
         QMetaMethod method = handler->metaObject()->method(i);
@@ -996,8 +1643,20 @@ void JsonRPCServerImplementation::clientDisconnected(const QUuid &clientId)
 {
     qCDebug(dcJsonRpc()) << "Client disconnected:" << clientId;
     m_clientTransports.remove(clientId);
-    m_clientNotifications.remove(clientId);
-    m_clientBuffers.remove(clientId);
+    foreach (const QString &namespaceName, m_clientNotifications.take(clientId)) {
+        m_notificationSubscribers[namespaceName].remove(clientId);
+        m_unfilteredSubscribers[namespaceName].remove(clientId);
+    }
+    m_notificationSubscriptions.removeClient(clientId);
+    m_notificationThrottles.remove(clientId);
+    m_clientFramers.remove(clientId);
+    m_clientEncodings.remove(clientId);
+    m_pendingEncodings.remove(clientId);
+    m_clientCborBuffers.remove(clientId);
+    m_clientCompressions.remove(clientId);
+    m_pendingCompressions.remove(clientId);
+    m_sendQueues.remove(clientId);
+    m_sendQueueOverBudgetSince.remove(clientId);
     m_clientLocales.remove(clientId);
     m_clientTokens.remove(clientId);
     if (m_pushButtonTransactions.values().contains(clientId)) {
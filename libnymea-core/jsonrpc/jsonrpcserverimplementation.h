@@ -35,6 +35,11 @@
 #include "jsonrpc/jsonhandler.h"
 #include "transportinterface.h"
 #include "usermanager/usermanager.h"
+#include "notificationsubscriptions.h"
+#include "notificationthrottle.h"
+#include "clientsendqueue.h"
+#include "jsonframer.h"
+#include "jsonvalidator.h"
 
 #include "types/thingclass.h"
 #include "types/action.h"
@@ -44,6 +49,9 @@
 #include <QVariantMap>
 #include <QString>
 #include <QSslConfiguration>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QCache>
 
 class Thing;
 
@@ -53,6 +61,18 @@ class JsonRPCServerImplementation: public JsonHandler, public JsonRPCServer
 {
     Q_OBJECT
 public:
+    enum Encoding {
+        EncodingJson,
+        EncodingCbor
+    };
+    Q_ENUM(Encoding)
+
+    enum Compression {
+        CompressionNone,
+        CompressionDeflate
+    };
+    Q_ENUM(Compression)
+
     JsonRPCServerImplementation(const QSslConfiguration &sslConfiguration = QSslConfiguration(), QObject *parent = nullptr);
 
     // JsonHandler API implementation
@@ -61,6 +81,8 @@ public:
     Q_INVOKABLE JsonReply *Introspect(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *Version(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *SetNotificationStatus(const QVariantMap &params, const JsonContext &context);
+    Q_INVOKABLE JsonReply *SetNotificationFilters(const QVariantMap &params, const JsonContext &context);
+    Q_INVOKABLE JsonReply *SetNotificationThrottling(const QVariantMap &params, const JsonContext &context);
 
     Q_INVOKABLE JsonReply *CreateUser(const QVariantMap &params);
     Q_INVOKABLE JsonReply *Authenticate(const QVariantMap &params, const JsonContext &context);
@@ -79,14 +101,31 @@ public:
     bool registerHandler(JsonHandler *handler) override;
     bool registerExperienceHandler(JsonHandler *handler, int majorVersion, int minorVersion) override;
 
+    QVariantList sendQueueStatistics() const;
+
 private:
     QHash<QString, JsonHandler *> handlers() const;
 
     void sendResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QVariantMap &params = QVariantMap(), const QString &deprecationWarning = QString());
     void sendErrorResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
     void sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
+    void sendResponseData(TransportInterface *interface, const QUuid &clientId, const QVariantMap &response);
+    void sendCachedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, JsonReply *reply, const QString &method);
 
+    QByteArray serialize(const QUuid &clientId, const QVariant &data) const;
+    void sendClientData(TransportInterface *interface, const QUuid &clientId, const QByteArray &data, ClientSendQueue::Priority priority = ClientSendQueue::PriorityReply, const QString &key = QString());
+    void writeClientData(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
+    void flushSendQueue(TransportInterface *interface, const QUuid &clientId);
+    void applyPendingEncoding(TransportInterface *interface, const QUuid &clientId);
+
+    void processCborData(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
     void processJsonPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
+    void processBatch(TransportInterface *interface, const QUuid &clientId, const QVariantList &requests);
+    void processRequest(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message);
+    bool verifyToken(const QByteArray &token);
+
+    void updateUnfilteredSubscriber(const QUuid &clientId);
+    void sendNotificationData(const QUuid &clientId, const QByteArray &data, const NotificationSubscriptions::Notification &notification);
 
 private slots:
     void setup();
@@ -99,23 +138,65 @@ private slots:
     void sendNotification(const QVariantMap &params);
     void sendClientNotification(const QUuid &clientId, const QVariantMap &params);
 
+    void flushThrottledNotifications();
+
+    void drainSendQueue(const QUuid &clientId);
+    void checkSendQueues();
+
     void asyncReplyFinished();
 
     void onPushButtonAuthFinished(int transactionId, bool success, const QByteArray &token);
 
 private:
+    // Responses to a batch of requests, sent as a single array once all of them are answered
+    class Batch {
+    public:
+        TransportInterface *interface = nullptr;
+        QUuid clientId;
+        QVariantList responses;
+        int pending = 0;
+        bool finished = false;
+        QByteArray verifiedToken;
+    };
+    void finishBatch(const QSharedPointer<Batch> &batch);
+
     QVariantMap m_api;
+    JsonValidator m_validator;
+    bool m_validateOutgoing = true;
     QHash<JsonHandler*, QString> m_experiences;
     QHash<QString, JsonHandler *> m_handlers;
     QHash<JsonReply *, TransportInterface *> m_asyncReplies;
+    QHash<JsonReply *, QPair<QSharedPointer<Batch>, int>> m_batchReplies;
+    QSharedPointer<Batch> m_currentBatch;
+    int m_currentBatchIndex = -1;
 
     QHash<QUuid, TransportInterface*> m_clientTransports;
-    QHash<QUuid, QByteArray> m_clientBuffers;
+    QHash<QUuid, JsonFramer> m_clientFramers;
+    QHash<QUuid, Encoding> m_clientEncodings;
+    QHash<QUuid, Encoding> m_pendingEncodings;
+    QHash<QUuid, QByteArray> m_clientCborBuffers;
+    QHash<QUuid, Compression> m_clientCompressions;
+    QHash<QUuid, Compression> m_pendingCompressions;
     QHash<QUuid, QStringList> m_clientNotifications;
+    // Clients by enabled notification namespace, so sending a notification only visits its subscribers
+    QHash<QString, QSet<QUuid> > m_notificationSubscribers;
+    // The subsets of m_notificationSubscribers without notification filters
+    QHash<QString, QSet<QUuid> > m_unfilteredSubscribers;
+    // Interfaces of the things notifications have been about, so ThingRemoved still matches interface filters
+    QHash<QUuid, QStringList> m_thingInterfaces;
+    NotificationSubscriptions m_notificationSubscriptions;
+    QHash<QUuid, NotificationThrottle> m_notificationThrottles;
+    QTimer m_notificationFlushTimer;
+    QElapsedTimer m_notificationClock;
+    QHash<QUuid, ClientSendQueue> m_sendQueues;
+    QHash<QUuid, qint64> m_sendQueueOverBudgetSince;
+    QTimer m_sendQueueTimer;
     QHash<QUuid, QLocale> m_clientLocales;
     QHash<QUuid, QByteArray> m_clientTokens;
     QHash<int, QUuid> m_pushButtonTransactions;
     QHash<QUuid, QTimer*> m_newConnectionWaitTimers;
+    // Serialized params of cacheable replies by cache key and encoding
+    QCache<QString, QByteArray> m_replyCache;
 
     QHash<QString, JsonReply*> m_pairingRequests;
 
@@ -123,6 +204,8 @@ private:
 
     QTimer m_connectionLockdownTimer;
 
+    void validateOutgoing(const JsonValidator::Result &result, const QVariantMap &data) const;
+
     QString formatAssertion(const QString &targetNamespace, const QString &method, QMetaMethod::MethodType methodType, JsonHandler *handler, const QVariantMap &data) const;
 };
 
@@ -39,6 +39,53 @@
 
 namespace nymeaserver {
 
+class JsonValidator::Node
+{
+public:
+    enum Kind {
+        KindBasicType,
+        KindEnum,
+        KindFlags,
+        KindMap,
+        KindList
+    };
+
+    class Field {
+    public:
+        QString key;
+        QString definitionKey;
+        Node *node = nullptr;
+        bool optional = false;
+        bool readOnly = false;
+    };
+
+    Kind kind = KindBasicType;
+    // The type or ref name, used in error messages
+    QString name;
+
+    JsonHandler::BasicType basicType = JsonHandler::Variant;
+    QVariant::Type variantType = QVariant::Invalid;
+
+    QSet<QString> enumValues;
+
+    // Fields of a map in definition order, indexed by the key without prefixes
+    QList<Field> fields;
+    QHash<QString, int> fieldIndex;
+
+    // The entry type of a list or the enum of flags
+    Node *element = nullptr;
+};
+
+JsonValidator::JsonValidator()
+{
+    setApi(QVariantMap());
+}
+
+JsonValidator::~JsonValidator()
+{
+    clear();
+}
+
 bool JsonValidator::checkRefs(const QVariantMap &map, const QVariantMap &api)
 {
     QVariantMap enums = api.value("enums").toMap();
@@ -80,209 +127,362 @@ bool JsonValidator::checkRefs(const QVariantMap &map, const QVariantMap &api)
 
 }
 
-JsonValidator::Result JsonValidator::validateParams(const QVariantMap &params, const QString &method, const QVariantMap &api)
+void JsonValidator::setApi(const QVariantMap &api)
 {
-    QVariantMap paramDefinition = api.value("methods").toMap().value(method).toMap().value("params").toMap();
-    m_result = validateMap(params, paramDefinition, api, QIODevice::WriteOnly);
-    m_result.setWhere(method + ", param " + m_result.where());
-    return m_result;
-}
+    clear();
 
-JsonValidator::Result JsonValidator::validateReturns(const QVariantMap &returns, const QString &method, const QVariantMap &api)
-{
-    QVariantMap returnsDefinition = api.value("methods").toMap().value(method).toMap().value("returns").toMap();
-    m_result = validateMap(returns, returnsDefinition, api, QIODevice::ReadOnly);
-    m_result.setWhere(method + ", returns " + m_result.where());
-    return m_result;
-}
+    m_emptyMap = createNode();
+    m_emptyMap->kind = Node::KindMap;
 
-JsonValidator::Result JsonValidator::validateNotificationParams(const QVariantMap &params, const QString &notification, const QVariantMap &api)
-{
-    QVariantMap paramDefinition = api.value("notifications").toMap().value(notification).toMap().value("params").toMap();
-    m_result = validateMap(params, paramDefinition, api, QIODevice::ReadOnly);
-    m_result.setWhere(notification + ", param " + m_result.where());
-    return m_result;
+    addApi(api);
 }
 
-JsonValidator::Result JsonValidator::result() const
+void JsonValidator::addApi(const QVariantMap &api)
 {
-    return m_result;
-}
+    QVariantMap enums = api.value("enums").toMap();
+    QVariantMap flags = api.value("flags").toMap();
+    QVariantMap types = api.value("types").toMap();
 
-JsonValidator::Result JsonValidator::validateMap(const QVariantMap &map, const QVariantMap &definition, const QVariantMap &api, QIODevice::OpenMode openMode)
-{
-    // Make sure all required values are available
-    foreach (const QString &key, definition.keys()) {
-        QRegExp isOptional = QRegExp("^([a-z]:)*o:.*");
-        if (isOptional.exactMatch(key)) {
+    // Create all new named nodes upfront so references, including recursive ones, can be resolved while compiling
+    foreach (const QString &enumName, enums.keys()) {
+        if (m_namedNodes.contains(enumName)) {
+            enums.remove(enumName);
+            continue;
+        }
+        Node *node = createNode();
+        node->kind = Node::KindEnum;
+        node->name = enumName;
+        foreach (const QVariant &enumValue, enums.value(enumName).toList()) {
+            node->enumValues.insert(enumValue.toString());
+        }
+        m_namedNodes.insert(enumName, node);
+    }
+    QStringList aliases;
+    foreach (const QString &typeName, types.keys()) {
+        if (m_namedNodes.contains(typeName)) {
+            types.remove(typeName);
             continue;
         }
-        QRegExp isReadOnly = QRegExp("^([a-z]:)*r:.*");
-        if (isReadOnly.exactMatch(key) && openMode.testFlag(QIODevice::WriteOnly)) {
+        if (types.value(typeName).type() == QVariant::String) {
+            aliases.append(typeName);
             continue;
         }
-        QString trimmedKey = key;
-        trimmedKey.remove(QRegExp("^(o:|r:|d:)*"));
-        if (!map.contains(trimmedKey)) {
-            return Result(false, "Missing required key: " + key, key);
+        Node *node = createNode();
+        node->name = typeName;
+        m_namedNodes.insert(typeName, node);
+    }
+    foreach (const QString &flagsName, flags.keys()) {
+        if (m_namedNodes.contains(flagsName)) {
+            flags.remove(flagsName);
+            continue;
         }
+        Node *node = createNode();
+        node->kind = Node::KindFlags;
+        node->name = flagsName;
+        m_namedNodes.insert(flagsName, node);
     }
 
-    // Make sure given values are valid
-    foreach (const QString &key, map.keys()) {
-        // Is the key allowed in here?
-        QVariant expectedValue = definition.value(key);
-        foreach (const QString &definitionKey, definition.keys()) {
-            QRegExp regExp = QRegExp("(o:|r:|d:)*" + key);
-            if (regExp.exactMatch(definitionKey)) {
-                expectedValue = definition.value(definitionKey);
+    // Aliases share the node of the type they refer to. They may refer to other aliases, resolve those first.
+    while (!aliases.isEmpty()) {
+        int unresolved = aliases.count();
+        foreach (const QString &alias, aliases) {
+            QString target = types.value(alias).toString();
+            if (target.startsWith("$ref:") && aliases.contains(target.mid(5))) {
+                continue;
             }
+            m_namedNodes.insert(alias, compileEntry(target));
+            aliases.removeAll(alias);
         }
-        if (!expectedValue.isValid()) {
-            expectedValue = definition.value("o:" + key);
-        }
-        if (!expectedValue.isValid()) {
-            expectedValue = definition.value("d:" + key);
-        }
-        if (!expectedValue.isValid()) {
-            return Result(false, "Invalid key: " + key);
+        if (aliases.count() == unresolved) {
+            qCWarning(dcJsonRpc()) << "Circular type aliases in API description:" << aliases;
+            foreach (const QString &alias, aliases) {
+                m_namedNodes.insert(alias, compileEntry(JsonHandler::enumValueName(JsonHandler::Variant)));
+            }
+            break;
         }
+    }
 
-        // Validate content
-        QVariant value = map.value(key);
+    foreach (const QString &flagsName, flags.keys()) {
+        m_namedNodes.value(flagsName)->element = compileEntry(flags.value(flagsName).toList().value(0));
+    }
 
-        Result result = validateEntry(value, expectedValue, api, openMode);
-        if (!result.success()) {
-            result.setWhere(key + '.' + result.where());
-            result.setErrorString(result.errorString());
-            return result;
+    foreach (const QString &typeName, types.keys()) {
+        if (types.value(typeName).type() != QVariant::String) {
+            compileInto(m_namedNodes.value(typeName), types.value(typeName));
         }
+    }
 
-   }
+    QVariantMap methods = api.value("methods").toMap();
+    foreach (const QString &methodName, methods.keys()) {
+        QVariantMap method = methods.value(methodName).toMap();
+        Node *params = createNode();
+        compileMap(params, method.value("params").toMap());
+        m_methodParams.insert(methodName, params);
+        Node *returns = createNode();
+        compileMap(returns, method.value("returns").toMap());
+        m_methodReturns.insert(methodName, returns);
+    }
 
-    return Result(true);
+    QVariantMap notifications = api.value("notifications").toMap();
+    foreach (const QString &notificationName, notifications.keys()) {
+        Node *params = createNode();
+        compileMap(params, notifications.value(notificationName).toMap().value("params").toMap());
+        m_notificationParams.insert(notificationName, params);
+    }
+
+    qCDebug(dcJsonRpc()) << "Compiled JSON RPC API description into" << m_nodes.count() << "validator nodes";
 }
 
-JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const QVariant &definition, const QVariantMap &api, QIODevice::OpenMode openMode)
+JsonValidator::Result JsonValidator::validateParams(const QVariantMap &params, const QString &method) const
 {
-    if (definition.type() == QVariant::String) {
-        QString expectedTypeName = definition.toString();
+    Result result = validateMap(params, m_methodParams.value(method, m_emptyMap), QIODevice::WriteOnly);
+    result.setWhere(method + ", param " + result.where());
+    return result;
+}
 
-        if (expectedTypeName.startsWith("$ref:")) {
-            QString refName = expectedTypeName;
-            refName.remove("$ref:");
+JsonValidator::Result JsonValidator::validateReturns(const QVariantMap &returns, const QString &method) const
+{
+    Result result = validateMap(returns, m_methodReturns.value(method, m_emptyMap), QIODevice::ReadOnly);
+    result.setWhere(method + ", returns " + result.where());
+    return result;
+}
 
-            // Refs might be enums
-            QVariantMap enums = api.value("enums").toMap();
-            if (enums.contains(refName)) {
-                QVariant refDefinition = enums.value(refName);
+JsonValidator::Result JsonValidator::validateNotificationParams(const QVariantMap &params, const QString &notification) const
+{
+    Result result = validateMap(params, m_notificationParams.value(notification, m_emptyMap), QIODevice::ReadOnly);
+    result.setWhere(notification + ", param " + result.where());
+    return result;
+}
 
-                QVariantList enumList = refDefinition.toList();
-                if (!enumList.contains(value.toString())) {
-                    return Result(false, "Expected enum value for" + refName + " but got " + value.toString());
-                }
-                return Result(true);
-            }
-            // Or flags
-            QVariantMap flags = api.value("flags").toMap();
-            if (flags.contains(refName)) {
-                QVariant refDefinition = flags.value(refName);
-                if (value.type() != QVariant::List && value.type() != QVariant::StringList) {
-                    return Result(false, "Expected flags " + refName + " but got " + value.toString());
-                }
-                QString flagEnum = refDefinition.toList().first().toString();
-                foreach (const QVariant &flagsEntry, value.toList()) {
-                    Result result = validateEntry(flagsEntry, flagEnum, api, openMode);
-                    if (!result.success()) {
-                        return result;
-                    }
-                }
-                return Result(true);
+void JsonValidator::clear()
+{
+    qDeleteAll(m_nodes);
+    m_nodes.clear();
+    m_basicTypeNodes.clear();
+    m_namedNodes.clear();
+    m_emptyMap = nullptr;
+    m_methodParams.clear();
+    m_methodReturns.clear();
+    m_notificationParams.clear();
+}
+
+JsonValidator::Node *JsonValidator::createNode()
+{
+    Node *node = new Node();
+    m_nodes.append(node);
+    return node;
+}
+
+JsonValidator::Node *JsonValidator::compileEntry(const QVariant &definition)
+{
+    if (definition.type() == QVariant::String) {
+        QString typeName = definition.toString();
+
+        if (typeName.startsWith("$ref:")) {
+            QString refName = typeName;
+            refName.remove("$ref:");
+            Node *node = m_namedNodes.value(refName);
+            if (node) {
+                return node;
             }
+            // References are verified with checkRefs() when registering handlers, this should not happen
+            qCWarning(dcJsonRpc()) << "Unresolved reference to" << refName << "in API description";
+            typeName = JsonHandler::enumValueName(JsonHandler::Variant);
+        }
 
-            QVariantMap types = api.value("types").toMap();
-            QVariant refDefinition = types.value(refName);
-            return validateEntry(value, refDefinition, api, openMode);
+        // Basic types don't carry any state, share them
+        Node *node = m_basicTypeNodes.value(typeName);
+        if (!node) {
+            node = createNode();
+            node->kind = Node::KindBasicType;
+            node->name = typeName;
+            node->basicType = JsonHandler::enumNameToValue<JsonHandler::BasicType>(typeName);
+            node->variantType = JsonHandler::basicTypeToVariantType(node->basicType);
+            m_basicTypeNodes.insert(typeName, node);
         }
+        return node;
+    }
 
-        JsonHandler::BasicType expectedBasicType = JsonHandler::enumNameToValue<JsonHandler::BasicType>(expectedTypeName);
-        QVariant::Type expectedVariantType = JsonHandler::basicTypeToVariantType(expectedBasicType);
+    Node *node = createNode();
+    compileInto(node, definition);
+    return node;
+}
 
-        // Verify basic compatiblity
-        if (expectedBasicType != JsonHandler::Variant && !value.canConvert(expectedVariantType)) {
-            return Result(false, "Invalid value. Expected: " + definition.toString() + ", Got: " + value.toString());
-        }
+void JsonValidator::compileInto(Node *node, const QVariant &definition)
+{
+    if (definition.type() == QVariant::Map) {
+        compileMap(node, definition.toMap());
+        return;
+    }
 
-        // Any string converts fine to Uuid, but the resulting uuid might be null
-        if (expectedBasicType == JsonHandler::Uuid && value.toUuid().isNull()) {
-            return Result(false, "Invalid Uuid: " + value.toString());
+    if (definition.type() == QVariant::List) {
+        QVariant entryDefinition = definition.toList().value(0);
+        node->kind = Node::KindList;
+        node->name = entryDefinition.toString();
+        node->element = compileEntry(entryDefinition);
+        return;
+    }
+
+    if (definition.type() == QVariant::String) {
+        // Aliases are resolved to their target nodes upfront, only the Variant fallback ends up here
+        *node = *compileEntry(definition);
+        return;
+    }
+
+    Q_ASSERT_X(false, "JsonValildator", QString("Incomplete validation. Unexpected type %1 in template").arg(definition.type()).toUtf8());
+    compileInto(node, JsonHandler::enumValueName(JsonHandler::Variant));
+}
+
+void JsonValidator::compileMap(Node *node, const QVariantMap &definition)
+{
+    node->kind = Node::KindMap;
+    foreach (const QString &definitionKey, definition.keys()) {
+        Node::Field field;
+        field.definitionKey = definitionKey;
+
+        // Strip the o: (optional), r: (read only) and d: (deprecated) prefixes once
+        QString key = definitionKey;
+        while (key.length() > 2 && key.at(1) == ':' && (key.at(0) == 'o' || key.at(0) == 'r' || key.at(0) == 'd')) {
+            field.optional |= key.at(0) == 'o';
+            field.readOnly |= key.at(0) == 'r';
+            key.remove(0, 2);
         }
-        // Make sure ints are valid
-        if (expectedBasicType == JsonHandler::Int) {
-            bool ok;
-            value.toLongLong(&ok);
-            if (!ok) {
-                return Result(false, "Invalid Int: " + value.toString());
-            }
+        field.key = key;
+
+        field.node = compileEntry(definition.value(definitionKey));
+        node->fieldIndex.insert(key, node->fields.count());
+        node->fields.append(field);
+    }
+}
+
+JsonValidator::Result JsonValidator::validateMap(const QVariantMap &map, const Node *node, QIODevice::OpenMode openMode) const
+{
+    // Make sure all required values are available
+    foreach (const Node::Field &field, node->fields) {
+        if (field.optional) {
+            continue;
         }
-        // UInts
-        if (expectedBasicType == JsonHandler::Uint) {
-            bool ok;
-            value.toULongLong(&ok);
-            if (!ok) {
-                return Result(false, "Invalid UInt: " + value.toString());
-            }
+        if (field.readOnly && openMode.testFlag(QIODevice::WriteOnly)) {
+            continue;
         }
-        // Double
-        if (expectedBasicType == JsonHandler::Double) {
-            bool ok;
-            value.toDouble(&ok);
-            if (!ok) {
-                return Result(false, "Invalid Double: " + value.toString());
-            }
+        if (!map.contains(field.key)) {
+            return Result(false, "Missing required key: " + field.definitionKey, field.definitionKey);
         }
-        // Color
-        if (expectedBasicType == JsonHandler::Color) {
-            QColor color = value.value<QColor>();
-            if (!color.isValid()) {
-                return Result(false, "Invalid Color: " + value.toString());
-            }
+    }
+
+    // Make sure given values are valid
+    for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+        // Is the key allowed in here?
+        int index = node->fieldIndex.value(it.key(), -1);
+        if (index < 0) {
+            return Result(false, "Invalid key: " + it.key());
         }
-        // Time
-        if (expectedBasicType == JsonHandler::Time) {
-            QTime time = QTime::fromString(value.toString(), "hh:mm");
-            if (!time.isValid()) {
-                return Result(false, "Invalid Time: " + value.toString());
-            }
+
+        // Validate content
+        Result result = validateEntry(it.value(), node->fields.at(index).node, openMode);
+        if (!result.success()) {
+            result.setWhere(it.key() + '.' + result.where());
+            return result;
         }
+    }
 
+    return Result(true);
+}
 
+JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const Node *node, QIODevice::OpenMode openMode) const
+{
+    switch (node->kind) {
+    case Node::KindEnum:
+        if (!node->enumValues.contains(value.toString())) {
+            return Result(false, "Expected enum value for" + node->name + " but got " + value.toString());
+        }
         return Result(true);
-    }
 
-    if (definition.type() == QVariant::Map) {
+    case Node::KindFlags:
+        if (value.type() != QVariant::List && value.type() != QVariant::StringList) {
+            return Result(false, "Expected flags " + node->name + " but got " + value.toString());
+        }
+        foreach (const QVariant &flagsEntry, value.toList()) {
+            Result result = validateEntry(flagsEntry, node->element, openMode);
+            if (!result.success()) {
+                return result;
+            }
+        }
+        return Result(true);
+
+    case Node::KindMap:
         if (value.type() != QVariant::Map) {
             return Result(false, "Invalid value. Expected a map but received: " + value.toString());
         }
-        return validateMap(value.toMap(), definition.toMap(), api, openMode);
-    }
+        return validateMap(value.toMap(), node, openMode);
 
-    if (definition.type() == QVariant::List) {
-        QVariantList list = definition.toList();
-        QVariant entryDefinition = list.first();
+    case Node::KindList:
         if (value.type() != QVariant::List && value.type() != QVariant::StringList) {
-            return Result(false, "Expected list of " + entryDefinition.toString() + " but got value of type " + value.typeName() + "\n" + QJsonDocument::fromVariant(value).toJson());
+            return Result(false, "Expected list of " + node->name + " but got value of type " + value.typeName() + "\n" + QJsonDocument::fromVariant(value).toJson());
         }
         foreach (const QVariant &entry, value.toList()) {
-            Result result = validateEntry(entry, entryDefinition, api, openMode);
+            Result result = validateEntry(entry, node->element, openMode);
             if (!result.success()) {
                 return result;
             }
         }
         return Result(true);
+
+    case Node::KindBasicType:
+        break;
     }
-    Q_ASSERT_X(false, "JsonValildator", QString("Incomplete validation. Unexpected type %1 in template").arg(definition.type()).toUtf8());
-    return Result(false);
+
+    // Verify basic compatiblity
+    if (node->basicType != JsonHandler::Variant && !value.canConvert(node->variantType)) {
+        return Result(false, "Invalid value. Expected: " + node->name + ", Got: " + value.toString());
+    }
+
+    switch (node->basicType) {
+    case JsonHandler::Uuid:
+        // Any string converts fine to Uuid, but the resulting uuid might be null
+        if (value.toUuid().isNull()) {
+            return Result(false, "Invalid Uuid: " + value.toString());
+        }
+        break;
+    case JsonHandler::Int: {
+        bool ok;
+        value.toLongLong(&ok);
+        if (!ok) {
+            return Result(false, "Invalid Int: " + value.toString());
+        }
+        break;
+    }
+    case JsonHandler::Uint: {
+        bool ok;
+        value.toULongLong(&ok);
+        if (!ok) {
+            return Result(false, "Invalid UInt: " + value.toString());
+        }
+        break;
+    }
+    case JsonHandler::Double: {
+        bool ok;
+        value.toDouble(&ok);
+        if (!ok) {
+            return Result(false, "Invalid Double: " + value.toString());
+        }
+        break;
+    }
+    case JsonHandler::Color:
+        if (!value.value<QColor>().isValid()) {
+            return Result(false, "Invalid Color: " + value.toString());
+        }
+        break;
+    case JsonHandler::Time:
+        if (!QTime::fromString(value.toString(), "hh:mm").isValid()) {
+            return Result(false, "Invalid Time: " + value.toString());
+        }
+        break;
+    default:
+        break;
+    }
+
+    return Result(true);
 }
 
 }
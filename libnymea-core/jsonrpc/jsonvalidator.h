@@ -34,6 +34,8 @@
 #include <QPair>
 #include <QVariant>
 #include <QIODevice>
+#include <QHash>
+#include <QSet>
 
 namespace nymeaserver {
 
@@ -59,20 +61,43 @@ public:
         bool m_deprecated = false;
     };
 
-    JsonValidator() {}
+    JsonValidator();
+    ~JsonValidator();
 
     static bool checkRefs(const QVariantMap &map, const QVariantMap &api);
 
-    Result validateParams(const QVariantMap &params, const QString &method, const QVariantMap &api);
-    Result validateReturns(const QVariantMap &returns, const QString &method, const QVariantMap &api);
-    Result validateNotificationParams(const QVariantMap &params, const QString &notification, const QVariantMap &api);
+    // Compiles the given API description, replacing everything compiled before
+    void setApi(const QVariantMap &api);
+    // Compiles an addition to the API. Already known enums, flags and types are kept, methods and notifications are replaced.
+    void addApi(const QVariantMap &api);
+
+    Result validateParams(const QVariantMap &params, const QString &method) const;
+    Result validateReturns(const QVariantMap &returns, const QString &method) const;
+    Result validateNotificationParams(const QVariantMap &params, const QString &notification) const;
 
-    Result result() const;
 private:
-    Result validateMap(const QVariantMap &map, const QVariantMap &definition, const QVariantMap &api, QIODevice::OpenMode openMode);
-    Result validateEntry(const QVariant &value, const QVariant &definition, const QVariantMap &api, QIODevice::OpenMode openMode);
+    Q_DISABLE_COPY(JsonValidator)
+
+    class Node;
+
+    void clear();
+    Node *createNode();
+    Node *compileEntry(const QVariant &definition);
+    void compileInto(Node *node, const QVariant &definition);
+    void compileMap(Node *node, const QVariantMap &definition);
+
+    Result validateMap(const QVariantMap &map, const Node *node, QIODevice::OpenMode openMode) const;
+    Result validateEntry(const QVariant &value, const Node *node, QIODevice::OpenMode openMode) const;
+
+    QList<Node*> m_nodes;
+    QHash<QString, Node*> m_basicTypeNodes;
+    // Enums, flags and types by name. Aliases point to the node of the type they refer to.
+    QHash<QString, Node*> m_namedNodes;
+    Node *m_emptyMap = nullptr;
 
-    Result m_result;
+    QHash<QString, Node*> m_methodParams;
+    QHash<QString, Node*> m_methodReturns;
+    QHash<QString, Node*> m_notificationParams;
 };
 
 }
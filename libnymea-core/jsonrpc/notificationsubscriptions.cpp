@@ -0,0 +1,191 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "notificationsubscriptions.h"
+
+namespace nymeaserver {
+
+NotificationSubscriptions::Filter NotificationSubscriptions::Filter::fromMap(const QVariantMap &map)
+{
+    Filter filter;
+    foreach (const QVariant &notification, map.value("notifications").toList()) {
+        filter.notifications.insert(notification.toString());
+    }
+    foreach (const QVariant &thingId, map.value("thingIds").toList()) {
+        filter.thingIds.insert(thingId.toUuid());
+    }
+    foreach (const QVariant &stateTypeId, map.value("stateTypeIds").toList()) {
+        filter.stateTypeIds.insert(stateTypeId.toUuid());
+    }
+    foreach (const QVariant &interface, map.value("interfaces").toList()) {
+        filter.interfaces.insert(interface.toString());
+    }
+    return filter;
+}
+
+QVariantMap NotificationSubscriptions::Filter::toMap() const
+{
+    QVariantMap map;
+    if (!notifications.isEmpty()) {
+        map.insert("notifications", QStringList(notifications.values()));
+    }
+    if (!thingIds.isEmpty()) {
+        QVariantList list;
+        foreach (const QUuid &thingId, thingIds) {
+            list.append(thingId);
+        }
+        map.insert("thingIds", list);
+    }
+    if (!stateTypeIds.isEmpty()) {
+        QVariantList list;
+        foreach (const QUuid &stateTypeId, stateTypeIds) {
+            list.append(stateTypeId);
+        }
+        map.insert("stateTypeIds", list);
+    }
+    if (!interfaces.isEmpty()) {
+        map.insert("interfaces", QStringList(interfaces.values()));
+    }
+    return map;
+}
+
+NotificationSubscriptions::Notification::Notification(const QString &name, const QVariantMap &params):
+    name(name)
+{
+    // Most thing related notifications carry a thingId, ThingAdded/ThingChanged carry the whole thing
+    if (params.contains("thingId")) {
+        thingId = params.value("thingId").toUuid();
+    } else if (params.contains("thing")) {
+        thingId = params.value("thing").toMap().value("id").toUuid();
+    }
+    stateTypeId = params.value("stateTypeId").toUuid();
+}
+
+void NotificationSubscriptions::setFilters(const QUuid &clientId, const QList<Filter> &filters)
+{
+    if (filters.isEmpty()) {
+        m_filters.remove(clientId);
+    } else {
+        m_filters.insert(clientId, filters);
+    }
+    rebuildIndex();
+}
+
+QList<NotificationSubscriptions::Filter> NotificationSubscriptions::filters(const QUuid &clientId) const
+{
+    return m_filters.value(clientId);
+}
+
+void NotificationSubscriptions::removeClient(const QUuid &clientId)
+{
+    if (m_filters.remove(clientId) > 0) {
+        rebuildIndex();
+    }
+}
+
+bool NotificationSubscriptions::hasFilters(const QUuid &clientId) const
+{
+    return m_filters.contains(clientId);
+}
+
+bool NotificationSubscriptions::hasInterfaceFilters() const
+{
+    return m_interfaceFilterCount > 0;
+}
+
+const QSet<QUuid> &NotificationSubscriptions::thingClients(const QUuid &thingId) const
+{
+    static const QSet<QUuid> noClients;
+    QHash<QUuid, QSet<QUuid> >::const_iterator it = m_thingIndex.constFind(thingId);
+    return it != m_thingIndex.constEnd() ? it.value() : noClients;
+}
+
+const QSet<QUuid> &NotificationSubscriptions::unindexedClients() const
+{
+    return m_unindexedClients;
+}
+
+bool NotificationSubscriptions::matches(const QUuid &clientId, const Notification &notification) const
+{
+    if (!m_filters.contains(clientId)) {
+        return true;
+    }
+
+    foreach (const Filter &filter, m_filters.value(clientId)) {
+        if (!filter.notifications.isEmpty() && !filter.notifications.contains(notification.name)) {
+            continue;
+        }
+        if (!filter.thingIds.isEmpty() && !filter.thingIds.contains(notification.thingId)) {
+            continue;
+        }
+        if (!filter.stateTypeIds.isEmpty() && !notification.stateTypeId.isNull() && !filter.stateTypeIds.contains(notification.stateTypeId)) {
+            continue;
+        }
+        if (!filter.interfaces.isEmpty() && !notification.interfacesUnknown) {
+            bool interfaceMatch = false;
+            foreach (const QString &interface, notification.interfaces) {
+                if (filter.interfaces.contains(interface)) {
+                    interfaceMatch = true;
+                    break;
+                }
+            }
+            if (!interfaceMatch) {
+                continue;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void NotificationSubscriptions::rebuildIndex()
+{
+    // Filters change rarely compared to notifications being sent, so just rebuild it all
+    m_thingIndex.clear();
+    m_unindexedClients.clear();
+    m_interfaceFilterCount = 0;
+
+    foreach (const QUuid &clientId, m_filters.keys()) {
+        foreach (const Filter &filter, m_filters.value(clientId)) {
+            if (!filter.interfaces.isEmpty()) {
+                m_interfaceFilterCount++;
+            }
+            if (filter.thingIds.isEmpty()) {
+                m_unindexedClients.insert(clientId);
+                continue;
+            }
+            foreach (const QUuid &thingId, filter.thingIds) {
+                m_thingIndex[thingId].insert(clientId);
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,99 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef NOTIFICATIONSUBSCRIPTIONS_H
+#define NOTIFICATIONSUBSCRIPTIONS_H
+
+#include <QUuid>
+#include <QSet>
+#include <QHash>
+#include <QVariant>
+#include <QStringList>
+
+namespace nymeaserver {
+
+// Keeps the notification filters clients registered with JSONRPC.SetNotificationFilters.
+// Clients without filters receive all notifications of their enabled namespaces.
+class NotificationSubscriptions
+{
+public:
+    class Filter {
+    public:
+        QSet<QString> notifications;
+        QSet<QUuid> thingIds;
+        QSet<QUuid> stateTypeIds;
+        QSet<QString> interfaces;
+
+        static Filter fromMap(const QVariantMap &map);
+        QVariantMap toMap() const;
+    };
+
+    // What a notification is about, extracted once and matched against all filters
+    class Notification {
+    public:
+        Notification(const QString &name, const QVariantMap &params);
+        QString name;
+        QUuid thingId;
+        QUuid stateTypeId;
+        QStringList interfaces;
+        // Set if the thing could not be resolved any more, interface filters match then
+        bool interfacesUnknown = false;
+    };
+
+    void setFilters(const QUuid &clientId, const QList<Filter> &filters);
+    QList<Filter> filters(const QUuid &clientId) const;
+    void removeClient(const QUuid &clientId);
+    bool hasFilters(const QUuid &clientId) const;
+
+    bool hasInterfaceFilters() const;
+
+    // The filtered clients which might be interested in notifications for the given thing are those
+    // with a filter naming the thing plus the unindexed ones. Filtered clients in neither set can be
+    // skipped right away. A client can be in both sets.
+    const QSet<QUuid> &thingClients(const QUuid &thingId) const;
+    const QSet<QUuid> &unindexedClients() const;
+
+    bool matches(const QUuid &clientId, const Notification &notification) const;
+
+private:
+    void rebuildIndex();
+
+    QHash<QUuid, QList<Filter> > m_filters;
+
+    // Clients whose filters all name specific things, indexed by thing id
+    QHash<QUuid, QSet<QUuid> > m_thingIndex;
+    // Clients with at least one filter not limited to specific things
+    QSet<QUuid> m_unindexedClients;
+    int m_interfaceFilterCount = 0;
+};
+
+}
+
+#endif // NOTIFICATIONSUBSCRIPTIONS_H
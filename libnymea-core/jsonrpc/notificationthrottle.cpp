@@ -0,0 +1,211 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "notificationthrottle.h"
+
+namespace nymeaserver {
+
+NotificationThrottle::Rule NotificationThrottle::Rule::fromMap(const QVariantMap &map)
+{
+    Rule rule;
+    rule.thingId = map.value("thingId").toUuid();
+    rule.stateTypeId = map.value("stateTypeId").toUuid();
+    rule.interval = qMax(0, map.value("interval").toInt());
+    return rule;
+}
+
+QVariantMap NotificationThrottle::Rule::toMap() const
+{
+    QVariantMap map;
+    if (!thingId.isNull()) {
+        map.insert("thingId", thingId);
+    }
+    if (!stateTypeId.isNull()) {
+        map.insert("stateTypeId", stateTypeId);
+    }
+    map.insert("interval", interval);
+    return map;
+}
+
+int NotificationThrottle::interval() const
+{
+    return m_interval;
+}
+
+void NotificationThrottle::setInterval(int interval)
+{
+    m_interval = qMax(0, interval);
+}
+
+QList<NotificationThrottle::Rule> NotificationThrottle::rules() const
+{
+    return m_rules;
+}
+
+void NotificationThrottle::setRules(const QList<NotificationThrottle::Rule> &rules)
+{
+    m_rules = rules;
+}
+
+bool NotificationThrottle::isEnabled() const
+{
+    if (m_interval > 0) {
+        return true;
+    }
+    foreach (const Rule &rule, m_rules) {
+        if (rule.interval > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int NotificationThrottle::interval(const QUuid &thingId, const QUuid &stateTypeId) const
+{
+    int bestScore = -1;
+    int interval = m_interval;
+    foreach (const Rule &rule, m_rules) {
+        if (!rule.thingId.isNull() && rule.thingId != thingId) {
+            continue;
+        }
+        if (!rule.stateTypeId.isNull() && rule.stateTypeId != stateTypeId) {
+            continue;
+        }
+        // A rule for thing and state beats a rule for the thing beats a rule for the state
+        int score = (rule.thingId.isNull() ? 0 : 2) + (rule.stateTypeId.isNull() ? 0 : 1);
+        if (score > bestScore) {
+            bestScore = score;
+            interval = rule.interval;
+        }
+    }
+    return interval;
+}
+
+bool NotificationThrottle::submit(const QString &key, int interval, const QByteArray &data, qint64 now)
+{
+    if (m_pending.contains(key)) {
+        m_pending[key].data = data;
+        return false;
+    }
+
+    if (!m_lastSent.contains(key) || now - m_lastSent.value(key) >= interval) {
+        m_lastSent[key] = now;
+        return true;
+    }
+
+    Pending pending;
+    pending.data = data;
+    pending.dueTime = m_lastSent.value(key) + interval;
+    m_pending.insert(key, pending);
+    return false;
+}
+
+bool NotificationThrottle::hasPending() const
+{
+    return !m_pending.isEmpty();
+}
+
+QList<QByteArray> NotificationThrottle::takeDue(qint64 now)
+{
+    QList<QByteArray> due;
+    QHash<QString, Pending>::iterator it = m_pending.begin();
+    while (it != m_pending.end()) {
+        if (it.value().dueTime > now) {
+            ++it;
+            continue;
+        }
+        due.append(it.value().data);
+        m_lastSent[it.key()] = now;
+        it = m_pending.erase(it);
+    }
+
+    // A key sent longer ago than any interval is as good as never sent
+    int maxInterval = this->maxInterval();
+    QHash<QString, qint64>::iterator lastSentIt = m_lastSent.begin();
+    while (lastSentIt != m_lastSent.end()) {
+        if (now - lastSentIt.value() >= maxInterval && !m_pending.contains(lastSentIt.key())) {
+            lastSentIt = m_lastSent.erase(lastSentIt);
+        } else {
+            ++lastSentIt;
+        }
+    }
+    return due;
+}
+
+QList<QByteArray> NotificationThrottle::takePending(qint64 now)
+{
+    QList<QByteArray> pending;
+    foreach (const QString &key, m_pending.keys()) {
+        pending.append(m_pending.take(key).data);
+        m_lastSent[key] = now;
+    }
+    return pending;
+}
+
+QByteArray NotificationThrottle::takePending(const QString &key, qint64 now)
+{
+    if (!m_pending.contains(key)) {
+        return QByteArray();
+    }
+    m_lastSent[key] = now;
+    return m_pending.take(key).data;
+}
+
+void NotificationThrottle::removeThing(const QUuid &thingId)
+{
+    QString thingIdString = thingId.toString();
+    QHash<QString, Pending>::iterator it = m_pending.begin();
+    while (it != m_pending.end()) {
+        if (it.key().contains(thingIdString)) {
+            it = m_pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    QHash<QString, qint64>::iterator lastSentIt = m_lastSent.begin();
+    while (lastSentIt != m_lastSent.end()) {
+        if (lastSentIt.key().contains(thingIdString)) {
+            lastSentIt = m_lastSent.erase(lastSentIt);
+        } else {
+            ++lastSentIt;
+        }
+    }
+}
+
+int NotificationThrottle::maxInterval() const
+{
+    int maxInterval = m_interval;
+    foreach (const Rule &rule, m_rules) {
+        maxInterval = qMax(maxInterval, rule.interval);
+    }
+    return maxInterval;
+}
+
+}
@@ -0,0 +1,98 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef NOTIFICATIONTHROTTLE_H
+#define NOTIFICATIONTHROTTLE_H
+
+#include <QUuid>
+#include <QHash>
+#include <QVariant>
+#include <QByteArray>
+
+namespace nymeaserver {
+
+// Rate limit for state notifications sent to a single client, as requested with
+// JSONRPC.SetNotificationThrottling. Notifications arriving faster than the configured
+// interval are coalesced so that only the latest value is sent once the interval has passed.
+class NotificationThrottle
+{
+public:
+    class Rule {
+    public:
+        QUuid thingId;
+        QUuid stateTypeId;
+        int interval = 0;
+
+        static Rule fromMap(const QVariantMap &map);
+        QVariantMap toMap() const;
+    };
+
+    int interval() const;
+    void setInterval(int interval);
+
+    QList<Rule> rules() const;
+    void setRules(const QList<Rule> &rules);
+
+    bool isEnabled() const;
+
+    // The interval applying to the given thing and state, the most specific rule wins
+    int interval(const QUuid &thingId, const QUuid &stateTypeId) const;
+
+    // Returns true if data can be sent right away. If not, it is kept pending, replacing
+    // any older pending data for the same key.
+    bool submit(const QString &key, int interval, const QByteArray &data, qint64 now);
+
+    bool hasPending() const;
+    QList<QByteArray> takeDue(qint64 now);
+    QList<QByteArray> takePending(qint64 now);
+    // Takes the pending data for a single key, if any
+    QByteArray takePending(const QString &key, qint64 now);
+    // Forgets everything about the given thing. Keys are expected to contain the thing id.
+    void removeThing(const QUuid &thingId);
+
+private:
+    class Pending {
+    public:
+        QByteArray data;
+        qint64 dueTime = 0;
+    };
+
+    int m_interval = 0;
+    QList<Rule> m_rules;
+
+    int maxInterval() const;
+
+    QHash<QString, qint64> m_lastSent;
+    QHash<QString, Pending> m_pending;
+};
+
+}
+
+#endif // NOTIFICATIONTHROTTLE_H
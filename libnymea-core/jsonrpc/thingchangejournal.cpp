@@ -0,0 +1,86 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "thingchangejournal.h"
+
+#include <QUuid>
+#include <QRegExp>
+
+namespace nymeaserver {
+
+ThingChangeJournal::ThingChangeJournal(int maxEntries):
+    m_maxEntries(maxEntries),
+    m_bootId(QUuid::createUuid().toString().remove(QRegExp("[{}]")))
+{
+}
+
+QString ThingChangeJournal::revision() const
+{
+    return QString("%1:%2").arg(m_bootId).arg(m_revision);
+}
+
+void ThingChangeJournal::record(const ThingId &thingId)
+{
+    m_revision++;
+
+    if (m_thingRevisions.contains(thingId)) {
+        m_entries.remove(m_thingRevisions.value(thingId));
+    }
+    m_entries.insert(m_revision, thingId);
+    m_thingRevisions.insert(thingId, m_revision);
+
+    while (m_entries.count() > m_maxEntries) {
+        QMap<quint64, ThingId>::iterator oldest = m_entries.begin();
+        m_firstRevision = oldest.key();
+        m_thingRevisions.remove(oldest.value());
+        m_entries.erase(oldest);
+    }
+}
+
+bool ThingChangeJournal::changesSince(const QString &revision, QList<ThingId> *thingIds) const
+{
+    int separator = revision.lastIndexOf(':');
+    if (separator < 0 || revision.left(separator) != m_bootId) {
+        return false;
+    }
+
+    bool ok = false;
+    quint64 counter = revision.mid(separator + 1).toULongLong(&ok);
+    if (!ok || counter < m_firstRevision || counter > m_revision) {
+        return false;
+    }
+
+    for (QMap<quint64, ThingId>::const_iterator it = m_entries.upperBound(counter); it != m_entries.constEnd(); ++it) {
+        thingIds->append(it.value());
+    }
+    return true;
+}
+
+}
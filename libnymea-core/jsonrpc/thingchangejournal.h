@@ -0,0 +1,72 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef THINGCHANGEJOURNAL_H
+#define THINGCHANGEJOURNAL_H
+
+#include "typeutils.h"
+
+#include <QMap>
+#include <QHash>
+
+namespace nymeaserver {
+
+// Records which things have been added, changed or removed at which revision so that
+// Integrations.GetThings can reply with only the things changed since a given revision.
+// Only the latest change per thing is kept, the oldest entries are dropped when the
+// journal grows beyond its maximum size.
+// Revisions are handed out as opaque "<bootId>:<counter>" tokens. The boot id is generated
+// for each journal, so tokens from before a restart are never taken for current ones.
+class ThingChangeJournal
+{
+public:
+    explicit ThingChangeJournal(int maxEntries = 10000);
+
+    QString revision() const;
+
+    void record(const ThingId &thingId);
+
+    // Returns false if the revision is malformed, has been handed out by another journal
+    // or the journal does not reach back to it
+    bool changesSince(const QString &revision, QList<ThingId> *thingIds) const;
+
+private:
+    int m_maxEntries = 0;
+    QString m_bootId;
+    quint64 m_revision = 0;
+    quint64 m_firstRevision = 0;
+
+    QMap<quint64, ThingId> m_entries;
+    QHash<ThingId, quint64> m_thingRevisions;
+};
+
+}
+
+#endif // THINGCHANGEJOURNAL_H
@@ -5,7 +5,7 @@ include(../nymea.pri)
 
 QT += bluetooth dbus qml sql websockets serialport
 INCLUDEPATH += $$top_srcdir/libnymea $$top_builddir
-LIBS += -L$$top_builddir/libnymea/ -lnymea -lssl -lcrypto
+LIBS += -L$$top_builddir/libnymea/ -lnymea -lssl -lcrypto -lz
 
 CONFIG += link_pkgconfig
 PKGCONFIG += nymea-mqtt nymea-networkmanager nymea-zigbee nymea-remoteproxyclient nymea-gpio
@@ -79,6 +79,7 @@ HEADERS += nymeacore.h \
     integrations/python/pypluginstorage.h \
     integrations/python/pyplugintimer.h \
     integrations/thingmanagerimplementation.h \
+    integrations/thingsetupscheduler.h \
     integrations/translator.h \
     experiences/experiencemanager.h \
     jsonrpc/modbusrtuhandler.h \
@@ -109,9 +110,18 @@ HEADERS += nymeacore.h \
     servers/bluetoothserver.h \
     servers/websocketserver.h \
     servers/mqttbroker.h \
+    servers/mqtttopictrie.h \
     servers/tunnelproxyserver.h \
+    servers/streamcompressor.h \
+    servers/staticfilecache.h \
+    servers/tlshandshaker.h \
     jsonrpc/jsonrpcserverimplementation.h \
+    jsonrpc/jsonframer.h \
     jsonrpc/jsonvalidator.h \
+    jsonrpc/notificationsubscriptions.h \
+    jsonrpc/notificationthrottle.h \
+    jsonrpc/thingchangejournal.h \
+    jsonrpc/clientsendqueue.h \
     jsonrpc/integrationshandler.h \
     jsonrpc/ruleshandler.h \
     jsonrpc/logginghandler.h \
@@ -181,6 +191,7 @@ SOURCES += nymeacore.cpp \
     integrations/apikeysprovidersloader.cpp \
     integrations/plugininfocache.cpp \
     integrations/thingmanagerimplementation.cpp \
+    integrations/thingsetupscheduler.cpp \
     integrations/translator.cpp \
     experiences/experiencemanager.cpp \
     jsonrpc/modbusrtuhandler.cpp \
@@ -211,9 +222,18 @@ SOURCES += nymeacore.cpp \
     servers/websocketserver.cpp \
     servers/bluetoothserver.cpp \
     servers/mqttbroker.cpp \
+    servers/mqtttopictrie.cpp \
     servers/tunnelproxyserver.cpp \
+    servers/streamcompressor.cpp \
+    servers/staticfilecache.cpp \
+    servers/tlshandshaker.cpp \
     jsonrpc/jsonrpcserverimplementation.cpp \
+    jsonrpc/jsonframer.cpp \
     jsonrpc/jsonvalidator.cpp \
+    jsonrpc/notificationsubscriptions.cpp \
+    jsonrpc/notificationthrottle.cpp \
+    jsonrpc/thingchangejournal.cpp \
+    jsonrpc/clientsendqueue.cpp \
     jsonrpc/integrationshandler.cpp \
     jsonrpc/ruleshandler.cpp \
     jsonrpc/logginghandler.cpp \
@@ -69,6 +69,7 @@ NymeaConfiguration::NymeaConfiguration(QObject *parent) :
     setLocale(locale());
     setBluetoothServerEnabled(bluetoothServerEnabled());
     setSslCertificate(sslCertificate(), sslCertificateKey());
+    setSslKeyType(sslKeyType());
     setDebugServerEnabled(debugServerEnabled());
 
     NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
@@ -544,6 +545,22 @@ void NymeaConfiguration::setSslCertificate(const QString &sslCertificate, const
     settings.endGroup();
 }
 
+QString NymeaConfiguration::sslKeyType() const
+{
+    // Key type of the self-signed fallback certificate, "rsa" or "ecdsa"
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("SSL");
+    return settings.value("key-type", "rsa").toString();
+}
+
+void NymeaConfiguration::setSslKeyType(const QString &keyType)
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("SSL");
+    settings.setValue("key-type", keyType);
+    settings.endGroup();
+}
+
 bool NymeaConfiguration::debugServerEnabled() const
 {
     NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
@@ -155,6 +155,8 @@ public:
     QString sslCertificate() const;
     QString sslCertificateKey() const;
     void setSslCertificate(const QString &sslCertificate, const QString &sslCertificateKey);
+    QString sslKeyType() const;
+    void setSslKeyType(const QString &keyType);
 
     // Debug server
     bool debugServerEnabled() const;
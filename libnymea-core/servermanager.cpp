@@ -84,16 +84,24 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
         QString fallbackCertificateFileName = NymeaSettings::storagePath() + "/certs/nymead-certificate.crt";
         QString fallbackKeyFileName = NymeaSettings::storagePath() + "/certs/nymead-certificate.key";
 
+        // The self-signed fallback certificate is regenerated if the configured key type changed
+        CertificateGenerator::KeyType keyType = CertificateGenerator::KeyTypeRsa;
+        QSsl::KeyAlgorithm keyAlgorithm = QSsl::Rsa;
+        if (configuration->sslKeyType().toLower() == "ecdsa") {
+            keyType = CertificateGenerator::KeyTypeEcdsa;
+            keyAlgorithm = QSsl::Ec;
+        }
+
         bool certsLoaded = false;
         if (!configKeyFileName.isEmpty() && !configCertificateFileName.isEmpty() && loadCertificate(configKeyFileName, configCertificateFileName)) {
             qCDebug(dcServerManager()) << "Using SSL certificate:" << configCertificateFileName;
             certsLoaded = true;
-        } else if (!fallbackKeyFileName.isEmpty() && !fallbackCertificateFileName.isEmpty() && loadCertificate(fallbackKeyFileName, fallbackCertificateFileName)) {
+        } else if (!fallbackKeyFileName.isEmpty() && !fallbackCertificateFileName.isEmpty() && loadCertificate(fallbackKeyFileName, fallbackCertificateFileName) && m_certificateKey.algorithm() == keyAlgorithm) {
             certsLoaded = true;
             qCDebug(dcServerManager()) << "Using fallback self-signed SSL certificate:" << fallbackCertificateFileName;
         } else {
-            qCDebug(dcServerManager()) << "Generating self signed certificates...";
-            CertificateGenerator::generate(fallbackCertificateFileName, fallbackKeyFileName);
+            qCDebug(dcServerManager()) << "Generating self signed certificates with key type" << configuration->sslKeyType();
+            CertificateGenerator::generate(fallbackCertificateFileName, fallbackKeyFileName, keyType);
             if (loadCertificate(fallbackKeyFileName, fallbackCertificateFileName)) {
                 qCWarning(dcServerManager()) << "Using newly created self-signed SSL certificate:" << fallbackCertificateFileName;
                 certsLoaded = true;
@@ -442,7 +450,11 @@ bool ServerManager::loadCertificate(const QString &certificateKeyFileName, const
         return false;
     }
 
-    m_certificateKey = QSslKey(&certificateKeyFile, QSsl::Rsa);
+    QByteArray keyData = certificateKeyFile.readAll();
+    m_certificateKey = QSslKey(keyData, QSsl::Rsa);
+    if (m_certificateKey.isNull()) {
+        m_certificateKey = QSslKey(keyData, QSsl::Ec);
+    }
     if (m_certificateKey.isNull()) {
         qCWarning(dcServerManager()) << "SSL certificate key" << certificateFileName << "is not valid.";
         return false;
@@ -55,8 +55,12 @@
         The resource was accepted.
     \value NoContent
         The request has no content but it was expected.
+    \value PartialContent
+        The reply contains the range of the resource requested with the "Range" header.
     \value Found
         The resource was found.
+    \value NotModified
+        The resource has not been modified since the version the client has cached.
     \value PermanentRedirect
         The resource redirects permanent to given url.
     \value BadRequest
@@ -71,6 +75,8 @@
         The request method timed out. Default timeout = 5s.
     \value Conflict
         The request resource conflicts with an other.
+    \value RangeNotSatisfiable
+        The range requested with the "Range" header lies outside of the resource.
     \value InternalServerError
         There was an internal server error.
     \value NotImplemented
@@ -147,6 +153,7 @@
 #include "version.h"
 
 #include <QDateTime>
+#include <QFileInfo>
 #include <QPair>
 #include <QDebug>
 
@@ -172,7 +179,6 @@ HttpReply::HttpReply(QObject *parent) :
     setHeader(HttpHeaderType::CacheControlHeader, "no-cache");
     setHeader(HttpHeaderType::ConnectionHeader, "Keep-Alive");
     setRawHeader("Access-Control-Allow-Origin","*");
-    setRawHeader("Keep-Alive", QString("timeout=%1, max=50").arg(m_timeout).toUtf8());
     packReply();
 }
 
@@ -181,6 +187,7 @@ HttpReply::HttpReply(const HttpReply::HttpStatusCode &statusCode, const HttpRepl
     m_statusCode(statusCode),
     m_type(type),
     m_payload(QByteArray()),
+    m_closeConnection(false),
     m_timedOut(false)
 {
     m_timer = new QTimer(this);
@@ -195,7 +202,6 @@ HttpReply::HttpReply(const HttpReply::HttpStatusCode &statusCode, const HttpRepl
     setHeader(HttpHeaderType::CacheControlHeader, "no-cache");
     setHeader(HttpHeaderType::ConnectionHeader, "Keep-Alive");
     setRawHeader("Access-Control-Allow-Origin","*");
-    setRawHeader("Keep-Alive", QString("timeout=%1, max=50").arg(m_timeout).toUtf8());
     packReply();
 }
 
@@ -263,6 +269,7 @@ QUuid HttpReply::clientId() const
 /*! Set the payload of this \l{HttpReply} to the given \a data.*/
 void HttpReply::setPayload(const QByteArray &data)
 {
+    m_payloadFileName.clear();
     m_payload = data;
     setHeader(HttpHeaderType::ContentLenghtHeader, QByteArray::number(data.length()));
     packReply();
@@ -274,6 +281,61 @@ QByteArray HttpReply::payload() const
     return m_payload;
 }
 
+/*! Set the payload of this \l{HttpReply} to \a length bytes of the file with the given \a fileName, starting at \a offset.
+    If \a length is -1, the rest of the file will be sent. The file will not be loaded into memory, the \l{WebServer}
+    streams it to the client in chunks once the header has been sent.
+
+    \sa hasPayloadFile()
+*/
+void HttpReply::setPayloadFile(const QString &fileName, qint64 offset, qint64 length)
+{
+    if (length < 0)
+        length = qMax<qint64>(QFileInfo(fileName).size() - offset, 0);
+
+    m_payload.clear();
+    m_payloadFileName = fileName;
+    m_payloadFileOffset = offset;
+    m_payloadFileLength = length;
+    setHeader(HttpHeaderType::ContentLenghtHeader, QByteArray::number(length));
+    packReply();
+}
+
+/*! Returns the name of the file sent as payload of this \l{HttpReply}.
+
+    \sa setPayloadFile()
+*/
+QString HttpReply::payloadFileName() const
+{
+    return m_payloadFileName;
+}
+
+/*! Returns the position in the payload file where the payload starts.
+
+    \sa setPayloadFile()
+*/
+qint64 HttpReply::payloadFileOffset() const
+{
+    return m_payloadFileOffset;
+}
+
+/*! Returns the number of bytes of the payload file which will be sent.
+
+    \sa setPayloadFile()
+*/
+qint64 HttpReply::payloadFileLength() const
+{
+    return m_payloadFileLength;
+}
+
+/*! Returns true if the payload of this \l{HttpReply} will be streamed from a file instead of \l{payload()}.
+
+    \sa setPayloadFile()
+*/
+bool HttpReply::hasPayloadFile() const
+{
+    return !m_payloadFileName.isEmpty();
+}
+
 /*! This method appends a raw header to the header list of this \l{HttpReply}.
     The Header will be set to \a headerType : \a value.
 */
@@ -340,6 +402,7 @@ void HttpReply::clear()
     m_statusCode = Ok;
     m_rawHeader.clear();
     m_payload.clear();
+    m_payloadFileName.clear();
     m_rawHeaderList.clear();
 }
 /*! Packs the whole reply data of this \l{HttpReply}. The data can be accessed with \l{HttpReply::data()}.
@@ -354,14 +417,28 @@ void HttpReply::packReply()
 
     // write header
     foreach (const QByteArray &headerName, m_rawHeaderList.keys()) {
+        if (m_closeConnection && (headerName == "Connection" || headerName == "Keep-Alive"))
+            continue;
+
         m_rawHeader.append(headerName + ": " + m_rawHeaderList.value(headerName) + "\r\n" );
     }
 
+    if (m_closeConnection)
+        m_rawHeader.append("Connection: close\r\n");
+
+    // On persistent connections the client needs the Content-Length to find the end of the reply
+    if (!m_rawHeaderList.contains("Content-Length") && m_statusCode != NoContent && m_statusCode != NotModified)
+        m_rawHeader.append("Content-Length: 0\r\n");
+
     m_rawHeader.append("\r\n");
     m_data = QByteArray(m_rawHeader).append(m_payload);
 }
 
-/*! Returns the current raw data (header + payload) of this \l{HttpReply}.*/
+/*! Returns the current raw data (header + payload) of this \l{HttpReply}. If the payload is
+    streamed from a file, only the header is returned.
+
+    \sa hasPayloadFile()
+*/
 QByteArray HttpReply::data() const
 {
     return m_data;
@@ -389,9 +466,15 @@ QByteArray HttpReply::getHttpReasonPhrase(const HttpReply::HttpStatusCode &statu
     case NoContent:
         response = QString("No Content").toUtf8();
         break;
+    case PartialContent:
+        response = QString("Partial Content").toUtf8();
+        break;
     case Found:
         response = QString("Found").toUtf8();
         break;
+    case NotModified:
+        response = QString("Not Modified").toUtf8();
+        break;
     case PermanentRedirect:
         response = QString("Permanent Redirect").toUtf8();
         break;
@@ -413,6 +496,9 @@ QByteArray HttpReply::getHttpReasonPhrase(const HttpReply::HttpStatusCode &statu
     case Conflict:
         response = QString("Conflict").toUtf8();
         break;
+    case RangeNotSatisfiable:
+        response = QString("Range Not Satisfiable").toUtf8();
+        break;
     case InternalServerError:
         response = QString("Internal Server Error").toUtf8();
         break;
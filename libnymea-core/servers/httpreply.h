@@ -51,7 +51,9 @@ public:
         Created                 = 201,
         Accepted                = 202,
         NoContent               = 204,
+        PartialContent          = 206,
         Found                   = 302,
+        NotModified             = 304,
         PermanentRedirect       = 308,
         BadRequest              = 400,
         Forbidden               = 403,
@@ -59,6 +61,7 @@ public:
         MethodNotAllowed        = 405,
         RequestTimeout          = 408,
         Conflict                = 409,
+        RangeNotSatisfiable     = 416,
         InternalServerError     = 500,
         NotImplemented          = 501,
         BadGateway              = 502,
@@ -104,6 +107,12 @@ public:
     void setPayload(const QByteArray &data);
     QByteArray payload() const;
 
+    void setPayloadFile(const QString &fileName, qint64 offset = 0, qint64 length = -1);
+    QString payloadFileName() const;
+    qint64 payloadFileOffset() const;
+    qint64 payloadFileLength() const;
+    bool hasPayloadFile() const;
+
     void setRawHeader(const QByteArray headerType, const QByteArray &value);
     void setHeader(const HttpHeaderType &headerType, const QByteArray &value);
     QHash<QByteArray, QByteArray> rawHeaderList() const;
@@ -131,6 +140,10 @@ private:
     QByteArray m_payload;
     QByteArray m_data;
 
+    QString m_payloadFileName;
+    qint64 m_payloadFileOffset = 0;
+    qint64 m_payloadFileLength = 0;
+
     QHash<QByteArray, QByteArray> m_rawHeaderList;
 
     bool m_closeConnection;
@@ -70,9 +70,17 @@
 
 namespace nymeaserver {
 
+static const int maxHeaderSize = 16 * 1024;
+static const qint64 maxPayloadSize = 16 * 1024 * 1024;
+// Data pipelined behind a complete request while the server is still busy with it
+static const qint64 maxPipelinedSize = maxHeaderSize + maxPayloadSize;
+// Chunk size lines (including extensions) and trailer lines
+static const int maxChunkLineSize = 1024;
+
 /*! Construct an empty \l{HttpRequest}. */
 HttpRequest::HttpRequest() :
     m_rawData(QByteArray()),
+    m_method(Unhandled),
     m_valid(false),
     m_isComplete(false)
 {
@@ -85,6 +93,7 @@ HttpRequest::HttpRequest() :
 */
 HttpRequest::HttpRequest(QByteArray rawData) :
     m_rawData(rawData),
+    m_method(Unhandled),
     m_valid(false),
     m_isComplete(false)
 {
@@ -148,7 +157,10 @@ bool HttpRequest::isValid() const
     return m_valid;
 }
 
-/*! Returns true if this \l{HttpRequest} is complete. A HTTP request is complete if "Content-Length" header value matches the actual payload size. Bigger packages will be sent in multiple TCP packages. */
+/*! Returns true if this \l{HttpRequest} is complete. A HTTP request is complete if the whole header and the whole body, as
+    announced by the "Content-Length" header or terminated by the last chunk of a "Transfer-Encoding: chunked" body, have
+    been received. Bigger packages will be sent in multiple TCP packages.
+*/
 bool HttpRequest::isComplete() const
 {
     return m_isComplete;
@@ -160,10 +172,33 @@ bool HttpRequest::hasPayload() const
     return !m_payload.isEmpty();
 }
 
+/*! Returns true if the body of this \l{HttpRequest} was sent with "Transfer-Encoding: chunked". The \l{payload()} contains
+    the decoded data in that case.
+*/
+bool HttpRequest::isChunked() const
+{
+    return m_chunked;
+}
+
+/*! Returns true if the client wants to keep the connection open after this \l{HttpRequest} has been answered. HTTP/1.1
+    connections are persistent unless the client sends "Connection: close", HTTP/1.0 connections only if the client
+    asks for it with "Connection: keep-alive".
+*/
+bool HttpRequest::keepAlive() const
+{
+    QByteArray connection = headerValue("Connection").toLower();
+    if (m_httpVersion == "HTTP/1.0")
+        return connection.contains("keep-alive");
+
+    return !connection.contains("close");
+}
+
 /*! Appends the given \a data to the current raw data of this \l{HttpRequest}.
- *  This method will be used if a \l{HttpRequest} is not complete yet.
+ *  This method will be used if a \l{HttpRequest} is not complete yet. Only the newly
+ *  received data will be parsed. Data appended to a complete request belongs to the
+ *  next request on this connection and can be fetched with \l{remainingData()}.
  *
- *  \sa isComplete()
+ *  \sa isComplete(), remainingData()
 */
 void HttpRequest::appendData(const QByteArray &data)
 {
@@ -171,38 +206,87 @@ void HttpRequest::appendData(const QByteArray &data)
     validate();
 }
 
-void HttpRequest::validate()
+/*! Returns the data received after the end of this \l{HttpRequest}. This is the beginning of
+ *  the next request if the client pipelines its requests. Returns an empty byte array as long
+ *  as this request is not complete.
+ *
+ *  \sa isComplete()
+*/
+QByteArray HttpRequest::remainingData() const
 {
-    m_isComplete = true; m_valid = false;
+    if (!m_isComplete)
+        return QByteArray();
 
-    // Parese the HTTP request. The request is invalid, until the end of the parse process.
-    if (m_rawData.isEmpty())
-        return;
+    return m_rawData.mid(m_requestSize);
+}
+
+/*! Returns true if the data received after the end of this complete \l{HttpRequest} exceeds
+ *  the size of the largest request accepted. The next request is only parsed once this one
+ *  has been answered, so the limits of a single request don't apply to it before.
+ *
+ *  \sa remainingData()
+*/
+bool HttpRequest::exceedsPipelineLimit() const
+{
+    return m_isComplete && m_rawData.size() - m_requestSize > maxPipelinedSize;
+}
 
-    // split the data into header and payload
-    int headerEndIndex = m_rawData.indexOf("\r\n\r\n");
-    if (headerEndIndex < 0) {
-        qCWarning(dcWebServer()) << "Could not parse end of HTTP header (empty line between header and body):" << m_rawData;
+void HttpRequest::validate()
+{
+    // Data behind a complete request belongs to the next one
+    if (m_isComplete)
         return;
+
+    // Parse the HTTP request. The request is invalid, until the end of the parse process.
+    if (m_headerSize == 0) {
+        // RFC 7230 3.5: ignore empty lines in front of the request line. Some clients
+        // also send a stray whitespace behind the body of the previous request.
+        int requestLineStart = 0;
+        while (requestLineStart < m_rawData.size() && QChar(m_rawData.at(requestLineStart)).isSpace())
+            requestLineStart++;
+        m_rawData.remove(0, requestLineStart);
+
+        int headerEndIndex = m_rawData.indexOf("\r\n\r\n");
+        if (headerEndIndex < 0) {
+            if (m_rawData.size() > maxHeaderSize) {
+                qCWarning(dcWebServer()) << "HTTP header exceeds" << maxHeaderSize << "bytes. Discarding request.";
+                discard();
+            }
+            return;
+        }
+
+        m_headerSize = headerEndIndex + 4;
+        m_rawHeader = m_rawData.left(headerEndIndex);
+        if (!parseHeader()) {
+            discard();
+            return;
+        }
+        m_parsePosition = m_headerSize;
     }
 
-    m_rawHeader = m_rawData.left(headerEndIndex);
-    m_payload = m_rawData.right(m_rawData.length() - headerEndIndex).simplified();
+    if (m_chunked) {
+        parseChunkedBody();
+    } else {
+        parseBody();
+    }
+}
 
+bool HttpRequest::parseHeader()
+{
     // parse status line
     QStringList headerLines = QString(m_rawHeader).split(QRegExp("\r\n"));
     QString statusLine = headerLines.takeFirst();
     QStringList statusLineTokens = statusLine.split(QRegExp("[ \r\n][ \r\n]*"));
     if (statusLineTokens.count() != 3) {
         qCWarning(dcWebServer()) << "Could not parse HTTP status line:" << statusLine;
-        return;
+        return false;
     }
 
     // verify http version
     m_httpVersion = statusLineTokens.at(2).toUtf8().simplified();
     if (!m_httpVersion.contains("HTTP")) {
         qCWarning(dcWebServer()) << "Unknown HTTP version:" << m_httpVersion;
-        return;
+        return false;
     }
     m_methodString = statusLineTokens.at(0).simplified();
     m_method = getRequestMethodType(m_methodString);
@@ -216,7 +300,7 @@ void HttpRequest::validate()
     foreach (const QString &line, headerLines) {
         if (!line.contains(":")) {
             qCWarning(dcWebServer()) << "Invalid HTTP header:" << line;
-            return;
+            return false;
         }
         int index = line.indexOf(":");
         QByteArray key = line.left(index).toUtf8().simplified();
@@ -228,36 +312,160 @@ void HttpRequest::validate()
     if (!m_rawHeaderList.contains("User-Agent"))
         qCDebug(dcWebServer()) << "User-Agent header is missing";
 
+    // RFC 7230 3.3.3: chunked transfer coding overrides the Content-Length
+    if (headerValue("Transfer-Encoding").toLower().contains("chunked")) {
+        m_chunked = true;
+        return true;
+    }
 
-    // verify content length with actual payload
-    if (m_rawHeaderList.contains("Content-Length")) {
+    QByteArray contentLength = headerValue("Content-Length");
+    if (!contentLength.isEmpty()) {
         bool ok = false;
-        int contentLength = m_rawHeaderList.value("Content-Length").toInt(&ok);
-        if (!ok) {
+        m_contentLength = contentLength.toLongLong(&ok);
+        if (!ok || m_contentLength < 0) {
             qCWarning(dcWebServer()) << "Could not parse Content-Length.";
+            return false;
+        }
+        if (m_contentLength > maxPayloadSize) {
+            qCWarning(dcWebServer()) << "Content-Length" << m_contentLength << "exceeds the maximum payload size of" << maxPayloadSize << "bytes.";
+            return false;
+        }
+    }
+    return true;
+}
+
+void HttpRequest::parseBody()
+{
+    // check if we have all data
+    if (m_rawData.size() - m_headerSize < m_contentLength) {
+        qCDebug(dcWebServer()) << "Request incomplete:";
+        qCDebug(dcWebServer()) << "   -> Content-Length:" << m_contentLength;
+        qCDebug(dcWebServer()) << "   -> Payload size  :" << m_rawData.size() - m_headerSize;
+        return;
+    }
+
+    m_payload = m_rawData.mid(m_headerSize, static_cast<int>(m_contentLength));
+    finish(m_headerSize + static_cast<int>(m_contentLength));
+}
+
+void HttpRequest::parseChunkedBody()
+{
+    // chunk = chunk-size [ chunk-ext ] CRLF chunk-data CRLF, terminated by a zero sized chunk and optional trailers
+    forever {
+        int lineEnd = m_rawData.indexOf("\r\n", m_parsePosition);
+        int lineSize = lineEnd < 0 ? m_rawData.size() - m_parsePosition : lineEnd - m_parsePosition;
+        if (lineSize > maxChunkLineSize) {
+            qCWarning(dcWebServer()) << "Chunk line exceeds" << maxChunkLineSize << "bytes. Discarding request.";
+            discard();
             return;
         }
-        // check if we have all data
-        if (m_payload.size() < contentLength) {
-            qCDebug(dcWebServer()) << "Request incomplete:";
-            qCDebug(dcWebServer()) << "   -> Content-Length:" << contentLength;
-            qCDebug(dcWebServer()) << "   -> Payload size  :" << payload().size();
-            m_isComplete = false;
+        if (lineEnd < 0)
+            return;
+
+        if (m_chunkTrailer) {
+            // The trailer section ends with an empty line. Trailer fields are not used.
+            if (lineEnd == m_parsePosition) {
+                finish(lineEnd + 2);
+                return;
+            }
+            m_parsePosition = lineEnd + 2;
+            continue;
+        }
+
+        QByteArray sizeLine = m_rawData.mid(m_parsePosition, lineEnd - m_parsePosition);
+        int extensionIndex = sizeLine.indexOf(';');
+        if (extensionIndex >= 0)
+            sizeLine.truncate(extensionIndex);
+
+        bool ok = false;
+        qint64 chunkSize = sizeLine.trimmed().toLongLong(&ok, 16);
+        if (!ok || chunkSize < 0 || m_payload.size() + chunkSize > maxPayloadSize) {
+            qCWarning(dcWebServer()) << "Invalid chunk size in chunked HTTP request:" << sizeLine;
+            discard();
+            return;
+        }
+
+        if (chunkSize == 0) {
+            m_chunkTrailer = true;
+            m_parsePosition = lineEnd + 2;
+            continue;
+        }
+
+        int chunkStart = lineEnd + 2;
+        if (m_rawData.size() < chunkStart + chunkSize + 2) {
+            qCDebug(dcWebServer()) << "Chunked request incomplete. Have" << m_payload.size() << "bytes.";
             return;
         }
-        // check if the content length bigger than header Content-Length
-        if (m_payload.size() > contentLength) {
-            qCWarning(dcWebServer()) << "Payload size greater than header Content-Length:";
-            qCWarning(dcWebServer()) << "   -> Content-Length:" << contentLength;
-            qCWarning(dcWebServer()) << "   -> Payload size  :" << payload().size();
-            m_isComplete = true;
+
+        if (m_rawData.mid(chunkStart + static_cast<int>(chunkSize), 2) != "\r\n") {
+            qCWarning(dcWebServer()) << "Chunk data not terminated with CRLF.";
+            discard();
             return;
         }
 
+        m_payload.append(m_rawData.constData() + chunkStart, static_cast<int>(chunkSize));
+        m_parsePosition = chunkStart + static_cast<int>(chunkSize) + 2;
+    }
+}
+
+void HttpRequest::finish(int requestSize)
+{
+    m_isComplete = true;
+    m_requestSize = requestSize;
+
+    // Data following the request must be the start of a pipelined request. Anything else
+    // means the client sent more payload than announced in the Content-Length.
+    QByteArray remaining = m_rawData.mid(m_requestSize);
+    if (!remaining.isEmpty() && !startsWithRequestLine(remaining)) {
+        qCWarning(dcWebServer()) << "Payload size greater than header Content-Length:";
+        qCWarning(dcWebServer()) << "   -> Content-Length:" << m_contentLength;
+        qCWarning(dcWebServer()) << "   -> Payload size  :" << m_rawData.size() - m_headerSize;
+        m_requestSize = m_rawData.size();
+        return;
     }
+
     m_valid = true;
 }
 
+void HttpRequest::discard()
+{
+    // The stream can not be resynchronized, drop everything received on it
+    m_isComplete = true;
+    m_valid = false;
+    m_requestSize = m_rawData.size();
+}
+
+QByteArray HttpRequest::headerValue(const QByteArray &name) const
+{
+    // Header field names are case-insensitive (RFC 7230 3.2)
+    foreach (const QByteArray &key, m_rawHeaderList.keys()) {
+        if (qstricmp(key.constData(), name.constData()) == 0) {
+            return m_rawHeaderList.value(key);
+        }
+    }
+    return QByteArray();
+}
+
+bool HttpRequest::startsWithRequestLine(const QByteArray &data)
+{
+    // A request line starts with an upper case method token followed by a space. The next
+    // request may also have been cut off in the middle of the method token.
+    int index = 0;
+    while (index < data.size() && QChar(data.at(index)).isSpace())
+        index++;
+
+    int tokenStart = index;
+    for (; index < data.size(); index++) {
+        char c = data.at(index);
+        if (c == ' ')
+            return index > tokenStart;
+
+        if (c < 'A' || c > 'Z')
+            return false;
+    }
+    return true;
+}
+
 HttpRequest::RequestMethod HttpRequest::getRequestMethodType(const QString &methodString)
 {
     if (methodString == "GET") {
@@ -55,6 +55,8 @@ public:
 
     QByteArray rawHeader() const;
     QHash<QByteArray, QByteArray> rawHeaderList() const;
+    // The value of the given header, the name is matched case-insensitively
+    QByteArray headerValue(const QByteArray &name) const;
 
     RequestMethod method() const;
     QString methodString() const;
@@ -68,8 +70,12 @@ public:
     bool isValid() const;
     bool isComplete() const;
     bool hasPayload() const;
+    bool isChunked() const;
+    bool keepAlive() const;
 
     void appendData(const QByteArray &data);
+    QByteArray remainingData() const;
+    bool exceedsPipelineLimit() const;
 
 private:
     QByteArray m_rawData;
@@ -88,7 +94,21 @@ private:
     bool m_valid;
     bool m_isComplete;
 
+    // Incremental parser state
+    int m_headerSize = 0;
+    int m_requestSize = 0;
+    int m_parsePosition = 0;
+    qint64 m_contentLength = 0;
+    bool m_chunked = false;
+    bool m_chunkTrailer = false;
+
     void validate();
+    bool parseHeader();
+    void parseBody();
+    void parseChunkedBody();
+    void finish(int requestSize);
+    void discard();
+    static bool startsWithRequestLine(const QByteArray &data);
     RequestMethod getRequestMethodType(const QString &methodString);
 };
 
@@ -70,6 +70,16 @@ void MockTcpServer::sendData(const QList<QUuid> &clients, const QByteArray &data
     }
 }
 
+bool MockTcpServer::supportsBinaryData() const
+{
+    return true;
+}
+
+void MockTcpServer::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    emit outgoingData(clientId, data);
+}
+
 void MockTcpServer::terminateClientConnection(const QUuid &clientId)
 {
     emit connectionTerminated(clientId);
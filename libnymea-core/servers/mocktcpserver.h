@@ -50,6 +50,8 @@ public:
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
+    bool supportsBinaryData() const override;
+    void sendBinaryData(const QUuid &clientId, const QByteArray &data) override;
     void terminateClientConnection(const QUuid &clientId) override;
 
 /************** Used for testing **************************/
@@ -29,6 +29,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "mqttbroker.h"
+#include "mqtttopictrie.h"
 #include "loggingcategories.h"
 
 #include <mqttserver.h>
@@ -63,60 +64,50 @@ public:
         if (!m_broker->m_configs.value(serverAddressId).authenticationEnabled) {
             return true;
         }
-        if (!m_broker->m_policies.contains(clientId)) {
+        QHash<QString, CompiledPolicy>::const_iterator policy = m_compiledPolicies.constFind(clientId);
+        if (policy == m_compiledPolicies.constEnd()) {
             return false;
         }
-        MqttPolicy policy = m_broker->m_policies.value(clientId);
-        return matchPolicy(policy.allowedSubscribeTopicFilters, topicFilter);
+        return policy.value().subscribeFilters.matches(topicFilter);
     }
 
     bool authorizePublish(int serverAddressId, const QString &clientId, const QString &topic) override {
         if (!m_broker->m_configs.value(serverAddressId).authenticationEnabled) {
             return true;
         }
-        if (!m_broker->m_policies.contains(clientId)) {
+        QHash<QString, CompiledPolicy>::const_iterator policy = m_compiledPolicies.constFind(clientId);
+        if (policy == m_compiledPolicies.constEnd()) {
             return false;
         }
-        MqttPolicy policy = m_broker->m_policies.value(clientId);
-        return matchPolicy(policy.allowedPublishTopicFilters, topic);
+        return policy.value().publishFilters.matches(topic);
     }
 
-    bool matchPolicy(const QStringList &policies, const QString &topic) {
-        foreach (const QString &policyFilter, policies) {
-            QStringList policyParts = policyFilter.split('/');
-            QStringList topicParts = topic.split('/');
-            if (topicParts.count() < policyParts.count() - 1) {
-                // Nope... actual topic is shorter than filter
-                continue;
-            }
-            bool bad = false;
-            for (int i = 0; i < policyParts.length(); i++) {
-                if (policyParts.at(i) == QStringLiteral("+")) {
-                    continue;
-                }
-                if (policyParts.at(i) == QStringLiteral("#")) {
-                    continue;
-                }
-                if (policyParts.at(i) == topicParts.at(i)) {
-                    continue;
-                }
-                // Nope... this part does neither match nor is covered by a wildcard in the policy
-                bad = true;
-            }
-            if (bad) {
-                continue;
-            }
-            if (policyParts.count() == topicParts.count() || policyFilter.endsWith('#')) {
-                // OK, either the policy is matching or the topicFilter is longer as the policy and policy ends with #
-                return true;
-            }
+    // Policies are compiled into topic tries when they are installed, so authorizing
+    // a publish or subscribe is a single walk over the topic levels.
+    void compilePolicy(const MqttPolicy &policy) {
+        CompiledPolicy compiled;
+        foreach (const QString &filter, policy.allowedPublishTopicFilters) {
+            compiled.publishFilters.insert(filter, filter);
         }
-        // Nope... none of the policies matched...
-        return false;
+        foreach (const QString &filter, policy.allowedSubscribeTopicFilters) {
+            compiled.subscribeFilters.insert(filter, filter);
+        }
+        m_compiledPolicies.insert(policy.clientId, compiled);
+    }
+
+    void removePolicy(const QString &clientId) {
+        m_compiledPolicies.remove(clientId);
     }
 
 private:
+    class CompiledPolicy {
+    public:
+        MqttTopicTrie publishFilters;
+        MqttTopicTrie subscribeFilters;
+    };
+
     MqttBroker *m_broker;
+    QHash<QString, CompiledPolicy> m_compiledPolicies;
 };
 
 MqttBroker::MqttBroker(QObject *parent) : QObject(parent)
@@ -200,6 +191,7 @@ MqttPolicy MqttBroker::policy(const QString &clientId)
 
 void MqttBroker::updatePolicy(const MqttPolicy &policy)
 {
+    m_authorizer->compilePolicy(policy);
     if (m_policies.contains(policy.clientId)) {
         m_policies[policy.clientId] = policy;
         qCDebug(dcMqtt) << "Policy for client" << policy.clientId << "updated.";
@@ -226,6 +218,7 @@ bool MqttBroker::removePolicy(const QString &clientId)
             m_server->disconnectClient(clientId);
         }
 
+        m_authorizer->removePolicy(clientId);
         qCDebug(dcMqtt) << "Policy for client" << clientId << "removed";
         emit policyRemoved(m_policies.take(clientId));
         return true;
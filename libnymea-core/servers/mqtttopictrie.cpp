@@ -0,0 +1,145 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "mqtttopictrie.h"
+
+namespace nymeaserver {
+
+static const QString singleLevelWildcard = QStringLiteral("+");
+static const QString multiLevelWildcard = QStringLiteral("#");
+
+void MqttTopicTrie::insert(const QString &filter, const QString &key)
+{
+    Node *node = &m_root;
+    foreach (const QStringRef &level, filter.splitRef('/')) {
+        node = &node->children[level.toString()];
+    }
+    node->keys.insert(key);
+}
+
+void MqttTopicTrie::remove(const QString &filter, const QString &key)
+{
+    removeKey(&m_root, filter.splitRef('/'), 0, key);
+}
+
+void MqttTopicTrie::clear()
+{
+    m_root = Node();
+}
+
+bool MqttTopicTrie::isEmpty() const
+{
+    return m_root.children.isEmpty() && m_root.keys.isEmpty();
+}
+
+bool MqttTopicTrie::matches(const QString &topic) const
+{
+    return walk(m_root, topic.splitRef('/'), 0, nullptr);
+}
+
+bool MqttTopicTrie::matches(const QString &topic, const QString &key) const
+{
+    return walk(m_root, topic.splitRef('/'), 0, nullptr, &key);
+}
+
+QSet<QString> MqttTopicTrie::match(const QString &topic) const
+{
+    QSet<QString> keys;
+    walk(m_root, topic.splitRef('/'), 0, &keys);
+    return keys;
+}
+
+// Returns true if the node is empty afterwards and can be pruned
+bool MqttTopicTrie::removeKey(Node *node, const QVector<QStringRef> &levels, int index, const QString &key)
+{
+    if (index == levels.count()) {
+        node->keys.remove(key);
+    } else {
+        QString level = levels.at(index).toString();
+        QHash<QString, Node>::iterator child = node->children.find(level);
+        if (child != node->children.end() && removeKey(&child.value(), levels, index + 1, key)) {
+            node->children.erase(child);
+        }
+    }
+    return node->keys.isEmpty() && node->children.isEmpty();
+}
+
+// Collects the keys of all filters below node matching the topic levels from index on.
+// Without keys, returns on the first match, only looking at filters stored with key if given.
+bool MqttTopicTrie::walk(const Node &node, const QVector<QStringRef> &levels, int index, QSet<QString> *keys, const QString *key)
+{
+    bool found = false;
+
+    // # matches the parent level and everything below
+    QHash<QString, Node>::const_iterator wildcard = node.children.constFind(multiLevelWildcard);
+    if (wildcard != node.children.constEnd() && hasKey(wildcard.value(), key)) {
+        if (!keys)
+            return true;
+
+        keys->unite(wildcard.value().keys);
+        found = true;
+    }
+
+    if (index == levels.count()) {
+        if (!hasKey(node, key))
+            return found;
+
+        if (keys)
+            keys->unite(node.keys);
+
+        return true;
+    }
+
+    // Points into the topic, no copy of the level is made for the lookup
+    const QStringRef &levelRef = levels.at(index);
+    QString level = QString::fromRawData(levelRef.unicode(), levelRef.size());
+
+    QHash<QString, Node>::const_iterator child = node.children.constFind(level);
+    if (child != node.children.constEnd() && walk(child.value(), levels, index + 1, keys, key)) {
+        if (!keys)
+            return true;
+
+        found = true;
+    }
+
+    child = node.children.constFind(singleLevelWildcard);
+    if (child != node.children.constEnd() && walk(child.value(), levels, index + 1, keys, key)) {
+        found = true;
+    }
+
+    return found;
+}
+
+bool MqttTopicTrie::hasKey(const Node &node, const QString *key)
+{
+    return key ? node.keys.contains(*key) : !node.keys.isEmpty();
+}
+
+}
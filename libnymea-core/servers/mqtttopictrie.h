@@ -0,0 +1,80 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MQTTTOPICTRIE_H
+#define MQTTTOPICTRIE_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+namespace nymeaserver {
+
+// Index of MQTT topic filters, one level of the filter per trie node. Each filter is
+// stored with a key (e.g. the policy or channel it belongs to), so matching a topic
+// is a single walk over its levels, no matter how many filters are stored.
+// The + and # wildcards are supported, # only as the last level of a filter.
+// Topic levels are matched literally, a subscription filter passed as topic only
+// matches filters which cover all its levels, including its wildcard levels.
+class MqttTopicTrie
+{
+public:
+    MqttTopicTrie() = default;
+
+    void insert(const QString &filter, const QString &key);
+    void remove(const QString &filter, const QString &key);
+    void clear();
+    bool isEmpty() const;
+
+    // True if any of the stored filters matches the topic
+    bool matches(const QString &topic) const;
+    // True if any of the filters stored with the given key matches the topic
+    bool matches(const QString &topic, const QString &key) const;
+    // The keys of all stored filters matching the topic
+    QSet<QString> match(const QString &topic) const;
+
+private:
+    class Node {
+    public:
+        QHash<QString, Node> children;
+        QSet<QString> keys;
+    };
+
+    Node m_root;
+
+    static bool removeKey(Node *node, const QVector<QStringRef> &levels, int index, const QString &key);
+    static bool walk(const Node &node, const QVector<QStringRef> &levels, int index, QSet<QString> *keys, const QString *key = nullptr);
+    static bool hasKey(const Node &node, const QString *key);
+};
+
+}
+
+#endif // MQTTTOPICTRIE_H
@@ -0,0 +1,214 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "staticfilecache.h"
+#include "loggingcategories.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QCryptographicHash>
+
+namespace nymeaserver {
+
+static const QHash<QString, QByteArray> mimeTypes = {
+    {"html", "text/html; charset=\"utf-8\";"},
+    {"htm", "text/html; charset=\"utf-8\";"},
+    {"css", "text/css; charset=\"utf-8\";"},
+    {"js", "text/javascript; charset=\"utf-8\";"},
+    {"mjs", "text/javascript; charset=\"utf-8\";"},
+    {"json", "application/json; charset=\"utf-8\";"},
+    {"map", "application/json; charset=\"utf-8\";"},
+    {"txt", "text/plain; charset=\"utf-8\";"},
+    {"xml", "text/xml; charset=\"utf-8\";"},
+    {"pdf", "application/pdf"},
+    {"wasm", "application/wasm"},
+    {"ttf", "application/x-font-ttf"},
+    {"eot", "application/vnd.ms-fontobject"},
+    {"woff", "application/x-font-woff"},
+    {"woff2", "font/woff2"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"png", "image/png"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"ico", "image/x-icon"},
+    {"svg", "image/svg+xml; charset=\"utf-8\";"}
+};
+
+bool StaticFileCache::Entry::isValid() const
+{
+    return size >= 0;
+}
+
+bool StaticFileCache::Entry::isLoaded() const
+{
+    return isValid() && data.size() == size;
+}
+
+StaticFileCache::StaticFileCache(int maxCost, qint64 maxFileSize):
+    m_maxFileSize(maxFileSize)
+{
+    m_entries.setMaxCost(maxCost);
+}
+
+StaticFileCache::Entry StaticFileCache::file(const QString &fileName, const QByteArray &acceptEncoding)
+{
+    // Prefer precompressed siblings, brotli being the smaller one
+    QString variantName = fileName;
+    QByteArray contentEncoding;
+    QList<QPair<QByteArray, QString>> variants = {{"br", ".br"}, {"gzip", ".gz"}};
+    for (int i = 0; i < variants.count(); i++) {
+        if (acceptsEncoding(acceptEncoding, variants.at(i).first) && QFileInfo(fileName + variants.at(i).second).isReadable()) {
+            variantName = fileName + variants.at(i).second;
+            contentEncoding = variants.at(i).first;
+            break;
+        }
+    }
+
+    QFileInfo fileInfo(variantName);
+    if (!fileInfo.isFile() || !fileInfo.isReadable()) {
+        return Entry();
+    }
+
+    Entry *cached = m_entries.object(variantName);
+    if (cached && cached->lastModified == fileInfo.lastModified() && cached->size == fileInfo.size()) {
+        return *cached;
+    }
+
+    Entry entry;
+    entry.filePath = variantName;
+    entry.contentType = contentType(fileName);
+    entry.contentEncoding = contentEncoding;
+    entry.lastModified = fileInfo.lastModified();
+
+    // Hashing or holding big files would cost as much as the file size, derive the
+    // ETag from the file state instead and let the web server stream the content.
+    if (fileInfo.size() > m_maxFileSize) {
+        entry.size = fileInfo.size();
+        entry.etag = '"' + QByteArray::number(entry.size, 16) + '-' + QByteArray::number(entry.lastModified.toMSecsSinceEpoch(), 16) + '"';
+        m_entries.remove(variantName);
+        return entry;
+    }
+
+    if (!readEntry(variantName, &entry)) {
+        m_entries.remove(variantName);
+        return Entry();
+    }
+
+    if (entry.size <= m_maxFileSize) {
+        qCDebug(dcWebServer()) << "Caching file" << variantName << entry.size << "bytes";
+        // Fails and deletes the copy if it is larger than the whole cache
+        m_entries.insert(variantName, new Entry(entry), static_cast<int>(entry.size));
+    } else {
+        m_entries.remove(variantName);
+    }
+    return entry;
+}
+
+bool StaticFileCache::etagMatches(const QByteArray &ifNoneMatch, const QByteArray &etag)
+{
+    foreach (const QByteArray &candidate, ifNoneMatch.split(',')) {
+        QByteArray tag = candidate.trimmed();
+        if (tag == "*") {
+            return true;
+        }
+        // If-None-Match uses the weak comparison
+        if (tag.startsWith("W/")) {
+            tag = tag.mid(2);
+        }
+        if (tag == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool StaticFileCache::acceptsEncoding(const QByteArray &acceptEncoding, const QByteArray &coding)
+{
+    // A coding listed by name wins over the wildcard, q=0 means "not acceptable" (RFC 7231 5.3.4)
+    int qualityForCoding = -1;
+    int qualityForAny = -1;
+    foreach (const QByteArray &element, acceptEncoding.split(',')) {
+        QList<QByteArray> parameters = element.split(';');
+        QByteArray name = parameters.takeFirst().trimmed();
+        if (name.isEmpty()) {
+            continue;
+        }
+        int quality = 1000;
+        foreach (const QByteArray &parameter, parameters) {
+            QByteArray trimmed = parameter.trimmed();
+            if (trimmed.startsWith("q=") || trimmed.startsWith("Q=")) {
+                bool ok = false;
+                double value = trimmed.mid(2).trimmed().toDouble(&ok);
+                quality = ok ? qRound(qBound(0.0, value, 1.0) * 1000) : 0;
+            }
+        }
+        if (qstricmp(name.constData(), coding.constData()) == 0) {
+            qualityForCoding = quality;
+        } else if (name == "*") {
+            qualityForAny = quality;
+        }
+    }
+    if (qualityForCoding >= 0) {
+        return qualityForCoding > 0;
+    }
+    return qualityForAny > 0;
+}
+
+QByteArray StaticFileCache::contentType(const QString &fileName)
+{
+    return mimeTypes.value(QFileInfo(fileName).suffix().toLower());
+}
+
+int StaticFileCache::totalCost() const
+{
+    return m_entries.totalCost();
+}
+
+int StaticFileCache::count() const
+{
+    return m_entries.count();
+}
+
+bool StaticFileCache::readEntry(const QString &fileName, Entry *entry) const
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        qCWarning(dcWebServer()) << "Could not open file" << fileName << file.errorString();
+        return false;
+    }
+    entry->data = file.readAll();
+    entry->size = entry->data.size();
+    entry->etag = '"' + QCryptographicHash::hash(entry->data, QCryptographicHash::Sha1).toHex().left(32) + '"';
+    return true;
+}
+
+}
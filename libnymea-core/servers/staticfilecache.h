@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STATICFILECACHE_H
+#define STATICFILECACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#include <QCache>
+
+namespace nymeaserver {
+
+// In-memory LRU cache for the files served from the public folder of the web server.
+// Entries are validated against the modification time and size of the file on every
+// lookup, so changes on disk are picked up right away. If the client accepts it, a
+// precompressed sibling (file.br or file.gz) is served instead of the file itself.
+// Files larger than maxFileSize are not loaded at all and have to be streamed from
+// filePath instead.
+class StaticFileCache
+{
+public:
+    class Entry {
+    public:
+        QByteArray data;
+        QString filePath;
+        QByteArray etag;
+        QByteArray contentType;
+        QByteArray contentEncoding;
+        QDateTime lastModified;
+        qint64 size = -1;
+
+        bool isValid() const;
+        bool isLoaded() const;
+    };
+
+    explicit StaticFileCache(int maxCost = 16 * 1024 * 1024, qint64 maxFileSize = 2 * 1024 * 1024);
+
+    // Returns the entry for fileName, or an invalid entry if the file can't be read.
+    // acceptEncoding is the value of the Accept-Encoding request header.
+    Entry file(const QString &fileName, const QByteArray &acceptEncoding = QByteArray());
+
+    // True if the If-None-Match header value matches the given etag
+    static bool etagMatches(const QByteArray &ifNoneMatch, const QByteArray &etag);
+    // True if the Accept-Encoding header value allows the given content coding
+    static bool acceptsEncoding(const QByteArray &acceptEncoding, const QByteArray &coding);
+    // The content type for the file name suffix, empty if unknown
+    static QByteArray contentType(const QString &fileName);
+
+    int totalCost() const;
+    int count() const;
+
+private:
+    bool readEntry(const QString &fileName, Entry *entry) const;
+
+    qint64 m_maxFileSize;
+    QCache<QString, Entry> m_entries;
+};
+
+}
+
+#endif // STATICFILECACHE_H
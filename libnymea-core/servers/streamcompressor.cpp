@@ -0,0 +1,134 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "streamcompressor.h"
+#include "loggingcategories.h"
+
+namespace nymeaserver {
+
+StreamCompressor::StreamCompressor(int threshold, int level):
+    m_threshold(threshold),
+    m_level(level),
+    m_currentLevel(level)
+{
+    m_stream.zalloc = Z_NULL;
+    m_stream.zfree = Z_NULL;
+    m_stream.opaque = Z_NULL;
+    int ret = deflateInit(&m_stream, level);
+    if (ret != Z_OK) {
+        qCWarning(dcServerManager()) << "Failed to initialize deflate stream:" << ret;
+        return;
+    }
+    m_valid = true;
+    m_buffer.resize(16 * 1024);
+}
+
+StreamCompressor::~StreamCompressor()
+{
+    if (m_valid) {
+        deflateEnd(&m_stream);
+    }
+}
+
+bool StreamCompressor::isValid() const
+{
+    return m_valid;
+}
+
+int StreamCompressor::threshold() const
+{
+    return m_threshold;
+}
+
+QByteArray StreamCompressor::compress(const QByteArray &data)
+{
+    if (!m_valid) {
+        return QByteArray();
+    }
+
+    // Switching the level is cheap here, the previous message has been flushed completely
+    QByteArray result;
+    if (!setLevel(data.size() < m_threshold ? Z_NO_COMPRESSION : m_level, &result)) {
+        return QByteArray();
+    }
+
+    m_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    m_stream.avail_in = static_cast<uInt>(data.size());
+    do {
+        m_stream.next_out = reinterpret_cast<Bytef *>(m_buffer.data());
+        m_stream.avail_out = static_cast<uInt>(m_buffer.size());
+        int ret = deflate(&m_stream, Z_SYNC_FLUSH);
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            qCWarning(dcServerManager()) << "Failed to compress data:" << ret;
+            deflateEnd(&m_stream);
+            m_valid = false;
+            return QByteArray();
+        }
+        result.append(m_buffer.constData(), m_buffer.size() - static_cast<int>(m_stream.avail_out));
+    } while (m_stream.avail_out == 0);
+
+    m_bytesIn += static_cast<quint64>(data.size());
+    m_bytesOut += static_cast<quint64>(result.size());
+    return result;
+}
+
+quint64 StreamCompressor::bytesIn() const
+{
+    return m_bytesIn;
+}
+
+quint64 StreamCompressor::bytesOut() const
+{
+    return m_bytesOut;
+}
+
+bool StreamCompressor::setLevel(int level, QByteArray *output)
+{
+    if (level == m_currentLevel) {
+        return true;
+    }
+    // No input is pending, deflateParams() is not expected to produce output. Keep it anyways.
+    m_stream.next_in = Z_NULL;
+    m_stream.avail_in = 0;
+    m_stream.next_out = reinterpret_cast<Bytef *>(m_buffer.data());
+    m_stream.avail_out = static_cast<uInt>(m_buffer.size());
+    int ret = deflateParams(&m_stream, level, Z_DEFAULT_STRATEGY);
+    if (ret != Z_OK) {
+        qCWarning(dcServerManager()) << "Failed to change compression level:" << ret;
+        deflateEnd(&m_stream);
+        m_valid = false;
+        return false;
+    }
+    output->append(m_buffer.constData(), m_buffer.size() - static_cast<int>(m_stream.avail_out));
+    m_currentLevel = level;
+    return true;
+}
+
+}
@@ -0,0 +1,77 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STREAMCOMPRESSOR_H
+#define STREAMCOMPRESSOR_H
+
+#include <QByteArray>
+
+#include <zlib.h>
+
+namespace nymeaserver {
+
+// Compresses outgoing messages of one connection into a single zlib stream. Each call to
+// compress() returns a sync flushed segment of that stream, so the receiver can inflate every
+// message as soon as it arrives. The deflate context and the output buffer are kept for the
+// lifetime of the connection, later messages benefit from the dictionary built by earlier ones.
+// Messages smaller than the threshold are stored without compression to save CPU time.
+class StreamCompressor
+{
+public:
+    explicit StreamCompressor(int threshold = 256, int level = Z_DEFAULT_COMPRESSION);
+    ~StreamCompressor();
+
+    bool isValid() const;
+    int threshold() const;
+
+    QByteArray compress(const QByteArray &data);
+
+    // Total number of bytes passed in and written out, for statistics
+    quint64 bytesIn() const;
+    quint64 bytesOut() const;
+
+private:
+    Q_DISABLE_COPY(StreamCompressor)
+
+    bool setLevel(int level, QByteArray *output);
+
+    z_stream m_stream;
+    bool m_valid = false;
+    int m_threshold;
+    int m_level;
+    int m_currentLevel;
+    QByteArray m_buffer;
+    quint64 m_bytesIn = 0;
+    quint64 m_bytesOut = 0;
+};
+
+}
+
+#endif // STREAMCOMPRESSOR_H
@@ -128,25 +128,97 @@ void TcpServer::sendData(const QUuid &clientId, const QByteArray &data)
     client = m_clientList.value(clientId);
     if (client) {
         qCDebug(dcTcpServerTraffic()) << "Sending to client" << clientId.toString() << data;
-        client->write(data + '\n');
+        StreamCompressor *compressor = m_compressors.value(clientId);
+        if (compressor) {
+            QByteArray compressed = compressor->compress(data + '\n');
+            if (compressed.isEmpty()) {
+                // The client can't decode anything sent after a gap in the stream
+                qCWarning(dcTcpServer()) << "Failed to compress data for client" << clientId.toString() << "Closing the connection.";
+                terminateClientConnection(clientId);
+                return;
+            }
+            client->write(compressed);
+        } else {
+            client->write(data + '\n');
+        }
     } else {
         qCWarning(dcTcpServer()) << "Client" << clientId.toString() << "unknown to this transport";
     }
 }
 
+/*! Returns true, the TCP stream can carry binary data. */
+bool TcpServer::supportsBinaryData() const
+{
+    return true;
+}
+
+/*! Sending binary \a data to the client with the given \a clientId. No delimiter is appended.*/
+void TcpServer::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    QTcpSocket *client = m_clientList.value(clientId);
+    if (client) {
+        qCDebug(dcTcpServerTraffic()) << "Sending binary data to client" << clientId.toString() << data.toHex();
+        StreamCompressor *compressor = m_compressors.value(clientId);
+        if (!compressor) {
+            client->write(data);
+            return;
+        }
+        QByteArray compressed = compressor->compress(data);
+        if (compressed.isEmpty()) {
+            qCWarning(dcTcpServer()) << "Failed to compress data for client" << clientId.toString() << "Closing the connection.";
+            terminateClientConnection(clientId);
+            return;
+        }
+        client->write(compressed);
+    } else {
+        qCWarning(dcTcpServer()) << "Client" << clientId.toString() << "unknown to this transport";
+    }
+}
+
+/*! Returns true, outgoing data can be sent as zlib stream. */
+bool TcpServer::supportsCompression() const
+{
+    return true;
+}
+
+/*! Enables or disables the zlib stream mode for the client with the given \a clientId. */
+void TcpServer::setCompressionEnabled(const QUuid &clientId, bool enabled)
+{
+    if (!m_clientList.contains(clientId)) {
+        return;
+    }
+    if (!enabled) {
+        delete m_compressors.take(clientId);
+        return;
+    }
+    if (!m_compressors.contains(clientId)) {
+        m_compressors.insert(clientId, new StreamCompressor());
+    }
+}
+
+/*! Returns the number of bytes waiting in the socket buffer of the client with the given \a clientId. */
+qint64 TcpServer::bytesToWrite(const QUuid &clientId) const
+{
+    QTcpSocket *client = m_clientList.value(clientId);
+    return client ? client->bytesToWrite() : 0;
+}
+
 void TcpServer::onClientConnected(QSslSocket *socket)
 {
     QUuid clientId = QUuid::createUuid();
     qCDebug(dcTcpServer()) << "New client connected:" << clientId.toString() << "(Remote address:" << socket->peerAddress().toString() << ")";
     m_clientList.insert(clientId, socket);
+    m_clientIds.insert(socket, clientId);
+    connect(socket, &QSslSocket::bytesWritten, this, [this, clientId](){ emit bytesWritten(clientId); });
     emit clientConnected(clientId);
 }
 
 void TcpServer::onClientDisconnected(QSslSocket *socket)
 {
-    QUuid clientId = m_clientList.key(socket);
+    QUuid clientId = m_clientIds.take(socket);
     qCDebug(dcTcpServer()) << "Client disconnected:" << clientId.toString() << "(Remote address:" << socket->peerAddress().toString() << ")";
     m_clientList.take(clientId);
+    delete m_compressors.take(clientId);
     emit clientDisconnected(clientId);
 }
 
@@ -160,7 +232,7 @@ void TcpServer::onError(QAbstractSocket::SocketError error)
 void TcpServer::onDataAvailable(QSslSocket * socket, const QByteArray &data)
 {
     qCDebug(dcTcpServerTraffic()) << "Emitting data available";
-    QUuid clientId = m_clientList.key(socket);
+    QUuid clientId = m_clientIds.value(socket);
     emit dataAvailable(clientId, data);
 }
 
@@ -215,35 +287,52 @@ bool TcpServer::stopServer()
 /*! This method will be called if a new \a socketDescriptor is about to connect to this SslSocket. */
 void SslServer::incomingConnection(qintptr socketDescriptor)
 {
-    QSslSocket *sslSocket = new QSslSocket(this);
+    QSslSocket *sslSocket = new QSslSocket();
 
     qCDebug(dcTcpServer()) << "New client socket connection:" << sslSocket;
 
-    connect(sslSocket, &QSslSocket::encrypted, this, [this, sslSocket](){ emit clientConnected(sslSocket); });
-    connect(sslSocket, &QSslSocket::readyRead, this, &SslServer::onSocketReadyRead);
-    connect(sslSocket, &QSslSocket::disconnected, this, &SslServer::onClientDisconnected);
-    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
-    connect(sslSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, [](const QList<QSslError> &errors) {
-        qCWarning(dcTcpServer()) << "SSL Errors happened in the client connections:";
-        foreach (const QSslError &error, errors) {
-            qCWarning(dcTcpServer()) << "SSL Error:" << error.error() << error.errorString();
-        }
-    });
-
     if (!sslSocket->setSocketDescriptor(socketDescriptor)) {
         qCWarning(dcTcpServer()) << "Failed to set SSL socket descriptor.";
         delete sslSocket;
         return;
     }
     if (m_sslEnabled) {
+        // The handshake runs on the handshake thread, the socket comes back with onEncrypted()
         qCDebug(dcTcpServer()) << "Starting SSL encryption";
-        sslSocket->setSslConfiguration(m_config);
-        sslSocket->startServerEncryption();
+        m_handshaker->startServerEncryption(sslSocket, m_config);
     } else {
+        setupSocket(sslSocket);
         emit clientConnected(sslSocket);
     }
 }
 
+void SslServer::onEncrypted(QSslSocket *socket)
+{
+    setupSocket(socket);
+    emit clientConnected(socket);
+}
+
+void SslServer::onHandshakeFailed(QSslSocket *socket)
+{
+    qCDebug(dcTcpServer()) << "Client socket failed to establish encryption:" << socket;
+    socket->abort();
+    socket->deleteLater();
+}
+
+void SslServer::setupSocket(QSslSocket *socket)
+{
+    socket->setParent(this);
+    connect(socket, &QSslSocket::readyRead, this, &SslServer::onSocketReadyRead);
+    connect(socket, &QSslSocket::disconnected, this, &SslServer::onClientDisconnected);
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    connect(socket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, [](const QList<QSslError> &errors) {
+        qCWarning(dcTcpServer()) << "SSL Errors happened in the client connections:";
+        foreach (const QSslError &error, errors) {
+            qCWarning(dcTcpServer()) << "SSL Error:" << error.error() << error.errorString();
+        }
+    });
+}
+
 void SslServer::onClientDisconnected()
 {
     QSslSocket *socket = static_cast<QSslSocket*>(sender());
@@ -41,6 +41,8 @@
 #include <QDebug>
 
 #include "transportinterface.h"
+#include "streamcompressor.h"
+#include "tlshandshaker.h"
 
 #include "loggingcategories.h"
 
@@ -53,9 +55,11 @@ public:
     SslServer(bool sslEnabled, const QSslConfiguration &config, QObject *parent = nullptr):
         QTcpServer(parent),
         m_sslEnabled(sslEnabled),
-        m_config(config)
+        m_config(config),
+        m_handshaker(new TlsHandshaker(this))
     {
-
+        connect(m_handshaker, &TlsHandshaker::encrypted, this, &SslServer::onEncrypted);
+        connect(m_handshaker, &TlsHandshaker::failed, this, &SslServer::onHandshakeFailed);
     }
 
 signals:
@@ -69,10 +73,15 @@ protected:
 private slots:
     void onClientDisconnected();
     void onSocketReadyRead();
+    void onEncrypted(QSslSocket *socket);
+    void onHandshakeFailed(QSslSocket *socket);
 
 private:
     bool m_sslEnabled = false;
     QSslConfiguration m_config;
+    TlsHandshaker *m_handshaker = nullptr;
+
+    void setupSocket(QSslSocket *socket);
 };
 
 class TcpServer : public TransportInterface
@@ -86,6 +95,11 @@ public:
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
+    bool supportsBinaryData() const override;
+    void sendBinaryData(const QUuid &clientId, const QByteArray &data) override;
+    bool supportsCompression() const override;
+    void setCompressionEnabled(const QUuid &clientId, bool enabled) override;
+    qint64 bytesToWrite(const QUuid &clientId) const override;
 
     void terminateClientConnection(const QUuid &clientId) override;
 
@@ -94,6 +108,8 @@ private:
 
     SslServer *m_server = nullptr;
     QHash<QUuid, QTcpSocket *> m_clientList;
+    QHash<QTcpSocket *, QUuid> m_clientIds;
+    QHash<QUuid, StreamCompressor *> m_compressors;
 
     QSslConfiguration m_sslConfig;
 
@@ -0,0 +1,149 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "tlshandshaker.h"
+#include "loggingcategories.h"
+
+#include <QTimer>
+#include <QSharedPointer>
+
+namespace nymeaserver {
+
+// Clients which don't finish the handshake in time are dropped
+static const int handshakeTimeout = 10000;
+
+// Queues function to the event loop of the thread context lives in
+template <typename Function>
+static void invokeQueued(QObject *context, Function function)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,10,0)
+    QMetaObject::invokeMethod(context, function, Qt::QueuedConnection);
+#else
+    // invokeMethod() takes functors only since Qt 5.10. A zero timer with a context
+    // object is delivered through the event loop of that object's thread as well.
+    QTimer::singleShot(0, context, function);
+#endif
+}
+
+TlsHandshaker::TlsHandshaker(QObject *parent) :
+    QObject(parent)
+{
+    m_thread = new QThread(this);
+    m_thread->setObjectName("TLS handshakes");
+    m_worker = new QObject();
+    m_worker->moveToThread(m_thread);
+    connect(m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread->start();
+}
+
+TlsHandshaker::~TlsHandshaker()
+{
+    m_thread->quit();
+    m_thread->wait();
+
+    // The worker thread is gone, nobody else can touch these anymore
+    qDeleteAll(m_pendingSockets);
+}
+
+void TlsHandshaker::startServerEncryption(QSslSocket *socket, const QSslConfiguration &configuration)
+{
+    Q_ASSERT_X(!socket->parent(), "TlsHandshaker", "Sockets with a parent can't be moved to the handshake thread");
+
+    QThread *callerThread = socket->thread();
+    m_pendingSockets.insert(socket);
+    socket->moveToThread(m_thread);
+
+    invokeQueued(m_worker, [this, socket, configuration, callerThread]() {
+        QTimer *timer = new QTimer(socket);
+        timer->setSingleShot(true);
+
+        QSharedPointer<bool> finished(new bool(false));
+        auto finish = [this, socket, timer, callerThread, finished](bool success) {
+            if (*finished)
+                return;
+
+            *finished = true;
+            QObject::disconnect(socket, nullptr, m_worker, nullptr);
+            timer->deleteLater();
+
+            // Let the socket return from emitting its signal before it changes the thread
+            invokeQueued(m_worker, [this, socket, success, callerThread]() {
+                socket->moveToThread(callerThread);
+                invokeQueued(this, [this, socket, success]() {
+                    onHandshakeFinished(socket, success);
+                });
+            });
+        };
+
+        connect(socket, &QSslSocket::encrypted, m_worker, [finish]() { finish(true); });
+        connect(socket, &QSslSocket::disconnected, m_worker, [finish]() { finish(false); });
+        connect(socket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error), m_worker, [socket, finish](QAbstractSocket::SocketError error) {
+            qCDebug(dcServerManager()) << "TLS handshake with" << socket->peerAddress().toString() << "failed:" << error << socket->errorString();
+            finish(false);
+        });
+        connect(timer, &QTimer::timeout, m_worker, [socket, finish]() {
+            qCWarning(dcServerManager()) << "TLS handshake with" << socket->peerAddress().toString() << "timed out";
+            finish(false);
+        });
+
+        socket->setSslConfiguration(configuration);
+        socket->startServerEncryption();
+        timer->start(handshakeTimeout);
+    });
+}
+
+bool TlsHandshaker::isHandshaking(QSslSocket *socket) const
+{
+    return m_pendingSockets.contains(socket);
+}
+
+int TlsHandshaker::pendingHandshakes() const
+{
+    return m_pendingSockets.count();
+}
+
+void TlsHandshaker::onHandshakeFinished(QSslSocket *socket, bool success)
+{
+    m_pendingSockets.remove(socket);
+
+    if (!success) {
+        emit failed(socket);
+        return;
+    }
+
+    emit encrypted(socket);
+
+    // Data which arrived right after the handshake was buffered without anybody listening
+    if (socket->bytesAvailable() > 0) {
+        QMetaObject::invokeMethod(socket, "readyRead", Qt::QueuedConnection);
+    }
+}
+
+}
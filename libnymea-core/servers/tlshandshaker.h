@@ -0,0 +1,74 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TLSHANDSHAKER_H
+#define TLSHANDSHAKER_H
+
+#include <QObject>
+#include <QSet>
+#include <QThread>
+#include <QSslSocket>
+#include <QSslConfiguration>
+
+namespace nymeaserver {
+
+// Runs the TLS server handshakes of incoming connections on a worker thread, so a burst
+// of reconnecting clients does not block the event loop with public key operations.
+// The socket is moved to the worker for the handshake and handed back to the thread it
+// came from afterwards, together with any data the client sent right after the handshake.
+class TlsHandshaker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TlsHandshaker(QObject *parent = nullptr);
+    ~TlsHandshaker() override;
+
+    // The socket must be connected and must not have a parent. Until encrypted() or
+    // failed() is emitted for it, it must not be used by the caller.
+    void startServerEncryption(QSslSocket *socket, const QSslConfiguration &configuration);
+
+    bool isHandshaking(QSslSocket *socket) const;
+    int pendingHandshakes() const;
+
+signals:
+    void encrypted(QSslSocket *socket);
+    void failed(QSslSocket *socket);
+
+private:
+    QThread *m_thread = nullptr;
+    QObject *m_worker = nullptr;
+    QSet<QSslSocket *> m_pendingSockets;
+
+    void onHandshakeFinished(QSslSocket *socket, bool success);
+};
+
+}
+
+#endif // TLSHANDSHAKER_H
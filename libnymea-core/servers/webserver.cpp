@@ -56,6 +56,11 @@
 
     You can turn on the HTTPS server in the \tt WebServer section of the \tt /etc/nymea/nymead.conf file.
 
+    Connections are persistent: a client can send any number of requests over one connection, also
+    pipelined without waiting for the replies, which are sent in the order of the requests. A connection
+    will be closed if the client sends "Connection: close", after 1000 requests or if it stays idle for
+    65 seconds. The server accepts up to 200 connections, 50 of them from the same address.
+
     \note For \tt HTTPS you need to have a certificate and configure it in the \tt SSL-configuration
     section of the \tt /etc/nymea/nymead.conf file.
 
@@ -103,6 +108,16 @@
 
 namespace nymeaserver {
 
+static const int maxConnections = 200;
+static const int maxConnectionsPerClient = 50;
+static const int maxRequestsPerConnection = 1000;
+// Close idle connections after 65 seconds, but advertise less so clients stop reusing them first
+static const int defaultConnectionIdleTimeout = 65000;
+static const int keepAliveTimeout = 60;
+// Files are streamed in chunks, refilled whenever the socket buffer drops below the watermark
+static const int fileStreamChunkSize = 64 * 1024;
+static const qint64 fileStreamHighWatermark = 256 * 1024;
+
 /*! Constructs a \l{WebServer} with the given \a configuration, \a sslConfiguration and \a parent.
  *
  *  \sa ServerManager, WebServerConfiguration
@@ -110,11 +125,16 @@ namespace nymeaserver {
 WebServer::WebServer(const WebServerConfiguration &configuration, const QSslConfiguration &sslConfiguration, QObject *parent) :
     QTcpServer(parent),
     m_configuration(configuration),
-    m_sslConfiguration(sslConfiguration)
+    m_sslConfiguration(sslConfiguration),
+    m_connectionIdleTimeout(defaultConnectionIdleTimeout)
 {
     if (QCoreApplication::instance()->organizationName() == "nymea-test") {
         m_configuration.publicFolder = QCoreApplication::applicationDirPath();
     }
+
+    m_handshaker = new TlsHandshaker(this);
+    connect(m_handshaker, &TlsHandshaker::encrypted, this, &WebServer::onEncrypted);
+    connect(m_handshaker, &TlsHandshaker::failed, this, &WebServer::onHandshakeFailed);
     qCDebug(dcWebServer()) << "Starting WebServer. Interface:" << m_configuration.address << "Port:" << m_configuration.port << "SSL:" << m_configuration.sslEnabled << "AUTH:" << m_configuration.authenticationEnabled << "Public folder:" << QDir(m_configuration.publicFolder).canonicalPath();
 }
 
@@ -132,6 +152,20 @@ QUrl WebServer::serverUrl() const
     return QUrl(QString("%1://%2:%3").arg((m_configuration.sslEnabled ? "https" : "http")).arg(m_configuration.address).arg(m_configuration.port));
 }
 
+/*! Returns the time in milliseconds after which a connection without any traffic is closed. */
+int WebServer::connectionIdleTimeout() const
+{
+    return m_connectionIdleTimeout;
+}
+
+/*! Sets the time in milliseconds after which a connection without any traffic is closed to \a msecs.
+ *  Only affects connections established afterwards.
+ */
+void WebServer::setConnectionIdleTimeout(int msecs)
+{
+    m_connectionIdleTimeout = msecs;
+}
+
 /*! Send the given \a reply map to the corresponding client.
  *
  * \sa HttpReply
@@ -146,11 +180,50 @@ void WebServer::sendHttpReply(HttpReply *reply)
         return;
     }
 
+    // Open the payload file before the header goes out, so the reply can still become an error
+    QFile *payloadFile = nullptr;
+    if (reply->hasPayloadFile()) {
+        payloadFile = new QFile(reply->payloadFileName());
+        if (!payloadFile->open(QFile::ReadOnly) || !payloadFile->seek(reply->payloadFileOffset())) {
+            qCWarning(dcWebServer()) << "Could not open payload file" << reply->payloadFileName() << payloadFile->errorString();
+            delete payloadFile;
+            payloadFile = nullptr;
+            reply->setHttpStatusCode(HttpReply::InternalServerError);
+            reply->setHeader(HttpReply::ContentTypeHeader, "text/plain; charset=\"utf-8\";");
+            reply->setPayload(QByteArray::number(reply->httpStatusCode()) + " " + reply->httpReasonPhrase());
+        }
+    }
+
+    // Keep the connection open for further requests unless the client or the reply asked to close it
+    bool closeConnection = reply->closeConnection() || m_closingConnections.contains(socket);
+    if (closeConnection) {
+        m_closingConnections.insert(socket);
+        reply->setCloseConnection(true);
+    } else {
+        int remainingRequests = maxRequestsPerConnection - m_requestCounts.value(socket);
+        reply->setRawHeader("Keep-Alive", QString("timeout=%1, max=%2").arg(keepAliveTimeout).arg(remainingRequests).toUtf8());
+    }
+
     // send raw data
     reply->packReply();
     qCDebug(dcWebServerTraffic()) << "Send reply to" << socket->peerAddress().toString() << reply;
     qCDebug(dcWebServer()) << "Respond" << socket->peerAddress().toString() << reply->httpStatusCode() << reply->httpReasonPhrase();
     socket->write(reply->data());
+
+    // The payload follows in chunks while the socket drains, see onBytesWritten()
+    if (payloadFile) {
+        FileStream stream;
+        stream.file = payloadFile;
+        stream.remaining = reply->payloadFileLength();
+        m_fileStreams.insert(socket, stream);
+        if (!streamFile(socket))
+            return;
+    }
+
+    if (closeConnection) {
+        qCDebug(dcWebServer()).noquote() << QString("Closing connection %1:%2 after reply").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+        socket->disconnectFromHost();
+    }
 }
 
 bool WebServer::verifyFile(QSslSocket *socket, const QString &fileName)
@@ -161,7 +234,7 @@ bool WebServer::verifyFile(QSslSocket *socket, const QString &fileName)
     if (!file.exists()) {
         qCDebug(dcWebServer()) << "requested file" << file.filePath() << "does not exist.";
         HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
-        reply->setClientId(m_clientList.key(socket));
+        reply->setClientId(m_clientIds.value(socket));
         sendHttpReply(reply);
         reply->deleteLater();
         return false;
@@ -171,7 +244,7 @@ bool WebServer::verifyFile(QSslSocket *socket, const QString &fileName)
     if (!file.canonicalFilePath().startsWith(QDir(m_configuration.publicFolder).canonicalPath())) {
         qCDebug(dcWebServer()) << "Requested file" << file.canonicalFilePath() << "is outside the public folder.";
         HttpReply *reply = HttpReply::createErrorReply(HttpReply::Forbidden);
-        reply->setClientId(m_clientList.key(socket));
+        reply->setClientId(m_clientIds.value(socket));
         sendHttpReply(reply);
         reply->deleteLater();
         return false;
@@ -181,7 +254,7 @@ bool WebServer::verifyFile(QSslSocket *socket, const QString &fileName)
     if (!file.isReadable()) {
         qCDebug(dcWebServer()) << "Requested file" << file.fileName() << "is not readable.";
         HttpReply *reply = HttpReply::createErrorReply(HttpReply::Forbidden);
-        reply->setClientId(m_clientList.key(socket));
+        reply->setClientId(m_clientIds.value(socket));
         reply->setPayload("403 Forbidden. File not readable");
         sendHttpReply(reply);
         reply->deleteLater();
@@ -202,6 +275,16 @@ QString WebServer::fileName(const QString &query)
     return m_configuration.publicFolder + "/" + fileName;
 }
 
+QByteArray WebServer::cacheControl(const QString &fileName) const
+{
+    // Pages must always be revalidated so updated assets are picked up. Assets may be used
+    // for a while without asking, after that the ETag makes revalidating them cheap.
+    if (fileName.endsWith(".html")) {
+        return "no-cache";
+    }
+    return "public, max-age=3600";
+}
+
 HttpReply *WebServer::processIconRequest(const QString &fileName)
 {
     if (!fileName.endsWith(".png"))
@@ -237,11 +320,18 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
         return;
     }
 
+    if (m_clientList.count() >= maxConnections) {
+        qCWarning(dcWebServer()).noquote() << QString("Maximum connections reached: rejecting connection from client %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+        socket->close();
+        delete socket;
+        return;
+    }
+
     // check webserver client
     bool existing = false;
     foreach (WebServerClient *client, m_webServerClients) {
         if (client->address() == socket->peerAddress()) {
-            if (client->connections().count() >= 50) {
+            if (client->connections().count() >= maxConnectionsPerClient) {
                 qCWarning(dcWebServer()).noquote() << QString("Maximum connections for this client reached: rejecting connection from client %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
                 socket->close();
                 delete socket;
@@ -254,7 +344,7 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
     }
 
     if (!existing) {
-        WebServerClient *webServerClient = new WebServerClient(socket->peerAddress());
+        WebServerClient *webServerClient = new WebServerClient(socket->peerAddress(), m_connectionIdleTimeout);
         webServerClient->addConnection(socket);
         m_webServerClients.append(webServerClient);
     }
@@ -262,19 +352,19 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
     // append the new client to the client list
     QUuid clientId = QUuid::createUuid();
     m_clientList.insert(clientId, socket);
+    m_clientIds.insert(socket, clientId);
 
     qCDebug(dcWebServer()).noquote() << QString("Webserver client %1:%2 connected").arg(socket->peerAddress().toString()).arg(socket->peerPort());
 
     if (m_configuration.sslEnabled) {
-        // configure client connection
-        socket->setSslConfiguration(m_sslConfiguration);
-        connect(socket, SIGNAL(encrypted()), this, SLOT(onEncrypted()));
-        socket->startServerEncryption();
-        // wait for encrypted connection before continue with this client
+        // The handshake runs on the handshake thread, wait for the encrypted connection before continue with this client
+        m_handshaker->startServerEncryption(socket, m_sslConfiguration);
         return;
     }
 
     connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
+    connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
+    connect(socket, SIGNAL(encryptedBytesWritten(qint64)), this, SLOT(onBytesWritten()));
     connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
     connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onError(QAbstractSocket::SocketError)));
 
@@ -287,7 +377,7 @@ void WebServer::readClient()
         return;
 
     QSslSocket *socket = qobject_cast<QSslSocket *>(sender());
-    QUuid clientId = m_clientList.key(socket);
+    QUuid clientId = m_clientIds.value(socket);
 
     // Check client
     if (clientId.isNull()) {
@@ -296,22 +386,53 @@ void WebServer::readClient()
         return;
     }
 
-    // Read HTTP request
-    QByteArray data = socket->readAll();
+    // Ignore anything the client sends after we decided to close the connection
+    if (m_closingConnections.contains(socket)) {
+        socket->readAll();
+        return;
+    }
+
+    // Read HTTP request data. A request may arrive in several packages,
+    // and a client pipelining its requests can send several at once.
+    m_incompleteRequests[socket].appendData(socket->readAll());
+    processRequests(socket);
 
-    HttpRequest request;
-    if (m_incompleteRequests.contains(socket)) {
-        request = m_incompleteRequests.take(socket);
-        request.appendData(data);
-    } else {
-        request = HttpRequest(data);
+    // Requests pipelined behind an async or streamed reply wait unparsed, don't let them pile up
+    if (m_incompleteRequests.value(socket).exceedsPipelineLimit()) {
+        qCWarning(dcWebServer()).noquote() << QString("Client %1:%2 pipelined too much data while a reply is pending. Closing the connection.").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+        socket->abort();
     }
+}
 
-    // Check if the request is complete
-    if (!request.isComplete()) {
-        m_incompleteRequests.insert(socket, request);
-        return;
+void WebServer::processRequests(QSslSocket *socket)
+{
+    // Pipelined requests must be answered in order, so an async or streamed reply blocks the following requests
+    while (m_incompleteRequests.contains(socket) && !m_asyncReplyConnections.contains(socket) && !m_fileStreams.contains(socket) && !m_closingConnections.contains(socket)) {
+        HttpRequest request = m_incompleteRequests.value(socket);
+        if (!request.isComplete())
+            return;
+
+        QByteArray remainingData = request.remainingData();
+        if (remainingData.isEmpty()) {
+            m_incompleteRequests.remove(socket);
+        } else {
+            m_incompleteRequests.insert(socket, HttpRequest(remainingData));
+        }
+
+        processRequest(socket, request);
     }
+}
+
+void WebServer::processRequest(QSslSocket *socket, const HttpRequest &request)
+{
+    QUuid clientId = m_clientIds.value(socket);
+
+    int requestCount = m_requestCounts.value(socket) + 1;
+    m_requestCounts.insert(socket, requestCount);
+
+    // An invalid request leaves the stream in an unknown state, close the connection after replying
+    if (!request.isValid() || !request.keepAlive() || requestCount >= maxRequestsPerConnection)
+        m_closingConnections.insert(socket);
 
     qCDebug(dcWebServerTraffic()) << "Received request from" << clientId.toString() << socket->peerAddress().toString() << request;
 
@@ -328,6 +449,7 @@ void WebServer::readClient()
     // Check HTTP version
     if (request.httpVersion() != "HTTP/1.1" && request.httpVersion() != "HTTP/1.0") {
         qCDebug(dcWebServer()) << "HTTP version is not supported." << request.httpVersion();
+        m_closingConnections.insert(socket);
         HttpReply *reply = HttpReply::createErrorReply(HttpReply::HttpVersionNotSupported);
         reply->setClientId(clientId);
         sendHttpReply(reply);
@@ -337,13 +459,7 @@ void WebServer::readClient()
 
     qCDebug(dcWebServer()).noquote() << QString("Got valid request from %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort()) << request.methodString() << request.url().path() << request.urlQuery().toString();
 
-    // Reset timout
-    foreach (WebServerClient *webserverClient, m_webServerClients) {
-        if (webserverClient->address() == socket->peerAddress()) {
-            webserverClient->resetTimout(socket);
-            break;
-        }
-    }
+    resetConnectionTimeout(socket);
 
     // Verify method
     if (request.method() == HttpRequest::Unhandled) {
@@ -384,9 +500,13 @@ void WebServer::readClient()
 
             // Handle async replies
             if (reply->type() == HttpReply::TypeAsync) {
+                m_asyncReplyConnections.insert(socket);
                 connect(reply, &HttpReply::finished, this, &WebServer::onAsyncReplyFinished);
                 reply->startWait();
             } else {
+                if (reply->hasPayloadFile())
+                    applyByteRange(request, reply);
+
                 sendHttpReply(reply);
                 reply->deleteLater();
             }
@@ -431,37 +551,38 @@ void WebServer::readClient()
         if (!verifyFile(socket, path))
             return;
 
-        QFile file(path);
-        if (file.open(QFile::ReadOnly)) {
-            qCDebug(dcWebServer()) << "Load file" << file.fileName();
-            HttpReply *reply = HttpReply::createSuccessReply();
-
-            // Check content type
-            if (file.fileName().endsWith(".html")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/html; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".css")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/css; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".pdf")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/pdf");
-            } else if (file.fileName().endsWith(".js")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/javascript; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".ttf")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/x-font-ttf");
-            } else if (file.fileName().endsWith(".eot")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/vnd.ms-fontobject");
-            } else if (file.fileName().endsWith(".woff")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/x-font-woff");
-            } else if (file.fileName().endsWith(".jpg") || file.fileName().endsWith(".jpeg")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/jpeg");
-            } else if (file.fileName().endsWith(".png") || file.fileName().endsWith(".PNG")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/png");
-            } else if (file.fileName().endsWith(".ico")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/x-icon");
-            } else if (file.fileName().endsWith(".svg")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/svg+xml; charset=\"utf-8\";");
+        StaticFileCache::Entry file = m_fileCache.file(path, request.headerValue("Accept-Encoding"));
+        if (file.isValid()) {
+            // The client has this version already
+            if (StaticFileCache::etagMatches(request.headerValue("If-None-Match"), file.etag)) {
+                qCDebug(dcWebServer()) << "File" << path << "not modified";
+                HttpReply *reply = new HttpReply(HttpReply::NotModified);
+                reply->setRawHeader("ETag", file.etag);
+                reply->setHeader(HttpReply::CacheControlHeader, cacheControl(path));
+                reply->setRawHeader("Vary", "Accept-Encoding");
+                reply->setClientId(clientId);
+                sendHttpReply(reply);
+                reply->deleteLater();
+                return;
             }
 
-            reply->setPayload(file.readAll());
+            qCDebug(dcWebServer()) << "Load file" << path << file.contentEncoding << (file.isLoaded() ? "from cache" : "streamed");
+            HttpReply *reply = HttpReply::createSuccessReply();
+            if (!file.contentType.isEmpty()) {
+                reply->setHeader(HttpReply::ContentTypeHeader, file.contentType);
+            }
+            if (!file.contentEncoding.isEmpty()) {
+                reply->setRawHeader("Content-Encoding", file.contentEncoding);
+            }
+            reply->setRawHeader("ETag", file.etag);
+            reply->setHeader(HttpReply::CacheControlHeader, cacheControl(path));
+            reply->setRawHeader("Vary", "Accept-Encoding");
+            if (file.isLoaded()) {
+                reply->setPayload(file.data);
+            } else {
+                reply->setPayloadFile(file.filePath);
+                applyByteRange(request, reply);
+            }
             reply->setClientId(clientId);
             sendHttpReply(reply);
             reply->deleteLater();
@@ -477,10 +598,131 @@ void WebServer::readClient()
     reply->deleteLater();
 }
 
+void WebServer::applyByteRange(const HttpRequest &request, HttpReply *reply)
+{
+    reply->setRawHeader("Accept-Ranges", "bytes");
+
+    QByteArray range = request.headerValue("Range");
+    if (range.isEmpty() || reply->httpStatusCode() != HttpReply::Ok)
+        return;
+
+    // Send the whole resource if it changed since the client fetched the first part
+    QByteArray ifRange = request.headerValue("If-Range");
+    if (!ifRange.isEmpty() && ifRange != reply->rawHeaderList().value("ETag"))
+        return;
+
+    // Only single byte ranges are supported. RFC 7233 allows ignoring the
+    // header otherwise, the client gets the whole resource then.
+    if (!range.startsWith("bytes=") || range.contains(','))
+        return;
+
+    qint64 size = reply->payloadFileLength();
+    QByteArray rangeSpec = range.mid(6).trimmed();
+    int dashIndex = rangeSpec.indexOf('-');
+    if (dashIndex < 0)
+        return;
+
+    QByteArray firstBytePos = rangeSpec.left(dashIndex).trimmed();
+    QByteArray lastBytePos = rangeSpec.mid(dashIndex + 1).trimmed();
+    qint64 first = 0;
+    qint64 last = size - 1;
+    bool ok = false;
+    if (firstBytePos.isEmpty()) {
+        // "bytes=-500" requests the last 500 bytes
+        qint64 suffixLength = lastBytePos.toLongLong(&ok);
+        if (!ok || suffixLength < 0)
+            return;
+
+        first = suffixLength == 0 ? size : qMax<qint64>(size - suffixLength, 0);
+    } else {
+        first = firstBytePos.toLongLong(&ok);
+        if (!ok || first < 0)
+            return;
+
+        if (!lastBytePos.isEmpty()) {
+            qint64 lastPos = lastBytePos.toLongLong(&ok);
+            if (!ok || lastPos < first)
+                return;
+
+            last = qMin(lastPos, size - 1);
+        }
+    }
+
+    if (first >= size) {
+        qCDebug(dcWebServer()) << "Range" << range << "not satisfiable for" << size << "bytes";
+        reply->setHttpStatusCode(HttpReply::RangeNotSatisfiable);
+        reply->setHeader(HttpReply::ContentTypeHeader, "text/plain; charset=\"utf-8\";");
+        reply->setRawHeader("Content-Range", "bytes */" + QByteArray::number(size));
+        reply->setPayload(QByteArray::number(reply->httpStatusCode()) + " " + reply->httpReasonPhrase());
+        return;
+    }
+
+    qCDebug(dcWebServer()) << "Sending range" << first << "-" << last << "of" << size << "bytes";
+    reply->setHttpStatusCode(HttpReply::PartialContent);
+    reply->setRawHeader("Content-Range", QString("bytes %1-%2/%3").arg(first).arg(last).arg(size).toUtf8());
+    reply->setPayloadFile(reply->payloadFileName(), reply->payloadFileOffset() + first, last - first + 1);
+}
+
+bool WebServer::streamFile(QSslSocket *socket)
+{
+    FileStream &stream = m_fileStreams[socket];
+
+    // Only keep a few chunks in the socket buffers, memory usage does not depend on the file size.
+    // With TLS, the data waits in the plain and the encrypted buffer.
+    if (m_fileStreamBuffer.size() != fileStreamChunkSize)
+        m_fileStreamBuffer.resize(fileStreamChunkSize);
+
+    while (stream.remaining > 0 && socket->bytesToWrite() + socket->encryptedBytesToWrite() < fileStreamHighWatermark) {
+        qint64 bytesRead = stream.file->read(m_fileStreamBuffer.data(), qMin<qint64>(stream.remaining, fileStreamChunkSize));
+        if (bytesRead <= 0) {
+            // The client waits for the announced Content-Length, closing is the only way out
+            qCWarning(dcWebServer()) << "Could not read from" << stream.file->fileName() << stream.file->errorString() << "Closing connection.";
+            m_closingConnections.insert(socket);
+            stream.remaining = 0;
+            break;
+        }
+        socket->write(m_fileStreamBuffer.constData(), bytesRead);
+        stream.remaining -= bytesRead;
+    }
+
+    if (stream.remaining > 0)
+        return false;
+
+    qCDebug(dcWebServer()) << "Finished streaming" << stream.file->fileName();
+    delete m_fileStreams.take(socket).file;
+    return true;
+}
+
+void WebServer::onBytesWritten()
+{
+    QSslSocket *socket = static_cast<QSslSocket *>(sender());
+    if (!m_fileStreams.contains(socket))
+        return;
+
+    // A download in progress is traffic too, slow clients must not run into the idle timeout
+    resetConnectionTimeout(socket);
+    if (!streamFile(socket))
+        return;
+
+    if (m_closingConnections.contains(socket)) {
+        socket->disconnectFromHost();
+    } else {
+        processRequests(socket);
+    }
+}
+
 void WebServer::onDisconnected()
-{    
+{
     QSslSocket* socket = static_cast<QSslSocket *>(sender());
+    qCDebug(dcWebServer()).noquote() << QString("Webserver client disonnected %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+
+    QUuid clientId = m_clientIds.value(socket);
+    cleanupConnection(socket);
+    emit clientDisconnected(clientId);
+}
 
+void WebServer::cleanupConnection(QSslSocket *socket)
+{
     // Remove connection from server client
     foreach (WebServerClient *client, m_webServerClients) {
         if (client->address() == socket->peerAddress()) {
@@ -493,26 +735,52 @@ void WebServer::onDisconnected()
         }
     }
 
-    qCDebug(dcWebServer()).noquote() << QString("Webserver client disonnected %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
-
     // clean up
-    QUuid clientId = m_clientList.key(socket);
+    QUuid clientId = m_clientIds.take(socket);
     m_clientList.remove(clientId);
     m_incompleteRequests.remove(socket);
-    emit clientDisconnected(clientId);
+    m_requestCounts.remove(socket);
+    m_closingConnections.remove(socket);
+    m_asyncReplyConnections.remove(socket);
+    if (m_fileStreams.contains(socket)) {
+        delete m_fileStreams.take(socket).file;
+    }
 
     socket->deleteLater();
 }
 
-void WebServer::onEncrypted()
+void WebServer::resetConnectionTimeout(QSslSocket *socket)
 {
-    QSslSocket* socket = static_cast<QSslSocket *>(sender());
+    foreach (WebServerClient *webserverClient, m_webServerClients) {
+        if (webserverClient->address() == socket->peerAddress()) {
+            webserverClient->resetTimout(socket);
+            break;
+        }
+    }
+}
+
+void WebServer::onEncrypted(QSslSocket *socket)
+{
+    if (!m_enabled) {
+        onHandshakeFailed(socket);
+        return;
+    }
+
     qCDebug(dcWebServer()).noquote() << QString("Encrypted connection %1:%2 successfully established.").arg(socket->peerAddress().toString()).arg(socket->peerPort());
     connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
+    connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
+    connect(socket, SIGNAL(encryptedBytesWritten(qint64)), this, SLOT(onBytesWritten()));
     connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
     connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onError(QAbstractSocket::SocketError)));
 
-    emit clientConnected(m_clientList.key(socket));
+    emit clientConnected(m_clientIds.value(socket));
+}
+
+void WebServer::onHandshakeFailed(QSslSocket *socket)
+{
+    qCDebug(dcWebServer()).noquote() << QString("Could not establish encrypted connection with %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+    socket->abort();
+    cleanupConnection(socket);
 }
 
 void WebServer::onError(QAbstractSocket::SocketError error)
@@ -541,6 +809,13 @@ void WebServer::onAsyncReplyFinished()
 
     sendHttpReply(reply);
     reply->deleteLater();
+
+    // Continue with requests the client pipelined behind this one
+    QSslSocket *socket = m_clientList.value(reply->clientId());
+    if (socket) {
+        m_asyncReplyConnections.remove(socket);
+        processRequests(socket);
+    }
 }
 
 /*! Set the configuration of this \l{WebServer} to the given \a config.
@@ -576,8 +851,13 @@ bool WebServer::startServer()
 /*! Returns true if this \l{WebServer} stopped successfully. */
 bool WebServer::stopServer()
 {
-    foreach (QSslSocket *client, m_clientList.values())
+    foreach (QSslSocket *client, m_clientList.values()) {
+        // Sockets in the handshake belong to the handshake thread and get dropped once they come back
+        if (m_handshaker->isHandshaking(client))
+            continue;
+
         client->close();
+    }
 
     close();
     m_enabled = false;
@@ -751,7 +1031,7 @@ QByteArray WebServer::createServerXmlDocument(QHostAddress address)
     \inmodule core
 
     The \l{WebServerClient} represents a client for the nymea \l{WebServer}. Each client can
-    have up to 50 connections and each connection will timeout after 12 seconds if the
+    have up to 50 connections and each connection will timeout after 65 seconds if the
     connection will not be used.
 
     If all connections of a \l{WebServerClient} are closed, the client will be removed from
@@ -760,10 +1040,13 @@ QByteArray WebServer::createServerXmlDocument(QHostAddress address)
     \sa WebServer
 */
 
-/*! Constructs a \l{WebServerClient} with the given \a address and \a parent. */
-WebServerClient::WebServerClient(const QHostAddress &address, QObject *parent):
+/*! Constructs a \l{WebServerClient} with the given \a address and \a parent. Connections are closed
+ *  after \a idleTimeout milliseconds without traffic.
+ */
+WebServerClient::WebServerClient(const QHostAddress &address, int idleTimeout, QObject *parent):
     QObject(parent),
-    m_address(address)
+    m_address(address),
+    m_idleTimeout(idleTimeout)
 {
 }
 
@@ -781,13 +1064,13 @@ QList<QSslSocket *> WebServerClient::connections()
 
 /*! Adds a new connection (\a socket) to this \l{WebServerClient}. A \l{WebServerClient}
  *  can have up to 50 connecections. The connection will timout and closed if the client
- *  does not use the connection for 65 seconds.
+ *  does not use the connection for the idle timeout.
  */
 void WebServerClient::addConnection(QSslSocket *socket)
 {
     QTimer *timer = new QTimer(this);
     timer->setSingleShot(true);
-    timer->setInterval(65000);
+    timer->setInterval(m_idleTimeout);
     connect(timer, &QTimer::timeout, this, &WebServerClient::onTimout);
 
     m_runningConnections.insert(timer, socket);
@@ -806,7 +1089,7 @@ void WebServerClient::removeConnection(QSslSocket *socket)
     delete timer;
 }
 
-/*! Resets the connection timeout for the given \a socket. If the socket will not be used for 12 seconds the
+/*! Resets the connection timeout for the given \a socket. If the socket will not be used for the idle timeout the
  *  connection will be closed.
  */
 void WebServerClient::resetTimout(QSslSocket *socket)
@@ -35,7 +35,9 @@
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QHash>
+#include <QSet>
 #include <QDir>
+#include <QFile>
 #include <QTimer>
 #include <QImage>
 #include <QBuffer>
@@ -45,6 +47,8 @@
 #include <QSslKey>
 
 #include "nymeaconfiguration.h"
+#include "staticfilecache.h"
+#include "tlshandshaker.h"
 
 // Note: Hypertext Transfer Protocol (HTTP/1.1) from the Internet Engineering Task Force (IETF):
 //       https://tools.ietf.org/html/rfc7231
@@ -58,7 +62,7 @@ class WebServerClient : public QObject
 {
     Q_OBJECT
 public:
-    WebServerClient(const QHostAddress &address, QObject *parent = nullptr);
+    WebServerClient(const QHostAddress &address, int idleTimeout, QObject *parent = nullptr);
 
     QHostAddress address() const;
 
@@ -70,6 +74,7 @@ public:
 
 private:
     QHostAddress m_address;
+    int m_idleTimeout;
     QList<QSslSocket *> m_connections;
     QHash<QTimer *, QSslSocket *> m_runningConnections;
 
@@ -89,24 +94,52 @@ public:
 
     void sendHttpReply(HttpReply *reply);
 
+    int connectionIdleTimeout() const;
+    void setConnectionIdleTimeout(int msecs);
+
 private:
     QHash<QUuid, QSslSocket *> m_clientList;
+    QHash<QSslSocket *, QUuid> m_clientIds;
     QList<WebServerClient *> m_webServerClients;
     QHash<QSslSocket *, HttpRequest> m_incompleteRequests;
+    QHash<QSslSocket *, int> m_requestCounts;
+    QSet<QSslSocket *> m_closingConnections;
+    QSet<QSslSocket *> m_asyncReplyConnections;
+
+    struct FileStream {
+        QFile *file = nullptr;
+        qint64 remaining = 0;
+    };
+    QHash<QSslSocket *, FileStream> m_fileStreams;
+    QByteArray m_fileStreamBuffer;
 
     QString m_serverName;
     WebServerConfiguration m_configuration;
     QSslConfiguration m_sslConfiguration;
 
     bool m_enabled = false;
+    int m_connectionIdleTimeout;
+
+    StaticFileCache m_fileCache;
+    TlsHandshaker *m_handshaker = nullptr;
 
     bool verifyFile(QSslSocket *socket, const QString &fileName);
     QString fileName(const QString &query);
+    QByteArray cacheControl(const QString &fileName) const;
 
     QByteArray createServerXmlDocument(QHostAddress address);
     HttpReply *processIconRequest(const QString &fileName);
     HttpReply *processDebugRequest(const QString &requestPath);
 
+    void processRequests(QSslSocket *socket);
+    void processRequest(QSslSocket *socket, const HttpRequest &request);
+
+    void cleanupConnection(QSslSocket *socket);
+    void resetConnectionTimeout(QSslSocket *socket);
+
+    void applyByteRange(const HttpRequest &request, HttpReply *reply);
+    bool streamFile(QSslSocket *socket);
+
 protected:
     void incomingConnection(qintptr socketDescriptor) override;
 
@@ -118,9 +151,11 @@ signals:
 private slots:
     void readClient();
     void onDisconnected();
-    void onEncrypted();
+    void onEncrypted(QSslSocket *socket);
+    void onHandshakeFailed(QSslSocket *socket);
     void onError(QAbstractSocket::SocketError error);
     void onAsyncReplyFinished();
+    void onBytesWritten();
 
 public slots:
     void setConfiguration(const WebServerConfiguration &config);
@@ -66,6 +66,40 @@
 
 namespace nymeaserver {
 
+WebSocketListener::WebSocketListener(const QSslConfiguration &sslConfiguration, QObject *parent) :
+    QTcpServer(parent),
+    m_sslConfiguration(sslConfiguration),
+    m_handshaker(new TlsHandshaker(this))
+{
+    connect(m_handshaker, &TlsHandshaker::encrypted, this, &WebSocketListener::onEncrypted);
+    connect(m_handshaker, &TlsHandshaker::failed, this, &WebSocketListener::onHandshakeFailed);
+}
+
+void WebSocketListener::incomingConnection(qintptr socketDescriptor)
+{
+    QSslSocket *socket = new QSslSocket();
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        qCWarning(dcWebSocketServer()) << "Failed to set SSL socket descriptor.";
+        delete socket;
+        return;
+    }
+    m_handshaker->startServerEncryption(socket, m_sslConfiguration);
+}
+
+void WebSocketListener::onEncrypted(QSslSocket *socket)
+{
+    socket->setParent(this);
+    addPendingConnection(socket);
+    emit newConnection();
+}
+
+void WebSocketListener::onHandshakeFailed(QSslSocket *socket)
+{
+    qCDebug(dcWebSocketServer()) << "Client failed to establish encryption:" << socket->peerAddress().toString();
+    socket->abort();
+    socket->deleteLater();
+}
+
 /*! Constructs a \l{WebSocketServer} with the given \a configuration, \a sslConfiguration and \a parent.
  *
  *  \sa ServerManager, ServerConfiguration
@@ -100,7 +134,19 @@ void WebSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
     client = m_clientList.value(clientId);
     if (client) {
         qCDebug(dcWebSocketServerTraffic()) << "Sending data to client" << data;
-        client->sendTextMessage(data + '\n');
+        StreamCompressor *compressor = m_compressors.value(clientId);
+        if (compressor) {
+            QByteArray compressed = compressor->compress(data + '\n');
+            if (compressed.isEmpty()) {
+                // The client can't decode anything sent after a gap in the stream
+                qCWarning(dcWebSocketServer()) << "Failed to compress data for client" << clientId.toString() << "Closing the connection.";
+                terminateClientConnection(clientId);
+                return;
+            }
+            m_bytesToWrite[clientId] += client->sendBinaryMessage(compressed);
+        } else {
+            m_bytesToWrite[clientId] += client->sendTextMessage(data + '\n');
+        }
     } else {
         qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
     }
@@ -117,6 +163,89 @@ void WebSocketServer::sendData(const QList<QUuid> &clients, const QByteArray &da
     }
 }
 
+/*! Returns true, binary data is sent in binary WebSocket messages. */
+bool WebSocketServer::supportsBinaryData() const
+{
+    return true;
+}
+
+/*! Send the given binary \a data to the client with the given \a clientId as binary message.
+ *
+ * \sa TransportInterface::sendBinaryData()
+ */
+void WebSocketServer::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    QWebSocket *client = m_clientList.value(clientId);
+    if (client) {
+        qCDebug(dcWebSocketServerTraffic()) << "Sending binary data to client" << data.toHex();
+        StreamCompressor *compressor = m_compressors.value(clientId);
+        if (!compressor) {
+            m_bytesToWrite[clientId] += client->sendBinaryMessage(data);
+            return;
+        }
+        QByteArray compressed = compressor->compress(data);
+        if (compressed.isEmpty()) {
+            qCWarning(dcWebSocketServer()) << "Failed to compress data for client" << clientId.toString() << "Closing the connection.";
+            terminateClientConnection(clientId);
+            return;
+        }
+        m_bytesToWrite[clientId] += client->sendBinaryMessage(compressed);
+    } else {
+        qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
+    }
+}
+
+/*! Marks the client with the given \a clientId as using a binary encoding. Binary messages are only
+ *  accepted from such clients and from clients with compression enabled, others speak JSON in text messages.
+ *
+ * \sa TransportInterface::setBinaryDataEnabled()
+ */
+void WebSocketServer::setBinaryDataEnabled(const QUuid &clientId, bool enabled)
+{
+    if (enabled && m_clientList.contains(clientId)) {
+        m_binaryClients.insert(clientId);
+    } else {
+        m_binaryClients.remove(clientId);
+    }
+}
+
+/*! Returns true, outgoing messages can be compressed. */
+bool WebSocketServer::supportsCompression() const
+{
+    return true;
+}
+
+/*! Enables or disables compression for the client with the given \a clientId.
+ *
+ * QWebSocketServer does not implement the permessage-deflate extension, so compression is done on
+ * the message level instead: Once enabled, each message is sent as binary frame containing the next
+ * sync flushed segment of a zlib stream shared by all messages of this connection (context takeover).
+ *
+ * \sa TransportInterface::setCompressionEnabled()
+ */
+void WebSocketServer::setCompressionEnabled(const QUuid &clientId, bool enabled)
+{
+    if (!m_clientList.contains(clientId)) {
+        return;
+    }
+    if (!enabled) {
+        delete m_compressors.take(clientId);
+        return;
+    }
+    if (!m_compressors.contains(clientId)) {
+        m_compressors.insert(clientId, new StreamCompressor());
+    }
+}
+
+/*! Returns the number of bytes sent to the client with the given \a clientId which have not been written yet.
+ *
+ * QWebSocket does not expose its socket buffer, the bytes are counted from the sent and written payloads.
+ */
+qint64 WebSocketServer::bytesToWrite(const QUuid &clientId) const
+{
+    return m_bytesToWrite.value(clientId);
+}
+
 void WebSocketServer::terminateClientConnection(const QUuid &clientId)
 {
     QWebSocket *client = m_clientList.value(clientId);
@@ -145,36 +274,70 @@ void WebSocketServer::onClientConnected()
 
     // append the new client to the client list
     m_clientList.insert(clientId, client);
+    m_clientIds.insert(client, clientId);
 
     connect(client, SIGNAL(pong(quint64,QByteArray)), this, SLOT(onPing(quint64,QByteArray)));
     connect(client, SIGNAL(binaryMessageReceived(QByteArray)), this, SLOT(onBinaryMessageReceived(QByteArray)));
     connect(client, SIGNAL(textMessageReceived(QString)), this, SLOT(onTextMessageReceived(QString)));
     connect(client, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onClientError(QAbstractSocket::SocketError)));
     connect(client, SIGNAL(disconnected()), this, SLOT(onClientDisconnected()));
+    connect(client, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten(qint64)));
 
     emit clientConnected(clientId);
 }
 
+void WebSocketServer::onEncryptedConnection()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,9,0)
+    while (m_listener->hasPendingConnections()) {
+        QTcpSocket *socket = m_listener->nextPendingConnection();
+        // The websocket server reads the upgrade request from the already encrypted socket
+        socket->setParent(m_server);
+        m_server->handleConnection(socket);
+    }
+#endif
+}
+
 void WebSocketServer::onClientDisconnected()
 {
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
-    QUuid clientId = m_clientList.key(client);
+    QUuid clientId = m_clientIds.take(client);
     qCDebug(dcWebSocketServer()) << "Client" << clientId.toString() << "disconnected. (Remote address:" << client->peerAddress().toString() << ")" ;
     m_clientList.take(clientId)->deleteLater();
+    delete m_compressors.take(clientId);
+    m_binaryClients.remove(clientId);
+    m_bytesToWrite.remove(clientId);
     emit clientDisconnected(clientId);
 }
 
 void WebSocketServer::onBinaryMessageReceived(const QByteArray &data)
 {
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
-    QUuid clientId = m_clientList.key(client);
-    qCDebug(dcWebSocketServerTraffic()) << "Binary message from" << clientId.toString() << ":" << data;
+    QUuid clientId = m_clientIds.value(client);
+    qCDebug(dcWebSocketServerTraffic()) << "Binary message from" << clientId.toString() << ":" << data.toHex();
+    if (!m_binaryClients.contains(clientId) && !m_compressors.contains(clientId)) {
+        qCWarning(dcWebSocketServer()) << "Ignoring binary message from client" << clientId.toString() << "which has not switched to a binary encoding or compression.";
+        return;
+    }
+    emit dataAvailable(clientId, data);
+}
+
+void WebSocketServer::onBytesWritten(qint64 bytes)
+{
+    QWebSocket *client = qobject_cast<QWebSocket *>(sender());
+    QUuid clientId = m_clientIds.value(client);
+    if (!m_bytesToWrite.contains(clientId)) {
+        return;
+    }
+    // Written bytes include frame headers, don't go below zero
+    m_bytesToWrite[clientId] = qMax<qint64>(0, m_bytesToWrite.value(clientId) - bytes);
+    emit bytesWritten(clientId);
 }
 
 void WebSocketServer::onTextMessageReceived(const QString &message)
 {
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
-    QUuid clientId = m_clientList.key(client);
+    QUuid clientId = m_clientIds.value(client);
     qCDebug(dcWebSocketServerTraffic()) << "Text message from" << clientId.toString() << ":" << message;
     emit dataAvailable(clientId, message.toUtf8());
 }
@@ -182,19 +345,19 @@ void WebSocketServer::onTextMessageReceived(const QString &message)
 void WebSocketServer::onClientError(QAbstractSocket::SocketError error)
 {
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
-    QUuid clientId = m_clientList.key(client);
+    QUuid clientId = m_clientIds.value(client);
     qCWarning(dcWebSocketServer()) << "Client error from" << clientId.toString() << ":" << error << client->errorString();
 }
 
 void WebSocketServer::onServerError(QAbstractSocket::SocketError error)
 {
-    qCWarning(dcWebSocketServer()) << "Server error " << error << m_server->errorString();
+    qCWarning(dcWebSocketServer()) << "Server error " << error << (m_listener ? m_listener->errorString() : m_server->errorString());
 }
 
 void WebSocketServer::onPing(quint64 elapsedTime, const QByteArray &payload)
 {
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
-    QUuid clientId = m_clientList.key(client);
+    QUuid clientId = m_clientIds.value(client);
     qCDebug(dcWebSocketServer) << "Ping response from" << clientId.toString() << elapsedTime << payload;
 }
 
@@ -210,6 +373,27 @@ void WebSocketServer::setServerName(const QString &serverName)
  */
 bool WebSocketServer::startServer()
 {
+#if QT_VERSION >= QT_VERSION_CHECK(5,9,0)
+    if (configuration().sslEnabled) {
+        // The TLS handshakes are done by the listener on the handshake thread, the websocket
+        // server only gets to see the encrypted connections.
+        m_server = new QWebSocketServer("nymea", QWebSocketServer::NonSecureMode, this);
+        connect (m_server, &QWebSocketServer::newConnection, this, &WebSocketServer::onClientConnected);
+
+        m_listener = new WebSocketListener(m_sslConfiguration, this);
+        connect (m_listener, &WebSocketListener::newConnection, this, &WebSocketServer::onEncryptedConnection);
+        connect (m_listener, &WebSocketListener::acceptError, this, &WebSocketServer::onServerError);
+
+        if (!m_listener->listen(QHostAddress(configuration().address), static_cast<quint16>(configuration().port))) {
+            qCWarning(dcWebSocketServer()) << "Error listening on" << serverUrl().toString();
+            return false;
+        }
+
+        qCDebug(dcWebSocketServer()) << "Server started on" << serverUrl().toString();
+        return true;
+    }
+#endif
+
     if (configuration().sslEnabled) {
         m_server = new QWebSocketServer("nymea", QWebSocketServer::SecureMode, this);
         m_server->setSslConfiguration(m_sslConfiguration);
@@ -238,6 +422,12 @@ bool WebSocketServer::stopServer()
         client->close(QWebSocketProtocol::CloseCodeNormal, "Stop server");
     }
 
+    if (m_listener) {
+        m_listener->close();
+        delete m_listener;
+        m_listener = nullptr;
+    }
+
     if (m_server) {
         m_server->close();
         delete m_server;
@@ -35,10 +35,14 @@
 #include <QUuid>
 #include <QVariant>
 #include <QList>
+#include <QSet>
+#include <QTcpServer>
 #include <QWebSocket>
 #include <QWebSocketServer>
 
 #include "transportinterface.h"
+#include "streamcompressor.h"
+#include "tlshandshaker.h"
 
 // Note: WebSocket Protocol from the Internet Engineering Task Force (IETF) -> RFC6455 V13:
 //       http://tools.ietf.org/html/rfc6455
@@ -47,6 +51,26 @@ class QSslConfiguration;
 
 namespace nymeaserver {
 
+// Accepts the TLS connections for the websocket server and hands them out once they are encrypted,
+// so the handshakes don't run in the event loop of QWebSocketServer.
+class WebSocketListener : public QTcpServer
+{
+    Q_OBJECT
+public:
+    explicit WebSocketListener(const QSslConfiguration &sslConfiguration, QObject *parent = nullptr);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private slots:
+    void onEncrypted(QSslSocket *socket);
+    void onHandshakeFailed(QSslSocket *socket);
+
+private:
+    QSslConfiguration m_sslConfiguration;
+    TlsHandshaker *m_handshaker = nullptr;
+};
+
 class WebSocketServer : public TransportInterface
 {
     Q_OBJECT
@@ -58,23 +82,36 @@ public:
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
+    bool supportsBinaryData() const override;
+    void sendBinaryData(const QUuid &clientId, const QByteArray &data) override;
+    void setBinaryDataEnabled(const QUuid &clientId, bool enabled) override;
+    bool supportsCompression() const override;
+    void setCompressionEnabled(const QUuid &clientId, bool enabled) override;
+    qint64 bytesToWrite(const QUuid &clientId) const override;
 
     void terminateClientConnection(const QUuid &clientId) override;
 
 private:
     QWebSocketServer *m_server = nullptr;
+    WebSocketListener *m_listener = nullptr;
     QHash<QUuid, QWebSocket *> m_clientList;
+    QHash<QWebSocket *, QUuid> m_clientIds;
+    QHash<QUuid, StreamCompressor *> m_compressors;
+    QSet<QUuid> m_binaryClients;
+    QHash<QUuid, qint64> m_bytesToWrite;
     QSslConfiguration m_sslConfiguration;
     bool m_enabled;
 
 private slots:
     void onClientConnected();
+    void onEncryptedConnection();
     void onClientDisconnected();
     void onBinaryMessageReceived(const QByteArray &data);
     void onTextMessageReceived(const QString &message);
     void onClientError(QAbstractSocket::SocketError error);
     void onServerError(QAbstractSocket::SocketError error);
     void onPing(quint64 elapsedTime, const QByteArray & payload);
+    void onBytesWritten(qint64 bytes);
 
 public slots:
     void setServerName(const QString &serverName) override;
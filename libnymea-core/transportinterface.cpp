@@ -80,6 +80,12 @@
     abort the connection but close it after flushing outgoing  buffers.
 */
 
+/*! \fn void nymeaserver::TransportInterface::bytesWritten(const QUuid &clientId);
+    This signal is emitted when data to the client with the given \a clientId has been written to the network.
+
+    \sa bytesToWrite()
+*/
+
 /*! \fn void nymeaserver::TransportInterface::dataAvailable(const QUuid &clientId, const QByteArray &data);
     This signal is emitted when valid \a data from the client with the given \a clientId are available.
 
@@ -101,6 +107,66 @@ TransportInterface::TransportInterface(const ServerConfiguration &config, QObjec
 
 }
 
+/*! Returns true if this transport can deliver binary (non line based) messages to its clients, e.g. CBOR
+    encoded messages. The default implementation returns false.
+
+    \sa sendBinaryData()
+*/
+bool TransportInterface::supportsBinaryData() const
+{
+    return false;
+}
+
+/*! Send the binary \a data to the client with the id \a clientId. Unlike sendData(), the data is sent as is,
+    without appending a line delimiter. Transports supporting binary data must reimplement this and
+    supportsBinaryData().
+*/
+void TransportInterface::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    Q_UNUSED(data)
+    qCWarning(dcJsonRpc()) << "Transport does not support binary data. Not sending data to client" << clientId;
+}
+
+/*! Informs the transport whether the client with the id \a clientId has switched to a binary encoding.
+    Transports which tell binary and text messages apart may use this to only accept binary messages from
+    such clients. The default implementation does nothing.
+*/
+void TransportInterface::setBinaryDataEnabled(const QUuid &clientId, bool enabled)
+{
+    Q_UNUSED(clientId)
+    Q_UNUSED(enabled)
+}
+
+/*! Returns true if this transport can compress the outgoing data for its clients. The default
+    implementation returns false.
+
+    \sa setCompressionEnabled()
+*/
+bool TransportInterface::supportsCompression() const
+{
+    return false;
+}
+
+/*! Enables or disables compression of all outgoing data to the client with the id \a clientId.
+    When \a enabled, all following data sent by sendData() or sendBinaryData() is written as
+    one continuous zlib stream, flushed after each message. Incoming data is not affected.
+*/
+void TransportInterface::setCompressionEnabled(const QUuid &clientId, bool enabled)
+{
+    Q_UNUSED(enabled)
+    qCWarning(dcJsonRpc()) << "Transport does not support compression. Not enabling compression for client" << clientId;
+}
+
+/*! Returns the number of bytes sent to the client with the id \a clientId which have not been written
+    to the network yet. Transports reporting this must emit bytesWritten() as their buffer drains. The
+    default implementation returns 0, meaning the transport never applies backpressure.
+*/
+qint64 TransportInterface::bytesToWrite(const QUuid &clientId) const
+{
+    Q_UNUSED(clientId)
+    return 0;
+}
+
 /*! Set the ServerConfiguration of this TransportInterface to the given \a config. */
 void TransportInterface::setConfiguration(const ServerConfiguration &config)
 {
@@ -52,6 +52,15 @@ public:
 
     virtual void terminateClientConnection(const QUuid &clientId) = 0;
 
+    virtual bool supportsBinaryData() const;
+    virtual void sendBinaryData(const QUuid &clientId, const QByteArray &data);
+    virtual void setBinaryDataEnabled(const QUuid &clientId, bool enabled);
+
+    virtual bool supportsCompression() const;
+    virtual void setCompressionEnabled(const QUuid &clientId, bool enabled);
+
+    virtual qint64 bytesToWrite(const QUuid &clientId) const;
+
     void setConfiguration(const ServerConfiguration &config);
     ServerConfiguration configuration() const;
 
@@ -62,6 +71,7 @@ signals:
     void clientConnected(const QUuid &clientId);
     void clientDisconnected(const QUuid &clientId);
     void dataAvailable(const QUuid &clientId, const QByteArray &data);
+    void bytesWritten(const QUuid &clientId);
 
 public slots:
     virtual void setServerName(const QString &serverName);
@@ -64,6 +64,7 @@ private:
     BrowserAction m_browserAction;
 
     bool m_finished = false;
+    quint64 m_timeoutHandle = 0;
     Thing::ThingError m_status = Thing::ThingErrorNoError;
     QString m_displayMessage;
 
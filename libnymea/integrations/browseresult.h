@@ -72,6 +72,7 @@ private:
     BrowserItems m_items;
 
     bool m_finished = false;
+    quint64 m_timeoutHandle = 0;
     Thing::ThingError m_status = Thing::ThingErrorNoError;
     QString m_displayMessage;
 
@@ -65,6 +65,7 @@ private:
     BrowserItemAction m_browserItemAction;
 
     bool m_finished = false;
+    quint64 m_timeoutHandle = 0;
     Thing::ThingError m_status = Thing::ThingErrorNoError;
     QString m_displayMessage;
 
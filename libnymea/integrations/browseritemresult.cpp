@@ -31,7 +31,7 @@
 #include "browseritemresult.h"
 #include "thingmanager.h"
 
-#include <QTimer>
+#include "infotimeoutwheel.h"
 
 Q_DECLARE_LOGGING_CATEGORY(dcIntegrations)
 
@@ -47,7 +47,7 @@ BrowserItemResult::BrowserItemResult(Thing *thing, ThingManager *thingManager, c
     // TODO 2.0: Create a base class and move this finished() of all Info classes logic handling there
     // That will badly break the ABI, so copy/pasting this for now.
     if (timeout > 0) {
-        QTimer::singleShot(timeout, this, [this] {
+        m_timeoutHandle = InfoTimeoutWheel::instance()->schedule(timeout, this, [this] {
             // It can happen that a plugin calls finish() in a slot which normally would be dispatched before the timeout
             // but due to high system load the slot is invoked only after the timeout. This in turn would cause Qt to also queue up
             // this timeout slot and by the time the system processes slots, the plugin comes in first and we'd fire an aborted()
@@ -122,6 +122,7 @@ void BrowserItemResult::finish(Thing::ThingError status, const QString &displayM
         return;
     }
     m_finished = true;
+    InfoTimeoutWheel::instance()->cancel(m_timeoutHandle);
     m_status = status;
     m_displayMessage = displayMessage;
     staticMetaObject.invokeMethod(this, "finished", Qt::QueuedConnection);
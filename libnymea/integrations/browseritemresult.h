@@ -71,6 +71,7 @@ private:
     BrowserItem m_item;
 
     bool m_finished = false;
+    quint64 m_timeoutHandle = 0;
     Thing::ThingError m_status = Thing::ThingErrorNoError;
     QString m_displayMessage;
 
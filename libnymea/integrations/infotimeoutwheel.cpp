@@ -0,0 +1,118 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "infotimeoutwheel.h"
+
+#include <QCoreApplication>
+
+InfoTimeoutWheel *InfoTimeoutWheel::instance()
+{
+    static InfoTimeoutWheel *wheel = nullptr;
+    if (!wheel) {
+        wheel = new InfoTimeoutWheel(100, 256, QCoreApplication::instance());
+    }
+    return wheel;
+}
+
+InfoTimeoutWheel::InfoTimeoutWheel(int tickInterval, int bucketCount, QObject *parent):
+    QObject(parent),
+    m_tickInterval(qMax(1, tickInterval))
+{
+    m_buckets.resize(qMax(1, bucketCount));
+    m_timer.setInterval(m_tickInterval);
+    connect(&m_timer, &QTimer::timeout, this, &InfoTimeoutWheel::tick);
+}
+
+quint64 InfoTimeoutWheel::schedule(quint32 timeout, QObject *context, std::function<void()> callback)
+{
+    // One extra tick makes sure we never fire early when the timer is already running
+    quint32 ticks = (timeout + m_tickInterval - 1) / m_tickInterval + 1;
+
+    Entry entry;
+    entry.context = context;
+    entry.callback = callback;
+    entry.rounds = (ticks - 1) / m_buckets.count();
+
+    int bucket = (m_currentBucket + ticks) % m_buckets.count();
+    quint64 handle = m_nextHandle++;
+    m_buckets[bucket].insert(handle, entry);
+    m_bucketIndex.insert(handle, bucket);
+
+    if (!m_timer.isActive()) {
+        m_timer.start();
+    }
+    return handle;
+}
+
+void InfoTimeoutWheel::cancel(quint64 handle)
+{
+    if (!m_bucketIndex.contains(handle)) {
+        return;
+    }
+    m_buckets[m_bucketIndex.take(handle)].remove(handle);
+    if (m_bucketIndex.isEmpty()) {
+        m_timer.stop();
+    }
+}
+
+int InfoTimeoutWheel::pendingTimeouts() const
+{
+    return m_bucketIndex.count();
+}
+
+void InfoTimeoutWheel::tick()
+{
+    m_currentBucket = (m_currentBucket + 1) % m_buckets.count();
+
+    // Collect the expired entries first, callbacks may schedule or cancel other timeouts
+    QList<Entry> expired;
+    QHash<quint64, Entry> &bucket = m_buckets[m_currentBucket];
+    QHash<quint64, Entry>::iterator it = bucket.begin();
+    while (it != bucket.end()) {
+        if (it.value().rounds > 0) {
+            it.value().rounds--;
+            ++it;
+            continue;
+        }
+        m_bucketIndex.remove(it.key());
+        expired.append(it.value());
+        it = bucket.erase(it);
+    }
+
+    if (m_bucketIndex.isEmpty()) {
+        m_timer.stop();
+    }
+
+    foreach (const Entry &entry, expired) {
+        if (entry.context) {
+            entry.callback();
+        }
+    }
+}
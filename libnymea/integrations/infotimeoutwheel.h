@@ -0,0 +1,79 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INFOTIMEOUTWHEEL_H
+#define INFOTIMEOUTWHEEL_H
+
+#include <QObject>
+#include <QTimer>
+#include <QPointer>
+#include <QVector>
+#include <QHash>
+
+#include <functional>
+
+// Shared timeout handling for the info objects (ThingActionInfo, ThingSetupInfo etc.). Instead of
+// one QTimer per info object, all timeouts are kept in a hashed timing wheel driven by a single
+// timer which only runs while there are timeouts pending.
+class InfoTimeoutWheel : public QObject
+{
+    Q_OBJECT
+public:
+    // The shared instance ticks every 100 ms and has 256 buckets
+    static InfoTimeoutWheel *instance();
+
+    explicit InfoTimeoutWheel(int tickInterval, int bucketCount, QObject *parent = nullptr);
+
+    // Calls callback after the timeout (in ms) unless cancelled or context has been destroyed.
+    // Timeouts are rounded up to the tick interval.
+    quint64 schedule(quint32 timeout, QObject *context, std::function<void()> callback);
+    void cancel(quint64 handle);
+
+    int pendingTimeouts() const;
+
+private:
+    void tick();
+
+    class Entry {
+    public:
+        QPointer<QObject> context;
+        std::function<void()> callback;
+        int rounds = 0;
+    };
+
+    int m_tickInterval = 0;
+    QVector<QHash<quint64, Entry> > m_buckets;
+    QHash<quint64, int> m_bucketIndex;
+    int m_currentBucket = 0;
+    quint64 m_nextHandle = 1;
+    QTimer m_timer;
+};
+
+#endif // INFOTIMEOUTWHEEL_H
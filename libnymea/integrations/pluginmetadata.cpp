@@ -336,7 +336,7 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
                 // TODO: DEPRECATED 1.2: Remove displayNameEvent eventually (requires updating all plugins)
                 QStringList stateTypeProperties = {"id", "name", "displayName", "displayNameEvent", "type", "defaultValue", "cached",
                                                    "unit", "minValue", "maxValue", "possibleValues", "writable", "displayNameAction",
-                                                   "ioType", "suggestLogging", "filter"};
+                                                   "ioType", "suggestLogging", "filter", "filterSettings", "coalesceAction"};
                 QStringList mandatoryStateTypeProperties = {"id", "name", "displayName", "type", "defaultValue"};
                 QPair<QStringList, QStringList> verificationResult = verifyFields(stateTypeProperties, mandatoryStateTypeProperties, st);
 
@@ -518,14 +518,28 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
                 stateType.setSuggestLogging(st.value("suggestLogging").toBool());
 
                 if (st.contains("filter")) {
+                    QHash<QString, Types::StateValueFilter> filters = {
+                        {"adaptive", Types::StateValueFilterAdaptive},
+                        {"ema", Types::StateValueFilterEma},
+                        {"median", Types::StateValueFilterMedian},
+                        {"deadband", Types::StateValueFilterDeadband},
+                        {"ratelimit", Types::StateValueFilterRateLimit}
+                    };
                     QString filter = st.value("filter").toString();
-                    if (filter == "adaptive") {
-                        stateType.setFilter(Types::StateValueFilterAdaptive);
+                    if (filters.contains(filter)) {
+                        stateType.setFilter(filters.value(filter));
                     } else if (!filter.isEmpty()) {
-                        m_validationErrors.append("Thing class \"" + thingClass.name() + "\" state type \"" + stateTypeName + "\" has invalid filter value \"" + filter + "\". Supported filters are: \"adaptive\"");
+                        m_validationErrors.append("Thing class \"" + thingClass.name() + "\" state type \"" + stateTypeName + "\" has invalid filter value \"" + filter + "\". Supported filters are: \"adaptive\", \"ema\", \"median\", \"deadband\", \"ratelimit\"");
                         hasError = true;
                     }
                 }
+                if (st.contains("filterSettings")) {
+                    if (!st.value("filterSettings").isObject()) {
+                        m_validationErrors.append("Thing class \"" + thingClass.name() + "\" state type \"" + stateTypeName + "\" has invalid filterSettings. An object is expected.");
+                        hasError = true;
+                    }
+                    stateType.setFilterSettings(st.value("filterSettings").toObject().toVariantMap());
+                }
                 stateTypes.append(stateType);
 
                 // ActionTypes for writeable StateTypes
@@ -543,6 +557,7 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
                     actionType.setDisplayName(st.value("displayNameAction").toString());
                     actionType.setIndex(stateType.index());
                     actionType.setParamTypes(QList<ParamType>() << paramType);
+                    actionType.setCoalesce(st.value("coalesceAction").toBool());
                     actionTypes.append(actionType);
                 }
             }
@@ -552,7 +567,7 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
             foreach (const QJsonValue &actionTypesJson, thingClassObject.value("actionTypes").toArray()) {
                 QJsonObject at = actionTypesJson.toObject();
 
-                QStringList actionTypeProperties = {"id", "name", "displayName", "paramTypes"};
+                QStringList actionTypeProperties = {"id", "name", "displayName", "paramTypes", "coalesce"};
                 QStringList mandatoryActionTypeProperties = {"id", "name", "displayName"};
                 QPair<QStringList, QStringList> verificationResult = verifyFields(actionTypeProperties, mandatoryActionTypeProperties, at);
 
@@ -584,6 +599,7 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
                 actionType.setName(actionTypeName);
                 actionType.setDisplayName(at.value("displayName").toString());
                 actionType.setIndex(index++);
+                actionType.setCoalesce(at.value("coalesce").toBool());
 
                 QPair<bool, QList<ParamType> > paramVerification = parseParamTypes(at.value("paramTypes").toArray());
                 if (!paramVerification.first) {
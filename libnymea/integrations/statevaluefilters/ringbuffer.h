@@ -0,0 +1,81 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QVector>
+
+// Fixed capacity buffer keeping the last capacity() values. Appending to a full buffer
+// overwrites the oldest value.
+template <typename T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(int capacity = 1):
+        m_data(qMax(1, capacity))
+    {
+    }
+
+    int capacity() const { return m_data.count(); }
+    int count() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+    bool isFull() const { return m_count == m_data.count(); }
+
+    void append(const T &value)
+    {
+        m_data[m_head] = value;
+        m_head = (m_head + 1) % m_data.count();
+        if (m_count < m_data.count()) {
+            m_count++;
+        }
+    }
+
+    void clear()
+    {
+        m_count = 0;
+    }
+
+    // Index 0 is the oldest value, count() - 1 the newest
+    const T &at(int index) const
+    {
+        return m_data.at((m_head - m_count + index + m_data.count()) % m_data.count());
+    }
+
+    const T &oldest() const { return at(0); }
+    const T &newest() const { return at(m_count - 1); }
+
+private:
+    QVector<T> m_data;
+    int m_head = 0;
+    int m_count = 0;
+};
+
+#endif // RINGBUFFER_H
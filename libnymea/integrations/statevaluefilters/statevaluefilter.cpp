@@ -29,6 +29,11 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "statevaluefilter.h"
+#include "statevaluefilteradaptive.h"
+#include "statevaluefilterema.h"
+#include "statevaluefiltermedian.h"
+#include "statevaluefilterdeadband.h"
+#include "statevaluefilterratelimit.h"
 
 #include "loggingcategories.h"
 
@@ -43,3 +48,32 @@ StateValueFilter::~StateValueFilter()
 {
 
 }
+
+int StateValueFilter::flushDelay() const
+{
+    return -1;
+}
+
+bool StateValueFilter::flush()
+{
+    return false;
+}
+
+StateValueFilter *StateValueFilter::create(Types::StateValueFilter filter, const QVariantMap &settings)
+{
+    switch (filter) {
+    case Types::StateValueFilterNone:
+        return nullptr;
+    case Types::StateValueFilterAdaptive:
+        return new StateValueFilterAdaptive();
+    case Types::StateValueFilterEma:
+        return new StateValueFilterEma(settings.value("alpha", 0.2).toDouble());
+    case Types::StateValueFilterMedian:
+        return new StateValueFilterMedian(settings.value("windowSize", 5).toInt());
+    case Types::StateValueFilterDeadband:
+        return new StateValueFilterDeadband(settings.value("absolute", 0).toDouble(), settings.value("relative", 0.01).toDouble());
+    case Types::StateValueFilterRateLimit:
+        return new StateValueFilterRateLimit(settings.value("minimumInterval", 1000).toInt());
+    }
+    return nullptr;
+}
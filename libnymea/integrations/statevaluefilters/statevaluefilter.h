@@ -31,6 +31,8 @@
 #ifndef STATEVALUEFILTER_H
 #define STATEVALUEFILTER_H
 
+#include "typeutils.h"
+
 #include <QVariant>
 #include <QLoggingCategory>
 
@@ -46,6 +48,14 @@ public:
 
     virtual QVariant filteredValue() const = 0;
 
+    // Filters holding back the latest value return the time in ms after which flush() should be
+    // called to pass it on, or -1 if nothing is held back.
+    virtual int flushDelay() const;
+    // Passes on a held back value. Returns false if there was nothing to flush.
+    virtual bool flush();
+
+    static StateValueFilter *create(Types::StateValueFilter filter, const QVariantMap &settings = QVariantMap());
+
 };
 
 #endif // STATEVALUEFILTER_H
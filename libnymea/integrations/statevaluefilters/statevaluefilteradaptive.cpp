@@ -32,14 +32,20 @@
 
 #include <qmath.h>
 
-StateValueFilterAdaptive::StateValueFilterAdaptive()
+StateValueFilterAdaptive::StateValueFilterAdaptive():
+    m_inputValues(m_windowSize)
 {
 
 }
 
 void StateValueFilterAdaptive::addValue(const QVariant &value)
 {
-    m_inputValues.prepend(value.toDouble());
+    double inputValue = value.toDouble();
+    if (m_inputValues.isFull()) {
+        m_inputSum -= m_inputValues.oldest();
+    }
+    m_inputValues.append(inputValue);
+    m_inputSum += inputValue;
     m_inputValueCount++;
     update();
 }
@@ -51,10 +57,6 @@ QVariant StateValueFilterAdaptive::filteredValue() const
 
 void StateValueFilterAdaptive::update()
 {
-    while (m_inputValues.count() > m_windowSize) {
-        m_inputValues.removeLast();
-    }
-
     if (m_inputValues.isEmpty()) {
         m_outputValue = 0;
         return;
@@ -62,12 +64,12 @@ void StateValueFilterAdaptive::update()
 
     if (m_inputValues.count() == 1) {
         // Not enough data
-        m_outputValue = m_inputValues.first();
+        m_outputValue = m_inputValues.newest();
         m_outputValueCount++;
         return;
     }
 
-    double currentValue = m_inputValues.first();
+    double currentValue = m_inputValues.newest();
     if (qFuzzyCompare(currentValue, 0)) {
         // If we went to 0, follow right away.
         m_outputValue = 0;
@@ -75,12 +77,8 @@ void StateValueFilterAdaptive::update()
     }
 
     // Calculate average of history, for all values and for all but the last one
-    double sum = 0;
-    for (int i = 0; i < m_inputValues.count(); i++) {
-        sum += m_inputValues.at(i);
-    }
-    double normalizedValue = sum / m_inputValues.count();
-    double previousNormalizedValue = (sum - m_inputValues.first()) / (m_inputValues.count() - 1);
+    double normalizedValue = m_inputSum / m_inputValues.count();
+    double previousNormalizedValue = (m_inputSum - currentValue) / (m_inputValues.count() - 1);
 
     if (qFuzzyCompare(previousNormalizedValue, 0)) {
         // We can't calculate anything if the history is at 0. Follow right away to the new value.
@@ -100,7 +98,8 @@ void StateValueFilterAdaptive::update()
     // Discard the history and follow the new value right away
     if (qAbs(changeRatioToAverage) > m_standardDeviation * 3) {
         m_inputValues.clear();
-        m_inputValues.prepend(currentValue);
+        m_inputValues.append(currentValue);
+        m_inputSum = currentValue;
         m_totalDeviation = 0;
         if (!qFuzzyCompare(m_outputValue, normalizedValue)) {
             m_outputValue = currentValue;
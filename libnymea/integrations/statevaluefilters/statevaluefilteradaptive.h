@@ -32,6 +32,7 @@
 #define STATEVALUEFILTERADAPTIVE_H
 
 #include "statevaluefilter.h"
+#include "ringbuffer.h"
 
 class StateValueFilterAdaptive : public StateValueFilter
 {
@@ -45,9 +46,10 @@ private:
     void update();
 
 private:
-    QList<double> m_inputValues;
-
     int m_windowSize = 20;
+    RingBuffer<double> m_inputValues;
+    double m_inputSum = 0;
+
     double m_standardDeviation = 0.05;
     double m_maxTotalDeviation = 0.4;
 
@@ -0,0 +1,66 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "statevaluefilterdeadband.h"
+
+#include <qmath.h>
+
+StateValueFilterDeadband::StateValueFilterDeadband(double absolute, double relative):
+    m_absolute(qAbs(absolute)),
+    m_relative(qAbs(relative))
+{
+
+}
+
+void StateValueFilterDeadband::addValue(const QVariant &value)
+{
+    double inputValue = value.toDouble();
+    if (!m_initialized) {
+        m_outputValue = inputValue;
+        m_initialized = true;
+        return;
+    }
+
+    // Always follow when going to 0 (e.g. turned off)
+    if (qFuzzyCompare(1 + inputValue, 1)) {
+        m_outputValue = inputValue;
+        return;
+    }
+
+    double threshold = qMax(m_absolute, m_relative * qAbs(m_outputValue));
+    if (qAbs(inputValue - m_outputValue) > threshold) {
+        m_outputValue = inputValue;
+    }
+}
+
+QVariant StateValueFilterDeadband::filteredValue() const
+{
+    return m_outputValue;
+}
@@ -0,0 +1,100 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "statevaluefiltermedian.h"
+
+#include <QtMath>
+
+#include <iterator>
+
+StateValueFilterMedian::StateValueFilterMedian(int windowSize):
+    m_inputValues(qMax(1, windowSize))
+{
+
+}
+
+void StateValueFilterMedian::addValue(const QVariant &value)
+{
+    double newValue = value.toDouble();
+    // NaN has no place in an ordered window
+    if (qIsNaN(newValue)) {
+        return;
+    }
+    if (m_inputValues.isFull()) {
+        remove(m_inputValues.oldest());
+    }
+    m_inputValues.append(newValue);
+    insert(newValue);
+
+    // Average the two middle values for even counts
+    if (m_lower.size() > m_upper.size()) {
+        m_outputValue = *m_lower.rbegin();
+    } else {
+        m_outputValue = (*m_lower.rbegin() + *m_upper.begin()) / 2;
+    }
+}
+
+QVariant StateValueFilterMedian::filteredValue() const
+{
+    return m_outputValue;
+}
+
+void StateValueFilterMedian::insert(double value)
+{
+    if (m_lower.empty() || value <= *m_lower.rbegin()) {
+        m_lower.insert(value);
+    } else {
+        m_upper.insert(value);
+    }
+    rebalance();
+}
+
+void StateValueFilterMedian::remove(double value)
+{
+    // Equal values are interchangeable, so any value <= the largest lower one can be taken from m_lower
+    if (value <= *m_lower.rbegin()) {
+        m_lower.erase(m_lower.find(value));
+    } else {
+        m_upper.erase(m_upper.find(value));
+    }
+    rebalance();
+}
+
+void StateValueFilterMedian::rebalance()
+{
+    if (m_lower.size() > m_upper.size() + 1) {
+        std::multiset<double>::iterator largest = std::prev(m_lower.end());
+        m_upper.insert(*largest);
+        m_lower.erase(largest);
+    } else if (m_upper.size() > m_lower.size()) {
+        m_lower.insert(*m_upper.begin());
+        m_upper.erase(m_upper.begin());
+    }
+}
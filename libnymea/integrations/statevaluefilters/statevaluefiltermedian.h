@@ -0,0 +1,62 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STATEVALUEFILTERMEDIAN_H
+#define STATEVALUEFILTERMEDIAN_H
+
+#include "statevaluefilter.h"
+#include "ringbuffer.h"
+
+#include <set>
+
+// Running median over the last windowSize values. Removes single spikes without lagging
+// behind on real steps for more than half the window. The window is kept sorted in two halves,
+// so each new value costs O(log windowSize).
+class StateValueFilterMedian : public StateValueFilter
+{
+public:
+    StateValueFilterMedian(int windowSize = 5);
+
+    void addValue(const QVariant &value) override;
+    QVariant filteredValue() const override;
+
+private:
+    void insert(double value);
+    void remove(double value);
+    void rebalance();
+
+    RingBuffer<double> m_inputValues;
+    // All values in m_lower are <= all values in m_upper, m_lower holds the extra one for odd counts
+    std::multiset<double> m_lower;
+    std::multiset<double> m_upper;
+    double m_outputValue = 0;
+};
+
+#endif // STATEVALUEFILTERMEDIAN_H
@@ -0,0 +1,80 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "statevaluefilterratelimit.h"
+
+StateValueFilterRateLimit::StateValueFilterRateLimit(int minimumInterval, Clock clock):
+    m_minimumInterval(qMax(0, minimumInterval)),
+    m_clock(clock)
+{
+    m_elapsed.start();
+}
+
+void StateValueFilterRateLimit::addValue(const QVariant &value)
+{
+    qint64 currentTime = now();
+    if (m_initialized && currentTime - m_lastUpdate < m_minimumInterval) {
+        m_pendingValue = value;
+        return;
+    }
+    m_initialized = true;
+    m_outputValue = value;
+    m_pendingValue.clear();
+    m_lastUpdate = currentTime;
+}
+
+QVariant StateValueFilterRateLimit::filteredValue() const
+{
+    return m_outputValue;
+}
+
+int StateValueFilterRateLimit::flushDelay() const
+{
+    if (!m_pendingValue.isValid()) {
+        return -1;
+    }
+    return static_cast<int>(qMax<qint64>(0, m_lastUpdate + m_minimumInterval - now()));
+}
+
+bool StateValueFilterRateLimit::flush()
+{
+    if (!m_pendingValue.isValid()) {
+        return false;
+    }
+    m_outputValue = m_pendingValue;
+    m_pendingValue.clear();
+    m_lastUpdate = now();
+    return true;
+}
+
+qint64 StateValueFilterRateLimit::now() const
+{
+    return m_clock ? m_clock() : m_elapsed.elapsed();
+}
@@ -0,0 +1,68 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STATEVALUEFILTERRATELIMIT_H
+#define STATEVALUEFILTERRATELIMIT_H
+
+#include "statevaluefilter.h"
+
+#include <QElapsedTimer>
+
+#include <functional>
+
+// Passes on at most one new value per minimum interval (in ms). The latest value arriving in
+// between is held back and passed on by flush() once the interval has passed.
+class StateValueFilterRateLimit : public StateValueFilter
+{
+public:
+    // Returns a monotonic time in ms, only used to replace the clock in tests
+    typedef std::function<qint64()> Clock;
+
+    StateValueFilterRateLimit(int minimumInterval = 1000, Clock clock = Clock());
+
+    void addValue(const QVariant &value) override;
+    QVariant filteredValue() const override;
+
+    int flushDelay() const override;
+    bool flush() override;
+
+private:
+    qint64 now() const;
+
+    int m_minimumInterval = 1000;
+    Clock m_clock;
+    QElapsedTimer m_elapsed;
+    qint64 m_lastUpdate = 0;
+    bool m_initialized = false;
+    QVariant m_outputValue;
+    QVariant m_pendingValue;
+};
+
+#endif // STATEVALUEFILTERRATELIMIT_H
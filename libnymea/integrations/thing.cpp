@@ -93,6 +93,8 @@
         The thing is in a rule and can not be deleted withou \l{nymeaserver::RuleEngine::RemovePolicy}.
     \value ThingErrorParameterNotWritable
         One of the given thing params is not writable.
+    \value ThingErrorActionSuperseded
+        The action has been dropped before execution because a newer action of the same type has been queued for the thing.
 */
 
 /*! \enum Thing::ThingSetupStatus
@@ -133,9 +135,10 @@
 #include "thing.h"
 #include "types/event.h"
 #include "loggingcategories.h"
-#include "statevaluefilters/statevaluefilteradaptive.h"
+#include "statevaluefilters/statevaluefilter.h"
 
 #include <QJsonDocument>
+#include <QTimer>
 #include <QDebug>
 
 /*! Construct a Thing with the given \a pluginId, \a id, \a thingClassId and \a parent. */
@@ -403,17 +406,10 @@ void Thing::setStateValue(const StateTypeId &stateTypeId, const QVariant &value)
                 filter->addValue(newValue);
                 newValue = filter->filteredValue();
                 newValue.convert(stateType.type());
+                scheduleStateValueFilterFlush(stateTypeId);
             }
 
-            QVariant oldValue = m_states.at(i).value();
-            if (oldValue == newValue) {
-                qCDebug(dcThing()).nospace() << this << ": Discarding state change for " << stateType.name() << " as the value did not actually change. Old value:" << oldValue << "New value:" << newValue;
-                return;
-            }
-
-            qCDebug(dcThing()).nospace() << this << ": State " << stateType.name() << " changed from " << oldValue << " to " << newValue;
-            m_states[i].setValue(newValue);
-            emit stateValueChanged(stateTypeId, newValue, m_states.at(i).minValue(), m_states.at(i).maxValue(), m_states.at(i).possibleValues());
+            updateStateValue(i, stateType, newValue);
             return;
         }
     }
@@ -729,13 +725,55 @@ void Thing::setStateValueFilter(const StateTypeId &stateTypeId, Types::StateValu
             if (stateValueFilter) {
                 delete stateValueFilter;
             }
-            if (filter == Types::StateValueFilterAdaptive) {
-                m_stateValueFilters.insert(stateTypeId, new StateValueFilterAdaptive());
+            StateValueFilter *newFilter = StateValueFilter::create(filter, m_thingClass.stateTypes().findById(stateTypeId).filterSettings());
+            if (newFilter) {
+                m_stateValueFilters.insert(stateTypeId, newFilter);
             }
         }
     }
 }
 
+void Thing::updateStateValue(int index, const StateType &stateType, const QVariant &value)
+{
+    QVariant oldValue = m_states.at(index).value();
+    if (oldValue == value) {
+        qCDebug(dcThing()).nospace() << this << ": Discarding state change for " << stateType.name() << " as the value did not actually change. Old value:" << oldValue << "New value:" << value;
+        return;
+    }
+
+    qCDebug(dcThing()).nospace() << this << ": State " << stateType.name() << " changed from " << oldValue << " to " << value;
+    m_states[index].setValue(value);
+    emit stateValueChanged(stateType.id(), value, m_states.at(index).minValue(), m_states.at(index).maxValue(), m_states.at(index).possibleValues());
+}
+
+void Thing::scheduleStateValueFilterFlush(const StateTypeId &stateTypeId)
+{
+    StateValueFilter *filter = m_stateValueFilters.value(stateTypeId);
+    int delay = filter ? filter->flushDelay() : -1;
+    if (delay < 0 || m_pendingFilterFlushes.contains(stateTypeId)) {
+        return;
+    }
+
+    // Pass on the value a filter held back, so the state doesn't get stuck on an outdated value
+    m_pendingFilterFlushes.insert(stateTypeId);
+    QTimer::singleShot(delay, Qt::PreciseTimer, this, [this, stateTypeId](){
+        m_pendingFilterFlushes.remove(stateTypeId);
+        StateValueFilter *filter = m_stateValueFilters.value(stateTypeId);
+        if (!filter || !filter->flush()) {
+            return;
+        }
+        for (int i = 0; i < m_states.count(); i++) {
+            if (m_states.at(i).stateTypeId() == stateTypeId) {
+                StateType stateType = m_thingClass.stateTypes().findById(stateTypeId);
+                QVariant newValue = filter->filteredValue();
+                newValue.convert(stateType.type());
+                updateStateValue(i, stateType, newValue);
+                return;
+            }
+        }
+    });
+}
+
 Things::Things(const QList<Thing*> &other)
 {
     foreach (Thing* thing, other) {
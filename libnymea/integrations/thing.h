@@ -43,6 +43,7 @@
 #include <QObject>
 #include <QUuid>
 #include <QVariant>
+#include <QSet>
 
 class IntegrationPlugin;
 class StateValueFilter;
@@ -94,6 +95,7 @@ public:
         ThingErrorItemNotExecutable,
         ThingErrorUnsupportedFeature,
         ThingErrorTimeout,
+        ThingErrorActionSuperseded,
     };
     Q_ENUM(ThingError)
 
@@ -191,6 +193,8 @@ private:
     void setLoggedEventTypeIds(const QList<EventTypeId> loggedEventTypeIds);
     void setLoggedActionTypeIds(const QList<ActionTypeId> loggedActionTypeIds);
     void setStateValueFilter(const StateTypeId &stateTypeId, Types::StateValueFilter filter);
+    void updateStateValue(int index, const StateType &stateType, const QVariant &value);
+    void scheduleStateValueFilterFlush(const StateTypeId &stateTypeId);
 
 private:
     ThingClass m_thingClass;
@@ -211,6 +215,7 @@ private:
     QList<EventTypeId> m_loggedEventTypeIds;
     QList<ActionTypeId> m_loggedActionTypeIds;
     QHash<StateTypeId, StateValueFilter*> m_stateValueFilters;
+    QSet<StateTypeId> m_pendingFilterFlushes;
 };
 
 QDebug operator<<(QDebug debug, Thing *device);
@@ -67,6 +67,7 @@ private:
     Action m_action;
 
     bool m_finished = false;
+    quint64 m_timeoutHandle = 0;
     Thing::ThingError m_status = Thing::ThingErrorNoError;
     QString m_displayMessage;
 
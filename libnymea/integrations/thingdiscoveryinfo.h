@@ -73,6 +73,7 @@ private:
     ParamList m_params;
 
     bool m_finished = false;
+    quint64 m_timeoutHandle = 0;
     Thing::ThingError m_status;
     QString m_displayMessage;
     ThingDescriptors m_thingDescriptors;
@@ -112,6 +112,7 @@ protected:
 
 signals:
     void loaded();
+    void pluginActivated(const PluginId &pluginId);
     void pluginConfigChanged(const PluginId &id, const ParamList &config);
     void eventTriggered(const Event &event);
     void thingStateChanged(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue, const QVariantList &possibleValues);
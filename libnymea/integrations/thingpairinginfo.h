@@ -80,6 +80,7 @@ private:
 
     bool m_reconfigure = false;
     bool m_finished = false;
+    quint64 m_timeoutHandle = 0;
     Thing::ThingError m_status = Thing::ThingErrorNoError;
     QString m_displayMessage;
     ThingManager *m_thingManager = nullptr;
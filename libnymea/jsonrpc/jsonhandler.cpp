@@ -187,12 +187,58 @@ void JsonHandler::registerObject(const QMetaObject &metaObject)
 {
     QString className = QString(metaObject.className()).split("::").last();
     QVariantMap description;
+    ObjectDescriptor descriptor;
     for (int i = 0; i < metaObject.propertyCount(); i++) {
         QMetaProperty metaProperty = metaObject.property(i);
         QString name = metaProperty.name();
         if (name == "objectName") {
             continue; // Skip QObject's objectName property
         }
+
+        ObjectDescriptor::Property property;
+        property.metaProperty = metaProperty;
+        property.name = name;
+        property.optional = metaProperty.isUser();
+        property.writable = metaProperty.isWritable();
+        QString propertyTypeName = QString(metaProperty.typeName()).split("::").last();
+        if (metaProperty.isFlagType()) {
+            property.kind = ObjectDescriptor::PropertyKindFlags;
+            property.metaEnum = metaProperty.enumerator();
+        } else if (metaProperty.isEnumType()) {
+            property.kind = ObjectDescriptor::PropertyKindEnum;
+            property.metaEnum = metaProperty.enumerator();
+        } else if (metaProperty.typeName() == QStringLiteral("QVariant::Type")) {
+            property.kind = ObjectDescriptor::PropertyKindBasicType;
+        } else if (metaProperty.type() == QVariant::UserType) {
+            if (propertyTypeName == "QList<int>") {
+                property.kind = ObjectDescriptor::PropertyKindIntList;
+            } else if (propertyTypeName == "QList<QUuid>") {
+                property.kind = ObjectDescriptor::PropertyKindUuidList;
+            } else if (propertyTypeName == "QList<ThingId>") {
+                property.kind = ObjectDescriptor::PropertyKindThingIdList;
+            } else if (propertyTypeName == "QList<EventTypeId>") {
+                property.kind = ObjectDescriptor::PropertyKindEventTypeIdList;
+            } else if (propertyTypeName == "QList<StateTypeId>") {
+                property.kind = ObjectDescriptor::PropertyKindStateTypeIdList;
+            } else if (propertyTypeName == "QList<ActionTypeId>") {
+                property.kind = ObjectDescriptor::PropertyKindActionTypeIdList;
+            } else if (propertyTypeName == "QList<QDateTime>") {
+                property.kind = ObjectDescriptor::PropertyKindDateTimeList;
+            } else if (propertyTypeName.startsWith("QList<")) {
+                property.kind = ObjectDescriptor::PropertyKindUnhandledList;
+                property.typeName = propertyTypeName;
+            } else {
+                // Might be registered later on, resolved when packing
+                property.kind = ObjectDescriptor::PropertyKindObject;
+                property.typeName = propertyTypeName;
+            }
+        } else if (metaProperty.type() == QVariant::DateTime) {
+            property.kind = ObjectDescriptor::PropertyKindDateTime;
+        } else if (metaProperty.type() == QVariant::Time) {
+            property.kind = ObjectDescriptor::PropertyKindTime;
+        }
+        descriptor.properties.append(property);
+
         if (metaProperty.isUser()) {
             name.prepend("o:");
         }
@@ -228,7 +274,12 @@ void JsonHandler::registerObject(const QMetaObject &metaObject)
         description.insert(name, typeName);
     }
     m_objects.insert(className, description);
-    m_metaObjects.insert(className, metaObject);
+
+    int isValidIndex = metaObject.indexOfMethod("isValid()");
+    if (isValidIndex >= 0) {
+        descriptor.isValidMethod = metaObject.method(isValidIndex);
+    }
+    registerDescriptor(className, metaObject, descriptor);
 }
 
 void JsonHandler::registerList(const QMetaObject &listMetaObject, const QMetaObject &metaObject)
@@ -236,12 +287,17 @@ void JsonHandler::registerList(const QMetaObject &listMetaObject, const QMetaObj
     QString listTypeName = QString(listMetaObject.className()).split("::").last();
     QString objectTypeName = QString(metaObject.className()).split("::").last();
     m_objects.insert(listTypeName, QVariantList() << QVariant(QString("$ref:%1").arg(objectTypeName)));
-    m_metaObjects.insert(listTypeName, listMetaObject);
-    m_listMetaObjects.insert(listTypeName, listMetaObject);
-    m_listEntryTypes.insert(listTypeName, objectTypeName);
     Q_ASSERT_X(listMetaObject.indexOfProperty("count") >= 0, "JsonHandler", QString("List type %1 does not implement \"count\" property!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("get(int)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE QVariant get(int index)\" method!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("put(QVariant)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE void put(QVariant variant)\" method!").arg(listTypeName).toUtf8());
+
+    ObjectDescriptor descriptor;
+    descriptor.isList = true;
+    descriptor.entryTypeName = objectTypeName;
+    descriptor.countProperty = listMetaObject.property(listMetaObject.indexOfProperty("count"));
+    descriptor.getMethod = listMetaObject.method(listMetaObject.indexOfMethod("get(int)"));
+    descriptor.putMethod = listMetaObject.method(listMetaObject.indexOfMethod("put(QVariant)"));
+    registerDescriptor(listTypeName, listMetaObject, descriptor);
 }
 
 void JsonHandler::registerObject(const QMetaObject &metaObject, const QMetaObject &listMetaObject)
@@ -250,190 +306,215 @@ void JsonHandler::registerObject(const QMetaObject &metaObject, const QMetaObjec
     registerList(listMetaObject, metaObject);
 }
 
+void JsonHandler::registerDescriptor(const QString &typeName, const QMetaObject &metaObject, const JsonHandler::ObjectDescriptor &descriptor)
+{
+    ObjectDescriptor completeDescriptor = descriptor;
+    completeDescriptor.className = metaObject.className();
+    completeDescriptor.typeId = QMetaType::type(metaObject.className());
+    m_descriptors.insert(typeName, completeDescriptor);
+    QString className = QString::fromUtf8(completeDescriptor.className);
+    if (typeName != className) {
+        m_descriptors.insert(className, completeDescriptor);
+    }
+}
+
+const JsonHandler::ObjectDescriptor *JsonHandler::descriptor(const QString &typeName) const
+{
+    QHash<QString, ObjectDescriptor>::const_iterator it = m_descriptors.constFind(typeName);
+    if (it == m_descriptors.constEnd()) {
+        return nullptr;
+    }
+    return &it.value();
+}
+
 QVariant JsonHandler::pack(const QMetaObject &metaObject, const void *value) const
 {
-    QString className = QString(metaObject.className()).split("::").last();
-    if (m_listMetaObjects.contains(className)) {
+    const ObjectDescriptor *objectDescriptor = descriptor(metaObject.className());
+    if (!objectDescriptor) {
+        Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered object type: %1").arg(metaObject.className()).toUtf8());
+        qCWarning(dcJsonRpc()) << "Cannot pack object of unregistered type" << metaObject.className();
+        return QVariant();
+    }
+    return pack(*objectDescriptor, value);
+}
+
+QVariant JsonHandler::pack(const ObjectDescriptor &descriptor, const void *value) const
+{
+    if (descriptor.isList) {
+        const ObjectDescriptor *entryDescriptor = this->descriptor(descriptor.entryTypeName);
+        Q_ASSERT_X(entryDescriptor, this->metaObject()->className(), QString("Unregistered object type: %1").arg(descriptor.entryTypeName).toUtf8());
+        if (!entryDescriptor) {
+            qCWarning(dcJsonRpc()) << "Cannot pack list entries of unregistered type" << descriptor.entryTypeName;
+            return QVariantList();
+        }
+        int count = descriptor.countProperty.readOnGadget(value).toInt();
         QVariantList ret;
-        QMetaProperty countProperty = metaObject.property(metaObject.indexOfProperty("count"));
-        QMetaObject entryMetaObject = m_metaObjects.value(m_listEntryTypes.value(className));
-        int count = countProperty.readOnGadget(value).toInt();
-        QMetaMethod getMethod = metaObject.method(metaObject.indexOfMethod("get(int)"));
+        ret.reserve(count);
         for (int i = 0; i < count; i++) {
             QVariant entry;
-            getMethod.invokeOnGadget(const_cast<void*>(value), Q_RETURN_ARG(QVariant, entry), Q_ARG(int, i));
-            ret.append(pack(entryMetaObject, entry.data()));
+            descriptor.getMethod.invokeOnGadget(const_cast<void*>(value), Q_RETURN_ARG(QVariant, entry), Q_ARG(int, i));
+            ret.append(pack(*entryDescriptor, entry.data()));
         }
         return ret;
     }
 
-    if (m_metaObjects.contains(className)) {
-        QVariantMap ret;
-        for (int i = 0; i < metaObject.propertyCount(); i++) {
-            QMetaProperty metaProperty = metaObject.property(i);
+    QVariantMap ret;
+    foreach (const ObjectDescriptor::Property &property, descriptor.properties) {
+        QVariant propertyValue = property.metaProperty.readOnGadget(value);
+        // If it's optional and empty, we may skip it
+        if (property.optional && (!propertyValue.isValid() || propertyValue.isNull())) {
+            continue;
+        }
 
-            // Skip QObject's objectName property
-            if (metaProperty.name() == QStringLiteral("objectName")) {
-                continue;
+        switch (property.kind) {
+        case ObjectDescriptor::PropertyKindFlags: {
+            int flagValue = propertyValue.toInt();
+            QStringList flags;
+            for (int i = 0; i < property.metaEnum.keyCount(); i++) {
+                int flag = property.metaEnum.value(i) & flagValue;
+                if (flag == property.metaEnum.value(i) && flag > 0) {
+                    flags.append(property.metaEnum.key(i));
+                }
             }
-
-            QVariant propertyValue = metaProperty.readOnGadget(value);
-            // If it's optional and empty, we may skip it
-            if (metaProperty.isUser() && (!propertyValue.isValid() || propertyValue.isNull())) {
-                continue;
+            ret.insert(property.name, flags);
+            break;
+        }
+        case ObjectDescriptor::PropertyKindEnum:
+            // Look up the key by value. Packing used to take the value as index into the key list,
+            // which only gave the right key for enums numbered 0, 1, 2... without gaps.
+            ret.insert(property.name, property.metaEnum.valueToKey(propertyValue.toInt()));
+            break;
+        case ObjectDescriptor::PropertyKindBasicType:
+            ret.insert(property.name, enumValueName(variantTypeToBasicType(propertyValue.template value<QVariant::Type>())));
+            break;
+        case ObjectDescriptor::PropertyKindObject: {
+            const ObjectDescriptor *propertyDescriptor = this->descriptor(property.typeName);
+            if (!propertyDescriptor) {
+                Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered property type: %1").arg(property.typeName).toUtf8());
+                qCWarning(dcJsonRpc()) << "Cannot pack property of unregistered object type" << property.typeName;
+                break;
             }
-
-            // Pack flags
-            if (metaProperty.isFlagType()) {
-                QString flagName = QString(metaProperty.typeName()).split("::").last();
-                Q_ASSERT_X(m_metaFlags.contains(flagName), this->metaObject()->className(), QString("Cannot pack %1. %2 is not registered in this handler.").arg(className).arg(flagName).toUtf8());
-                QMetaEnum metaFlag = m_metaFlags.value(flagName);
-                int flagValue = propertyValue.toInt();
-                QStringList flags;
-                for (int i = 0; i < metaFlag.keyCount(); i++) {
-                    int flag = metaFlag.value(i) & flagValue;
-                    if (flag == metaFlag.value(i) && flag > 0) {
-                        flags.append(metaFlag.key(i));
-                    }
+            if (propertyDescriptor->isList) {
+                QVariant packed = pack(*propertyDescriptor, propertyValue.data());
+                if (!property.optional || packed.toList().count() > 0) {
+                    ret.insert(property.name, packed);
                 }
-                ret.insert(metaProperty.name(), flags);
-                continue;
-            }
-
-            // Pack enums
-            if (metaProperty.isEnumType()) {
-                QString enumName = QString(metaProperty.typeName()).split("::").last();
-                Q_ASSERT_X(m_metaEnums.contains(enumName), this->metaObject()->className(), QString("Cannot pack %1. %2 is not registered in this handler.").arg(className).arg(metaProperty.typeName()).toUtf8());
-                QMetaEnum metaEnum = m_metaEnums.value(enumName);
-                ret.insert(metaProperty.name(), metaEnum.key(propertyValue.toInt()));
-                continue;
+                break;
             }
-
-            // Basic type/Variant type
-            if (metaProperty.typeName() == QStringLiteral("QVariant::Type")) {
-                QMetaEnum metaEnum = QMetaEnum::fromType<BasicType>();
-                ret.insert(metaProperty.name(), metaEnum.key(variantTypeToBasicType(propertyValue.template value<QVariant::Type>())));
-                continue;
+            if (property.optional && propertyDescriptor->isValidMethod.isValid()) {
+                bool isValid = true;
+                propertyDescriptor->isValidMethod.invokeOnGadget(propertyValue.data(), Q_RETURN_ARG(bool, isValid));
+                if (!isValid) {
+                    break;
+                }
             }
-
-            // Our own objects
-            if (metaProperty.type() == QVariant::UserType) {
-                QString propertyTypeName = QString(metaProperty.typeName()).split("::").last();
-                if (m_listMetaObjects.contains(propertyTypeName)) {
-                    QMetaObject entryMetaObject = m_listMetaObjects.value(propertyTypeName);
-                    QVariant packed = pack(entryMetaObject, propertyValue.data());
-                    if (!metaProperty.isUser() || packed.toList().count() > 0) {
-                        ret.insert(metaProperty.name(), packed);
-                    }
-                    continue;
+            ret.insert(property.name, pack(*propertyDescriptor, propertyValue.data()));
+            break;
+        }
+        case ObjectDescriptor::PropertyKindIntList:
+        case ObjectDescriptor::PropertyKindUuidList:
+        case ObjectDescriptor::PropertyKindThingIdList:
+        case ObjectDescriptor::PropertyKindEventTypeIdList:
+        case ObjectDescriptor::PropertyKindStateTypeIdList:
+        case ObjectDescriptor::PropertyKindActionTypeIdList:
+        case ObjectDescriptor::PropertyKindDateTimeList:
+        case ObjectDescriptor::PropertyKindUnhandledList: {
+            // Manually converting QList<BasicType>... Only QVariantList is known to the meta system
+            QVariantList list;
+            switch (property.kind) {
+            case ObjectDescriptor::PropertyKindIntList:
+                foreach (int entry, propertyValue.value<QList<int>>()) {
+                    list << entry;
                 }
-
-                if (m_metaObjects.contains(propertyTypeName)) {
-                    QMetaObject entryMetaObject = m_metaObjects.value(propertyTypeName);
-                    QVariant packed = pack(entryMetaObject, propertyValue.data());
-                    int isValidIndex = entryMetaObject.indexOfMethod("isValid()");
-                    bool isValid = true;
-                    if (isValidIndex >= 0) {
-                        QMetaMethod isValidMethod = entryMetaObject.method(isValidIndex);
-                        isValidMethod.invokeOnGadget(propertyValue.data(), Q_RETURN_ARG(bool, isValid));
-                    }
-                    if (isValid || !metaProperty.isUser()) {
-                        ret.insert(metaProperty.name(), packed);
-                    }
-                    continue;
+                break;
+            case ObjectDescriptor::PropertyKindUuidList:
+                foreach (const QUuid &entry, propertyValue.value<QList<QUuid>>()) {
+                    list << entry;
                 }
-
-                // Manually converting QList<BasicType>... Only QVariantList is known to the meta system
-                if (propertyTypeName.startsWith("QList<")) {
-                    QVariantList list;
-                    if (propertyTypeName == "QList<int>") {
-                        foreach (int entry, propertyValue.value<QList<int>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<QUuid>") {
-                        foreach (const QUuid &entry, propertyValue.value<QList<QUuid>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<ThingId>") {
-                        foreach (const ThingId &entry, propertyValue.value<QList<ThingId>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<EventTypeId>") {
-                        foreach (const EventTypeId &entry, propertyValue.value<QList<EventTypeId>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<StateTypeId>") {
-                        foreach (const EventTypeId &entry, propertyValue.value<QList<StateTypeId>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<ActionTypeId>") {
-                        foreach (const EventTypeId &entry, propertyValue.value<QList<ActionTypeId>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<QDateTime>") {
-                        foreach (const QDateTime &timestamp, propertyValue.value<QList<QDateTime>>()) {
-                            list << timestamp.toMSecsSinceEpoch() / 1000;
-                        }
-                    } else {
-                        Q_ASSERT_X(false, this->metaObject()->className(), QString("Unhandled list type: %1").arg(propertyTypeName).toUtf8());
-                        qCWarning(dcJsonRpc()) << "Cannot pack property of unhandled list type" << propertyTypeName;
-                    }
-
-                    if (!list.isEmpty() || !metaProperty.isUser()) {
-                        ret.insert(metaProperty.name(), list);
-                    }
-                    continue;
+                break;
+            case ObjectDescriptor::PropertyKindThingIdList:
+                foreach (const ThingId &entry, propertyValue.value<QList<ThingId>>()) {
+                    list << entry;
                 }
-
-                Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered property type: %1").arg(propertyTypeName).toUtf8());
-                qCWarning(dcJsonRpc()) << "Cannot pack property of unregistered object type" << propertyTypeName;
-                continue;
+                break;
+            case ObjectDescriptor::PropertyKindEventTypeIdList:
+                foreach (const EventTypeId &entry, propertyValue.value<QList<EventTypeId>>()) {
+                    list << entry;
+                }
+                break;
+            case ObjectDescriptor::PropertyKindStateTypeIdList:
+                foreach (const StateTypeId &entry, propertyValue.value<QList<StateTypeId>>()) {
+                    list << entry;
+                }
+                break;
+            case ObjectDescriptor::PropertyKindActionTypeIdList:
+                foreach (const ActionTypeId &entry, propertyValue.value<QList<ActionTypeId>>()) {
+                    list << entry;
+                }
+                break;
+            case ObjectDescriptor::PropertyKindDateTimeList:
+                foreach (const QDateTime &timestamp, propertyValue.value<QList<QDateTime>>()) {
+                    list << timestamp.toMSecsSinceEpoch() / 1000;
+                }
+                break;
+            default:
+                Q_ASSERT_X(false, this->metaObject()->className(), QString("Unhandled list type: %1").arg(property.typeName).toUtf8());
+                qCWarning(dcJsonRpc()) << "Cannot pack property of unhandled list type" << property.typeName;
+                break;
             }
 
-            // Standard properties, QString, int etc...
+            if (!list.isEmpty() || !property.optional) {
+                ret.insert(property.name, list);
+            }
+            break;
+        }
+        case ObjectDescriptor::PropertyKindDateTime: {
             // Special treatment for QDateTime (converting to time_t)
-            if (metaProperty.type() == QVariant::DateTime) {
-                QDateTime dateTime = propertyValue.toDateTime();
-                if (metaProperty.isUser() && dateTime.toTime_t() == 0) {
-                    continue;
-                }
-                propertyValue = propertyValue.toDateTime().toTime_t();
-            } else if (metaProperty.type() == QVariant::Time) {
-                propertyValue = propertyValue.toTime().toString("hh:mm");
+            QDateTime dateTime = propertyValue.toDateTime();
+            if (property.optional && dateTime.toTime_t() == 0) {
+                break;
             }
-            ret.insert(metaProperty.name(), propertyValue);
+            ret.insert(property.name, dateTime.toTime_t());
+            break;
+        }
+        case ObjectDescriptor::PropertyKindTime:
+            ret.insert(property.name, propertyValue.toTime().toString("hh:mm"));
+            break;
+        case ObjectDescriptor::PropertyKindValue:
+            // Standard properties, QString, int etc...
+            ret.insert(property.name, propertyValue);
+            break;
         }
-        return ret;
     }
-
-    Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered object type: %1").arg(className).toUtf8());
-    qCWarning(dcJsonRpc()) << "Cannot pack object of unregistered type" << className;
-    return QVariant();    
+    return ret;
 }
 
 QVariant JsonHandler::unpack(const QMetaObject &metaObject, const QVariant &value) const
 {
-    QString typeName = QString(metaObject.className()).split("::").last();
+    const ObjectDescriptor *objectDescriptor = descriptor(metaObject.className());
+    if (!objectDescriptor) {
+        return QVariant();
+    }
+    return unpack(*objectDescriptor, value);
+}
+
+QVariant JsonHandler::unpack(const ObjectDescriptor &descriptor, const QVariant &value) const
+{
+    // Uncreatable objects might get registered to the meta type system after the handler registered them
+    int typeId = descriptor.typeId != 0 ? descriptor.typeId : QMetaType::type(descriptor.className);
+    Q_ASSERT_X(typeId != 0, this->metaObject()->className(), QString("Cannot handle unregistered meta type %1").arg(QString(descriptor.className)).toUtf8());
 
     // If it's a list object, loop over count
-    if (m_listMetaObjects.contains(typeName)) {
+    if (descriptor.isList) {
         if (value.type() != QVariant::List) {
-//            qCWarning(dcJsonRpc()) << "Cannot unpack" << typeName << ". Value is not in list format:" << value;
             return QVariant();
         }
 
-        QVariantList list = value.toList();
-
-        int typeId = QMetaType::type(metaObject.className());
+        const ObjectDescriptor *entryDescriptor = this->descriptor(descriptor.entryTypeName);
         void* ptr = QMetaType::create(typeId);
-        Q_ASSERT_X(typeId != 0, this->metaObject()->className(), QString("Cannot handle unregistered meta type %1").arg(metaObject.className()).toUtf8());
-
-        QMetaObject entryMetaObject = m_metaObjects.value(m_listEntryTypes.value(typeName));
-        QMetaMethod putMethod = metaObject.method(metaObject.indexOfMethod("put(QVariant)"));
-
-        foreach (const QVariant &variant, list) {
-            QVariant value = unpack(entryMetaObject, variant);
-            putMethod.invokeOnGadget(ptr, Q_ARG(QVariant, value));
+        foreach (const QVariant &variant, value.toList()) {
+            QVariant entry = entryDescriptor ? unpack(*entryDescriptor, variant) : QVariant();
+            descriptor.putMethod.invokeOnGadget(ptr, Q_ARG(QVariant, entry));
         }
 
         QVariant ret = QVariant(typeId, ptr);
@@ -442,79 +523,70 @@ QVariant JsonHandler::unpack(const QMetaObject &metaObject, const QVariant &valu
     }
 
     // if it's an object, loop over all properties
-    if (m_metaObjects.contains(typeName)) {
-        QVariantMap map = value.toMap();
-        int typeId = QMetaType::type(metaObject.className());
-        Q_ASSERT_X(typeId != 0, this->metaObject()->className(), QString("Cannot handle unregistered meta type %1").arg(typeName).toUtf8());
-        void* ptr = QMetaType::create(typeId);
-        for (int i = 0; i < metaObject.propertyCount(); i++) {
-            QMetaProperty metaProperty = metaObject.property(i);
-            if (metaProperty.name() == QStringLiteral("objectName")) {
-                continue;
-            }
-            if (!metaProperty.isWritable()) {
-                continue;
+    QVariantMap map = value.toMap();
+    void* ptr = QMetaType::create(typeId);
+    foreach (const ObjectDescriptor::Property &property, descriptor.properties) {
+        if (!property.writable) {
+            continue;
+        }
+        if (!property.optional) {
+            Q_ASSERT_X(map.contains(property.name), this->metaObject()->className(), QString("Missing property %1 in map.").arg(property.name).toUtf8());
+        }
+
+        QVariantMap::const_iterator it = map.constFind(property.name);
+        if (it == map.constEnd()) {
+            continue;
+        }
+        QVariant variant = it.value();
+
+        switch (property.kind) {
+        case ObjectDescriptor::PropertyKindObject: {
+            // recurse into child objects and lists
+            const ObjectDescriptor *propertyDescriptor = this->descriptor(property.typeName);
+            if (propertyDescriptor) {
+                property.metaProperty.writeOnGadget(ptr, unpack(*propertyDescriptor, variant));
+            } else {
+                property.metaProperty.writeOnGadget(ptr, variant);
             }
-            if (!metaProperty.isUser()) {
-                Q_ASSERT_X(map.contains(metaProperty.name()), this->metaObject()->className(), QString("Missing property %1 in map.").arg(metaProperty.name()).toUtf8());
+            break;
+        }
+        case ObjectDescriptor::PropertyKindIntList: {
+            QList<int> intList;
+            foreach (const QVariant &val, variant.toList()) {
+                intList.append(val.toInt());
             }
-
-            if (map.contains(metaProperty.name())) {
-
-                QString propertyTypeName = QString(metaProperty.typeName()).split("::").last();
-                QVariant variant = map.value(metaProperty.name());
-
-                // recurse into child lists
-                if (m_listMetaObjects.contains(propertyTypeName)) {
-                    QMetaObject propertyMetaObject = m_listMetaObjects.value(propertyTypeName);
-                    metaProperty.writeOnGadget(ptr, unpack(propertyMetaObject, variant));
-                    continue;
-                }
-
-                // recurse into child objects
-                if (m_metaObjects.contains(propertyTypeName)) {
-                    QMetaObject propertyMetaObject = m_metaObjects.value(propertyTypeName);
-                    metaProperty.writeOnGadget(ptr, unpack(propertyMetaObject, variant));
-                    continue;
-                }
-
-                if (QString(metaProperty.typeName()).startsWith("QList<")) {
-                    if (metaProperty.typeName() == QStringLiteral("QList<int>")) {
-                        QList<int> intList;
-                        foreach (const QVariant &val, variant.toList()) {
-                            intList.append(val.toInt());
-                        }
-                        metaProperty.writeOnGadget(ptr, QVariant::fromValue(intList));
-                    } else if (metaProperty.typeName() == QStringLiteral("QList<QUuid>")
-                               || metaProperty.typeName() == QStringLiteral("QList<ThingId>")
-                               || metaProperty.typeName() == QStringLiteral("QList<EventTypeId>")
-                               || metaProperty.typeName() == QStringLiteral("QList<StateTypeId>")
-                               || metaProperty.typeName() == QStringLiteral("QList<ActionTypeId>")) {
-                        QList<QUuid> uuidList;
-                        foreach (const QVariant &val, variant.toList()) {
-                            uuidList.append(val.toUuid());
-                        }
-                        metaProperty.writeOnGadget(ptr, QVariant::fromValue(uuidList));
-                    }
-                    continue;
-                }
-
-                // Special treatment for QDateTime (convert from time_t)
-                if (metaProperty.type() == QVariant::DateTime) {
-                    variant = QDateTime::fromTime_t(variant.toUInt());
-                } else if (metaProperty.type() == QVariant::Time) {
-                    variant = QTime::fromString(variant.toString(), "hh:mm");
-                }
-
-                // For basic properties just write the veriant as is
-                metaProperty.writeOnGadget(ptr, variant);
+            property.metaProperty.writeOnGadget(ptr, QVariant::fromValue(intList));
+            break;
+        }
+        case ObjectDescriptor::PropertyKindUuidList:
+        case ObjectDescriptor::PropertyKindThingIdList:
+        case ObjectDescriptor::PropertyKindEventTypeIdList:
+        case ObjectDescriptor::PropertyKindStateTypeIdList:
+        case ObjectDescriptor::PropertyKindActionTypeIdList: {
+            QList<QUuid> uuidList;
+            foreach (const QVariant &val, variant.toList()) {
+                uuidList.append(val.toUuid());
             }
-
+            property.metaProperty.writeOnGadget(ptr, QVariant::fromValue(uuidList));
+            break;
+        }
+        case ObjectDescriptor::PropertyKindDateTimeList:
+        case ObjectDescriptor::PropertyKindUnhandledList:
+            break;
+        case ObjectDescriptor::PropertyKindDateTime:
+            // Special treatment for QDateTime (convert from time_t)
+            property.metaProperty.writeOnGadget(ptr, QDateTime::fromTime_t(variant.toUInt()));
+            break;
+        case ObjectDescriptor::PropertyKindTime:
+            property.metaProperty.writeOnGadget(ptr, QTime::fromString(variant.toString(), "hh:mm"));
+            break;
+        default:
+            // For basic properties just write the veriant as is
+            property.metaProperty.writeOnGadget(ptr, variant);
+            break;
         }
-        QVariant ret = QVariant(typeId, ptr);
-        QMetaType::destroy(typeId, ptr);
-        return ret;
     }
-
-    return QVariant();
+    QVariant ret = QVariant(typeId, ptr);
+    QMetaType::destroy(typeId, ptr);
+    return ret;
 }
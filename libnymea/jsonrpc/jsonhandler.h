@@ -120,12 +120,65 @@ protected:
     JsonReply *createAsyncReply(const QString &method) const;
 
 private:
+    // Reflection data of a registered object or list type, collected once at registration time
+    class ObjectDescriptor {
+    public:
+        enum PropertyKind {
+            PropertyKindValue,
+            PropertyKindDateTime,
+            PropertyKindTime,
+            PropertyKindEnum,
+            PropertyKindFlags,
+            PropertyKindBasicType,
+            PropertyKindObject,
+            PropertyKindIntList,
+            PropertyKindUuidList,
+            PropertyKindThingIdList,
+            PropertyKindEventTypeIdList,
+            PropertyKindStateTypeIdList,
+            PropertyKindActionTypeIdList,
+            PropertyKindDateTimeList,
+            PropertyKindUnhandledList
+        };
+
+        class Property {
+        public:
+            QMetaProperty metaProperty;
+            QString name;
+            PropertyKind kind = PropertyKindValue;
+            // The registered object or list type name for PropertyKindObject
+            QString typeName;
+            QMetaEnum metaEnum;
+            bool optional = false;
+            bool writable = false;
+        };
+
+        QByteArray className;
+        int typeId = 0;
+
+        // Objects
+        QList<Property> properties;
+        QMetaMethod isValidMethod;
+
+        // Lists
+        bool isList = false;
+        QString entryTypeName;
+        QMetaProperty countProperty;
+        QMetaMethod getMethod;
+        QMetaMethod putMethod;
+    };
+
     void registerObject(const QMetaObject &metaObject);
     void registerList(const QMetaObject &listObject, const QMetaObject &metaObject);
     void registerObject(const QMetaObject &metaObject, const QMetaObject &listMetaObject);
 
+    void registerDescriptor(const QString &typeName, const QMetaObject &metaObject, const ObjectDescriptor &descriptor);
+    const ObjectDescriptor *descriptor(const QString &typeName) const;
+
     QVariant pack(const QMetaObject &metaObject, const void *gadget) const;
+    QVariant pack(const ObjectDescriptor &descriptor, const void *gadget) const;
     QVariant unpack(const QMetaObject &metaObject, const QVariant &value) const;
+    QVariant unpack(const ObjectDescriptor &descriptor, const QVariant &value) const;
 
 private:
     QVariantMap m_enums;
@@ -134,9 +187,8 @@ private:
     QHash<QString, QMetaEnum> m_metaFlags;
     QHash<QString, QString> m_flagsEnums;
     QVariantMap m_objects;
-    QHash<QString, QMetaObject> m_metaObjects;
-    QHash<QString, QMetaObject> m_listMetaObjects;
-    QHash<QString, QString> m_listEntryTypes;
+    // Keyed by the type name and, for namespaced types, by the full class name too
+    QHash<QString, ObjectDescriptor> m_descriptors;
     QVariantMap m_methods;
     QVariantMap m_notifications;
 };
@@ -212,7 +264,6 @@ void JsonHandler::registerList(BasicTypeName typeName)
 {
     QMetaObject listMetaObject = ListType::staticMetaObject;
     QString listTypeName = QString(listMetaObject.className()).split("::").last();
-    m_metaObjects.insert(listTypeName, listMetaObject);
     m_objects.insert(listTypeName, QVariantList() << QVariant(QString("$ref:%1").arg(enumValueName(typeName))));
     Q_ASSERT_X(listMetaObject.indexOfProperty("count") >= 0, "JsonHandler", QString("List type %1 does not implement \"count\" property!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("get(int)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE QVariant get(int index)\" method!").arg(listTypeName).toUtf8());
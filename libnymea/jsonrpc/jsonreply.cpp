@@ -151,3 +151,18 @@ bool JsonReply::timedOut() const
 {
     return m_timedOut;
 }
+
+/*! Returns the cache key of this \l{JsonReply}. Empty unless set with \l{setCacheKey()}. */
+QString JsonReply::cacheKey() const
+{
+    return m_cacheKey;
+}
+
+/*! Marks the data of this synchronous \l{JsonReply} as cacheable. All replies with the same \a cacheKey
+    must carry the same data, so the server can keep their serialized form and reuse it. The key has to
+    change whenever the data changes.
+*/
+void JsonReply::setCacheKey(const QString &cacheKey)
+{
+    m_cacheKey = cacheKey;
+}
@@ -65,6 +65,9 @@ public:
 
     bool timedOut() const;
 
+    QString cacheKey() const;
+    void setCacheKey(const QString &cacheKey);
+
 public slots:
     void startWait();
 
@@ -84,6 +87,7 @@ private:
     QUuid m_clientId;
     int m_commandId;
     bool m_timedOut;
+    QString m_cacheKey;
 
     QTimer m_timeout;
 
@@ -145,6 +145,7 @@ SOURCES += \
     integrations/browseractioninfo.cpp \
     integrations/browseritemactioninfo.cpp \
     integrations/browseritemresult.cpp \
+    integrations/infotimeoutwheel.cpp \
     integrations/integrationplugin.cpp \
     integrations/ioconnection.cpp \
     integrations/pluginmetadata.cpp \
@@ -160,6 +161,10 @@ SOURCES += \
     integrations/servicedata.cpp \
     integrations/statevaluefilters/statevaluefilter.cpp \
     integrations/statevaluefilters/statevaluefilteradaptive.cpp \
+    integrations/statevaluefilters/statevaluefilterdeadband.cpp \
+    integrations/statevaluefilters/statevaluefilterema.cpp \
+    integrations/statevaluefilters/statevaluefiltermedian.cpp \
+    integrations/statevaluefilters/statevaluefilterratelimit.cpp \
     jsonrpc/jsoncontext.cpp \
     jsonrpc/jsonhandler.cpp \
     jsonrpc/jsonreply.cpp \
@@ -265,6 +270,10 @@ for(header, HEADERS) {
     eval(INSTALLS *= headers_$${path})
 }
 
+# internal headers, not installed
+HEADERS += \
+    integrations/infotimeoutwheel.h \
+
 # define install target
 target.path = $$[QT_INSTALL_LIBS]
 INSTALLS += target
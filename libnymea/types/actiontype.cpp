@@ -111,6 +111,19 @@ void ActionType::setParamTypes(const ParamTypes &paramTypes)
     m_paramTypes = paramTypes;
 }
 
+/*! Returns true if \l{Action}{Actions} of this \l{ActionType} may be coalesced. While such an action is being
+ *  executed, only the most recent further action is kept pending and older pending ones are superseded. */
+bool ActionType::coalesce() const
+{
+    return m_coalesce;
+}
+
+/*! Set whether \l{Action}{Actions} of this \l{ActionType} may be coalesced to \a coalesce. */
+void ActionType::setCoalesce(bool coalesce)
+{
+    m_coalesce = coalesce;
+}
+
 ActionTypes::ActionTypes(const QList<ActionType> &other)
 {
     foreach (const ActionType &at, other) {
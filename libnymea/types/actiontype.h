@@ -63,12 +63,16 @@ public:
     ParamTypes paramTypes() const;
     void setParamTypes(const ParamTypes &paramTypes);
 
+    bool coalesce() const;
+    void setCoalesce(bool coalesce);
+
 private:
     ActionTypeId m_id;
     QString m_name;
     QString m_displayName;
     int m_index;
     ParamTypes m_paramTypes;
+    bool m_coalesce = false;
 };
 Q_DECLARE_METATYPE(ActionType)
 
@@ -238,6 +238,19 @@ void StateType::setFilter(Types::StateValueFilter filter)
     m_filter = filter;
 }
 
+/*! Returns the settings for the filter of this StateType, e.g. the "alpha" of an EMA filter.
+    Filters use their defaults for any setting not given here. */
+QVariantMap StateType::filterSettings() const
+{
+    return m_filterSettings;
+}
+
+/*! Sets the settings for the filter of this StateType to \a filterSettings. */
+void StateType::setFilterSettings(const QVariantMap &filterSettings)
+{
+    m_filterSettings = filterSettings;
+}
+
 /*! Returns true if this state type has an ID, a type and a name set. */
 bool StateType::isValid() const
 {
@@ -103,6 +103,9 @@ public:
     Types::StateValueFilter filter() const;
     void setFilter(Types::StateValueFilter filter);
 
+    QVariantMap filterSettings() const;
+    void setFilterSettings(const QVariantMap &filterSettings);
+
     bool isValid() const;
 
 private:
@@ -122,6 +125,7 @@ private:
     bool m_cached = true;
     bool m_logged = false;
     Types::StateValueFilter m_filter = Types::StateValueFilterNone;
+    QVariantMap m_filterSettings;
 };
 Q_DECLARE_METATYPE(StateType)
 
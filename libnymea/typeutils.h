@@ -181,7 +181,11 @@ public:
 
     enum StateValueFilter {
         StateValueFilterNone,
-        StateValueFilterAdaptive
+        StateValueFilterAdaptive,
+        StateValueFilterEma,
+        StateValueFilterMedian,
+        StateValueFilterDeadband,
+        StateValueFilterRateLimit
     };
     Q_ENUM(StateValueFilter)
 
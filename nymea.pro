@@ -11,9 +11,9 @@ isEmpty(NYMEA_VERSION) {
 
 # define protocol versions
 JSON_PROTOCOL_VERSION_MAJOR=8
-JSON_PROTOCOL_VERSION_MINOR=1
+JSON_PROTOCOL_VERSION_MINOR=2
 JSON_PROTOCOL_VERSION="$${JSON_PROTOCOL_VERSION_MAJOR}.$${JSON_PROTOCOL_VERSION_MINOR}"
-LIBNYMEA_API_VERSION_MAJOR=8
+LIBNYMEA_API_VERSION_MAJOR=9
 LIBNYMEA_API_VERSION_MINOR=0
 LIBNYMEA_API_VERSION_PATCH=0
 LIBNYMEA_API_VERSION="$${LIBNYMEA_API_VERSION_MAJOR}.$${LIBNYMEA_API_VERSION_MINOR}.$${LIBNYMEA_API_VERSION_PATCH}"
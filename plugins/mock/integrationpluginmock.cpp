@@ -572,9 +572,9 @@ void IntegrationPluginMock::browserItem(BrowserItemResult *result)
 void IntegrationPluginMock::executeAction(ThingActionInfo *info)
 {
     if (info->thing()->thingClassId() == mockThingClassId) {
-        if (info->action().actionTypeId() == mockAsyncActionTypeId || info->action().actionTypeId() == mockAsyncFailingActionTypeId) {
+        if (info->action().actionTypeId() == mockAsyncActionTypeId || info->action().actionTypeId() == mockAsyncFailingActionTypeId || info->action().actionTypeId() == mockAsyncCoalescingActionTypeId) {
             QTimer::singleShot(1000, info->thing(), [this, info](){
-                if (info->action().actionTypeId() == mockAsyncActionTypeId) {
+                if (info->action().actionTypeId() == mockAsyncActionTypeId || info->action().actionTypeId() == mockAsyncCoalescingActionTypeId) {
                     m_daemons.value(info->thing())->actionExecuted(info->action().actionTypeId());
                     info->finish(Thing::ThingErrorNoError);
                 } else if (info->action().actionTypeId() == mockAsyncFailingActionTypeId) {
@@ -1,19 +1,33 @@
 TEMPLATE = subdirs
 
 SUBDIRS = \
+        clientsendqueue \
         configurations \
+        infotimeoutwheel \
         integrations \
         ioconnections \
+        jsonframer \
+        jsonhandler \
         jsonrpc \
+        jsonvalidator \
+        lazypluginloading \
         logging \
         macaddress \
         mqttbroker \
+        mqtttopictrie \
+        plugininfocache \
         plugins \
         pythonplugins \
         rules \
         scripts \
+        staticfilecache \
+        statevaluefilters \
+        streamcompressor \
         tags \
+        tcpserver \
+        thingsetupscheduler \
         timemanager \
+        tlshandshaker \
         userloading \
         usermanager \
         versioning \
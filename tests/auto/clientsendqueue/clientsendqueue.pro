@@ -0,0 +1,6 @@
+TARGET = nymeatestclientsendqueue
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testclientsendqueue.cpp
@@ -0,0 +1,189 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "jsonrpc/clientsendqueue.h"
+
+using namespace nymeaserver;
+
+class TestClientSendQueue: public NymeaTestBase
+{
+    Q_OBJECT
+
+protected slots:
+    void initTestCase();
+
+private slots:
+    void repliesFirst();
+    void coalesceNotifications();
+    void dropOldNotifications();
+    void overBudget();
+    void keysAfterDequeue();
+
+    void takeNextManyKeys();
+};
+
+void TestClientSendQueue::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+void TestClientSendQueue::repliesFirst()
+{
+    ClientSendQueue queue;
+    queue.enqueue("n1", ClientSendQueue::PriorityNotification);
+    queue.enqueue("r1", ClientSendQueue::PriorityReply);
+    queue.enqueue("n2", ClientSendQueue::PriorityNotification);
+    queue.enqueue("r2", ClientSendQueue::PriorityReply);
+    QCOMPARE(queue.queuedBytes(), qint64(8));
+    QCOMPARE(queue.queuedReplies(), 2);
+    QCOMPARE(queue.queuedNotifications(), 2);
+
+    QCOMPARE(queue.takeNext(), QByteArray("r1"));
+    QCOMPARE(queue.takeNext(), QByteArray("r2"));
+    QCOMPARE(queue.takeNext(), QByteArray("n1"));
+    QCOMPARE(queue.takeNext(), QByteArray("n2"));
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.queuedBytes(), qint64(0));
+}
+
+void TestClientSendQueue::coalesceNotifications()
+{
+    ClientSendQueue queue;
+    queue.enqueue("a1", ClientSendQueue::PriorityNotification, "a");
+    queue.enqueue("b1", ClientSendQueue::PriorityNotification, "b");
+    queue.enqueue("x", ClientSendQueue::PriorityNotification);
+    queue.enqueue("a22", ClientSendQueue::PriorityNotification, "a");
+    QCOMPARE(queue.queuedNotifications(), 3);
+    QCOMPARE(queue.queuedBytes(), qint64(6));
+    QCOMPARE(queue.droppedNotifications(), quint64(1));
+
+    // The latest value takes the place of the older one
+    QCOMPARE(queue.takeNext(), QByteArray("a22"));
+    queue.enqueue("b2", ClientSendQueue::PriorityNotification, "b");
+    QCOMPARE(queue.takeNext(), QByteArray("b2"));
+    QCOMPARE(queue.takeNext(), QByteArray("x"));
+
+    // Keys are released once sent
+    queue.enqueue("a3", ClientSendQueue::PriorityNotification, "a");
+    QCOMPARE(queue.queuedNotifications(), 1);
+    QCOMPARE(queue.takeNext(), QByteArray("a3"));
+    QVERIFY(queue.isEmpty());
+}
+
+void TestClientSendQueue::dropOldNotifications()
+{
+    ClientSendQueue queue(10);
+    queue.enqueue("1234", ClientSendQueue::PriorityNotification, "a");
+    queue.enqueue("5678", ClientSendQueue::PriorityNotification);
+    queue.enqueue("rr", ClientSendQueue::PriorityReply);
+    QVERIFY(!queue.overBudget());
+
+    // The oldest notification has to go
+    queue.enqueue("9abc", ClientSendQueue::PriorityNotification, "b");
+    QVERIFY(!queue.overBudget());
+    QCOMPARE(queue.queuedBytes(), qint64(10));
+    QCOMPARE(queue.droppedNotifications(), quint64(1));
+
+    // Keys still point to the right entries
+    queue.enqueue("9ab", ClientSendQueue::PriorityNotification, "b");
+    QCOMPARE(queue.takeNext(), QByteArray("rr"));
+    QCOMPARE(queue.takeNext(), QByteArray("5678"));
+    QCOMPARE(queue.takeNext(), QByteArray("9ab"));
+    QVERIFY(queue.isEmpty());
+}
+
+void TestClientSendQueue::overBudget()
+{
+    // Replies are never dropped
+    ClientSendQueue queue(10);
+    queue.enqueue("notification", ClientSendQueue::PriorityNotification);
+    queue.enqueue("reply 1", ClientSendQueue::PriorityReply);
+    QVERIFY(!queue.overBudget());
+    QCOMPARE(queue.queuedNotifications(), 0);
+    queue.enqueue("reply 2", ClientSendQueue::PriorityReply);
+    QVERIFY(queue.overBudget());
+    QCOMPARE(queue.queuedReplies(), 2);
+
+    QCOMPARE(queue.takeAll().count(), 2);
+    QVERIFY(queue.isEmpty());
+    QVERIFY(!queue.overBudget());
+}
+
+void TestClientSendQueue::keysAfterDequeue()
+{
+    // Compare against a plain list, looking up keys linearly
+    ClientSendQueue queue(1024 * 1024);
+    QList<QPair<QString, QByteArray>> model;
+    for (int i = 0; i < 2000; i++) {
+        QString key = i % 5 == 0 ? QString() : QString("key%1").arg(i % 13);
+        QByteArray data = QByteArray::number(i);
+        queue.enqueue(data, ClientSendQueue::PriorityNotification, key);
+
+        bool replaced = false;
+        for (int j = 0; !key.isEmpty() && j < model.count(); j++) {
+            if (model.at(j).first == key) {
+                model[j].second = data;
+                replaced = true;
+                break;
+            }
+        }
+        if (!replaced) {
+            model.append(qMakePair(key, data));
+        }
+
+        if (i % 3 == 0) {
+            QCOMPARE(queue.takeNext(), model.takeFirst().second);
+        }
+        QCOMPARE(queue.queuedNotifications(), model.count());
+    }
+    while (!model.isEmpty()) {
+        QCOMPARE(queue.takeNext(), model.takeFirst().second);
+    }
+    QVERIFY(queue.isEmpty());
+}
+
+void TestClientSendQueue::takeNextManyKeys()
+{
+    // Taking from the front must not depend on the number of queued keys
+    ClientSendQueue queue(1024 * 1024 * 1024);
+    QBENCHMARK {
+        for (int i = 0; i < 10000; i++) {
+            queue.enqueue("data", ClientSendQueue::PriorityNotification, QString::number(i));
+        }
+        while (!queue.isEmpty()) {
+            queue.takeNext();
+        }
+    }
+}
+
+#include "testclientsendqueue.moc"
+QTEST_MAIN(TestClientSendQueue)
@@ -0,0 +1,6 @@
+TARGET = nymeatestinfotimeoutwheel
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testinfotimeoutwheel.cpp
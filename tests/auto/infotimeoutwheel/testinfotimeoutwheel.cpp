@@ -0,0 +1,189 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "integrations/infotimeoutwheel.h"
+
+#include <QElapsedTimer>
+
+class TestInfoTimeoutWheel: public NymeaTestBase
+{
+    Q_OBJECT
+
+protected slots:
+    void initTestCase();
+
+private slots:
+    void expiry_data();
+    void expiry();
+
+    void cancel();
+    void contextDestroyed();
+    void wrapAround();
+    void scheduleFromCallback();
+
+    void scheduleCancel();
+    void timerStartStop();
+};
+
+void TestInfoTimeoutWheel::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+void TestInfoTimeoutWheel::expiry_data()
+{
+    QTest::addColumn<int>("timeout");
+
+    QTest::newRow("less than a tick") << 3;
+    QTest::newRow("one tick") << 10;
+    QTest::newRow("between ticks") << 25;
+    QTest::newRow("last bucket") << 70;
+}
+
+void TestInfoTimeoutWheel::expiry()
+{
+    QFETCH(int, timeout);
+
+    InfoTimeoutWheel wheel(10, 8);
+    QElapsedTimer elapsed;
+    qint64 firedAfter = -1;
+
+    elapsed.start();
+    wheel.schedule(timeout, this, [&](){
+        firedAfter = elapsed.elapsed();
+    });
+    QCOMPARE(wheel.pendingTimeouts(), 1);
+
+    QTRY_VERIFY(firedAfter >= 0);
+    QVERIFY2(firedAfter >= timeout, QString("Fired after %1 ms, expected at least %2 ms").arg(firedAfter).arg(timeout).toUtf8());
+    QCOMPARE(wheel.pendingTimeouts(), 0);
+}
+
+void TestInfoTimeoutWheel::cancel()
+{
+    InfoTimeoutWheel wheel(10, 8);
+    int fired = 0;
+
+    quint64 cancelled = wheel.schedule(20, this, [&](){ fired++; });
+    wheel.schedule(20, this, [&](){ fired += 10; });
+    QCOMPARE(wheel.pendingTimeouts(), 2);
+
+    wheel.cancel(cancelled);
+    QCOMPARE(wheel.pendingTimeouts(), 1);
+
+    // Cancelling twice or cancelling unknown handles does nothing
+    wheel.cancel(cancelled);
+    wheel.cancel(0);
+    QCOMPARE(wheel.pendingTimeouts(), 1);
+
+    QTRY_COMPARE(fired, 10);
+    QTest::qWait(50);
+    QCOMPARE(fired, 10);
+}
+
+void TestInfoTimeoutWheel::contextDestroyed()
+{
+    InfoTimeoutWheel wheel(10, 8);
+    int fired = 0;
+
+    QObject *context = new QObject(this);
+    wheel.schedule(20, context, [&](){ fired++; });
+    delete context;
+
+    // The entry still expires, but the callback isn't called any more
+    QTRY_COMPARE(wheel.pendingTimeouts(), 0);
+    QCOMPARE(fired, 0);
+}
+
+void TestInfoTimeoutWheel::wrapAround()
+{
+    // 4 buckets of 10 ms, so these go around the wheel several times
+    InfoTimeoutWheel wheel(10, 4);
+    QElapsedTimer elapsed;
+    QList<QPair<int, qint64> > fired;
+
+    elapsed.start();
+    QList<int> timeouts = {150, 40, 100, 25, 10};
+    foreach (int timeout, timeouts) {
+        wheel.schedule(timeout, this, [&fired, &elapsed, timeout](){
+            fired.append(qMakePair(timeout, elapsed.elapsed()));
+        });
+    }
+
+    QTRY_COMPARE(fired.count(), timeouts.count());
+    QCOMPARE(wheel.pendingTimeouts(), 0);
+
+    // Timeouts sharing a bucket must not fire on an earlier round
+    for (int i = 0; i < fired.count(); i++) {
+        QVERIFY2(fired.at(i).second >= fired.at(i).first, QString("Timeout of %1 ms fired after %2 ms").arg(fired.at(i).first).arg(fired.at(i).second).toUtf8());
+        if (i > 0) {
+            QVERIFY(fired.at(i - 1).first <= fired.at(i).first);
+        }
+    }
+}
+
+void TestInfoTimeoutWheel::scheduleFromCallback()
+{
+    InfoTimeoutWheel wheel(10, 4);
+    int fired = 0;
+
+    // The timer stops once nothing is pending and must start again from within a callback
+    wheel.schedule(10, this, [&](){
+        fired++;
+        wheel.schedule(10, this, [&](){ fired++; });
+    });
+
+    QTRY_COMPARE(fired, 2);
+    QCOMPARE(wheel.pendingTimeouts(), 0);
+}
+
+void TestInfoTimeoutWheel::scheduleCancel()
+{
+    // What every info object costs for its timeout now...
+    InfoTimeoutWheel wheel(100, 256);
+    QBENCHMARK {
+        quint64 handle = wheel.schedule(30000, this, [](){});
+        wheel.cancel(handle);
+    }
+}
+
+void TestInfoTimeoutWheel::timerStartStop()
+{
+    // ...and what a QTimer::singleShot() per info object cost before
+    QBENCHMARK {
+        QObject context;
+        QTimer::singleShot(30000, &context, [](){});
+    }
+}
+
+#include "testinfotimeoutwheel.moc"
+QTEST_MAIN(TestInfoTimeoutWheel)
@@ -34,6 +34,7 @@
 
 #include "integrations/thingdiscoveryinfo.h"
 #include "integrations/thingsetupinfo.h"
+#include "integrations/thingactioninfo.h"
 
 #include "servers/mocktcpserver.h"
 #include "jsonrpc/integrationshandler.h"
@@ -83,6 +84,8 @@ private slots:
     void getThing_data();
     void getThing();
 
+    void getThingsDelta();
+
     void storedThings();
 
     void stateCache();
@@ -138,6 +141,8 @@ private slots:
 
     void executeAction_data();
     void executeAction();
+    void executeActionOverhead();
+    void coalesceActions();
 
     void triggerEvent();
     void triggerStateChangeSignal();
@@ -149,6 +154,7 @@ private slots:
     void asyncSetupEmitsSetupStatusUpdate();
 
     void testTranslations();
+    void cachedRepliesPerLocale();
 
     // Keep those at last as they will remove things
     void removeThing_data();
@@ -593,6 +599,86 @@ void TestIntegrations::getThing()
     }
 }
 
+void TestIntegrations::getThingsDelta()
+{
+    QVariantMap response = injectAndWait("Integrations.GetThings").toMap().value("params").toMap();
+    QVERIFY(!response.contains("removedThingIds"));
+    QString revision = response.value("revision").toString();
+    QVERIFY(!revision.isEmpty());
+
+    QVariantMap params;
+    params.insert("sinceRevision", revision);
+
+    // Change a state of the mock thing
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY(thing);
+    QSignalSpy spy(NymeaCore::instance()->thingManager(), &ThingManager::thingStateChanged);
+    QNetworkAccessManager nam;
+    int port = thing->paramValue(mockThingHttpportParamTypeId).toInt();
+    int newValue = thing->stateValue(mockIntStateTypeId).toInt() + 1;
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(newValue)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+
+    // Only the changed things are returned
+    response = injectAndWait("Integrations.GetThings", params).toMap().value("params").toMap();
+    QVERIFY(response.contains("removedThingIds"));
+    QCOMPARE(response.value("removedThingIds").toList().count(), 0);
+    QVariantList things = response.value("things").toList();
+    QVERIFY(things.count() < NymeaCore::instance()->thingManager()->configuredThings().count());
+    bool found = false;
+    foreach (const QVariant &packedThing, things) {
+        if (packedThing.toMap().value("id").toUuid() == m_mockThingId) {
+            QVariantList states = packedThing.toMap().value("states").toList();
+            foreach (const QVariant &state, states) {
+                if (state.toMap().value("stateTypeId").toUuid() == mockIntStateTypeId) {
+                    QCOMPARE(state.toMap().value("value").toInt(), newValue);
+                }
+            }
+            found = true;
+        }
+    }
+    QVERIFY(found);
+    QString newRevision = response.value("revision").toString();
+    QVERIFY(newRevision != revision);
+
+    // The current revision is a valid starting point for the next delta
+    params.insert("sinceRevision", newRevision);
+    response = injectAndWait("Integrations.GetThings", params).toMap().value("params").toMap();
+    QVERIFY(response.contains("removedThingIds"));
+
+    // A revision the journal doesn't know about returns the full list
+    QString bootId = newRevision.left(newRevision.lastIndexOf(':'));
+    QStringList unknownRevisions = {"1", "", bootId + ":", bootId + ":abc", bootId + ":999999999", "00000000-0000-0000-0000-000000000000:1"};
+    foreach (const QString &unknownRevision, unknownRevisions) {
+        params.insert("sinceRevision", unknownRevision);
+        response = injectAndWait("Integrations.GetThings", params).toMap().value("params").toMap();
+        QVERIFY2(!response.contains("removedThingIds"), unknownRevision.toUtf8());
+        QCOMPARE(response.value("things").toList().count(), NymeaCore::instance()->thingManager()->configuredThings().count());
+    }
+
+    // After a restart the journal starts over with another boot id and rejects the revisions handed out before
+    restartServer();
+    response = injectAndWait("Integrations.GetThings").toMap().value("params").toMap();
+    QString restartedRevision = response.value("revision").toString();
+    QVERIFY(restartedRevision.left(restartedRevision.lastIndexOf(':')) != bootId);
+
+    // Also with a counter the restarted journal does know
+    QString restartedCounter = restartedRevision.mid(restartedRevision.lastIndexOf(':'));
+    foreach (const QString &oldRevision, QStringList({revision, bootId + restartedCounter})) {
+        params.insert("sinceRevision", oldRevision);
+        response = injectAndWait("Integrations.GetThings", params).toMap().value("params").toMap();
+        QVERIFY2(!response.contains("removedThingIds"), oldRevision.toUtf8());
+        QCOMPARE(response.value("things").toList().count(), NymeaCore::instance()->thingManager()->configuredThings().count());
+    }
+
+    params.insert("sinceRevision", restartedRevision);
+    response = injectAndWait("Integrations.GetThings", params).toMap().value("params").toMap();
+    QVERIFY(response.contains("removedThingIds"));
+}
+
 void TestIntegrations::storedThings()
 {
     QVariantMap params;
@@ -992,7 +1078,7 @@ void TestIntegrations::getActionTypes_data()
     QTest::addColumn<QList<ActionTypeId> >("actionTypeTestData");
 
     QTest::newRow("valid thingClass") << mockThingClassId
-                                       << (QList<ActionTypeId>() << mockIntWithLimitsActionTypeId << mockAsyncActionTypeId << mockAsyncFailingActionTypeId << mockFailingActionTypeId << mockWithoutParamsActionTypeId << mockPowerActionTypeId << mockWithoutParamsActionTypeId << mockBatteryLevelActionTypeId << mockSignalStrengthActionTypeId << mockUpdateStatusActionTypeId << mockPerformUpdateActionTypeId << mockPressButtonActionTypeId);
+                                       << (QList<ActionTypeId>() << mockIntWithLimitsActionTypeId << mockAsyncActionTypeId << mockAsyncFailingActionTypeId << mockAsyncCoalescingActionTypeId << mockFailingActionTypeId << mockWithoutParamsActionTypeId << mockPowerActionTypeId << mockWithoutParamsActionTypeId << mockBatteryLevelActionTypeId << mockSignalStrengthActionTypeId << mockUpdateStatusActionTypeId << mockPerformUpdateActionTypeId << mockPressButtonActionTypeId);
     QTest::newRow("invalid thingClass") << ThingClassId("094f8024-5caa-48c1-ab6a-de486a92088f") << QList<ActionTypeId>();
 }
 
@@ -2100,6 +2186,52 @@ void TestIntegrations::executeAction()
 
 }
 
+void TestIntegrations::executeActionOverhead()
+{
+    // The failing mock action finishes right away and doesn't touch the action history
+    Action action(mockFailingActionTypeId, ThingId(m_mockThingId));
+
+    QBENCHMARK {
+        ThingActionInfo *info = NymeaCore::instance()->thingManager()->executeAction(action);
+        QSignalSpy spy(info, &ThingActionInfo::finished);
+        QVERIFY(spy.wait());
+    }
+}
+
+void TestIntegrations::coalesceActions()
+{
+    Action action(mockAsyncCoalescingActionTypeId, ThingId(m_mockThingId));
+
+    // Infos are deleted once finished, so record the status when they finish
+    QList<QPair<int, Thing::ThingError> > finished;
+    QList<ThingActionInfo *> infos;
+    for (int i = 0; i < 3; i++) {
+        ThingActionInfo *info = NymeaCore::instance()->thingManager()->executeAction(action);
+        connect(info, &ThingActionInfo::finished, this, [&finished, info, i](){
+            finished.append(qMakePair(i, info->status()));
+        });
+        infos.append(info);
+    }
+
+    // The first one is in flight, the second one is replaced by the third one right away
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(finished.at(0).first, 1);
+    QCOMPARE(finished.at(0).second, Thing::ThingErrorActionSuperseded);
+
+    // The pending one is only handed to the plugin once the one in flight has finished
+    QSignalSpy firstSpy(infos.at(0), &ThingActionInfo::finished);
+    QVERIFY(firstSpy.wait());
+    QCOMPARE(finished.count(), 2);
+    QCOMPARE(finished.at(1).first, 0);
+    QCOMPARE(finished.at(1).second, Thing::ThingErrorNoError);
+
+    QSignalSpy lastSpy(infos.at(2), &ThingActionInfo::finished);
+    QVERIFY(lastSpy.wait());
+    QCOMPARE(finished.count(), 3);
+    QCOMPARE(finished.at(2).first, 2);
+    QCOMPARE(finished.at(2).second, Thing::ThingErrorNoError);
+}
+
 void TestIntegrations::triggerEvent()
 {
     enableNotifications({"Integrations"});
@@ -2397,6 +2529,74 @@ void TestIntegrations::testTranslations()
 
 }
 
+void TestIntegrations::cachedRepliesPerLocale()
+{
+    auto switchLocale = [this](const QString &locale) {
+        QVariantMap params;
+        params.insert("locale", locale);
+        injectAndWait("JSONRPC.Hello", params);
+    };
+    auto thingClassDisplayName = [this](const QVariantMap &params) {
+        QVariant response = injectAndWait("Integrations.GetThingClasses", params);
+        foreach (const QVariant &tcVariant, response.toMap().value("params").toMap().value("thingClasses").toList()) {
+            if (tcVariant.toMap().value("id").toUuid() == autoMockThingClassId) {
+                return tcVariant.toMap().value("displayName").toString();
+            }
+        }
+        return QString();
+    };
+    auto pluginDisplayName = [this]() {
+        QVariant response = injectAndWait("Integrations.GetPlugins");
+        foreach (const QVariant &pluginVariant, response.toMap().value("params").toMap().value("plugins").toList()) {
+            if (pluginVariant.toMap().value("id").toUuid() == mockPluginId) {
+                return pluginVariant.toMap().value("displayName").toString();
+            }
+        }
+        return QString();
+    };
+
+    QVariantMap filter;
+    filter.insert("thingClassIds", QVariantList() << autoMockThingClassId);
+
+    QString english = "Mocked Thing (Auto created)";
+    QString german = "Mock \"Thing\" (automatisch erstellt)";
+    QString dutch = "Nepding (automatisch aangemaakt)";
+
+    // Switching back and forth must never hand out the cached lists of another locale
+    QList<QPair<QString, QString>> expectations = {
+        {"de_AT", german},
+        {"en_US", english},
+        {"nl_NL", dutch},
+        {"de_AT", german},
+        {"en_US", english}
+    };
+    for (int i = 0; i < expectations.count(); i++) {
+        switchLocale(expectations.at(i).first);
+        QCOMPARE(thingClassDisplayName(QVariantMap()), expectations.at(i).second);
+        QCOMPARE(thingClassDisplayName(filter), expectations.at(i).second);
+    }
+
+    switchLocale("de_AT");
+    QCOMPARE(pluginDisplayName(), QString("Mock \"Things\""));
+    switchLocale("en_US");
+    QCOMPARE(pluginDisplayName(), QString("Mocked things"));
+
+    // Only a few locales are kept, the others are built again when requested
+    QStringList otherLocales = {"fr_FR", "it_IT", "es_ES", "pt_PT", "fi_FI", "da_DK", "cs_CZ", "pl_PL", "sv_SE", "nb_NO"};
+    foreach (const QString &locale, otherLocales) {
+        switchLocale(locale);
+        QVERIFY(!thingClassDisplayName(QVariantMap()).isEmpty());
+        QVERIFY(!pluginDisplayName().isEmpty());
+    }
+    switchLocale("de_AT");
+    QCOMPARE(thingClassDisplayName(QVariantMap()), german);
+    QCOMPARE(thingClassDisplayName(filter), german);
+    QCOMPARE(pluginDisplayName(), QString("Mock \"Things\""));
+
+    switchLocale("en_US");
+    QCOMPARE(thingClassDisplayName(QVariantMap()), english);
+}
+
 #include "testintegrations.moc"
 QTEST_MAIN(TestIntegrations)
 
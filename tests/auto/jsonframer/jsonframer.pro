@@ -0,0 +1,6 @@
+TARGET = nymeatestjsonframer
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testjsonframer.cpp
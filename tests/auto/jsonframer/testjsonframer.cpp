@@ -0,0 +1,264 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "jsonrpc/jsonframer.h"
+
+#include <QJsonDocument>
+
+using namespace nymeaserver;
+
+class TestJsonFramer: public NymeaTestBase
+{
+    Q_OBJECT
+
+protected slots:
+    void initTestCase();
+
+private:
+    QByteArray message(int id) const;
+
+private slots:
+    void frames_data();
+    void frames();
+
+    void byteByByte();
+    void rawNewlineInString();
+    void fragmentedGarbage();
+    void overflow();
+
+    void fuzzFragmentation();
+    void fuzzRandomData();
+
+    void throughput_data();
+    void throughput();
+};
+
+void TestJsonFramer::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+    qsrand(1234);
+}
+
+QByteArray TestJsonFramer::message(int id) const
+{
+    QVariantMap params;
+    params.insert("name", QString("Thing {%1} \"quoted\" [x] \\").arg(id));
+    params.insert("values", QVariantList() << id << QVariantMap({{"nested", true}}));
+    QVariantMap message;
+    message.insert("id", id);
+    message.insert("method", "Integrations.GetThings");
+    message.insert("params", params);
+    return QJsonDocument::fromVariant(message).toJson(id % 2 ? QJsonDocument::Compact : QJsonDocument::Indented);
+}
+
+void TestJsonFramer::frames_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("frameCount");
+    QTest::addColumn<int>("remaining");
+
+    QTest::newRow("single") << QByteArray("{\"id\":1}") << 1 << 0;
+    QTest::newRow("single newline") << QByteArray("{\"id\":1}\n") << 1 << 0;
+    QTest::newRow("leading whitespace") << QByteArray("\n\r\t {\"id\":1}") << 1 << 0;
+    QTest::newRow("concatenated") << QByteArray("{\"id\":1}{\"id\":2}") << 2 << 0;
+    QTest::newRow("newline separated") << QByteArray("{\"id\":1}\n{\"id\":2}\n") << 2 << 0;
+    QTest::newRow("array") << QByteArray("[{\"id\":1},{\"id\":2}]\n") << 1 << 0;
+    QTest::newRow("brackets in strings") << QByteArray("{\"a\":\"}{][\"}\n") << 1 << 0;
+    QTest::newRow("escaped quotes") << QByteArray("{\"a\":\"\\\"}\\\\\"}\n") << 1 << 0;
+    QTest::newRow("incomplete") << QByteArray("{\"id\":1}\n{\"id\":") << 1 << 6;
+    QTest::newRow("garbage line") << QByteArray("garbage\n{\"id\":1}") << 2 << 0;
+    QTest::newRow("incomplete garbage") << QByteArray("garbage") << 1 << 0;
+}
+
+void TestJsonFramer::frames()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, frameCount);
+    QFETCH(int, remaining);
+
+    JsonFramer framer;
+    QList<QByteArray> frames = framer.feed(data);
+    QCOMPARE(frames.count(), frameCount);
+    QCOMPARE(framer.bufferedSize(), remaining);
+}
+
+void TestJsonFramer::byteByByte()
+{
+    QByteArray data;
+    for (int i = 0; i < 10; i++) {
+        data.append(message(i));
+    }
+
+    JsonFramer framer;
+    QList<QByteArray> frames;
+    for (int i = 0; i < data.size(); i++) {
+        frames.append(framer.feed(data.mid(i, 1)));
+    }
+    QCOMPARE(frames.count(), 10);
+    for (int i = 0; i < frames.count(); i++) {
+        QJsonParseError error;
+        QJsonDocument jsonDoc = QJsonDocument::fromJson(frames.at(i), &error);
+        QCOMPARE(error.error, QJsonParseError::NoError);
+        QCOMPARE(jsonDoc.toVariant().toMap().value("id").toInt(), i);
+    }
+    QCOMPARE(framer.bufferedSize(), 0);
+}
+
+void TestJsonFramer::rawNewlineInString()
+{
+    // A broken string must not swallow the following messages
+    JsonFramer framer;
+    QList<QByteArray> frames = framer.feed("{\"id\":1, \"method\":\"JSO}\n{\"id\":2}\n");
+    QCOMPARE(frames.count(), 2);
+    QJsonParseError error;
+    QJsonDocument::fromJson(frames.first(), &error);
+    QVERIFY(error.error != QJsonParseError::NoError);
+    QCOMPARE(QJsonDocument::fromJson(frames.last()).toVariant().toMap().value("id").toInt(), 2);
+}
+
+void TestJsonFramer::fragmentedGarbage()
+{
+    // Garbage is reported with the first fragment, the rest of its line is dropped
+    JsonFramer framer;
+    QList<QByteArray> frames = framer.feed("garb");
+    QCOMPARE(frames, QList<QByteArray>() << "garb");
+    QCOMPARE(framer.bufferedSize(), 0);
+
+    QVERIFY(framer.feed("age").isEmpty());
+    frames = framer.feed(" more\n{\"id\":1}");
+    QCOMPARE(frames.count(), 1);
+    QCOMPARE(QJsonDocument::fromJson(frames.first()).toVariant().toMap().value("id").toInt(), 1);
+    QCOMPARE(framer.bufferedSize(), 0);
+}
+
+void TestJsonFramer::overflow()
+{
+    JsonFramer framer(1024);
+    framer.feed("{\"data\":\"");
+    QVERIFY(!framer.overflow());
+    framer.feed(QByteArray(2048, 'a'));
+    QVERIFY(framer.overflow());
+    framer.reset();
+    QVERIFY(!framer.overflow());
+    QCOMPARE(framer.feed("{\"id\":1}").count(), 1);
+}
+
+void TestJsonFramer::fuzzFragmentation()
+{
+    for (int run = 0; run < 100; run++) {
+        QByteArray data;
+        int count = qrand() % 20 + 1;
+        for (int i = 0; i < count; i++) {
+            data.append(message(i));
+            // Random whitespace between messages
+            data.append(QByteArray(qrand() % 3, '\n'));
+        }
+
+        JsonFramer framer;
+        QList<QByteArray> frames;
+        int position = 0;
+        while (position < data.size()) {
+            int chunkSize = qrand() % 200 + 1;
+            frames.append(framer.feed(data.mid(position, chunkSize)));
+            position += chunkSize;
+        }
+
+        QCOMPARE(frames.count(), count);
+        for (int i = 0; i < frames.count(); i++) {
+            QCOMPARE(QJsonDocument::fromJson(frames.at(i)).toVariant().toMap().value("id").toInt(), i);
+        }
+        QCOMPARE(framer.bufferedSize(), 0);
+    }
+}
+
+void TestJsonFramer::fuzzRandomData()
+{
+    // Random data made of JSON control characters must never crash or lose track of the buffer
+    const char alphabet[] = "{}[]\"\\\n a:,1";
+    for (int run = 0; run < 1000; run++) {
+        JsonFramer framer(4096);
+        int total = 0;
+        int framed = 0;
+        for (int chunk = 0; chunk < 10; chunk++) {
+            QByteArray data;
+            int length = qrand() % 100;
+            for (int i = 0; i < length; i++) {
+                data.append(alphabet[qrand() % (sizeof(alphabet) - 1)]);
+            }
+            total += data.size();
+            foreach (const QByteArray &frame, framer.feed(data)) {
+                QVERIFY(!frame.isEmpty());
+                framed += frame.size();
+            }
+        }
+        QVERIFY(framed + framer.bufferedSize() <= total);
+    }
+}
+
+void TestJsonFramer::throughput_data()
+{
+    QTest::addColumn<int>("chunkSize");
+
+    QTest::newRow("whole messages") << 0;
+    QTest::newRow("1400 byte chunks") << 1400;
+    QTest::newRow("16 byte chunks") << 16;
+}
+
+void TestJsonFramer::throughput()
+{
+    QFETCH(int, chunkSize);
+
+    QList<QByteArray> chunks;
+    QByteArray data;
+    for (int i = 0; i < 1000; i++) {
+        if (chunkSize == 0) {
+            chunks.append(message(i));
+        } else {
+            data.append(message(i));
+        }
+    }
+    for (int position = 0; position < data.size(); position += chunkSize) {
+        chunks.append(data.mid(position, chunkSize));
+    }
+
+    QBENCHMARK {
+        JsonFramer framer;
+        int frames = 0;
+        foreach (const QByteArray &chunk, chunks) {
+            frames += framer.feed(chunk).count();
+        }
+        QCOMPARE(frames, 1000);
+    }
+}
+
+#include "testjsonframer.moc"
+QTEST_MAIN(TestJsonFramer)
@@ -0,0 +1,6 @@
+TARGET = nymeatestjsonhandler
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testjsonhandler.cpp
@@ -0,0 +1,500 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "nymeacore.h"
+
+#include "jsonrpc/jsonhandler.h"
+#include "jsonrpc/jsonrpcserverimplementation.h"
+#include "integrations/thingmanager.h"
+
+using namespace nymeaserver;
+
+class TestEntry
+{
+    Q_GADGET
+    Q_PROPERTY(int value MEMBER m_value)
+    Q_PROPERTY(QString label MEMBER m_label USER true)
+public:
+    Q_INVOKABLE bool isValid() const { return m_value >= 0; }
+
+    int m_value = -1;
+    QString m_label;
+};
+Q_DECLARE_METATYPE(TestEntry)
+
+class TestEntries: public QList<TestEntry>
+{
+    Q_GADGET
+    Q_PROPERTY(int count READ count)
+public:
+    Q_INVOKABLE QVariant get(int index) const { return QVariant::fromValue(at(index)); }
+    Q_INVOKABLE void put(const QVariant &variant) { append(variant.value<TestEntry>()); }
+};
+Q_DECLARE_METATYPE(TestEntries)
+
+class TestObject
+{
+    Q_GADGET
+    Q_PROPERTY(QString name MEMBER m_name)
+    Q_PROPERTY(Level level MEMBER m_level)
+    Q_PROPERTY(Features features MEMBER m_features USER true)
+    Q_PROPERTY(QVariant::Type basicType MEMBER m_basicType)
+    Q_PROPERTY(QList<int> values MEMBER m_values USER true)
+    Q_PROPERTY(QList<QUuid> ids MEMBER m_ids USER true)
+    Q_PROPERTY(QList<QDateTime> timestamps MEMBER m_timestamps USER true)
+    Q_PROPERTY(QDateTime timestamp MEMBER m_timestamp USER true)
+    Q_PROPERTY(QTime time MEMBER m_time)
+    Q_PROPERTY(QVariant value MEMBER m_value USER true)
+    Q_PROPERTY(TestEntry entry MEMBER m_entry USER true)
+    Q_PROPERTY(TestEntries entries MEMBER m_entries USER true)
+    Q_PROPERTY(QUuid id READ id)
+    Q_PROPERTY(bool legacy MEMBER m_legacy REVISION 1)
+public:
+    // Deliberately not numbered 0, 1, 2...
+    enum Level {
+        LevelLow = 1,
+        LevelMedium = 5,
+        LevelHigh = 20
+    };
+    Q_ENUM(Level)
+
+    enum Feature {
+        FeatureNone = 0,
+        FeatureA = 0x1,
+        FeatureB = 0x4,
+        FeatureC = 0x10
+    };
+    Q_ENUM(Feature)
+    Q_DECLARE_FLAGS(Features, Feature)
+    Q_FLAG(Features)
+
+    QUuid id() const { return m_id; }
+
+    QString m_name;
+    Level m_level = LevelLow;
+    Features m_features;
+    QVariant::Type m_basicType = QVariant::Int;
+    QList<int> m_values;
+    QList<QUuid> m_ids;
+    QList<QDateTime> m_timestamps;
+    QDateTime m_timestamp;
+    QTime m_time;
+    QVariant m_value;
+    TestEntry m_entry;
+    TestEntries m_entries;
+    QUuid m_id = QUuid("d7f2a0c3-6f1e-4b8e-9e0a-3c5b1d2e4f60");
+    bool m_legacy = false;
+};
+Q_DECLARE_METATYPE(TestObject)
+
+class TestHandler: public JsonHandler
+{
+    Q_OBJECT
+public:
+    TestHandler(QObject *parent = nullptr): JsonHandler(parent) {
+        registerEnum<TestObject::Level>();
+        registerFlag<TestObject::Feature, TestObject::Features>();
+        registerObject<TestEntry, TestEntries>();
+        registerObject<TestObject>();
+    }
+    QString name() const override { return "Test"; }
+};
+
+// Packs and describes objects by walking their QMetaObject on every call, the way JsonHandler did
+// before the reflection data got cached in descriptors. Serves as reference for the cached path.
+class UncachedReflection
+{
+public:
+    static QVariantMap describe(const QMetaObject &metaObject)
+    {
+        QVariantMap description;
+        for (int i = 0; i < metaObject.propertyCount(); i++) {
+            QMetaProperty metaProperty = metaObject.property(i);
+            QString name = metaProperty.name();
+            if (name == "objectName") {
+                continue;
+            }
+            if (metaProperty.isUser()) {
+                name.prepend("o:");
+            }
+            if (!metaProperty.isWritable()) {
+                name.prepend("r:");
+            }
+            if (metaProperty.revision() == 1) {
+                name.prepend("d:");
+            }
+            QString propertyTypeName = metaProperty.typeName();
+            QVariant typeName;
+            if (metaProperty.type() == QVariant::UserType) {
+                if (propertyTypeName == "QVariant::Type") {
+                    typeName = QString("$ref:BasicType");
+                } else if (propertyTypeName.startsWith("QList")) {
+                    QString elementType = propertyTypeName.remove("QList<").remove(">");
+                    if (elementType == "ThingId" || elementType == "EventTypeId" || elementType == "StateTypeId" || elementType == "ActionTypeId") {
+                        elementType = "QUuid";
+                    }
+                    typeName = QVariantList() << JsonHandler::enumValueName(JsonHandler::variantTypeToBasicType(QVariant::nameToType(elementType.toUtf8())));
+                } else {
+                    typeName = QString("$ref:%1").arg(propertyTypeName.split("::").last());
+                }
+            } else if (metaProperty.isEnumType()) {
+                typeName = QString("$ref:%1").arg(propertyTypeName.split("::").last());
+            } else if (metaProperty.type() == QVariant::List) {
+                typeName = QVariantList() << JsonHandler::enumValueName(JsonHandler::Variant);
+            } else {
+                typeName = JsonHandler::enumValueName(JsonHandler::variantTypeToBasicType(metaProperty.type()));
+            }
+            description.insert(name, typeName);
+        }
+        return description;
+    }
+
+    static QVariant pack(const QMetaObject &metaObject, const void *value)
+    {
+        if (isList(metaObject)) {
+            QVariantList ret;
+            int count = metaObject.property(metaObject.indexOfProperty("count")).readOnGadget(value).toInt();
+            QMetaMethod getMethod = metaObject.method(metaObject.indexOfMethod("get(int)"));
+            for (int i = 0; i < count; i++) {
+                QVariant entry;
+                getMethod.invokeOnGadget(const_cast<void*>(value), Q_RETURN_ARG(QVariant, entry), Q_ARG(int, i));
+                ret.append(pack(*QMetaType::metaObjectForType(entry.userType()), entry.data()));
+            }
+            return ret;
+        }
+
+        QVariantMap ret;
+        for (int i = 0; i < metaObject.propertyCount(); i++) {
+            QMetaProperty metaProperty = metaObject.property(i);
+            if (metaProperty.name() == QStringLiteral("objectName")) {
+                continue;
+            }
+            QVariant propertyValue = metaProperty.readOnGadget(value);
+            if (metaProperty.isUser() && (!propertyValue.isValid() || propertyValue.isNull())) {
+                continue;
+            }
+
+            if (metaProperty.isFlagType()) {
+                QMetaEnum metaFlag = metaProperty.enumerator();
+                QStringList flags;
+                for (int j = 0; j < metaFlag.keyCount(); j++) {
+                    if (metaFlag.value(j) > 0 && (metaFlag.value(j) & propertyValue.toInt()) == metaFlag.value(j)) {
+                        flags.append(metaFlag.key(j));
+                    }
+                }
+                ret.insert(metaProperty.name(), flags);
+                continue;
+            }
+            if (metaProperty.isEnumType()) {
+                ret.insert(metaProperty.name(), metaProperty.enumerator().valueToKey(propertyValue.toInt()));
+                continue;
+            }
+            if (metaProperty.typeName() == QStringLiteral("QVariant::Type")) {
+                ret.insert(metaProperty.name(), JsonHandler::enumValueName(JsonHandler::variantTypeToBasicType(propertyValue.value<QVariant::Type>())));
+                continue;
+            }
+
+            if (metaProperty.type() == QVariant::UserType) {
+                QString propertyTypeName = metaProperty.typeName();
+                if (propertyTypeName.startsWith("QList<")) {
+                    QVariantList list;
+                    if (propertyTypeName == "QList<int>") {
+                        foreach (int entry, propertyValue.value<QList<int>>()) {
+                            list << entry;
+                        }
+                    } else if (propertyTypeName == "QList<QUuid>") {
+                        foreach (const QUuid &entry, propertyValue.value<QList<QUuid>>()) {
+                            list << entry;
+                        }
+                    } else if (propertyTypeName == "QList<ThingId>") {
+                        foreach (const ThingId &entry, propertyValue.value<QList<ThingId>>()) {
+                            list << entry;
+                        }
+                    } else if (propertyTypeName == "QList<EventTypeId>") {
+                        foreach (const EventTypeId &entry, propertyValue.value<QList<EventTypeId>>()) {
+                            list << entry;
+                        }
+                    } else if (propertyTypeName == "QList<StateTypeId>") {
+                        foreach (const StateTypeId &entry, propertyValue.value<QList<StateTypeId>>()) {
+                            list << entry;
+                        }
+                    } else if (propertyTypeName == "QList<ActionTypeId>") {
+                        foreach (const ActionTypeId &entry, propertyValue.value<QList<ActionTypeId>>()) {
+                            list << entry;
+                        }
+                    } else if (propertyTypeName == "QList<QDateTime>") {
+                        foreach (const QDateTime &timestamp, propertyValue.value<QList<QDateTime>>()) {
+                            list << timestamp.toMSecsSinceEpoch() / 1000;
+                        }
+                    }
+                    if (!list.isEmpty() || !metaProperty.isUser()) {
+                        ret.insert(metaProperty.name(), list);
+                    }
+                    continue;
+                }
+
+                const QMetaObject *propertyMetaObject = QMetaType::metaObjectForType(metaProperty.userType());
+                Q_ASSERT_X(propertyMetaObject, "UncachedReflection", QString("No meta object for %1").arg(propertyTypeName).toUtf8());
+                QVariant packed = pack(*propertyMetaObject, propertyValue.data());
+                if (isList(*propertyMetaObject)) {
+                    if (!metaProperty.isUser() || packed.toList().count() > 0) {
+                        ret.insert(metaProperty.name(), packed);
+                    }
+                    continue;
+                }
+                bool isValid = true;
+                int isValidIndex = propertyMetaObject->indexOfMethod("isValid()");
+                if (isValidIndex >= 0) {
+                    propertyMetaObject->method(isValidIndex).invokeOnGadget(propertyValue.data(), Q_RETURN_ARG(bool, isValid));
+                }
+                if (isValid || !metaProperty.isUser()) {
+                    ret.insert(metaProperty.name(), packed);
+                }
+                continue;
+            }
+
+            if (metaProperty.type() == QVariant::DateTime) {
+                if (metaProperty.isUser() && propertyValue.toDateTime().toTime_t() == 0) {
+                    continue;
+                }
+                propertyValue = propertyValue.toDateTime().toTime_t();
+            } else if (metaProperty.type() == QVariant::Time) {
+                propertyValue = propertyValue.toTime().toString("hh:mm");
+            }
+            ret.insert(metaProperty.name(), propertyValue);
+        }
+        return ret;
+    }
+
+private:
+    static bool isList(const QMetaObject &metaObject)
+    {
+        return metaObject.indexOfProperty("count") >= 0
+                && metaObject.indexOfMethod("get(int)") >= 0
+                && metaObject.indexOfMethod("put(QVariant)") >= 0;
+    }
+};
+
+class TestJsonHandler: public NymeaTestBase
+{
+    Q_OBJECT
+
+private:
+    TestObject fullObject() const;
+
+private slots:
+    void initTestCase();
+
+    void introspection();
+
+    void packObject_data();
+    void packObject();
+
+    void unpackObject_data();
+    void unpackObject();
+
+    void nonContiguousEnum();
+
+    void serverTypes();
+};
+
+void TestJsonHandler::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+TestObject TestJsonHandler::fullObject() const
+{
+    TestEntry first;
+    first.m_value = 1;
+    first.m_label = "first";
+    TestEntry second;
+    second.m_value = 2;
+
+    TestObject object;
+    object.m_name = "full";
+    object.m_level = TestObject::LevelHigh;
+    object.m_features = TestObject::FeatureA | TestObject::FeatureC;
+    object.m_basicType = QVariant::Double;
+    object.m_values = {3, 1, 2};
+    object.m_ids = {QUuid("2f1a8c9e-0b7d-4e3a-8d6c-5a4b3c2d1e0f")};
+    object.m_timestamps = {QDateTime::fromMSecsSinceEpoch(1600000000000), QDateTime::fromMSecsSinceEpoch(1600000001500)};
+    object.m_timestamp = QDateTime::fromMSecsSinceEpoch(1600000000000);
+    object.m_time = QTime(7, 30);
+    object.m_value = 42.5;
+    object.m_entry = first;
+    object.m_entries << first << second;
+    object.m_legacy = true;
+    return object;
+}
+
+void TestJsonHandler::introspection()
+{
+    TestHandler handler;
+    QVariantMap objects = handler.jsonObjects();
+
+    QCOMPARE(objects.value("TestObject").toMap(), UncachedReflection::describe(TestObject::staticMetaObject));
+    QCOMPARE(objects.value("TestEntry").toMap(), UncachedReflection::describe(TestEntry::staticMetaObject));
+    QCOMPARE(objects.value("TestEntries").toList(), QVariantList() << "$ref:TestEntry");
+
+    QCOMPARE(objects.value("TestObject").toMap().value("o:features").toString(), QString("$ref:Features"));
+    QCOMPARE(objects.value("TestObject").toMap().value("r:id").toString(), QString("Uuid"));
+    QCOMPARE(objects.value("TestObject").toMap().value("d:legacy").toString(), QString("Bool"));
+    QCOMPARE(handler.jsonEnums().value("Level").toStringList(), QStringList() << "LevelLow" << "LevelMedium" << "LevelHigh");
+}
+
+void TestJsonHandler::packObject_data()
+{
+    QTest::addColumn<TestObject>("object");
+
+    QTest::newRow("default") << TestObject();
+    QTest::newRow("full") << fullObject();
+
+    TestObject invalidEntry = fullObject();
+    invalidEntry.m_entry = TestEntry();
+    QTest::newRow("invalid optional entry") << invalidEntry;
+
+    TestObject emptyLists = fullObject();
+    emptyLists.m_values.clear();
+    emptyLists.m_ids.clear();
+    emptyLists.m_entries.clear();
+    QTest::newRow("empty optional lists") << emptyLists;
+
+    TestObject allFeatures = fullObject();
+    allFeatures.m_features = TestObject::FeatureA | TestObject::FeatureB | TestObject::FeatureC;
+    allFeatures.m_level = TestObject::LevelMedium;
+    QTest::newRow("all features") << allFeatures;
+}
+
+void TestJsonHandler::packObject()
+{
+    QFETCH(TestObject, object);
+
+    TestHandler handler;
+    QVariant cached = handler.pack(object);
+    QVariant uncached = UncachedReflection::pack(TestObject::staticMetaObject, &object);
+    QCOMPARE(cached, uncached);
+
+    // Packing again reuses the descriptors and must give the same result
+    QCOMPARE(handler.pack(object), cached);
+
+    TestEntries entries = object.m_entries;
+    QCOMPARE(handler.pack(entries), UncachedReflection::pack(TestEntries::staticMetaObject, &entries));
+}
+
+void TestJsonHandler::unpackObject_data()
+{
+    packObject_data();
+}
+
+void TestJsonHandler::unpackObject()
+{
+    QFETCH(TestObject, object);
+
+    TestHandler handler;
+    QVariantMap packed = handler.pack(object).toMap();
+    // unpack() writes enums and flags as they come, hand them in as numeric values
+    packed.insert("level", object.m_level);
+    packed.insert("features", static_cast<int>(object.m_features));
+
+    TestObject unpacked = handler.unpack<TestObject>(packed);
+    QCOMPARE(unpacked.m_name, object.m_name);
+    QCOMPARE(unpacked.m_level, object.m_level);
+    QCOMPARE(unpacked.m_features, object.m_features);
+    QCOMPARE(unpacked.m_values, object.m_values);
+    QCOMPARE(unpacked.m_ids, object.m_ids);
+    QCOMPARE(unpacked.m_value, object.m_value);
+    QCOMPARE(unpacked.m_timestamp, object.m_timestamp);
+    QCOMPARE(unpacked.m_time, object.m_time);
+    QCOMPARE(unpacked.m_entries.count(), object.m_entries.count());
+    for (int i = 0; i < object.m_entries.count(); i++) {
+        QCOMPARE(unpacked.m_entries.at(i).m_value, object.m_entries.at(i).m_value);
+        QCOMPARE(unpacked.m_entries.at(i).m_label, object.m_entries.at(i).m_label);
+    }
+    if (object.m_entry.isValid()) {
+        QCOMPARE(unpacked.m_entry.m_value, object.m_entry.m_value);
+        QCOMPARE(unpacked.m_entry.m_label, object.m_entry.m_label);
+    }
+
+    QVariantMap repacked = handler.pack(unpacked).toMap();
+    QCOMPARE(repacked.value("level"), handler.pack(object).toMap().value("level"));
+    QCOMPARE(repacked.value("features"), handler.pack(object).toMap().value("features"));
+    QCOMPARE(repacked.value("entries"), handler.pack(object).toMap().value("entries"));
+}
+
+void TestJsonHandler::nonContiguousEnum()
+{
+    TestHandler handler;
+    TestObject object;
+
+    // Enum values are looked up by value, not used as index into the key list
+    object.m_level = TestObject::LevelLow;
+    QCOMPARE(handler.pack(object).toMap().value("level").toString(), QString("LevelLow"));
+    object.m_level = TestObject::LevelMedium;
+    QCOMPARE(handler.pack(object).toMap().value("level").toString(), QString("LevelMedium"));
+    object.m_level = TestObject::LevelHigh;
+    QCOMPARE(handler.pack(object).toMap().value("level").toString(), QString("LevelHigh"));
+
+    object.m_features = TestObject::FeatureB | TestObject::FeatureC;
+    QCOMPARE(handler.pack(object).toMap().value("features").toStringList(), QStringList() << "FeatureB" << "FeatureC");
+}
+
+void TestJsonHandler::serverTypes()
+{
+    JsonHandler *handler = NymeaCore::instance()->jsonRPCServer()->handlers().value("Integrations");
+    QVERIFY(handler);
+
+    QList<QMetaObject> metaObjects = {
+        ThingClass::staticMetaObject,
+        StateType::staticMetaObject,
+        EventType::staticMetaObject,
+        ActionType::staticMetaObject,
+        ParamType::staticMetaObject,
+        Vendor::staticMetaObject
+    };
+    QVariantMap objects = handler->jsonObjects();
+    foreach (const QMetaObject &metaObject, metaObjects) {
+        QString typeName = QString(metaObject.className()).split("::").last();
+        QVERIFY2(objects.contains(typeName), typeName.toUtf8());
+        QCOMPARE(objects.value(typeName).toMap(), UncachedReflection::describe(metaObject));
+    }
+
+    ThingClasses thingClasses = NymeaCore::instance()->thingManager()->supportedThings();
+    QVERIFY(!thingClasses.isEmpty());
+    QCOMPARE(handler->pack(thingClasses), UncachedReflection::pack(ThingClasses::staticMetaObject, &thingClasses));
+
+    Vendors vendors = NymeaCore::instance()->thingManager()->supportedVendors();
+    QVERIFY(!vendors.isEmpty());
+    QCOMPARE(handler->pack(vendors), UncachedReflection::pack(Vendors::staticMetaObject, &vendors));
+}
+
+#include "testjsonhandler.moc"
+QTEST_MAIN(TestJsonHandler)
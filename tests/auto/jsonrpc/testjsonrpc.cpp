@@ -38,6 +38,10 @@
 #include "nymeadbusservice.h"
 #include "../plugins/mock/extern-plugininfo.h"
 
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#endif
+
 using namespace nymeaserver;
 
 class TestJSONRPC: public NymeaTestBase
@@ -67,6 +71,12 @@ private slots:
     void testBasicCall_data();
     void testBasicCall();
 
+    void testBatchCall();
+
+    void testCborEncoding();
+    void cachedReplies();
+    void testCompressionFallback();
+
     void introspect();
 
     void enableDisableNotifications_legacy_data();
@@ -78,6 +88,12 @@ private slots:
 
     void stateChangeEmitsNotifications();
 
+    void notificationFilters();
+    void notificationFiltersThingRemoved();
+    void notificationThrottling();
+    void notificationThrottlingUnthrottledState();
+    void notificationThrottlingThingRemoved();
+
     void pluginConfigChangeEmitsNotification();
 
     /*
@@ -608,6 +624,7 @@ void TestJSONRPC::testBasicCall_data()
     QTest::newRow("missing id") << QByteArray("{\"method\":\"JSONRPC.Introspect\", \"token\": \"" + m_apiToken + "\"}\n") << false << false;
     QTest::newRow("missing method") << QByteArray("{\"id\":42, \"token\": \"" + m_apiToken + "\"}\n") << true << false;
     QTest::newRow("borked") << QByteArray("{\"id\":42,, \"token\": \"" + m_apiToken + "\" \"method\":\"JSO}\n") << false << false;
+    QTest::newRow("garbage") << QByteArray("garbage without newline") << false << false;
     QTest::newRow("invalid function") << QByteArray("{\"id\":42, \"method\":\"JSONRPC.Foobar\", \"token\": \"" + m_apiToken + "\"}\n") << true << false;
     QTest::newRow("invalid namespace") << QByteArray("{\"id\":42, \"method\":\"FOO.Introspect\", \"token\": \"" + m_apiToken + "\"}\n") << true << false;
     QTest::newRow("missing dot") << QByteArray("{\"id\":42, \"method\":\"JSONRPCIntrospect\", \"token\": \"" + m_apiToken + "\"}\n") << true << false;
@@ -649,6 +666,248 @@ void TestJSONRPC::testBasicCall()
     }
 }
 
+void TestJSONRPC::testBatchCall()
+{
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    QVERIFY(spy.isValid());
+
+    QByteArray call = "["
+            "{\"id\":1, \"method\":\"JSONRPC.Version\", \"token\": \"" + m_apiToken + "\"},"
+            "{\"id\":2, \"method\":\"JSONRPC.Foobar\", \"token\": \"" + m_apiToken + "\"},"
+            "{\"id\":3, \"method\":\"Integrations.GetVendors\", \"token\": \"" + m_apiToken + "\"}"
+            "]\n";
+    m_mockTcpServer->injectData(m_clientId, call);
+
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+
+    // All responses come in a single array, in the order of the requests
+    QCOMPARE(spy.count(), 1);
+    QJsonParseError error;
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(spy.first().last().toByteArray(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY(jsonDoc.isArray());
+
+    QVariantList responses = jsonDoc.toVariant().toList();
+    QCOMPARE(responses.count(), 3);
+    QCOMPARE(responses.at(0).toMap().value("id").toInt(), 1);
+    QCOMPARE(responses.at(0).toMap().value("status").toString(), QString("success"));
+    QCOMPARE(responses.at(1).toMap().value("id").toInt(), 2);
+    QCOMPARE(responses.at(1).toMap().value("status").toString(), QString("error"));
+    QCOMPARE(responses.at(2).toMap().value("id").toInt(), 3);
+    QCOMPARE(responses.at(2).toMap().value("status").toString(), QString("success"));
+    QVERIFY(responses.at(2).toMap().value("params").toMap().contains("vendors"));
+
+    // An empty batch is an error
+    spy.clear();
+    m_mockTcpServer->injectData(m_clientId, "[]\n");
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    jsonDoc = QJsonDocument::fromJson(spy.first().last().toByteArray());
+    QCOMPARE(jsonDoc.toVariant().toMap().value("status").toString(), QString("error"));
+}
+
+void TestJSONRPC::testCborEncoding()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+    QSKIP("CBOR encoding requires Qt 5.12");
+#else
+    QUuid newClientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    QVERIFY(spy.isValid());
+
+    // Request CBOR encoding. The reply is still JSON encoded
+    m_mockTcpServer->injectData(newClientId, "{\"id\":1, \"method\":\"JSONRPC.Hello\", \"params\": {\"encoding\": \"EncodingCbor\"}}\n");
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    QJsonParseError error;
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(spy.first().last().toByteArray(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(jsonDoc.toVariant().toMap().value("params").toMap().value("encoding").toString(), QString("EncodingCbor"));
+
+    // Send a CBOR request in two chunks
+    spy.clear();
+    QVariantMap request;
+    request.insert("id", 2);
+    request.insert("method", "JSONRPC.Version");
+    request.insert("token", m_apiToken);
+    QByteArray data = QCborValue::fromVariant(request).toCbor();
+    m_mockTcpServer->injectData(newClientId, data.left(5));
+    qApp->processEvents();
+    QCOMPARE(spy.count(), 0);
+    m_mockTcpServer->injectData(newClientId, data.mid(5));
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    QCborParserError cborError;
+    QVariantMap response = QCborValue::fromCbor(spy.first().last().toByteArray(), &cborError).toVariant().toMap();
+    QCOMPARE(cborError.error, QCborError::NoError);
+    QCOMPARE(response.value("id").toInt(), 2);
+    QCOMPARE(response.value("status").toString(), QString("success"));
+    QVERIFY(response.value("params").toMap().contains("protocol version"));
+
+    // Several requests in one chunk, followed by the start of another one
+    spy.clear();
+    QByteArray chunk;
+    for (int i = 0; i < 3; i++) {
+        request.insert("id", 10 + i);
+        chunk.append(QCborValue::fromVariant(request).toCbor());
+    }
+    request.insert("id", 13);
+    QByteArray last = QCborValue::fromVariant(request).toCbor();
+    m_mockTcpServer->injectData(newClientId, chunk + last.left(3));
+    while (spy.count() < 3 && spy.wait()) { }
+    QCOMPARE(spy.count(), 3);
+    for (int i = 0; i < 3; i++) {
+        response = QCborValue::fromCbor(spy.at(i).last().toByteArray(), &cborError).toVariant().toMap();
+        QCOMPARE(cborError.error, QCborError::NoError);
+        QCOMPARE(response.value("id").toInt(), 10 + i);
+    }
+    spy.clear();
+    m_mockTcpServer->injectData(newClientId, last.mid(3));
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    response = QCborValue::fromCbor(spy.first().last().toByteArray(), &cborError).toVariant().toMap();
+    QCOMPARE(cborError.error, QCborError::NoError);
+    QCOMPARE(response.value("id").toInt(), 13);
+
+    // UUIDs are sent as binary UUIDs
+    spy.clear();
+    request.insert("id", 3);
+    request.insert("method", "Integrations.GetThings");
+    m_mockTcpServer->injectData(newClientId, QCborValue::fromVariant(request).toCbor());
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    response = QCborValue::fromCbor(spy.first().last().toByteArray(), &cborError).toVariant().toMap();
+    QCOMPARE(cborError.error, QCborError::NoError);
+    QVariantList things = response.value("params").toMap().value("things").toList();
+    QVERIFY(!things.isEmpty());
+    foreach (const QVariant &thing, things) {
+        QCOMPARE(thing.toMap().value("id").type(), QVariant::Uuid);
+    }
+
+    // Switch back to JSON
+    spy.clear();
+    request.insert("id", 4);
+    request.insert("method", "JSONRPC.Hello");
+    request.insert("params", QVariantMap{{"encoding", "EncodingJson"}});
+    m_mockTcpServer->injectData(newClientId, QCborValue::fromVariant(request).toCbor());
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    response = QCborValue::fromCbor(spy.first().last().toByteArray(), &cborError).toVariant().toMap();
+    QCOMPARE(cborError.error, QCborError::NoError);
+    QCOMPARE(response.value("params").toMap().value("encoding").toString(), QString("EncodingJson"));
+
+    spy.clear();
+    m_mockTcpServer->injectData(newClientId, "{\"id\":5, \"method\":\"JSONRPC.Version\", \"token\": \"" + m_apiToken + "\"}\n");
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    jsonDoc = QJsonDocument::fromJson(spy.first().last().toByteArray(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(jsonDoc.toVariant().toMap().value("id").toInt(), 5);
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+#endif
+}
+
+void TestJSONRPC::cachedReplies()
+{
+    QUuid newClientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    QVERIFY(spy.isValid());
+    auto call = [&](int id, const QString &method) {
+        spy.clear();
+        m_mockTcpServer->injectData(newClientId, QString("{\"id\":%1, \"method\":\"%2\", \"token\": \"%3\"}\n").arg(id).arg(method).arg(QString(m_apiToken)).toUtf8());
+        if (spy.count() == 0) {
+            spy.wait();
+        }
+        return spy.count() == 1 ? spy.first().last().toByteArray() : QByteArray();
+    };
+
+    // The second reply is put together from the cached params, it must look exactly like a serialized one
+    QByteArray first = call(1, "Integrations.GetVendors");
+    QByteArray second = call(2, "Integrations.GetVendors");
+    QJsonParseError error;
+    QVariantMap firstResponse = QJsonDocument::fromJson(first, &error).toVariant().toMap();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVariantMap secondResponse = QJsonDocument::fromJson(second, &error).toVariant().toMap();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(firstResponse.value("id").toInt(), 1);
+    QCOMPARE(secondResponse.value("id").toInt(), 2);
+    QCOMPARE(secondResponse.value("status").toString(), QString("success"));
+    QVERIFY(!secondResponse.value("params").toMap().value("vendors").toList().isEmpty());
+    QCOMPARE(secondResponse.value("params"), firstResponse.value("params"));
+    QCOMPARE(second, QJsonDocument::fromVariant(secondResponse).toJson(QJsonDocument::Compact));
+
+    // Other methods are cached separately
+    QVariantMap thingClassesResponse = QJsonDocument::fromJson(call(3, "Integrations.GetThingClasses")).toVariant().toMap();
+    QCOMPARE(thingClassesResponse.value("id").toInt(), 3);
+    QVERIFY(!thingClassesResponse.value("params").toMap().value("thingClasses").toList().isEmpty());
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    // CBOR encoded clients get their own cached params
+    spy.clear();
+    m_mockTcpServer->injectData(newClientId, "{\"id\":4, \"method\":\"JSONRPC.Hello\", \"params\": {\"encoding\": \"EncodingCbor\"}}\n");
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    for (int id = 5; id < 7; id++) {
+        spy.clear();
+        QVariantMap request;
+        request.insert("id", id);
+        request.insert("method", "Integrations.GetVendors");
+        request.insert("token", m_apiToken);
+        m_mockTcpServer->injectData(newClientId, QCborValue::fromVariant(request).toCbor());
+        if (spy.count() == 0) {
+            spy.wait();
+        }
+        QCOMPARE(spy.count(), 1);
+        QCborParserError cborError;
+        QVariantMap response = QCborValue::fromCbor(spy.first().last().toByteArray(), &cborError).toVariant().toMap();
+        QCOMPARE(cborError.error, QCborError::NoError);
+        QCOMPARE(response.value("id").toInt(), id);
+        QCOMPARE(response.value("status").toString(), QString("success"));
+        QCOMPARE(response.value("params").toMap().value("vendors").toList().count(), secondResponse.value("params").toMap().value("vendors").toList().count());
+    }
+#endif
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+}
+
+void TestJSONRPC::testCompressionFallback()
+{
+    // The mock transport can't compress. Compression must not be enabled on it.
+    QVariantMap params;
+    params.insert("compression", "CompressionDeflate");
+    QVariant response = injectAndWait("JSONRPC.Hello", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(response.toMap().value("params").toMap().value("compression").toString(), QString("CompressionNone"));
+
+    response = injectAndWait("JSONRPC.Version");
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+}
+
 void TestJSONRPC::introspect()
 {
     QVariant response = injectAndWait("JSONRPC.Introspect");
@@ -962,6 +1221,279 @@ void TestJSONRPC::stateChangeEmitsNotifications()
     QCOMPARE(response.toMap().value("params").toMap().value("value").toInt(), newVal);
 }
 
+void TestJSONRPC::notificationFilters()
+{
+    enableNotifications({"Integrations"});
+    QUuid stateTypeId("80baec19-54de-4948-ac46-31eabfaceb83");
+
+    // Filter for a thing which doesn't exist
+    QVariantMap filter;
+    filter.insert("thingIds", QVariantList() << QUuid::createUuid());
+    QVariantMap params;
+    params.insert("filters", QVariantList() << filter);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationFilters", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("filters").toList().count(), 1);
+
+    QNetworkAccessManager nam;
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(12)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    clientSpy.wait(500);
+    QVERIFY2(checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty(), "Got a StateChanged notification not matching the filter.");
+
+    // Filter for the mock thing and state
+    filter.clear();
+    filter.insert("thingIds", QVariantList() << m_mockThingId);
+    filter.insert("stateTypeIds", QVariantList() << stateTypeId);
+    filter.insert("notifications", QStringList() << "Integrations.StateChanged");
+    params.insert("filters", QVariantList() << filter);
+    response = injectAndWait("JSONRPC.SetNotificationFilters", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("filters").toList().count(), 1);
+
+    clientSpy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(13)));
+    reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy replySpy(reply, SIGNAL(finished()));
+    replySpy.wait();
+    QVariantList stateChangedVariants = checkNotifications(clientSpy, "Integrations.StateChanged");
+    QVERIFY2(!stateChangedVariants.isEmpty(), "Did not get Integrations.StateChanged notification matching the filter.");
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("stateTypeId").toUuid(), stateTypeId);
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("value").toInt(), 13);
+
+    // A client matching through a filter for the thing and through one for any thing gets it only once
+    QVariantMap anyThingFilter;
+    anyThingFilter.insert("notifications", QStringList() << "Integrations.StateChanged");
+    params.insert("filters", QVariantList() << filter << anyThingFilter);
+    response = injectAndWait("JSONRPC.SetNotificationFilters", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("filters").toList().count(), 2);
+
+    clientSpy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(14)));
+    reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy mixedReplySpy(reply, SIGNAL(finished()));
+    mixedReplySpy.wait();
+    clientSpy.wait(200);
+    QCOMPARE(checkNotifications(clientSpy, "Integrations.StateChanged").count(), 1);
+
+    // Remove filters again, the client gets everything of its namespaces then
+    params.insert("filters", QVariantList());
+    response = injectAndWait("JSONRPC.SetNotificationFilters", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("filters").toList().count(), 0);
+
+    clientSpy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(15)));
+    reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy unfilteredReplySpy(reply, SIGNAL(finished()));
+    unfilteredReplySpy.wait();
+    stateChangedVariants = checkNotifications(clientSpy, "Integrations.StateChanged");
+    QVERIFY2(!stateChangedVariants.isEmpty(), "Did not get Integrations.StateChanged notification after removing the filters.");
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("value").toInt(), 15);
+    QCOMPARE(disableNotifications(), true);
+}
+
+void TestJSONRPC::notificationFiltersThingRemoved()
+{
+    enableNotifications({"Integrations"});
+
+    QVariantMap filter;
+    filter.insert("interfaces", QStringList() << "light");
+    QVariantMap params;
+    params.insert("filters", QVariantList() << filter);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationFilters", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("filters").toList().count(), 1);
+
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    params.clear();
+    params.insert("thingClassId", virtualIoLightMockThingClassId);
+    params.insert("name", "Filtered light");
+    response = injectAndWait("Integrations.AddThing", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    ThingId lightId = response.toMap().value("params").toMap().value("thingId").toUuid();
+    QCOMPARE(checkNotification(clientSpy, "Integrations.ThingAdded").toMap().value("params").toMap().value("thing").toMap().value("id").toUuid(), QUuid(lightId));
+
+    params.insert("thingClassId", genericIoMockThingClassId);
+    params.insert("name", "Filtered generic IO");
+    clientSpy.clear();
+    response = injectAndWait("Integrations.AddThing", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    ThingId genericId = response.toMap().value("params").toMap().value("thingId").toUuid();
+    QVERIFY2(checkNotifications(clientSpy, "Integrations.ThingAdded").isEmpty(), "Got a ThingAdded notification not matching the filter.");
+
+    // The thing is gone by the time ThingRemoved is sent, it must still reach clients filtering for its interface
+    params.clear();
+    params.insert("thingId", lightId);
+    clientSpy.clear();
+    response = injectAndWait("Integrations.RemoveThing", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    QCOMPARE(checkNotification(clientSpy, "Integrations.ThingRemoved").toMap().value("params").toMap().value("thingId").toUuid(), QUuid(lightId));
+
+    // Clients which didn't get the thing don't get its removal either
+    params.insert("thingId", genericId);
+    clientSpy.clear();
+    response = injectAndWait("Integrations.RemoveThing", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    QVERIFY2(checkNotifications(clientSpy, "Integrations.ThingRemoved").isEmpty(), "Got a ThingRemoved notification not matching the filter.");
+
+    params.clear();
+    params.insert("filters", QVariantList());
+    response = injectAndWait("JSONRPC.SetNotificationFilters", params);
+    QCOMPARE(disableNotifications(), true);
+}
+
+void TestJSONRPC::notificationThrottling()
+{
+    enableNotifications({"Integrations"});
+    QUuid stateTypeId("80baec19-54de-4948-ac46-31eabfaceb83");
+
+    QVariantMap params;
+    params.insert("interval", 1000);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationThrottling", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("interval").toInt(), 1000);
+
+    QNetworkAccessManager nam;
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // Change the state three times in a row
+    for (int i = 20; i < 23; i++) {
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(i)));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        QSignalSpy replySpy(reply, SIGNAL(finished()));
+        replySpy.wait();
+    }
+
+    // Only the first change is sent right away
+    QVariantList stateChangedVariants = checkNotifications(clientSpy, "Integrations.StateChanged");
+    QCOMPARE(stateChangedVariants.count(), 1);
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("value").toInt(), 20);
+
+    // The latest value follows after the interval
+    QTest::qWait(1200);
+    stateChangedVariants = checkNotifications(clientSpy, "Integrations.StateChanged");
+    QCOMPARE(stateChangedVariants.count(), 2);
+    QCOMPARE(stateChangedVariants.last().toMap().value("params").toMap().value("value").toInt(), 22);
+
+    params.insert("interval", 0);
+    response = injectAndWait("JSONRPC.SetNotificationThrottling", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("interval").toInt(), 0);
+    QCOMPARE(disableNotifications(), true);
+}
+
+void TestJSONRPC::notificationThrottlingUnthrottledState()
+{
+    enableNotifications({"Integrations"});
+    QUuid intStateTypeId("80baec19-54de-4948-ac46-31eabfaceb83");
+    QUuid doubleStateTypeId("7cac53ee-7048-4dc9-b000-7b585390f34c");
+
+    // Only the int state is throttled
+    QVariantMap rule;
+    rule.insert("stateTypeId", intStateTypeId);
+    rule.insert("interval", 1000);
+    QVariantMap params;
+    params.insert("rules", QVariantList() << rule);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationThrottling", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("rules").toList().count(), 1);
+
+    QNetworkAccessManager nam;
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    auto setState = [&](const QUuid &stateTypeId, const QVariant &value) {
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(value.toString())));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        QSignalSpy replySpy(reply, SIGNAL(finished()));
+        replySpy.wait();
+    };
+    auto stateChanges = [&](const QUuid &stateTypeId) {
+        QVariantList values;
+        foreach (const QVariant &notification, checkNotifications(clientSpy, "Integrations.StateChanged")) {
+            QVariantMap notificationParams = notification.toMap().value("params").toMap();
+            if (notificationParams.value("stateTypeId").toUuid() == stateTypeId) {
+                values.append(notificationParams.value("value"));
+            }
+        }
+        return values;
+    };
+
+    // The second change is held back
+    setState(intStateTypeId, 30);
+    setState(intStateTypeId, 31);
+    QCOMPARE(stateChanges(intStateTypeId), QVariantList() << 30);
+
+    // An unthrottled state change goes out right away without releasing the held back one
+    setState(doubleStateTypeId, 42.5);
+    QCOMPARE(stateChanges(doubleStateTypeId), QVariantList() << 42.5);
+    QCOMPARE(stateChanges(intStateTypeId), QVariantList() << 30);
+
+    // The held back value follows after the interval
+    QTest::qWait(1200);
+    QCOMPARE(stateChanges(intStateTypeId), QVariantList() << 30 << 31);
+
+    params.clear();
+    params.insert("interval", 0);
+    params.insert("rules", QVariantList());
+    response = injectAndWait("JSONRPC.SetNotificationThrottling", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("rules").toList().count(), 0);
+    QCOMPARE(disableNotifications(), true);
+}
+
+void TestJSONRPC::notificationThrottlingThingRemoved()
+{
+    enableNotifications({"Integrations"});
+
+    QVariantMap params;
+    params.insert("interval", 1000);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationThrottling", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("interval").toInt(), 1000);
+
+    params.clear();
+    params.insert("thingClassId", virtualIoLightMockThingClassId);
+    params.insert("name", "Throttled light");
+    response = injectAndWait("Integrations.AddThing", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    ThingId lightId = response.toMap().value("params").toMap().value("thingId").toUuid();
+
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    auto setPower = [&](bool power) {
+        QVariantMap actionParam;
+        actionParam.insert("paramTypeId", virtualIoLightMockPowerActionPowerParamTypeId);
+        actionParam.insert("value", power);
+        QVariantMap params;
+        params.insert("thingId", lightId);
+        params.insert("actionTypeId", virtualIoLightMockPowerActionTypeId);
+        params.insert("params", QVariantList() << actionParam);
+        QVariant response = injectAndWait("Integrations.ExecuteAction", params);
+        verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    };
+
+    // The second change is held back
+    setPower(true);
+    setPower(false);
+    QCOMPARE(checkNotifications(clientSpy, "Integrations.StateChanged").count(), 1);
+
+    // Removing the thing drops it, nothing about the thing may follow its removal
+    params.clear();
+    params.insert("thingId", lightId);
+    clientSpy.clear();
+    response = injectAndWait("Integrations.RemoveThing", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    QCOMPARE(checkNotification(clientSpy, "Integrations.ThingRemoved").toMap().value("params").toMap().value("thingId").toUuid(), QUuid(lightId));
+
+    clientSpy.clear();
+    QTest::qWait(1200);
+    QCOMPARE(checkNotifications(clientSpy, "Integrations.StateChanged").count(), 0);
+
+    params.clear();
+    params.insert("interval", 0);
+    response = injectAndWait("JSONRPC.SetNotificationThrottling", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("interval").toInt(), 0);
+    QCOMPARE(disableNotifications(), true);
+}
+
 void TestJSONRPC::pluginConfigChangeEmitsNotification()
 {
     QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
@@ -0,0 +1,6 @@
+TARGET = nymeatestjsonvalidator
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testjsonvalidator.cpp
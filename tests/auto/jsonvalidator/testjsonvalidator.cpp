@@ -0,0 +1,538 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "jsonrpc/jsonvalidator.h"
+#include "jsonrpc/jsonhandler.h"
+
+#include <QColor>
+#include <QJsonDocument>
+
+using namespace nymeaserver;
+
+// The validator as it was before the API description got compiled into nodes. It walks the plain
+// API description for every value and serves as reference for the compiled one.
+class InterpretedValidator
+{
+public:
+    typedef JsonValidator::Result Result;
+
+    explicit InterpretedValidator(const QVariantMap &api): m_api(api) {}
+
+    Result validateParams(const QVariantMap &params, const QString &method) const
+    {
+        QVariantMap definition = m_api.value("methods").toMap().value(method).toMap().value("params").toMap();
+        Result result = validateMap(params, definition, QIODevice::WriteOnly);
+        result.setWhere(method + ", param " + result.where());
+        return result;
+    }
+
+    Result validateReturns(const QVariantMap &returns, const QString &method) const
+    {
+        QVariantMap definition = m_api.value("methods").toMap().value(method).toMap().value("returns").toMap();
+        Result result = validateMap(returns, definition, QIODevice::ReadOnly);
+        result.setWhere(method + ", returns " + result.where());
+        return result;
+    }
+
+private:
+    Result validateMap(const QVariantMap &map, const QVariantMap &definition, QIODevice::OpenMode openMode) const
+    {
+        foreach (const QString &key, definition.keys()) {
+            if (QRegExp("^([a-z]:)*o:.*").exactMatch(key)) {
+                continue;
+            }
+            if (QRegExp("^([a-z]:)*r:.*").exactMatch(key) && openMode.testFlag(QIODevice::WriteOnly)) {
+                continue;
+            }
+            QString trimmedKey = key;
+            trimmedKey.remove(QRegExp("^(o:|r:|d:)*"));
+            if (!map.contains(trimmedKey)) {
+                return Result(false, "Missing required key: " + key, key);
+            }
+        }
+
+        foreach (const QString &key, map.keys()) {
+            QVariant expectedValue = definition.value(key);
+            foreach (const QString &definitionKey, definition.keys()) {
+                if (QRegExp("(o:|r:|d:)*" + key).exactMatch(definitionKey)) {
+                    expectedValue = definition.value(definitionKey);
+                }
+            }
+            if (!expectedValue.isValid()) {
+                return Result(false, "Invalid key: " + key);
+            }
+            Result result = validateEntry(map.value(key), expectedValue, openMode);
+            if (!result.success()) {
+                result.setWhere(key + '.' + result.where());
+                return result;
+            }
+        }
+        return Result(true);
+    }
+
+    Result validateEntry(const QVariant &value, const QVariant &definition, QIODevice::OpenMode openMode) const
+    {
+        if (definition.type() == QVariant::String) {
+            QString expectedTypeName = definition.toString();
+
+            if (expectedTypeName.startsWith("$ref:")) {
+                QString refName = expectedTypeName;
+                refName.remove("$ref:");
+
+                QVariantMap enums = m_api.value("enums").toMap();
+                if (enums.contains(refName)) {
+                    if (!enums.value(refName).toList().contains(value.toString())) {
+                        return Result(false, "Expected enum value for" + refName + " but got " + value.toString());
+                    }
+                    return Result(true);
+                }
+                QVariantMap flags = m_api.value("flags").toMap();
+                if (flags.contains(refName)) {
+                    if (value.type() != QVariant::List && value.type() != QVariant::StringList) {
+                        return Result(false, "Expected flags " + refName + " but got " + value.toString());
+                    }
+                    foreach (const QVariant &flagsEntry, value.toList()) {
+                        Result result = validateEntry(flagsEntry, flags.value(refName).toList().first(), openMode);
+                        if (!result.success()) {
+                            return result;
+                        }
+                    }
+                    return Result(true);
+                }
+                return validateEntry(value, m_api.value("types").toMap().value(refName), openMode);
+            }
+
+            JsonHandler::BasicType expectedBasicType = JsonHandler::enumNameToValue<JsonHandler::BasicType>(expectedTypeName);
+            QVariant::Type expectedVariantType = JsonHandler::basicTypeToVariantType(expectedBasicType);
+            if (expectedBasicType != JsonHandler::Variant && !value.canConvert(expectedVariantType)) {
+                return Result(false, "Invalid value. Expected: " + expectedTypeName + ", Got: " + value.toString());
+            }
+            bool ok = true;
+            switch (expectedBasicType) {
+            case JsonHandler::Uuid:
+                if (value.toUuid().isNull()) {
+                    return Result(false, "Invalid Uuid: " + value.toString());
+                }
+                break;
+            case JsonHandler::Int:
+                value.toLongLong(&ok);
+                if (!ok) {
+                    return Result(false, "Invalid Int: " + value.toString());
+                }
+                break;
+            case JsonHandler::Uint:
+                value.toULongLong(&ok);
+                if (!ok) {
+                    return Result(false, "Invalid UInt: " + value.toString());
+                }
+                break;
+            case JsonHandler::Double:
+                value.toDouble(&ok);
+                if (!ok) {
+                    return Result(false, "Invalid Double: " + value.toString());
+                }
+                break;
+            case JsonHandler::Color:
+                if (!value.value<QColor>().isValid()) {
+                    return Result(false, "Invalid Color: " + value.toString());
+                }
+                break;
+            case JsonHandler::Time:
+                if (!QTime::fromString(value.toString(), "hh:mm").isValid()) {
+                    return Result(false, "Invalid Time: " + value.toString());
+                }
+                break;
+            default:
+                break;
+            }
+            return Result(true);
+        }
+
+        if (definition.type() == QVariant::Map) {
+            if (value.type() != QVariant::Map) {
+                return Result(false, "Invalid value. Expected a map but received: " + value.toString());
+            }
+            return validateMap(value.toMap(), definition.toMap(), openMode);
+        }
+
+        QVariant entryDefinition = definition.toList().first();
+        if (value.type() != QVariant::List && value.type() != QVariant::StringList) {
+            return Result(false, "Expected list of " + entryDefinition.toString() + " but got value of type " + value.typeName() + "\n" + QJsonDocument::fromVariant(value).toJson());
+        }
+        foreach (const QVariant &entry, value.toList()) {
+            Result result = validateEntry(entry, entryDefinition, openMode);
+            if (!result.success()) {
+                return result;
+            }
+        }
+        return Result(true);
+    }
+
+    QVariantMap m_api;
+};
+
+class TestJsonValidator: public NymeaTestBase
+{
+    Q_OBJECT
+
+private:
+    QVariantMap testApi() const;
+    void compare(const JsonValidator::Result &compiled, const JsonValidator::Result &interpreted);
+
+protected slots:
+    void initTestCase();
+
+private slots:
+    void compareParams_data();
+    void compareParams();
+
+    void compareReturns_data();
+    void compareReturns();
+
+    void compareServerApi_data();
+    void compareServerApi();
+
+    void recursiveTypes();
+    void typeAliases();
+    void addApi();
+};
+
+void TestJsonValidator::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+QVariantMap TestJsonValidator::testApi() const
+{
+    QVariantMap enums;
+    enums.insert("Shade", QVariantList() << "ShadeLight" << "ShadeDark");
+    enums.insert("Feature", QVariantList() << "FeatureA" << "FeatureB" << "FeatureC");
+
+    QVariantMap flags;
+    flags.insert("Features", QVariantList() << "$ref:Feature");
+
+    QVariantMap inner;
+    inner.insert("value", "Int");
+    inner.insert("o:label", "String");
+    inner.insert("r:id", "Uuid");
+    inner.insert("o:shade", "$ref:Shade");
+
+    QVariantMap outer;
+    outer.insert("name", "String");
+    outer.insert("o:inner", "$ref:Inner");
+    outer.insert("entries", QVariantList() << "$ref:Inner");
+    outer.insert("o:features", "$ref:Features");
+    outer.insert("d:legacy", "Bool");
+    outer.insert("o:nested", QVariantMap({{"color", "Color"}, {"o:r:since", "Time"}}));
+
+    QVariantMap types;
+    types.insert("Inner", inner);
+    types.insert("Outer", outer);
+    types.insert("Entries", QVariantList() << "$ref:Inner");
+
+    QVariantMap params;
+    params.insert("outer", "$ref:Outer");
+    params.insert("o:count", "Uint");
+    params.insert("o:ratio", "Double");
+    params.insert("o:tags", "StringList");
+    params.insert("o:any", "Variant");
+
+    QVariantMap returns;
+    returns.insert("entries", "$ref:Entries");
+    returns.insert("r:id", "Uuid");
+    returns.insert("o:shade", "$ref:Shade");
+
+    QVariantMap method;
+    method.insert("params", params);
+    method.insert("returns", returns);
+    QVariantMap methods;
+    methods.insert("Test.Method", method);
+
+    QVariantMap api;
+    api.insert("enums", enums);
+    api.insert("flags", flags);
+    api.insert("types", types);
+    api.insert("methods", methods);
+    return api;
+}
+
+void TestJsonValidator::compare(const JsonValidator::Result &compiled, const JsonValidator::Result &interpreted)
+{
+    QCOMPARE(compiled.success(), interpreted.success());
+    QCOMPARE(compiled.errorString(), interpreted.errorString());
+    QCOMPARE(compiled.where(), interpreted.where());
+}
+
+void TestJsonValidator::compareParams_data()
+{
+    QTest::addColumn<QVariantMap>("params");
+    QTest::addColumn<bool>("valid");
+
+    QVariantMap inner({{"value", 5}});
+    QVariantMap outer({{"name", "outer"}, {"legacy", true}, {"entries", QVariantList() << inner}});
+
+    QTest::newRow("minimal") << QVariantMap({{"outer", outer}}) << true;
+
+    QVariantMap full = outer;
+    full.insert("inner", QVariantMap({{"value", "7"}, {"label", "seven"}, {"id", QUuid::createUuid()}, {"shade", "ShadeDark"}}));
+    full.insert("features", QVariantList() << "FeatureA" << "FeatureC");
+    full.insert("nested", QVariantMap({{"color", "#ff0000"}, {"since", "12:30"}}));
+    QTest::newRow("all optionals") << QVariantMap({{"outer", full}, {"count", 3}, {"ratio", 0.5}, {"tags", QStringList() << "a"}, {"any", QVariantList()}}) << true;
+
+    QTest::newRow("missing param") << QVariantMap() << false;
+    QTest::newRow("unknown param") << QVariantMap({{"outer", outer}, {"unknown", 1}}) << false;
+
+    QVariantMap missingNested = outer;
+    missingNested.insert("entries", QVariantList() << inner << QVariantMap({{"label", "no value"}}));
+    QTest::newRow("missing nested key") << QVariantMap({{"outer", missingNested}}) << false;
+
+    QVariantMap unknownNested = outer;
+    unknownNested.insert("inner", QVariantMap({{"value", 1}, {"colour", "red"}}));
+    QTest::newRow("unknown nested key") << QVariantMap({{"outer", unknownNested}}) << false;
+
+    QVariantMap missingDeprecated = outer;
+    missingDeprecated.remove("legacy");
+    QTest::newRow("missing deprecated key") << QVariantMap({{"outer", missingDeprecated}}) << false;
+
+    QVariantMap badEnum = outer;
+    badEnum.insert("inner", QVariantMap({{"value", 1}, {"shade", "ShadeMedium"}}));
+    QTest::newRow("invalid enum") << QVariantMap({{"outer", badEnum}}) << false;
+
+    QVariantMap badFlag = outer;
+    badFlag.insert("features", QVariantList() << "FeatureA" << "FeatureD");
+    QTest::newRow("invalid flag") << QVariantMap({{"outer", badFlag}}) << false;
+
+    QVariantMap flagNoList = outer;
+    flagNoList.insert("features", "FeatureA");
+    QTest::newRow("flags not a list") << QVariantMap({{"outer", flagNoList}}) << false;
+
+    QVariantMap badInt = outer;
+    badInt.insert("entries", QVariantList() << QVariantMap({{"value", "five"}}));
+    QTest::newRow("invalid int in list") << QVariantMap({{"outer", badInt}}) << false;
+
+    QVariantMap listNoList = outer;
+    listNoList.insert("entries", inner);
+    QTest::newRow("list not a list") << QVariantMap({{"outer", listNoList}}) << false;
+
+    QVariantMap mapNoMap = outer;
+    mapNoMap.insert("inner", 42);
+    QTest::newRow("map not a map") << QVariantMap({{"outer", mapNoMap}}) << false;
+
+    QVariantMap badUuid = outer;
+    badUuid.insert("inner", QVariantMap({{"value", 1}, {"id", "not a uuid"}}));
+    QTest::newRow("invalid uuid") << QVariantMap({{"outer", badUuid}}) << false;
+
+    QVariantMap badColor = outer;
+    badColor.insert("nested", QVariantMap({{"color", "nocolor"}}));
+    QTest::newRow("invalid color") << QVariantMap({{"outer", badColor}}) << false;
+
+    QVariantMap badTime = outer;
+    badTime.insert("nested", QVariantMap({{"color", "red"}, {"since", "25:99"}}));
+    QTest::newRow("invalid time") << QVariantMap({{"outer", badTime}}) << false;
+
+    QTest::newRow("invalid uint") << QVariantMap({{"outer", outer}, {"count", "many"}}) << false;
+    QTest::newRow("invalid double") << QVariantMap({{"outer", outer}, {"ratio", "half"}}) << false;
+}
+
+void TestJsonValidator::compareParams()
+{
+    QFETCH(QVariantMap, params);
+    QFETCH(bool, valid);
+
+    JsonValidator compiled;
+    compiled.setApi(testApi());
+    InterpretedValidator interpreted(testApi());
+
+    JsonValidator::Result result = compiled.validateParams(params, "Test.Method");
+    compare(result, interpreted.validateParams(params, "Test.Method"));
+    QCOMPARE(result.success(), valid);
+}
+
+void TestJsonValidator::compareReturns_data()
+{
+    QTest::addColumn<QVariantMap>("returns");
+    QTest::addColumn<bool>("valid");
+
+    QVariantMap inner({{"value", 1}, {"id", QUuid::createUuid()}});
+    QTest::newRow("valid") << QVariantMap({{"entries", QVariantList() << inner}, {"id", QUuid::createUuid()}}) << true;
+    QTest::newRow("with enum") << QVariantMap({{"entries", QVariantList()}, {"id", QUuid::createUuid()}, {"shade", "ShadeLight"}}) << true;
+
+    // Read only keys are required in returns
+    QTest::newRow("missing read only") << QVariantMap({{"entries", QVariantList()}}) << false;
+    QTest::newRow("missing nested read only") << QVariantMap({{"entries", QVariantList() << QVariantMap({{"value", 1}})}, {"id", QUuid::createUuid()}}) << false;
+    QTest::newRow("invalid enum") << QVariantMap({{"entries", QVariantList()}, {"id", QUuid::createUuid()}, {"shade", 1}}) << false;
+}
+
+void TestJsonValidator::compareReturns()
+{
+    QFETCH(QVariantMap, returns);
+    QFETCH(bool, valid);
+
+    JsonValidator compiled;
+    compiled.setApi(testApi());
+    InterpretedValidator interpreted(testApi());
+
+    JsonValidator::Result result = compiled.validateReturns(returns, "Test.Method");
+    compare(result, interpreted.validateReturns(returns, "Test.Method"));
+    QCOMPARE(result.success(), valid);
+}
+
+void TestJsonValidator::compareServerApi_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::addColumn<QVariantMap>("params");
+
+    QTest::newRow("JSONRPC.Hello") << "JSONRPC.Hello" << QVariantMap();
+    QTest::newRow("JSONRPC.Version") << "JSONRPC.Version" << QVariantMap();
+    QTest::newRow("Integrations.GetVendors") << "Integrations.GetVendors" << QVariantMap();
+    QTest::newRow("Integrations.GetThingClasses") << "Integrations.GetThingClasses" << QVariantMap();
+    QTest::newRow("Integrations.GetThings") << "Integrations.GetThings" << QVariantMap();
+    QTest::newRow("Integrations.GetPlugins") << "Integrations.GetPlugins" << QVariantMap();
+    QTest::newRow("Rules.GetRules") << "Rules.GetRules" << QVariantMap();
+}
+
+void TestJsonValidator::compareServerApi()
+{
+    QFETCH(QString, method);
+    QFETCH(QVariantMap, params);
+
+    QVariantMap api = injectAndWait("JSONRPC.Introspect").toMap().value("params").toMap();
+    QVERIFY(!api.value("methods").toMap().isEmpty());
+
+    JsonValidator compiled;
+    compiled.setApi(api);
+    InterpretedValidator interpreted(api);
+
+    compare(compiled.validateParams(params, method), interpreted.validateParams(params, method));
+
+    // The real replies, and a broken copy of them
+    QVariantMap returns = injectAndWait(method, params).toMap().value("params").toMap();
+    JsonValidator::Result result = compiled.validateReturns(returns, method);
+    compare(result, interpreted.validateReturns(returns, method));
+    QVERIFY2(result.success(), qUtf8Printable(result.errorString() + " in " + result.where()));
+
+    returns.insert("unexpected", true);
+    compare(compiled.validateReturns(returns, method), interpreted.validateReturns(returns, method));
+}
+
+void TestJsonValidator::recursiveTypes()
+{
+    // Types referring to themselves are resolved once when compiling
+    QVariantMap node;
+    node.insert("name", "String");
+    node.insert("o:children", QVariantList() << "$ref:Node");
+    QVariantMap method;
+    method.insert("params", QVariantMap({{"root", "$ref:Node"}}));
+    method.insert("returns", QVariantMap());
+    QVariantMap api;
+    api.insert("types", QVariantMap({{"Node", node}}));
+    api.insert("methods", QVariantMap({{"Test.Tree", method}}));
+
+    JsonValidator compiled;
+    compiled.setApi(api);
+    InterpretedValidator interpreted(api);
+
+    QVariantMap leaf({{"name", "leaf"}});
+    QVariantMap brokenLeaf({{"name", "leaf"}, {"children", 5}});
+    QVariantMap tree({{"name", "root"}, {"children", QVariantList() << QVariantMap({{"name", "branch"}, {"children", QVariantList() << leaf}})}});
+    QVariantMap brokenTree({{"name", "root"}, {"children", QVariantList() << QVariantMap({{"name", "branch"}, {"children", QVariantList() << brokenLeaf}})}});
+
+    QVariantMap params({{"root", tree}});
+    QVERIFY(compiled.validateParams(params, "Test.Tree").success());
+    compare(compiled.validateParams(params, "Test.Tree"), interpreted.validateParams(params, "Test.Tree"));
+
+    params.insert("root", brokenTree);
+    QVERIFY(!compiled.validateParams(params, "Test.Tree").success());
+    compare(compiled.validateParams(params, "Test.Tree"), interpreted.validateParams(params, "Test.Tree"));
+}
+
+void TestJsonValidator::typeAliases()
+{
+    // Aliases compiled before the type they refer to, and an alias of an alias
+    QVariantMap types;
+    types.insert("Zone", QVariantMap({{"name", "String"}, {"o:level", "Int"}}));
+    types.insert("Area", "$ref:Zone");
+    types.insert("Room", "$ref:Area");
+    types.insert("Label", "String");
+    QVariantMap method;
+    method.insert("params", QVariantMap({{"room", "$ref:Room"}, {"o:label", "$ref:Label"}}));
+    method.insert("returns", QVariantMap());
+    QVariantMap api;
+    api.insert("types", types);
+    api.insert("methods", QVariantMap({{"Test.Alias", method}}));
+
+    JsonValidator compiled;
+    compiled.setApi(api);
+
+    QVERIFY(compiled.validateParams(QVariantMap({{"room", QVariantMap({{"name", "kitchen"}, {"level", 1}})}}), "Test.Alias").success());
+    QVERIFY(compiled.validateParams(QVariantMap({{"room", QVariantMap({{"name", "kitchen"}})}, {"label", "first floor"}}), "Test.Alias").success());
+    QVERIFY(!compiled.validateParams(QVariantMap({{"room", QVariantMap({{"level", 1}})}}), "Test.Alias").success());
+    QVERIFY(!compiled.validateParams(QVariantMap({{"room", QVariantMap({{"name", "kitchen"}, {"level", "top"}})}}), "Test.Alias").success());
+    QVERIFY(!compiled.validateParams(QVariantMap({{"room", QVariantMap({{"name", "kitchen"}})}, {"label", 5}}), "Test.Alias").success());
+}
+
+void TestJsonValidator::addApi()
+{
+    // A second part of the API refers to the types of the first one, like handlers registered one after another
+    QVariantMap method;
+    method.insert("params", QVariantMap({{"outer", "$ref:Outer"}, {"o:shade", "$ref:Shade"}}));
+    method.insert("returns", QVariantMap({{"entries", "$ref:Entries"}}));
+    QVariantMap addition;
+    addition.insert("enums", QVariantMap({{"Shade", QVariantList() << "ShadeLight" << "ShadeDark"}}));
+    addition.insert("methods", QVariantMap({{"Test.Added", method}}));
+
+    JsonValidator compiled;
+    compiled.setApi(testApi());
+    compiled.addApi(addition);
+
+    QVariantMap full = testApi();
+    QVariantMap methods = full.value("methods").toMap();
+    methods.insert("Test.Added", method);
+    full.insert("methods", methods);
+    InterpretedValidator interpreted(full);
+
+    QVariantMap outer({{"name", "outer"}, {"entries", QVariantList() << QVariantMap({{"value", 5}})}});
+    QVariantMap params({{"outer", outer}, {"shade", "ShadeDark"}});
+    QVERIFY(compiled.validateParams(params, "Test.Added").success());
+    compare(compiled.validateParams(params, "Test.Added"), interpreted.validateParams(params, "Test.Added"));
+
+    params.insert("shade", "ShadeGrey");
+    QVERIFY(!compiled.validateParams(params, "Test.Added").success());
+    compare(compiled.validateParams(params, "Test.Added"), interpreted.validateParams(params, "Test.Added"));
+
+    // The first part is still there
+    QVariantMap returns({{"entries", QVariantList()}, {"id", QUuid::createUuid()}});
+    QVERIFY(compiled.validateReturns(returns, "Test.Method").success());
+}
+
+#include "testjsonvalidator.moc"
+QTEST_MAIN(TestJsonValidator)
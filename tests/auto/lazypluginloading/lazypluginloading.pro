@@ -0,0 +1,6 @@
+TARGET = nymeatestlazypluginloading
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testlazypluginloading.cpp
@@ -0,0 +1,201 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "nymeacore.h"
+#include "nymeasettings.h"
+
+#include "integrations/thingmanagerimplementation.h"
+
+#include <QTemporaryDir>
+
+using namespace nymeaserver;
+
+PluginId lazyPluginId = PluginId("7bbc5fe4-2ff2-4ba4-8b51-3a1f1d7fb9b1");
+ThingClassId lazyThingClassId = ThingClassId("0f6a9b7e-3d55-4c39-9b2e-0d4f3f4c2d9e");
+
+// A JS plugin with a user created thing class, which has nothing to do until a thing is added
+static const char *lazyPluginMetadata = R"({
+    "id": "7bbc5fe4-2ff2-4ba4-8b51-3a1f1d7fb9b1",
+    "name": "lazyTest",
+    "displayName": "Lazy loading test plugin",
+    "vendors": [
+        {
+            "id": "c1a8f1a3-6f7b-4c5e-8a1e-2b9d8e4a7c31",
+            "name": "lazyTestVendor",
+            "displayName": "Lazy test vendor",
+            "thingClasses": [
+                {
+                    "id": "0f6a9b7e-3d55-4c39-9b2e-0d4f3f4c2d9e",
+                    "name": "lazyThing",
+                    "displayName": "Lazy thing",
+                    "createMethods": ["user"],
+                    "setupMethod": "justAdd"
+                }
+            ]
+        }
+    ]
+})";
+
+class TestLazyPluginLoading: public NymeaTestBase
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir m_pluginDir;
+
+    ThingManagerImplementation *thingManager() const;
+    ThingId addLazyThing();
+
+protected slots:
+    void initTestCase();
+
+private slots:
+    void init();
+
+    void pluginRegisteredWithoutLoading();
+    void autoThingPluginsActivated();
+    void activateOnAddThing();
+    void activateOnStartupForConfiguredThings();
+};
+
+ThingManagerImplementation *TestLazyPluginLoading::thingManager() const
+{
+    return static_cast<ThingManagerImplementation *>(NymeaCore::instance()->thingManager());
+}
+
+void TestLazyPluginLoading::initTestCase()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+    QSKIP("JS plugins are not supported with this Qt version");
+#endif
+
+    QFile metadata(m_pluginDir.filePath("integrationpluginlazytest.json"));
+    QVERIFY(metadata.open(QFile::WriteOnly));
+    metadata.write(lazyPluginMetadata);
+    metadata.close();
+    QFile script(m_pluginDir.filePath("integrationpluginlazytest.js"));
+    QVERIFY(script.open(QFile::WriteOnly));
+    script.write("export function init() { }\n");
+    script.close();
+    qputenv("NYMEA_PLUGINS_EXTRA_PATH", m_pluginDir.path().toUtf8());
+
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\nThingManager.debug=true");
+
+    // The settings are reset by the test base, enable lazy loading and start over
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("ThingManager");
+    settings.setValue("lazyPluginLoading", true);
+    settings.endGroup();
+    restartServer();
+}
+
+void TestLazyPluginLoading::init()
+{
+    // Every test starts without lazy things and with the lazy plugin not loaded
+    foreach (Thing *thing, thingManager()->findConfiguredThings(lazyThingClassId)) {
+        QVariantMap params;
+        params.insert("thingId", thing->id());
+        QVariant response = injectAndWait("Integrations.RemoveThing", params);
+        verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    }
+    if (thingManager()->isPluginActive(lazyPluginId)) {
+        restartServer();
+    }
+    QVERIFY(!thingManager()->isPluginActive(lazyPluginId));
+}
+
+ThingId TestLazyPluginLoading::addLazyThing()
+{
+    QVariantMap params;
+    params.insert("thingClassId", lazyThingClassId);
+    params.insert("name", "Lazy thing");
+    QVariant response = injectAndWait("Integrations.AddThing", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    return response.toMap().value("params").toMap().value("thingId").toUuid();
+}
+
+void TestLazyPluginLoading::pluginRegisteredWithoutLoading()
+{
+    // Plugin, vendor and thing class are known from the metadata alone
+    QVariant response = injectAndWait("Integrations.GetPlugins");
+    bool found = false;
+    foreach (const QVariant &plugin, response.toMap().value("params").toMap().value("plugins").toList()) {
+        if (PluginId(plugin.toMap().value("id").toString()) == lazyPluginId) {
+            found = true;
+        }
+    }
+    QVERIFY2(found, "Inactive plugin not listed in Integrations.GetPlugins");
+
+    QVariantMap params;
+    params.insert("thingClassIds", QVariantList() << lazyThingClassId);
+    response = injectAndWait("Integrations.GetThingClasses", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("thingClasses").toList().count(), 1);
+
+    QVERIFY(!thingManager()->isPluginActive(lazyPluginId));
+}
+
+void TestLazyPluginLoading::autoThingPluginsActivated()
+{
+    // The mock plugin provides auto things and needs to run from the start to detect them
+    QVERIFY(thingManager()->isPluginActive(mockPluginId));
+}
+
+void TestLazyPluginLoading::activateOnAddThing()
+{
+    qRegisterMetaType<PluginId>();
+    QSignalSpy activatedSpy(thingManager(), &ThingManager::pluginActivated);
+
+    ThingId thingId = addLazyThing();
+
+    QVERIFY(thingManager()->isPluginActive(lazyPluginId));
+    // Announced, so cached plugin and thing class replies get built again
+    QCOMPARE(activatedSpy.count(), 1);
+    QCOMPARE(activatedSpy.first().first().value<PluginId>(), lazyPluginId);
+    Thing *thing = thingManager()->findConfiguredThing(thingId);
+    QVERIFY(thing);
+    QCOMPARE(thing->setupStatus(), Thing::ThingSetupStatusComplete);
+}
+
+void TestLazyPluginLoading::activateOnStartupForConfiguredThings()
+{
+    addLazyThing();
+    QCOMPARE(thingManager()->findConfiguredThings(lazyThingClassId).count(), 1);
+
+    // A configured thing needs its plugin right away
+    restartServer();
+    QVERIFY(thingManager()->isPluginActive(lazyPluginId));
+    QCOMPARE(thingManager()->findConfiguredThings(lazyThingClassId).count(), 1);
+    Thing *thing = thingManager()->findConfiguredThings(lazyThingClassId).first();
+    QTRY_COMPARE(thing->setupStatus(), Thing::ThingSetupStatusComplete);
+}
+
+#include "testlazypluginloading.moc"
+QTEST_MAIN(TestLazyPluginLoading)
@@ -32,6 +32,7 @@
 #include "nymeacore.h"
 #include "servers/mqttbroker.h"
 #include "servers/mocktcpserver.h"
+#include "hardware/network/mqtt/mqttproviderimplementation.h"
 
 #include <mqttclient.h>
 
@@ -57,6 +58,16 @@ private slots:
 
     void testSubscribePolicy_data();
     void testSubscribePolicy();
+
+    void publishBenchmark();
+
+    void channelRouting();
+    void channelPublishFiltering();
+    void channelRoutingBenchmark();
+
+private:
+    QList<MqttChannel *> createChannels(MqttProviderImplementation *provider, int count);
+    MqttClient *connectChannelClient(MqttChannel *channel);
 };
 
 void TestMqttBroker::initTestCase()
@@ -365,6 +376,12 @@ void TestMqttBroker::testPublishPolicy_data()
     QTest::newRow("/a/#, /b/a/c") << (QStringList() << "/a/#") << "/b/a/c" << false;
     QTest::newRow("/+/b/#, /a/b") << (QStringList() << "/+/b/#") << "/a/b" << true;
     QTest::newRow("/+/b/#, /b") << (QStringList() << "/+/b/#") << "/b" << false;
+    QTest::newRow("/a/b, /a") << (QStringList() << "/a/b") << "/a" << false;
+    QTest::newRow("a/+, a") << (QStringList() << "a/+") << "a" << false;
+    QTest::newRow("a/+, a/b") << (QStringList() << "a/+") << "a/b" << true;
+    QTest::newRow("a/+, a/b/c") << (QStringList() << "a/+") << "a/b/c" << false;
+    QTest::newRow("a/+/c, a/b/c") << (QStringList() << "a/+/c") << "a/b/c" << true;
+    QTest::newRow("a/b/# a/+/c, a/x/c") << (QStringList() << "a/b/#" << "a/+/c") << "a/x/c" << true;
 }
 
 void TestMqttBroker::testPublishPolicy()
@@ -447,6 +464,184 @@ void TestMqttBroker::testSubscribePolicy()
     QCOMPARE(clientSubscribedSpy.count(), (allowed ? 1 : 0));
 }
 
+void TestMqttBroker::publishBenchmark()
+{
+    // A client with a large policy, publishing telemetry to the last of its topics
+    MqttPolicy policy;
+    policy.clientId = "testclient";
+    policy.username = "testuser";
+    policy.password = "testpassword";
+    for (int i = 0; i < 500; i++) {
+        policy.allowedPublishTopicFilters.append(QString("devices/device%1/#").arg(i));
+        policy.allowedPublishTopicFilters.append(QString("devices/device%1/+/state").arg(i));
+    }
+    NymeaCore::instance()->configuration()->updateMqttPolicy(policy);
+
+    MqttClient* mqttClient = new MqttClient("testclient", this);
+    mqttClient->setUsername("testuser");
+    mqttClient->setPassword("testpassword");
+    mqttClient->setAutoReconnect(false);
+    QSignalSpy connectedSpy(mqttClient, &MqttClient::connected);
+    mqttClient->connectToHost("127.0.0.1", 1883);
+    QVERIFY2(connectedSpy.count() == 1 || connectedSpy.wait(), "Mqtt client didn't connect");
+
+    QSignalSpy publishReceivedSpy(NymeaCore::instance()->serverManager()->mqttBroker(), &MqttBroker::publishReceived);
+
+    const int messages = 1000;
+    QBENCHMARK {
+        publishReceivedSpy.clear();
+        for (int i = 0; i < messages; i++) {
+            mqttClient->publish("devices/device499/sensor/temperature", "21.5");
+        }
+        while (publishReceivedSpy.count() < messages) {
+            QVERIFY(publishReceivedSpy.wait());
+        }
+    }
+
+    mqttClient->deleteLater();
+}
+
+
+QList<MqttChannel *> TestMqttBroker::createChannels(MqttProviderImplementation *provider, int count)
+{
+    QList<MqttChannel *> channels;
+    for (int i = 0; i < count; i++) {
+        MqttChannel *channel = provider->createChannel(QString("channel%1").arg(i), QHostAddress::LocalHost, QStringList() << QString("devices/device%1").arg(i));
+        if (!channel) {
+            qCWarning(dcTests()) << "Could not create MQTT channel" << i;
+            break;
+        }
+        channels.append(channel);
+    }
+    return channels;
+}
+
+MqttClient *TestMqttBroker::connectChannelClient(MqttChannel *channel)
+{
+    MqttClient* mqttClient = new MqttClient(channel->clientId(), this);
+    mqttClient->setUsername(channel->username());
+    mqttClient->setPassword(channel->password());
+    mqttClient->setAutoReconnect(false);
+    QSignalSpy connectedSpy(mqttClient, &MqttClient::connected);
+    mqttClient->connectToHost("127.0.0.1", 1883);
+    if (connectedSpy.count() == 0 && !connectedSpy.wait()) {
+        delete mqttClient;
+        return nullptr;
+    }
+    return mqttClient;
+}
+
+void TestMqttBroker::channelRouting()
+{
+    MqttProviderImplementation provider(NymeaCore::instance()->serverManager()->mqttBroker());
+    QList<MqttChannel *> channels = createChannels(&provider, 2000);
+    QCOMPARE(channels.count(), 2000);
+
+    MqttChannel *channel = channels.at(1234);
+    QSignalSpy channelSpy(channel, &MqttChannel::publishReceived);
+    QSignalSpy neighbourSpy(channels.at(1235), &MqttChannel::publishReceived);
+    // Prefixes match whole topic levels, devices/device12 is not a prefix of devices/device1234
+    QSignalSpy shortPrefixSpy(channels.at(12), &MqttChannel::publishReceived);
+
+    MqttClient *mqttClient = connectChannelClient(channel);
+    QVERIFY2(mqttClient, "Mqtt client didn't connect");
+
+    mqttClient->publish("devices/device1234/sensor/temperature", "21.5");
+    QVERIFY(channelSpy.wait());
+    QCOMPARE(channelSpy.count(), 1);
+    QCOMPARE(channelSpy.first().at(1).toString(), QString("devices/device1234/sensor/temperature"));
+    QCOMPARE(channelSpy.first().at(2).toByteArray(), QByteArray("21.5"));
+    QCOMPARE(neighbourSpy.count(), 0);
+    QCOMPARE(shortPrefixSpy.count(), 0);
+
+    // Topics of other channels are denied by the policy and never routed
+    mqttClient->publish("devices/device1235/sensor/temperature", "21.5");
+    QVERIFY(!neighbourSpy.wait(400));
+    QCOMPARE(channelSpy.count(), 1);
+
+    // Other clients publishing within the channel's topic prefix are not routed to it
+    MqttClient *internalClient = provider.createInternalClient("routingtestclient");
+    QSignalSpy connectedSpy(internalClient, &MqttClient::connected);
+    QVERIFY(connectedSpy.wait());
+    QSignalSpy publishReceivedSpy(NymeaCore::instance()->serverManager()->mqttBroker(), &MqttBroker::publishReceived);
+    internalClient->publish("devices/device1234/sensor/temperature", "22.5");
+    QVERIFY(publishReceivedSpy.wait());
+    QCOMPARE(publishReceivedSpy.first().at(0).toString(), QString("routingtestclient"));
+    QVERIFY(!channelSpy.wait(400));
+    QCOMPARE(channelSpy.count(), 1);
+
+    // Released channels don't get anything anymore, not even from their own client
+    MqttClient *neighbourClient = connectChannelClient(channels.at(1235));
+    QVERIFY2(neighbourClient, "Mqtt client didn't connect");
+    provider.releaseChannel(channels.takeAt(1235));
+    neighbourClient->publish("devices/device1235/sensor/temperature", "21.5");
+    mqttClient->publish("devices/device1234/sensor/temperature", "22.5");
+    QVERIFY(channelSpy.wait());
+    QCOMPARE(channelSpy.count(), 2);
+    QVERIFY(!neighbourSpy.wait(400));
+    QCOMPARE(neighbourSpy.count(), 0);
+
+    delete neighbourClient;
+    delete mqttClient;
+    delete internalClient;
+    foreach (MqttChannel *remainingChannel, channels) {
+        provider.releaseChannel(remainingChannel);
+    }
+}
+
+void TestMqttBroker::channelPublishFiltering()
+{
+    MqttProviderImplementation provider(NymeaCore::instance()->serverManager()->mqttBroker());
+    MqttChannel *channel = provider.createChannel("filteringchannel", QHostAddress::LocalHost, QStringList() << "plugin/device");
+    QVERIFY(channel);
+
+    MqttClient *subscriber = provider.createInternalClient("filteringsubscriber");
+    QSignalSpy connectedSpy(subscriber, &MqttClient::connected);
+    QVERIFY(connectedSpy.wait());
+    QSignalSpy subscribedSpy(NymeaCore::instance()->serverManager()->mqttBroker(), &MqttBroker::clientSubscribed);
+    subscriber->subscribe("#");
+    QVERIFY(subscribedSpy.wait());
+
+    QSignalSpy receivedSpy(subscriber, &MqttClient::publishReceived);
+    channel->publish("other/device/state", "on");
+    channel->publish("plugin/devices/state", "on");
+    channel->publish("plugin/device/state", "on");
+    QVERIFY(receivedSpy.wait());
+    receivedSpy.wait(200);
+    QCOMPARE(receivedSpy.count(), 1);
+    QCOMPARE(receivedSpy.first().at(0).toString(), QString("plugin/device/state"));
+
+    delete subscriber;
+    provider.releaseChannel(channel);
+}
+
+void TestMqttBroker::channelRoutingBenchmark()
+{
+    MqttProviderImplementation provider(NymeaCore::instance()->serverManager()->mqttBroker());
+    QList<MqttChannel *> channels = createChannels(&provider, 5000);
+    QCOMPARE(channels.count(), 5000);
+
+    MqttChannel *channel = channels.last();
+    MqttClient *mqttClient = connectChannelClient(channel);
+    QVERIFY2(mqttClient, "Mqtt client didn't connect");
+    QSignalSpy channelSpy(channel, &MqttChannel::publishReceived);
+
+    const int messages = 1000;
+    QBENCHMARK {
+        channelSpy.clear();
+        for (int i = 0; i < messages; i++) {
+            mqttClient->publish("devices/device4999/sensor/temperature", "21.5");
+        }
+        while (channelSpy.count() < messages) {
+            QVERIFY(channelSpy.wait());
+        }
+    }
+
+    delete mqttClient;
+    foreach (MqttChannel *remainingChannel, channels) {
+        provider.releaseChannel(remainingChannel);
+    }
+}
 
 #include "testmqttbroker.moc"
 QTEST_MAIN(TestMqttBroker)
@@ -0,0 +1,6 @@
+TARGET = nymeatestmqtttopictrie
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testmqtttopictrie.cpp
@@ -0,0 +1,152 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "servers/mqtttopictrie.h"
+
+using namespace nymeaserver;
+
+class TestMqttTopicTrie: public NymeaTestBase
+{
+    Q_OBJECT
+
+protected slots:
+    void initTestCase();
+
+private slots:
+    void matches_data();
+    void matches();
+    void matchKeys();
+    void remove();
+    void matchBenchmark();
+};
+
+void TestMqttTopicTrie::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+void TestMqttTopicTrie::matches_data()
+{
+    QTest::addColumn<QString>("filter");
+    QTest::addColumn<QString>("topic");
+    QTest::addColumn<bool>("matches");
+
+    QTest::newRow("#, /") << "#" << "/" << true;
+    QTest::newRow("#, a/b") << "#" << "a/b" << true;
+    QTest::newRow("a, a") << "a" << "a" << true;
+    QTest::newRow("a, b") << "a" << "b" << false;
+    QTest::newRow("a, a/b") << "a" << "a/b" << false;
+    QTest::newRow("a/b, a") << "a/b" << "a" << false;
+    QTest::newRow("a/#, a") << "a/#" << "a" << true;
+    QTest::newRow("a/#, a/b/c") << "a/#" << "a/b/c" << true;
+    QTest::newRow("a/#, ab/c") << "a/#" << "ab/c" << false;
+    QTest::newRow("a/+, a") << "a/+" << "a" << false;
+    QTest::newRow("a/+, a/b") << "a/+" << "a/b" << true;
+    QTest::newRow("a/+, a/") << "a/+" << "a/" << true;
+    QTest::newRow("a/+, a/b/c") << "a/+" << "a/b/c" << false;
+    QTest::newRow("+/+, /a") << "+/+" << "/a" << true;
+    QTest::newRow("/+/b/#, /a/b") << "/+/b/#" << "/a/b" << true;
+    QTest::newRow("/+/b/#, /b") << "/+/b/#" << "/b" << false;
+    QTest::newRow("a/+, a/#") << "a/+" << "a/#" << true;
+    QTest::newRow("a/b, a/+") << "a/b" << "a/+" << false;
+}
+
+void TestMqttTopicTrie::matches()
+{
+    QFETCH(QString, filter);
+    QFETCH(QString, topic);
+    QFETCH(bool, matches);
+
+    MqttTopicTrie trie;
+    trie.insert(filter, "key");
+    QCOMPARE(trie.matches(topic), matches);
+    QCOMPARE(trie.match(topic), matches ? QSet<QString>({"key"}) : QSet<QString>());
+}
+
+void TestMqttTopicTrie::matchKeys()
+{
+    MqttTopicTrie trie;
+    trie.insert("devices/device1/#", "channel1");
+    trie.insert("devices/device12/#", "channel12");
+    trie.insert("devices/+/state", "states");
+    trie.insert("#", "all");
+
+    QCOMPARE(trie.match("devices/device1/state"), QSet<QString>({"channel1", "states", "all"}));
+    QCOMPARE(trie.match("devices/device12/power"), QSet<QString>({"channel12", "all"}));
+    QCOMPARE(trie.match("other"), QSet<QString>({"all"}));
+
+    // Only the filters stored with the given key count
+    QVERIFY(trie.matches("devices/device1/state", "channel1"));
+    QVERIFY(trie.matches("devices/device1/state", "states"));
+    QVERIFY(!trie.matches("devices/device12/state", "channel1"));
+    QVERIFY(!trie.matches("devices/device1/power", "states"));
+    QVERIFY(trie.matches("other", "all"));
+    QVERIFY(!trie.matches("devices/device1/state", "unknown"));
+}
+
+void TestMqttTopicTrie::remove()
+{
+    MqttTopicTrie trie;
+    trie.insert("devices/device1/#", "channel1");
+    trie.insert("devices/device1/#", "channel2");
+    trie.insert("devices/+/state", "channel1");
+
+    trie.remove("devices/device1/#", "channel1");
+    QCOMPARE(trie.match("devices/device1/state"), QSet<QString>({"channel2", "channel1"}));
+    QCOMPARE(trie.match("devices/device1/power"), QSet<QString>({"channel2"}));
+
+    // Unknown filters and keys are ignored
+    trie.remove("devices/device2/#", "channel2");
+    trie.remove("devices/+/state", "channel2");
+
+    trie.remove("devices/device1/#", "channel2");
+    trie.remove("devices/+/state", "channel1");
+    QVERIFY(!trie.matches("devices/device1/state"));
+    QVERIFY(trie.isEmpty());
+}
+
+void TestMqttTopicTrie::matchBenchmark()
+{
+    MqttTopicTrie trie;
+    for (int i = 0; i < 5000; i++) {
+        trie.insert(QString("devices/device%1/#").arg(i), QString("channel%1").arg(i));
+    }
+
+    QSet<QString> keys;
+    QBENCHMARK {
+        keys = trie.match("devices/device4999/sensor/temperature");
+    }
+    QCOMPARE(keys, QSet<QString>({"channel4999"}));
+}
+
+#include "testmqtttopictrie.moc"
+QTEST_MAIN(TestMqttTopicTrie)
@@ -0,0 +1,6 @@
+TARGET = nymeatestplugininfocache
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testplugininfocache.cpp
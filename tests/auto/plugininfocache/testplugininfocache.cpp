@@ -0,0 +1,188 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "integrations/plugininfocache.h"
+
+#include <QTemporaryDir>
+#include <QJsonObject>
+
+class TestPluginInfoCache: public NymeaTestBase
+{
+    Q_OBJECT
+
+protected slots:
+    void initTestCase();
+
+private:
+    QFileInfo writePlugin(const QTemporaryDir &dir, const QString &name, const QByteArray &data);
+    QJsonObject metaData(const PluginId &pluginId, const QString &name);
+
+private slots:
+    void cacheAndReload();
+    void stamp();
+    void pruneRemovedPlugins();
+    void incompatibleCache();
+};
+
+void TestPluginInfoCache::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+QFileInfo TestPluginInfoCache::writePlugin(const QTemporaryDir &dir, const QString &name, const QByteArray &data)
+{
+    QFile file(dir.filePath(name));
+    file.open(QFile::WriteOnly | QFile::Truncate);
+    file.write(data);
+    file.close();
+    return QFileInfo(file.fileName());
+}
+
+QJsonObject TestPluginInfoCache::metaData(const PluginId &pluginId, const QString &name)
+{
+    QJsonObject object;
+    object.insert("id", pluginId.toString());
+    object.insert("name", name);
+    return object;
+}
+
+void TestPluginInfoCache::cacheAndReload()
+{
+    QTemporaryDir dir;
+    QString cacheFile = dir.filePath("cache/plugininfo.cache");
+    QFileInfo pluginFile = writePlugin(dir, "libnymea_integrationplugintest.so", "binary");
+    PluginId pluginId = PluginId::createPluginId();
+
+    {
+        PluginInfoCache cache(cacheFile);
+        QVERIFY(cache.pluginInfo(pluginFile).isEmpty());
+        cache.cachePluginInfo(pluginFile, metaData(pluginId, "test"));
+        QCOMPARE(cache.pluginInfo(pluginFile).value("name").toString(), QString("test"));
+        QVERIFY(cache.save(QList<PluginId>()));
+    }
+    QVERIFY(QFile::exists(cacheFile));
+
+    PluginInfoCache cache(cacheFile);
+    QCOMPARE(cache.pluginInfo(pluginId).value("name").toString(), QString("test"));
+    QCOMPARE(cache.pluginInfo(pluginFile).value("name").toString(), QString("test"));
+
+    // Nothing changed, nothing is written
+    QDateTime written = QFileInfo(cacheFile).lastModified();
+    QTest::qWait(20);
+    cache.cachePluginInfo(pluginFile, metaData(pluginId, "test"));
+    QVERIFY(cache.save(QList<PluginId>()));
+    QCOMPARE(QFileInfo(cacheFile).lastModified(), written);
+}
+
+void TestPluginInfoCache::stamp()
+{
+    QTemporaryDir dir;
+    QFileInfo pluginFile = writePlugin(dir, "libnymea_integrationplugintest.so", "binary");
+    PluginId pluginId = PluginId::createPluginId();
+
+    PluginInfoCache cache(dir.filePath("plugininfo.cache"));
+    cache.cachePluginInfo(pluginFile, metaData(pluginId, "test"));
+
+    // A changed plugin file invalidates the lookup by file, the metadata has to be read again
+    pluginFile = writePlugin(dir, "libnymea_integrationplugintest.so", "updated binary");
+    QVERIFY(cache.pluginInfo(pluginFile).isEmpty());
+    QCOMPARE(cache.pluginInfo(pluginId).value("name").toString(), QString("test"));
+
+    cache.cachePluginInfo(pluginFile, metaData(pluginId, "updated"));
+    QCOMPARE(cache.pluginInfo(pluginFile).value("name").toString(), QString("updated"));
+
+    // Script plugins are stamped with their JSON file too
+    QFileInfo scriptFile = writePlugin(dir, "integrationplugintest.js", "script");
+    writePlugin(dir, "integrationplugintest.json", "{}");
+    PluginId scriptPluginId = PluginId::createPluginId();
+    cache.cachePluginInfo(scriptFile, metaData(scriptPluginId, "script"));
+    QVERIFY(!cache.pluginInfo(scriptFile).isEmpty());
+    writePlugin(dir, "integrationplugintest.json", "{ \"changed\": true }");
+    QVERIFY(cache.pluginInfo(scriptFile).isEmpty());
+}
+
+void TestPluginInfoCache::pruneRemovedPlugins()
+{
+    QTemporaryDir dir;
+    QString cacheFile = dir.filePath("plugininfo.cache");
+    QFileInfo usedPluginFile = writePlugin(dir, "libnymea_integrationpluginused.so", "used");
+    QFileInfo unusedPluginFile = writePlugin(dir, "libnymea_integrationpluginunused.so", "unused");
+    PluginId usedPluginId = PluginId::createPluginId();
+    PluginId unusedPluginId = PluginId::createPluginId();
+
+    {
+        PluginInfoCache cache(cacheFile);
+        cache.cachePluginInfo(usedPluginFile, metaData(usedPluginId, "used"));
+        cache.cachePluginInfo(unusedPluginFile, metaData(unusedPluginId, "unused"));
+        QVERIFY(cache.save(QList<PluginId>()));
+    }
+
+    QFile::remove(usedPluginFile.absoluteFilePath());
+    QFile::remove(unusedPluginFile.absoluteFilePath());
+
+    {
+        // Things of the used plugin still need its thing classes
+        PluginInfoCache cache(cacheFile);
+        QVERIFY(cache.save(QList<PluginId>() << usedPluginId));
+        QCOMPARE(cache.pluginInfo(usedPluginId).value("name").toString(), QString("used"));
+        QVERIFY(cache.pluginInfo(unusedPluginId).isEmpty());
+    }
+
+    PluginInfoCache cache(cacheFile);
+    QCOMPARE(cache.pluginInfo(usedPluginId).value("name").toString(), QString("used"));
+    QVERIFY(cache.pluginInfo(unusedPluginId).isEmpty());
+
+    QVERIFY(cache.save(QList<PluginId>()));
+    QVERIFY(PluginInfoCache(cacheFile).pluginInfo(usedPluginId).isEmpty());
+}
+
+void TestPluginInfoCache::incompatibleCache()
+{
+    QTemporaryDir dir;
+    QString cacheFile = dir.filePath("plugininfo.cache");
+    QFile file(cacheFile);
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write("this is not a plugin info cache");
+    file.close();
+
+    QFileInfo pluginFile = writePlugin(dir, "libnymea_integrationplugintest.so", "binary");
+    PluginId pluginId = PluginId::createPluginId();
+
+    PluginInfoCache cache(cacheFile);
+    QVERIFY(cache.pluginInfo(pluginFile).isEmpty());
+    cache.cachePluginInfo(pluginFile, metaData(pluginId, "test"));
+    QVERIFY(cache.save(QList<PluginId>()));
+    QCOMPARE(PluginInfoCache(cacheFile).pluginInfo(pluginId).value("name").toString(), QString("test"));
+}
+
+#include "testplugininfocache.moc"
+QTEST_MAIN(TestPluginInfoCache)
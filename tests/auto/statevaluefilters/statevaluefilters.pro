@@ -0,0 +1,6 @@
+TARGET = nymeateststatevaluefilters
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += teststatevaluefilters.cpp
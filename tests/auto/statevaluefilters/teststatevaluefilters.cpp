@@ -0,0 +1,293 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "integrations/statevaluefilters/statevaluefilter.h"
+#include "integrations/statevaluefilters/statevaluefilterratelimit.h"
+#include "integrations/statevaluefilters/ringbuffer.h"
+
+#include <algorithm>
+
+class TestStateValueFilters: public NymeaTestBase
+{
+    Q_OBJECT
+
+protected slots:
+    void initTestCase();
+
+private slots:
+    void ringBuffer();
+
+    void ema();
+    void median();
+    void medianWindow_data();
+    void medianWindow();
+    void medianRounding();
+    void deadband();
+    void rateLimit();
+    void rateLimitFlush();
+    void adaptive();
+
+    void compression_data();
+    void compression();
+};
+
+void TestStateValueFilters::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+void TestStateValueFilters::ringBuffer()
+{
+    RingBuffer<int> buffer(3);
+    QVERIFY(buffer.isEmpty());
+
+    buffer.append(1);
+    buffer.append(2);
+    QCOMPARE(buffer.count(), 2);
+    QCOMPARE(buffer.oldest(), 1);
+    QCOMPARE(buffer.newest(), 2);
+
+    buffer.append(3);
+    buffer.append(4);
+    QVERIFY(buffer.isFull());
+    QCOMPARE(buffer.count(), 3);
+    QCOMPARE(buffer.at(0), 2);
+    QCOMPARE(buffer.at(1), 3);
+    QCOMPARE(buffer.at(2), 4);
+
+    buffer.clear();
+    buffer.append(5);
+    QCOMPARE(buffer.count(), 1);
+    QCOMPARE(buffer.oldest(), 5);
+    QCOMPARE(buffer.newest(), 5);
+}
+
+void TestStateValueFilters::ema()
+{
+    QScopedPointer<StateValueFilter> filter(StateValueFilter::create(Types::StateValueFilterEma, {{"alpha", 0.5}}));
+    filter->addValue(10);
+    QCOMPARE(filter->filteredValue().toDouble(), 10.0);
+    filter->addValue(20);
+    QCOMPARE(filter->filteredValue().toDouble(), 15.0);
+    filter->addValue(20);
+    QCOMPARE(filter->filteredValue().toDouble(), 17.5);
+}
+
+void TestStateValueFilters::median()
+{
+    QScopedPointer<StateValueFilter> filter(StateValueFilter::create(Types::StateValueFilterMedian, {{"windowSize", 3}}));
+    filter->addValue(10);
+    QCOMPARE(filter->filteredValue().toDouble(), 10.0);
+    filter->addValue(20);
+    QCOMPARE(filter->filteredValue().toDouble(), 15.0);
+    // A single spike is removed
+    filter->addValue(1000);
+    QCOMPARE(filter->filteredValue().toDouble(), 20.0);
+    filter->addValue(21);
+    QCOMPARE(filter->filteredValue().toDouble(), 21.0);
+}
+
+void TestStateValueFilters::medianWindow_data()
+{
+    QTest::addColumn<int>("windowSize");
+
+    QTest::newRow("1") << 1;
+    QTest::newRow("2") << 2;
+    QTest::newRow("5") << 5;
+    QTest::newRow("8") << 8;
+    QTest::newRow("31") << 31;
+}
+
+void TestStateValueFilters::medianWindow()
+{
+    QFETCH(int, windowSize);
+
+    // Compare against sorting the window for every value, with plenty of duplicates
+    QScopedPointer<StateValueFilter> filter(StateValueFilter::create(Types::StateValueFilterMedian, {{"windowSize", windowSize}}));
+    qsrand(42);
+    QList<double> window;
+    for (int i = 0; i < 1000; i++) {
+        double value = qrand() % 20;
+        filter->addValue(value);
+
+        window.append(value);
+        if (window.count() > windowSize) {
+            window.removeFirst();
+        }
+        QList<double> sorted = window;
+        std::sort(sorted.begin(), sorted.end());
+        int middle = sorted.count() / 2;
+        double expected = sorted.count() % 2 ? sorted.at(middle) : (sorted.at(middle - 1) + sorted.at(middle)) / 2;
+        QCOMPARE(filter->filteredValue().toDouble(), expected);
+    }
+}
+
+void TestStateValueFilters::medianRounding()
+{
+    // Median alone doesn't compress, it's meant to be combined with a coarse state type.
+    // The spikes to 1350 and 600 are dropped and the state only changes on the real steps.
+    QScopedPointer<StateValueFilter> filter(StateValueFilter::create(Types::StateValueFilterMedian));
+    QList<double> input = {1000, 1004, 996, 1003, 1350, 998, 1002, 1006, 995, 1001, 1012, 1016, 1014, 1018, 600, 1021, 1019, 1024, 1026, 1022};
+    QList<int> expected = {1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1010, 1010, 1010, 1010, 1020, 1020, 1020, 1020, 1020};
+
+    QList<int> output;
+    foreach (double value, input) {
+        filter->addValue(value);
+        output.append(qRound(filter->filteredValue().toDouble() / 10) * 10);
+    }
+    QCOMPARE(output, expected);
+}
+
+void TestStateValueFilters::deadband()
+{
+    QScopedPointer<StateValueFilter> filter(StateValueFilter::create(Types::StateValueFilterDeadband, {{"absolute", 1}, {"relative", 0.05}}));
+    filter->addValue(100);
+    QCOMPARE(filter->filteredValue().toDouble(), 100.0);
+    // Within 5% of 100
+    filter->addValue(104);
+    QCOMPARE(filter->filteredValue().toDouble(), 100.0);
+    filter->addValue(106);
+    QCOMPARE(filter->filteredValue().toDouble(), 106.0);
+    // Absolute threshold applies for small values
+    filter->addValue(2);
+    QCOMPARE(filter->filteredValue().toDouble(), 2.0);
+    filter->addValue(2.5);
+    QCOMPARE(filter->filteredValue().toDouble(), 2.0);
+    // Going to 0 is always followed
+    filter->addValue(0);
+    QCOMPARE(filter->filteredValue().toDouble(), 0.0);
+}
+
+void TestStateValueFilters::rateLimit()
+{
+    qint64 now = 0;
+    StateValueFilterRateLimit filter(100, [&now](){ return now; });
+    QCOMPARE(filter.flushDelay(), -1);
+
+    filter.addValue(1);
+    QCOMPARE(filter.filteredValue().toInt(), 1);
+    QCOMPARE(filter.flushDelay(), -1);
+
+    now = 40;
+    filter.addValue(2);
+    QCOMPARE(filter.filteredValue().toInt(), 1);
+    QCOMPARE(filter.flushDelay(), 60);
+
+    // Only the latest value is held back
+    now = 99;
+    filter.addValue(3);
+    QCOMPARE(filter.filteredValue().toInt(), 1);
+    QCOMPARE(filter.flushDelay(), 1);
+
+    // A value after the interval passes right away and replaces the held back one
+    now = 100;
+    filter.addValue(4);
+    QCOMPARE(filter.filteredValue().toInt(), 4);
+    QCOMPARE(filter.flushDelay(), -1);
+    QVERIFY(!filter.flush());
+    QCOMPARE(filter.filteredValue().toInt(), 4);
+}
+
+void TestStateValueFilters::rateLimitFlush()
+{
+    qint64 now = 0;
+    StateValueFilterRateLimit filter(100, [&now](){ return now; });
+    filter.addValue(1);
+    now = 10;
+    filter.addValue(2);
+    now = 20;
+    filter.addValue(3);
+    QCOMPARE(filter.flushDelay(), 80);
+
+    // No new value comes in, the last one is still passed on when the interval expires
+    now = 100;
+    QCOMPARE(filter.flushDelay(), 0);
+    QVERIFY(filter.flush());
+    QCOMPARE(filter.filteredValue().toInt(), 3);
+    QCOMPARE(filter.flushDelay(), -1);
+
+    // The flush starts a new interval
+    now = 150;
+    filter.addValue(5);
+    QCOMPARE(filter.filteredValue().toInt(), 3);
+    QCOMPARE(filter.flushDelay(), 50);
+}
+
+void TestStateValueFilters::adaptive()
+{
+    QScopedPointer<StateValueFilter> filter(StateValueFilter::create(Types::StateValueFilterAdaptive));
+    filter->addValue(100);
+    QCOMPARE(filter->filteredValue().toDouble(), 100.0);
+    // Small jitter is filtered
+    filter->addValue(100.5);
+    QCOMPARE(filter->filteredValue().toDouble(), 100.0);
+    // Big steps are followed right away
+    filter->addValue(500);
+    QCOMPARE(filter->filteredValue().toDouble(), 500.0);
+    filter->addValue(0);
+    QCOMPARE(filter->filteredValue().toDouble(), 0.0);
+}
+
+void TestStateValueFilters::compression_data()
+{
+    QTest::addColumn<Types::StateValueFilter>("filterType");
+    QTest::addColumn<QVariantMap>("settings");
+
+    QTest::newRow("adaptive") << Types::StateValueFilterAdaptive << QVariantMap();
+    QTest::newRow("deadband") << Types::StateValueFilterDeadband << QVariantMap();
+}
+
+void TestStateValueFilters::compression()
+{
+    QFETCH(Types::StateValueFilter, filterType);
+    QFETCH(QVariantMap, settings);
+
+    // A noisy power meter around 1000 W with +/- 0.5% jitter
+    QScopedPointer<StateValueFilter> filter(StateValueFilter::create(filterType, settings));
+    qsrand(42);
+    int changes = 0;
+    QVariant lastValue;
+    for (int i = 0; i < 1000; i++) {
+        double value = 1000 + (qrand() % 100 - 50) / 10.0;
+        filter->addValue(value);
+        QVariant filtered = filter->filteredValue();
+        if (filtered != lastValue) {
+            changes++;
+            lastValue = filtered;
+        }
+    }
+    qCDebug(dcTests()) << "State changes for 1000 input values:" << changes;
+    QVERIFY2(changes < 100, QString("Expected less than 100 state changes, got %1").arg(changes).toUtf8());
+}
+
+#include "teststatevaluefilters.moc"
+QTEST_MAIN(TestStateValueFilters)
@@ -0,0 +1,6 @@
+TARGET = nymeateststaticfilecache
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += teststaticfilecache.cpp
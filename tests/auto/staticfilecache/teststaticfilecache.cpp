@@ -0,0 +1,247 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "servers/staticfilecache.h"
+
+#include <QTemporaryDir>
+
+using namespace nymeaserver;
+
+class TestStaticFileCache: public NymeaTestBase
+{
+    Q_OBJECT
+
+protected slots:
+    void initTestCase();
+
+private:
+    void writeFile(const QString &fileName, const QByteArray &data, const QDateTime &lastModified = QDateTime());
+
+private slots:
+    void etag();
+    void invalidation();
+    void precompressed();
+    void etagMatches_data();
+    void etagMatches();
+    void acceptsEncoding_data();
+    void acceptsEncoding();
+    void contentType_data();
+    void contentType();
+    void eviction();
+};
+
+void TestStaticFileCache::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+void TestStaticFileCache::writeFile(const QString &fileName, const QByteArray &data, const QDateTime &lastModified)
+{
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write(data);
+    if (lastModified.isValid()) {
+        file.setFileTime(lastModified, QFileDevice::FileModificationTime);
+    }
+    file.close();
+}
+
+void TestStaticFileCache::etag()
+{
+    QTemporaryDir dir;
+    writeFile(dir.filePath("index.html"), "<html></html>");
+    writeFile(dir.filePath("other.html"), "<html>other</html>");
+
+    StaticFileCache cache;
+    StaticFileCache::Entry entry = cache.file(dir.filePath("index.html"));
+    QVERIFY(entry.isValid());
+    QCOMPARE(entry.data, QByteArray("<html></html>"));
+    QVERIFY(entry.etag.startsWith('"') && entry.etag.endsWith('"'));
+    QCOMPARE(cache.count(), 1);
+
+    // Strong ETags depend on the content only
+    QCOMPARE(cache.file(dir.filePath("index.html")).etag, entry.etag);
+    QVERIFY(cache.file(dir.filePath("other.html")).etag != entry.etag);
+
+    QVERIFY(!cache.file(dir.filePath("missing.html")).isValid());
+    QVERIFY(!cache.file(dir.path()).isValid());
+}
+
+void TestStaticFileCache::invalidation()
+{
+    QTemporaryDir dir;
+    QString fileName = dir.filePath("app.js");
+    QDateTime time = QDateTime::currentDateTime().addSecs(-100);
+    writeFile(fileName, "var a = 1;", time);
+
+    StaticFileCache cache;
+    StaticFileCache::Entry entry = cache.file(fileName);
+    QCOMPARE(entry.data, QByteArray("var a = 1;"));
+
+    // Same size, different modification time
+    writeFile(fileName, "var a = 2;", time.addSecs(10));
+    StaticFileCache::Entry updated = cache.file(fileName);
+    QCOMPARE(updated.data, QByteArray("var a = 2;"));
+    QVERIFY(updated.etag != entry.etag);
+
+    QFile::remove(fileName);
+    QVERIFY(!cache.file(fileName).isValid());
+}
+
+void TestStaticFileCache::precompressed()
+{
+    QTemporaryDir dir;
+    QString fileName = dir.filePath("app.js");
+    writeFile(fileName, "plain");
+    writeFile(fileName + ".gz", "gzipped");
+
+    StaticFileCache cache;
+    QCOMPARE(cache.file(fileName).data, QByteArray("plain"));
+    QCOMPARE(cache.file(fileName, "deflate").data, QByteArray("plain"));
+
+    StaticFileCache::Entry entry = cache.file(fileName, "gzip, deflate, br");
+    QCOMPARE(entry.data, QByteArray("gzipped"));
+    QCOMPARE(entry.contentEncoding, QByteArray("gzip"));
+    // The content type is the one of the original file
+    QCOMPARE(entry.contentType, StaticFileCache::contentType(fileName));
+
+    writeFile(fileName + ".br", "brotli");
+    entry = cache.file(fileName, "gzip, deflate, br");
+    QCOMPARE(entry.data, QByteArray("brotli"));
+    QCOMPARE(entry.contentEncoding, QByteArray("br"));
+
+    // Codings the client refuses are skipped
+    entry = cache.file(fileName, "gzip, br;q=0");
+    QCOMPARE(entry.data, QByteArray("gzipped"));
+    QCOMPARE(entry.contentEncoding, QByteArray("gzip"));
+    entry = cache.file(fileName, "br;q=0, gzip;q=0");
+    QCOMPARE(entry.data, QByteArray("plain"));
+    QVERIFY(entry.contentEncoding.isEmpty());
+}
+
+void TestStaticFileCache::etagMatches_data()
+{
+    QTest::addColumn<QByteArray>("ifNoneMatch");
+    QTest::addColumn<bool>("matches");
+
+    QTest::newRow("empty") << QByteArray() << false;
+    QTest::newRow("same") << QByteArray("\"abc\"") << true;
+    QTest::newRow("other") << QByteArray("\"abd\"") << false;
+    QTest::newRow("weak") << QByteArray("W/\"abc\"") << true;
+    QTest::newRow("list") << QByteArray("\"x\", \"abc\"") << true;
+    QTest::newRow("any") << QByteArray("*") << true;
+    QTest::newRow("unquoted") << QByteArray("abc") << false;
+}
+
+void TestStaticFileCache::etagMatches()
+{
+    QFETCH(QByteArray, ifNoneMatch);
+    QFETCH(bool, matches);
+
+    QCOMPARE(StaticFileCache::etagMatches(ifNoneMatch, "\"abc\""), matches);
+}
+
+void TestStaticFileCache::acceptsEncoding_data()
+{
+    QTest::addColumn<QByteArray>("acceptEncoding");
+    QTest::addColumn<bool>("accepted");
+
+    QTest::newRow("empty") << QByteArray() << false;
+    QTest::newRow("plain") << QByteArray("gzip") << true;
+    QTest::newRow("list") << QByteArray("deflate, gzip, br") << true;
+    QTest::newRow("case") << QByteArray("GZip") << true;
+    QTest::newRow("other") << QByteArray("deflate, br") << false;
+    QTest::newRow("substring") << QByteArray("x-gzipped") << false;
+    QTest::newRow("quality") << QByteArray("gzip;q=0.5") << true;
+    QTest::newRow("refused") << QByteArray("gzip;q=0") << false;
+    QTest::newRow("refused with spaces") << QByteArray("br, gzip ; q=0.000") << false;
+    QTest::newRow("any") << QByteArray("*") << true;
+    QTest::newRow("any refused") << QByteArray("*;q=0") << false;
+    QTest::newRow("named wins over any") << QByteArray("*, gzip;q=0") << false;
+    QTest::newRow("named wins over refused any") << QByteArray("gzip;q=0.1, *;q=0") << true;
+}
+
+void TestStaticFileCache::acceptsEncoding()
+{
+    QFETCH(QByteArray, acceptEncoding);
+    QFETCH(bool, accepted);
+
+    QCOMPARE(StaticFileCache::acceptsEncoding(acceptEncoding, "gzip"), accepted);
+}
+
+void TestStaticFileCache::contentType_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<QByteArray>("contentType");
+
+    QTest::newRow("html") << "/index.html" << QByteArray("text/html; charset=\"utf-8\";");
+    QTest::newRow("upper case") << "/image.PNG" << QByteArray("image/png");
+    QTest::newRow("jpeg") << "/a.b/image.jpeg" << QByteArray("image/jpeg");
+    QTest::newRow("unknown") << "/file.unknown" << QByteArray();
+    QTest::newRow("no suffix") << "/file" << QByteArray();
+}
+
+void TestStaticFileCache::contentType()
+{
+    QFETCH(QString, fileName);
+    QFETCH(QByteArray, contentType);
+
+    QCOMPARE(StaticFileCache::contentType(fileName), contentType);
+}
+
+void TestStaticFileCache::eviction()
+{
+    QTemporaryDir dir;
+    for (int i = 0; i < 10; i++) {
+        writeFile(dir.filePath(QString("file%1.txt").arg(i)), QByteArray(100, 'a' + i));
+    }
+    writeFile(dir.filePath("large.txt"), QByteArray(1000, 'x'));
+
+    StaticFileCache cache(500, 200);
+    for (int i = 0; i < 10; i++) {
+        QVERIFY(cache.file(dir.filePath(QString("file%1.txt").arg(i))).isValid());
+        QVERIFY(cache.totalCost() <= 500);
+    }
+    QCOMPARE(cache.count(), 5);
+
+    // Too large files are served from disk, neither loaded nor cached
+    StaticFileCache::Entry large = cache.file(dir.filePath("large.txt"));
+    QVERIFY(large.isValid());
+    QVERIFY(!large.isLoaded());
+    QCOMPARE(large.size, qint64(1000));
+    QCOMPARE(large.filePath, dir.filePath("large.txt"));
+    QVERIFY(!large.etag.isEmpty());
+    QCOMPARE(cache.count(), 5);
+}
+
+#include "teststaticfilecache.moc"
+QTEST_MAIN(TestStaticFileCache)
@@ -0,0 +1,8 @@
+TARGET = nymeateststreamcompressor
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+LIBS += -lz
+
+SOURCES += teststreamcompressor.cpp
@@ -0,0 +1,214 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "servers/streamcompressor.h"
+
+#include <QJsonDocument>
+#include <QElapsedTimer>
+
+using namespace nymeaserver;
+
+class TestStreamCompressor: public NymeaTestBase
+{
+    Q_OBJECT
+
+protected slots:
+    void initTestCase();
+
+private:
+    QByteArray message(int id, int things) const;
+    QByteArray inflate(z_stream *stream, const QByteArray &data) const;
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+
+    void threshold();
+    void contextTakeover();
+
+    void throughput_data();
+    void throughput();
+};
+
+void TestStreamCompressor::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+QByteArray TestStreamCompressor::message(int id, int things) const
+{
+    // Resembles a GetThings reply, repetitive like most large replies
+    QVariantList thingList;
+    for (int i = 0; i < things; i++) {
+        QVariantMap thing;
+        thing.insert("id", QUuid::createUuid());
+        thing.insert("thingClassId", "{753f0d32-0468-4d08-82ed-1964aab03298}");
+        thing.insert("name", QString("Mock thing %1").arg(i));
+        thing.insert("setupStatus", "ThingSetupStatusComplete");
+        QVariantList states;
+        for (int j = 0; j < 10; j++) {
+            states.append(QVariantMap({{"stateTypeId", "{80baec19-54de-4948-ac46-31eabfaceb83}"}, {"value", j}}));
+        }
+        thing.insert("states", states);
+        thingList.append(thing);
+    }
+    QVariantMap message;
+    message.insert("id", id);
+    message.insert("status", "success");
+    message.insert("params", QVariantMap({{"things", thingList}}));
+    return QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact) + '\n';
+}
+
+QByteArray TestStreamCompressor::inflate(z_stream *stream, const QByteArray &data) const
+{
+    QByteArray result;
+    char buffer[4096];
+    stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream->avail_in = static_cast<uInt>(data.size());
+    do {
+        stream->next_out = reinterpret_cast<Bytef *>(buffer);
+        stream->avail_out = sizeof(buffer);
+        int ret = ::inflate(stream, Z_SYNC_FLUSH);
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return QByteArray();
+        }
+        result.append(buffer, static_cast<int>(sizeof(buffer) - stream->avail_out));
+    } while (stream->avail_out == 0);
+    return result;
+}
+
+void TestStreamCompressor::roundTrip_data()
+{
+    QTest::addColumn<int>("things");
+
+    QTest::newRow("empty") << 0;
+    QTest::newRow("small") << 1;
+    QTest::newRow("large") << 100;
+}
+
+void TestStreamCompressor::roundTrip()
+{
+    QFETCH(int, things);
+
+    StreamCompressor compressor;
+    QVERIFY(compressor.isValid());
+
+    z_stream stream = {};
+    QCOMPARE(inflateInit(&stream), Z_OK);
+
+    // Every segment must be decodable on its own, without waiting for following data
+    for (int i = 0; i < 10; i++) {
+        QByteArray data = message(i, things);
+        QByteArray compressed = compressor.compress(data);
+        QVERIFY(!compressed.isEmpty());
+        QCOMPARE(inflate(&stream, compressed), data);
+    }
+    inflateEnd(&stream);
+}
+
+void TestStreamCompressor::threshold()
+{
+    // Data below the threshold is stored, it must not shrink but remain decodable
+    StreamCompressor compressor(1024);
+    z_stream stream = {};
+    QCOMPARE(inflateInit(&stream), Z_OK);
+
+    QByteArray small(512, 'a');
+    QByteArray compressed = compressor.compress(small);
+    QVERIFY(compressed.size() > small.size());
+    QCOMPARE(inflate(&stream, compressed), small);
+
+    QByteArray large(4096, 'a');
+    compressed = compressor.compress(large);
+    QVERIFY(compressed.size() < large.size() / 10);
+    QCOMPARE(inflate(&stream, compressed), large);
+
+    compressed = compressor.compress(small);
+    QCOMPARE(inflate(&stream, compressed), small);
+    inflateEnd(&stream);
+}
+
+void TestStreamCompressor::contextTakeover()
+{
+    // Repeating a message must be cheaper the second time as the dictionary is kept
+    StreamCompressor compressor;
+    QByteArray data = message(1, 10);
+    int first = compressor.compress(data).size();
+    int second = compressor.compress(data).size();
+    QVERIFY2(second < first / 2, QString("First: %1, second: %2").arg(first).arg(second).toUtf8());
+}
+
+void TestStreamCompressor::throughput_data()
+{
+    QTest::addColumn<int>("things");
+    QTest::addColumn<int>("level");
+
+    QTest::newRow("small messages, fast") << 1 << 1;
+    QTest::newRow("small messages, default") << 1 << static_cast<int>(Z_DEFAULT_COMPRESSION);
+    QTest::newRow("large messages, fast") << 200 << 1;
+    QTest::newRow("large messages, default") << 200 << static_cast<int>(Z_DEFAULT_COMPRESSION);
+    QTest::newRow("large messages, best") << 200 << 9;
+}
+
+void TestStreamCompressor::throughput()
+{
+    QFETCH(int, things);
+    QFETCH(int, level);
+
+    QList<QByteArray> messages;
+    qint64 total = 0;
+    for (int i = 0; i < 20; i++) {
+        messages.append(message(i, things));
+        total += messages.last().size();
+    }
+
+    // Run with -tickcounter or -callgrind to get the CPU cost instead of walltime
+    qint64 compressedSize = 0;
+    QElapsedTimer timer;
+    timer.start();
+    int iterations = 0;
+    QBENCHMARK {
+        StreamCompressor compressor(256, level);
+        compressedSize = 0;
+        foreach (const QByteArray &data, messages) {
+            compressedSize += compressor.compress(data).size();
+        }
+        iterations++;
+    }
+    qint64 elapsed = qMax<qint64>(timer.nsecsElapsed(), 1);
+    qCDebug(dcTests()) << QTest::currentDataTag() << "Ratio:" << (double)total / compressedSize
+                       << "Throughput:" << (double)total * iterations / elapsed * 1000 << "MB/s";
+    QVERIFY(compressedSize > 0);
+}
+
+#include "teststreamcompressor.moc"
+QTEST_MAIN(TestStreamCompressor)
@@ -0,0 +1,6 @@
+TARGET = nymeatesttcpserver
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testtcpserver.cpp
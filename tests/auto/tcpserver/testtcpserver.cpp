@@ -0,0 +1,348 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "nymeacore.h"
+#include "servers/tcpserver.h"
+#include "jsonrpc/jsonrpcserverimplementation.h"
+
+#include <QTcpSocket>
+
+using namespace nymeaserver;
+
+class TestTcpServer: public NymeaTestBase
+{
+    Q_OBJECT
+
+protected slots:
+    void initTestCase();
+
+private:
+    QList<QTcpSocket *> connectClients(TcpServer *server, int count, QList<QUuid> *clientIds);
+    QTcpSocket *connectStalledClient(TcpServer *server, QUuid *clientId);
+    int stallClient(QTcpSocket *socket);
+    QVariantMap sendQueueStatistics(const QUuid &clientId);
+
+private slots:
+    void clientMapping();
+
+    void readThroughput_data();
+    void readThroughput();
+
+    void acceptDisconnect_data();
+    void acceptDisconnect();
+
+    void slowClient();
+    void slowClientOverBudget();
+};
+
+void TestTcpServer::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+QList<QTcpSocket *> TestTcpServer::connectClients(TcpServer *server, int count, QList<QUuid> *clientIds)
+{
+    QSignalSpy connectedSpy(server, &TransportInterface::clientConnected);
+    QList<QTcpSocket *> sockets;
+    for (int i = 0; i < count; i++) {
+        QTcpSocket *socket = new QTcpSocket(this);
+        socket->connectToHost("127.0.0.1", 2229);
+        sockets.append(socket);
+    }
+    while (connectedSpy.count() < count) {
+        if (!connectedSpy.wait()) {
+            break;
+        }
+    }
+    for (int i = 0; i < connectedSpy.count(); i++) {
+        clientIds->append(connectedSpy.at(i).first().toUuid());
+    }
+    return sockets;
+}
+
+QTcpSocket *TestTcpServer::connectStalledClient(TcpServer *server, QUuid *clientId)
+{
+    QList<QUuid> clientIds;
+    QList<QTcpSocket *> sockets = connectClients(server, 1, &clientIds);
+    if (clientIds.isEmpty()) {
+        qDeleteAll(sockets);
+        return nullptr;
+    }
+    *clientId = clientIds.first();
+    QTcpSocket *socket = sockets.first();
+
+    QSignalSpy readSpy(socket, &QTcpSocket::readyRead);
+    socket->write("{\"id\":0,\"method\":\"JSONRPC.Hello\"}\n");
+    while (!socket->canReadLine() && readSpy.wait()) { }
+    socket->readLine();
+
+    // Stop reading from the kernel once a few bytes are buffered, so everything piles up on the server side
+    socket->setReadBufferSize(1024);
+    return socket;
+}
+
+int TestTcpServer::stallClient(QTcpSocket *socket)
+{
+    // The replies have to exceed the kernel buffers on both ends, plus the queue budget of 4 MB
+    int count = 300;
+    for (int i = 1; i <= count; i++) {
+        socket->write(QString("{\"id\":%1,\"method\":\"JSONRPC.Introspect\"}\n").arg(i).toUtf8());
+    }
+    return count;
+}
+
+QVariantMap TestTcpServer::sendQueueStatistics(const QUuid &clientId)
+{
+    foreach (const QVariant &entry, NymeaCore::instance()->jsonRPCServer()->sendQueueStatistics()) {
+        if (entry.toMap().value("clientId").toUuid() == clientId) {
+            return entry.toMap();
+        }
+    }
+    return QVariantMap();
+}
+
+void TestTcpServer::clientMapping()
+{
+    ServerConfiguration config;
+    config.address = "127.0.0.1";
+    config.port = 2229;
+    config.sslEnabled = false;
+    TcpServer server(config, QSslConfiguration());
+    QVERIFY(server.startServer());
+
+    QList<QUuid> clientIds;
+    QList<QTcpSocket *> sockets = connectClients(&server, 10, &clientIds);
+    QCOMPARE(clientIds.count(), 10);
+
+    // Data from each socket must be attributed to the client it announced
+    QSignalSpy dataSpy(&server, &TransportInterface::dataAvailable);
+    for (int i = 0; i < sockets.count(); i++) {
+        sockets.at(i)->write(QByteArray::number(i));
+    }
+    while (dataSpy.count() < sockets.count() && dataSpy.wait()) { }
+    QCOMPARE(dataSpy.count(), sockets.count());
+    QHash<QUuid, int> received;
+    for (int i = 0; i < dataSpy.count(); i++) {
+        received.insert(dataSpy.at(i).first().toUuid(), dataSpy.at(i).last().toByteArray().toInt());
+    }
+    QCOMPARE(received.count(), 10);
+
+    // Replies reach the right socket
+    QUuid clientId = received.key(3);
+    QSignalSpy readSpy(sockets.at(3), &QTcpSocket::readyRead);
+    server.sendData(clientId, "{\"id\":3}");
+    QVERIFY(readSpy.wait());
+    QCOMPARE(sockets.at(3)->readAll(), QByteArray("{\"id\":3}\n"));
+
+    // Disconnecting one client reports its id and leaves the others intact
+    QSignalSpy disconnectedSpy(&server, &TransportInterface::clientDisconnected);
+    sockets.at(5)->disconnectFromHost();
+    QVERIFY(disconnectedSpy.wait());
+    QCOMPARE(disconnectedSpy.first().first().toUuid(), received.key(5));
+
+    dataSpy.clear();
+    sockets.at(6)->write("6");
+    QVERIFY(dataSpy.wait());
+    QCOMPARE(dataSpy.first().first().toUuid(), received.key(6));
+
+    qDeleteAll(sockets);
+}
+
+void TestTcpServer::readThroughput_data()
+{
+    QTest::addColumn<int>("connections");
+
+    QTest::newRow("1 connection") << 1;
+    QTest::newRow("100 connections") << 100;
+    QTest::newRow("300 connections") << 300;
+}
+
+void TestTcpServer::readThroughput()
+{
+    QFETCH(int, connections);
+
+    ServerConfiguration config;
+    config.address = "127.0.0.1";
+    config.port = 2229;
+    config.sslEnabled = false;
+    TcpServer server(config, QSslConfiguration());
+    QVERIFY(server.startServer());
+
+    QList<QUuid> clientIds;
+    QList<QTcpSocket *> sockets = connectClients(&server, connections, &clientIds);
+    QCOMPARE(clientIds.count(), connections);
+
+    // The time per read should not depend on the number of connections. With many connections
+    // open, a lookup that walks all clients to find the sender would show up here.
+    QTcpSocket *socket = sockets.last();
+    QSignalSpy dataSpy(&server, &TransportInterface::dataAvailable);
+    QBENCHMARK {
+        for (int i = 0; i < 100; i++) {
+            dataSpy.clear();
+            socket->write("{\"id\":1}\n");
+            while (dataSpy.isEmpty() && dataSpy.wait()) { }
+        }
+    }
+
+    qDeleteAll(sockets);
+}
+
+void TestTcpServer::acceptDisconnect_data()
+{
+    QTest::addColumn<int>("connections");
+
+    QTest::newRow("no other connections") << 0;
+    QTest::newRow("100 other connections") << 100;
+    QTest::newRow("300 other connections") << 300;
+}
+
+void TestTcpServer::acceptDisconnect()
+{
+    QFETCH(int, connections);
+
+    ServerConfiguration config;
+    config.address = "127.0.0.1";
+    config.port = 2229;
+    config.sslEnabled = false;
+    TcpServer server(config, QSslConfiguration());
+    QVERIFY(server.startServer());
+
+    QList<QUuid> clientIds;
+    QList<QTcpSocket *> sockets = connectClients(&server, connections, &clientIds);
+    QCOMPARE(clientIds.count(), connections);
+
+    // Adding and removing clients updates the maps in both directions, that must not
+    // depend on how many other clients are connected either.
+    QSignalSpy disconnectedSpy(&server, &TransportInterface::clientDisconnected);
+    QBENCHMARK {
+        QList<QUuid> newClientIds;
+        QList<QTcpSocket *> newSockets = connectClients(&server, 10, &newClientIds);
+        QCOMPARE(newClientIds.count(), 10);
+
+        disconnectedSpy.clear();
+        foreach (QTcpSocket *socket, newSockets) {
+            socket->disconnectFromHost();
+        }
+        while (disconnectedSpy.count() < newSockets.count() && disconnectedSpy.wait()) { }
+        QCOMPARE(disconnectedSpy.count(), newSockets.count());
+        qDeleteAll(newSockets);
+    }
+
+    qDeleteAll(sockets);
+}
+
+void TestTcpServer::slowClient()
+{
+    ServerConfiguration config;
+    config.address = "127.0.0.1";
+    config.port = 2229;
+    config.sslEnabled = false;
+    config.authenticationEnabled = false;
+    TcpServer server(config, QSslConfiguration());
+    QVERIFY(server.startServer());
+    NymeaCore::instance()->jsonRPCServer()->registerTransportInterface(&server);
+
+    QUuid clientId;
+    QTcpSocket *socket = connectStalledClient(&server, &clientId);
+    QVERIFY(socket);
+    int count = stallClient(socket);
+
+    // Once the socket holds more than the high watermark, replies are held back in the queue
+    QVariantMap statistics;
+    QTRY_VERIFY_WITH_TIMEOUT((statistics = sendQueueStatistics(clientId)).value("queuedReplies").toInt() > 0, 10000);
+    QVERIFY2(statistics.value("bytesToWrite").toLongLong() >= 64 * 1024, "Queued data while the socket is below the low watermark");
+    QVERIFY(statistics.value("queuedBytes").toLongLong() > 0);
+
+    // Replies are never dropped, so the queue goes over budget
+    QTRY_VERIFY_WITH_TIMEOUT(sendQueueStatistics(clientId).value("overBudget").toBool(), 10000);
+
+    // Reading again drains the queue on bytesWritten, long before the grace period ends. All replies arrive in order.
+    socket->setReadBufferSize(0);
+    QSignalSpy readSpy(socket, &QTcpSocket::readyRead);
+    int received = 0;
+    while (received < count) {
+        if (!socket->canReadLine()) {
+            if (!readSpy.wait()) {
+                break;
+            }
+            continue;
+        }
+        QVariantMap reply = QJsonDocument::fromJson(socket->readLine()).toVariant().toMap();
+        received++;
+        QCOMPARE(reply.value("id").toInt(), received);
+        QCOMPARE(reply.value("status").toString(), QString("success"));
+    }
+    QCOMPARE(received, count);
+
+    statistics = sendQueueStatistics(clientId);
+    QVERIFY(!statistics.isEmpty());
+    QCOMPARE(statistics.value("queuedBytes").toLongLong(), qint64(0));
+    QCOMPARE(statistics.value("bytesToWrite").toLongLong(), qint64(0));
+    QCOMPARE(statistics.value("overBudget").toBool(), false);
+
+    NymeaCore::instance()->jsonRPCServer()->unregisterTransportInterface(&server);
+    delete socket;
+}
+
+void TestTcpServer::slowClientOverBudget()
+{
+    ServerConfiguration config;
+    config.address = "127.0.0.1";
+    config.port = 2229;
+    config.sslEnabled = false;
+    config.authenticationEnabled = false;
+    TcpServer server(config, QSslConfiguration());
+    QVERIFY(server.startServer());
+    NymeaCore::instance()->jsonRPCServer()->registerTransportInterface(&server);
+
+    QUuid clientId;
+    QTcpSocket *socket = connectStalledClient(&server, &clientId);
+    QVERIFY(socket);
+    stallClient(socket);
+
+    QTRY_VERIFY_WITH_TIMEOUT(sendQueueStatistics(clientId).value("overBudget").toBool(), 10000);
+    QElapsedTimer overBudgetTimer;
+    overBudgetTimer.start();
+
+    // A client that never catches up is dropped after the grace period of 30 seconds
+    QSignalSpy disconnectedSpy(&server, &TransportInterface::clientDisconnected);
+    QVERIFY(disconnectedSpy.wait(45000));
+    QCOMPARE(disconnectedSpy.first().first().toUuid(), clientId);
+    QVERIFY2(overBudgetTimer.elapsed() > 25000, "Client dropped before the grace period ended");
+    QVERIFY(sendQueueStatistics(clientId).isEmpty());
+
+    NymeaCore::instance()->jsonRPCServer()->unregisterTransportInterface(&server);
+    delete socket;
+}
+
+#include "testtcpserver.moc"
+QTEST_MAIN(TestTcpServer)
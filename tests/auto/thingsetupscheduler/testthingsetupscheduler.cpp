@@ -0,0 +1,273 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "nymeacore.h"
+
+#include "integrations/thingsetupscheduler.h"
+#include "../plugins/mock/extern-plugininfo.h"
+
+using namespace nymeaserver;
+
+class TestThingSetupScheduler: public NymeaTestBase
+{
+    Q_OBJECT
+
+private:
+    QList<Thing *> m_things;
+
+    QList<Thing *> dispatched(const QSignalSpy &spy) const;
+
+protected slots:
+    void initTestCase();
+
+private slots:
+    void concurrencyLimit();
+    void pluginLimit();
+    void priorities();
+    void duplicateSchedule();
+    void unschedule();
+    void failedSetups();
+    void progress();
+};
+
+void TestThingSetupScheduler::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+
+    // The scheduler only hands out things, it doesn't matter that these are set up already
+    for (int i = 0; i < 10; i++) {
+        QVariantMap params;
+        params.insert("thingClassId", virtualIoLightMockThingClassId);
+        params.insert("name", QString("Light %1").arg(i));
+        QVariant response = injectAndWait("Integrations.AddThing", params);
+        verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+        ThingId thingId = response.toMap().value("params").toMap().value("thingId").toUuid();
+        m_things.append(NymeaCore::instance()->thingManager()->findConfiguredThing(thingId));
+    }
+}
+
+QList<Thing *> TestThingSetupScheduler::dispatched(const QSignalSpy &spy) const
+{
+    QList<Thing *> things;
+    for (int i = 0; i < spy.count(); i++) {
+        things.append(spy.at(i).first().value<Thing *>());
+    }
+    return things;
+}
+
+void TestThingSetupScheduler::concurrencyLimit()
+{
+    ThingSetupScheduler scheduler;
+    scheduler.setMaxConcurrentSetups(3);
+    QSignalSpy setupSpy(&scheduler, &ThingSetupScheduler::setupThing);
+
+    foreach (Thing *thing, m_things) {
+        scheduler.schedule(thing);
+    }
+    QCOMPARE(scheduler.total(), 10);
+    QCOMPARE(dispatched(setupSpy), m_things.mid(0, 3));
+
+    // Each finished setup makes room for the next one
+    scheduler.setupFinished(m_things.at(1), Thing::ThingErrorNoError);
+    QCOMPARE(dispatched(setupSpy), m_things.mid(0, 4));
+    QCOMPARE(scheduler.completed(), 1);
+
+    // Only things which are running count
+    scheduler.setupFinished(m_things.at(9), Thing::ThingErrorNoError);
+    QCOMPARE(setupSpy.count(), 4);
+    QCOMPARE(scheduler.completed(), 1);
+
+    for (int i = 0; i < m_things.count(); i++) {
+        scheduler.setupFinished(m_things.at(i), Thing::ThingErrorNoError);
+    }
+    QCOMPARE(dispatched(setupSpy).count(), 10);
+    QCOMPARE(scheduler.completed(), 10);
+}
+
+void TestThingSetupScheduler::pluginLimit()
+{
+    ThingSetupScheduler scheduler;
+    scheduler.setMaxConcurrentSetups(3);
+    scheduler.setMaxConcurrentSetups(mockPluginId, 1);
+    QCOMPARE(scheduler.maxConcurrentSetups(mockPluginId), 1);
+    QCOMPARE(scheduler.maxConcurrentSetups(PluginId::createPluginId()), 3);
+
+    QSignalSpy setupSpy(&scheduler, &ThingSetupScheduler::setupThing);
+    foreach (Thing *thing, m_things) {
+        scheduler.schedule(thing);
+    }
+    QCOMPARE(setupSpy.count(), 1);
+
+    // 0 means unlimited
+    scheduler.setMaxConcurrentSetups(mockPluginId, 0);
+    scheduler.setupFinished(m_things.at(0), Thing::ThingErrorNoError);
+    QCOMPARE(setupSpy.count(), 10);
+}
+
+void TestThingSetupScheduler::priorities()
+{
+    ThingSetupScheduler scheduler;
+    scheduler.setMaxConcurrentSetups(1);
+    QSignalSpy setupSpy(&scheduler, &ThingSetupScheduler::setupThing);
+
+    scheduler.schedule(m_things.at(0));
+    scheduler.schedule(m_things.at(1));
+    scheduler.schedule(m_things.at(2), 5);
+    scheduler.schedule(m_things.at(3), 5);
+    scheduler.schedule(m_things.at(4), 2);
+
+    // Higher priorities first, same priorities in the order they have been scheduled
+    QList<Thing *> expected = {m_things.at(0), m_things.at(2), m_things.at(3), m_things.at(4), m_things.at(1)};
+    for (int i = 0; i < expected.count(); i++) {
+        QCOMPARE(setupSpy.count(), i + 1);
+        QCOMPARE(setupSpy.at(i).first().value<Thing *>(), expected.at(i));
+        scheduler.setupFinished(expected.at(i), Thing::ThingErrorNoError);
+    }
+    QCOMPARE(setupSpy.count(), expected.count());
+}
+
+void TestThingSetupScheduler::duplicateSchedule()
+{
+    ThingSetupScheduler scheduler;
+    scheduler.setMaxConcurrentSetups(1);
+    QSignalSpy setupSpy(&scheduler, &ThingSetupScheduler::setupThing);
+
+    // Running and queued things are not scheduled again
+    scheduler.schedule(m_things.at(0));
+    scheduler.schedule(m_things.at(1));
+    scheduler.schedule(m_things.at(0));
+    scheduler.schedule(m_things.at(1));
+    QCOMPARE(scheduler.total(), 2);
+
+    scheduler.setupFinished(m_things.at(0), Thing::ThingErrorNoError);
+    scheduler.setupFinished(m_things.at(1), Thing::ThingErrorNoError);
+    QCOMPARE(dispatched(setupSpy), m_things.mid(0, 2));
+}
+
+void TestThingSetupScheduler::unschedule()
+{
+    ThingSetupScheduler scheduler;
+    scheduler.setMaxConcurrentSetups(1);
+    QSignalSpy setupSpy(&scheduler, &ThingSetupScheduler::setupThing);
+
+    scheduler.schedule(m_things.at(0));
+    scheduler.schedule(m_things.at(1));
+    scheduler.schedule(m_things.at(2));
+    scheduler.schedule(m_things.at(3));
+
+    // A queued thing is dropped from the queue
+    scheduler.unschedule(m_things.at(1)->id());
+    QCOMPARE(scheduler.total(), 3);
+    scheduler.setupFinished(m_things.at(0), Thing::ThingErrorNoError);
+    QCOMPARE(dispatched(setupSpy), QList<Thing *>({m_things.at(0), m_things.at(2)}));
+
+    // A running thing frees its slot
+    scheduler.unschedule(m_things.at(2)->id());
+    QCOMPARE(dispatched(setupSpy), QList<Thing *>({m_things.at(0), m_things.at(2), m_things.at(3)}));
+    QCOMPARE(scheduler.total(), 2);
+
+    // Can be scheduled again afterwards
+    scheduler.schedule(m_things.at(1));
+    scheduler.setupFinished(m_things.at(3), Thing::ThingErrorNoError);
+    QCOMPARE(setupSpy.count(), 4);
+    QCOMPARE(setupSpy.last().first().value<Thing *>(), m_things.at(1));
+}
+
+void TestThingSetupScheduler::failedSetups()
+{
+    ThingSetupScheduler scheduler;
+    scheduler.setMaxConcurrentSetups(1);
+    QSignalSpy setupSpy(&scheduler, &ThingSetupScheduler::setupThing);
+
+    scheduler.schedule(m_things.at(0));
+    scheduler.schedule(m_things.at(1));
+
+    // Failed setups are retried later and don't block the queue in the meantime
+    scheduler.setupFinished(m_things.at(0), Thing::ThingErrorHardwareNotAvailable);
+    QCOMPARE(dispatched(setupSpy), m_things.mid(0, 2));
+    QCOMPARE(scheduler.completed(), 1);
+
+    // Nothing to retry without a plugin, so the thing can be scheduled right away again
+    scheduler.setupFinished(m_things.at(1), Thing::ThingErrorPluginNotFound);
+    scheduler.schedule(m_things.at(1));
+    QCOMPARE(setupSpy.count(), 3);
+
+    // Unscheduling drops the pending retry
+    scheduler.unschedule(m_things.at(0)->id());
+}
+
+void TestThingSetupScheduler::progress()
+{
+    ThingSetupScheduler scheduler;
+    scheduler.setMaxConcurrentSetups(1);
+    QSignalSpy progressSpy(&scheduler, &ThingSetupScheduler::progress);
+    QSignalSpy readySpy(&scheduler, &ThingSetupScheduler::ready);
+    QVERIFY(scheduler.isReady());
+
+    scheduler.schedule(m_things.at(0));
+    scheduler.schedule(m_things.at(1));
+    scheduler.schedule(m_things.at(2));
+    QVERIFY(!scheduler.isReady());
+    QCOMPARE(progressSpy.count(), 0);
+
+    // Failed setups count as done for the initial run
+    scheduler.setupFinished(m_things.at(0), Thing::ThingErrorHardwareNotAvailable);
+    QCOMPARE(progressSpy.count(), 1);
+    QCOMPARE(progressSpy.last(), QVariantList({1, 3}));
+    QCOMPARE(readySpy.count(), 0);
+
+    // Unscheduling a pending thing shrinks the total
+    scheduler.unschedule(m_things.at(2)->id());
+    QCOMPARE(progressSpy.count(), 2);
+    QCOMPARE(progressSpy.last(), QVariantList({1, 2}));
+    QCOMPARE(readySpy.count(), 0);
+
+    scheduler.setupFinished(m_things.at(1), Thing::ThingErrorNoError);
+    QCOMPARE(progressSpy.count(), 3);
+    QCOMPARE(progressSpy.last(), QVariantList({2, 2}));
+    QCOMPARE(readySpy.count(), 1);
+    QVERIFY(scheduler.isReady());
+
+    // Only the first attempt of a thing counts, late finishes are ignored
+    scheduler.setupFinished(m_things.at(0), Thing::ThingErrorNoError);
+    QCOMPARE(progressSpy.count(), 3);
+    QCOMPARE(readySpy.count(), 1);
+
+    // Things added later start a new run
+    scheduler.schedule(m_things.at(3));
+    QVERIFY(!scheduler.isReady());
+    scheduler.setupFinished(m_things.at(3), Thing::ThingErrorNoError);
+    QCOMPARE(progressSpy.last(), QVariantList({1, 1}));
+    QCOMPARE(readySpy.count(), 2);
+}
+
+#include "testthingsetupscheduler.moc"
+QTEST_MAIN(TestThingSetupScheduler)
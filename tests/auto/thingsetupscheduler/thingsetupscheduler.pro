@@ -0,0 +1,6 @@
+TARGET = nymeatestthingsetupscheduler
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testthingsetupscheduler.cpp
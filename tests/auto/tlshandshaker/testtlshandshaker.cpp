@@ -0,0 +1,212 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+#include "certificategenerator.h"
+#include "servers/tlshandshaker.h"
+
+#include <QTcpServer>
+#include <QSslKey>
+#include <QSslCertificate>
+#include <QTemporaryDir>
+
+using namespace nymeaserver;
+
+Q_DECLARE_METATYPE(CertificateGenerator::KeyType)
+
+class HandshakeServer: public QTcpServer
+{
+    Q_OBJECT
+public:
+    HandshakeServer(TlsHandshaker *handshaker, const QSslConfiguration &configuration):
+        m_handshaker(handshaker),
+        m_configuration(configuration)
+    { }
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override {
+        QSslSocket *socket = new QSslSocket();
+        socket->setSocketDescriptor(socketDescriptor);
+        m_handshaker->startServerEncryption(socket, m_configuration);
+    }
+
+private:
+    TlsHandshaker *m_handshaker = nullptr;
+    QSslConfiguration m_configuration;
+};
+
+class TestTlsHandshaker: public NymeaTestBase
+{
+    Q_OBJECT
+
+protected slots:
+    void initTestCase();
+
+private:
+    QTemporaryDir m_dir;
+
+    QSslConfiguration serverConfiguration(CertificateGenerator::KeyType keyType);
+    QSslSocket *connectClient(quint16 port);
+
+private slots:
+    void generateCertificate_data();
+    void generateCertificate();
+    void handshake();
+    void failedHandshake();
+    void handshakeBenchmark_data();
+    void handshakeBenchmark();
+};
+
+void TestTlsHandshaker::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\n");
+}
+
+QSslConfiguration TestTlsHandshaker::serverConfiguration(CertificateGenerator::KeyType keyType)
+{
+    QString certificateFileName = m_dir.filePath(QString("certificate-%1.crt").arg(keyType));
+    QString keyFileName = m_dir.filePath(QString("certificate-%1.key").arg(keyType));
+    if (!QFile::exists(certificateFileName)) {
+        CertificateGenerator::generate(certificateFileName, keyFileName, keyType);
+    }
+
+    QFile keyFile(keyFileName);
+    keyFile.open(QFile::ReadOnly);
+    QSslKey key(&keyFile, keyType == CertificateGenerator::KeyTypeEcdsa ? QSsl::Ec : QSsl::Rsa);
+
+    QSslConfiguration configuration;
+    configuration.setProtocol(QSsl::TlsV1_2OrLater);
+    configuration.setPrivateKey(key);
+    configuration.setLocalCertificate(QSslCertificate::fromPath(certificateFileName).first());
+    return configuration;
+}
+
+QSslSocket *TestTlsHandshaker::connectClient(quint16 port)
+{
+    QSslSocket *socket = new QSslSocket(this);
+    socket->setPeerVerifyMode(QSslSocket::VerifyNone);
+    socket->connectToHostEncrypted("127.0.0.1", port);
+    return socket;
+}
+
+void TestTlsHandshaker::generateCertificate_data()
+{
+    QTest::addColumn<CertificateGenerator::KeyType>("keyType");
+    QTest::addColumn<int>("algorithm");
+
+    QTest::newRow("rsa") << CertificateGenerator::KeyTypeRsa << static_cast<int>(QSsl::Rsa);
+    QTest::newRow("ecdsa") << CertificateGenerator::KeyTypeEcdsa << static_cast<int>(QSsl::Ec);
+}
+
+void TestTlsHandshaker::generateCertificate()
+{
+    QFETCH(CertificateGenerator::KeyType, keyType);
+    QFETCH(int, algorithm);
+
+    QSslConfiguration configuration = serverConfiguration(keyType);
+    QVERIFY(!configuration.privateKey().isNull());
+    QCOMPARE(static_cast<int>(configuration.privateKey().algorithm()), algorithm);
+    QCOMPARE(static_cast<int>(configuration.localCertificate().publicKey().algorithm()), algorithm);
+}
+
+void TestTlsHandshaker::handshake()
+{
+    TlsHandshaker handshaker;
+    HandshakeServer server(&handshaker, serverConfiguration(CertificateGenerator::KeyTypeEcdsa));
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy encryptedSpy(&handshaker, &TlsHandshaker::encrypted);
+
+    // The client sends data right after the handshake, before the server socket is handed back
+    QSslSocket *client = connectClient(server.serverPort());
+    connect(client, &QSslSocket::encrypted, client, [client]() { client->write("hello"); });
+
+    QVERIFY(encryptedSpy.wait());
+    QSslSocket *socket = encryptedSpy.first().first().value<QSslSocket *>();
+    QCOMPARE(socket->thread(), QThread::currentThread());
+    QVERIFY(socket->isEncrypted());
+    QCOMPARE(handshaker.pendingHandshakes(), 0);
+
+    QSignalSpy readSpy(socket, &QSslSocket::readyRead);
+    QVERIFY(socket->bytesAvailable() > 0 || readSpy.wait());
+    QCOMPARE(socket->readAll(), QByteArray("hello"));
+
+    delete socket;
+    delete client;
+}
+
+void TestTlsHandshaker::failedHandshake()
+{
+    TlsHandshaker handshaker;
+    HandshakeServer server(&handshaker, serverConfiguration(CertificateGenerator::KeyTypeEcdsa));
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy failedSpy(&handshaker, &TlsHandshaker::failed);
+
+    QTcpSocket client;
+    client.connectToHost("127.0.0.1", server.serverPort());
+    QVERIFY(client.waitForConnected());
+    client.write("GET / HTTP/1.1\r\n\r\n");
+
+    QVERIFY(failedSpy.wait());
+    QSslSocket *socket = failedSpy.first().first().value<QSslSocket *>();
+    QCOMPARE(socket->thread(), QThread::currentThread());
+    QVERIFY(!socket->isEncrypted());
+    QCOMPARE(handshaker.pendingHandshakes(), 0);
+    delete socket;
+}
+
+void TestTlsHandshaker::handshakeBenchmark_data()
+{
+    QTest::addColumn<CertificateGenerator::KeyType>("keyType");
+
+    QTest::newRow("rsa") << CertificateGenerator::KeyTypeRsa;
+    QTest::newRow("ecdsa") << CertificateGenerator::KeyTypeEcdsa;
+}
+
+void TestTlsHandshaker::handshakeBenchmark()
+{
+    QFETCH(CertificateGenerator::KeyType, keyType);
+
+    TlsHandshaker handshaker;
+    HandshakeServer server(&handshaker, serverConfiguration(keyType));
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy encryptedSpy(&handshaker, &TlsHandshaker::encrypted);
+
+    QBENCHMARK {
+        encryptedSpy.clear();
+        QSslSocket *client = connectClient(server.serverPort());
+        QVERIFY(encryptedSpy.wait());
+        delete encryptedSpy.first().first().value<QSslSocket *>();
+        delete client;
+    }
+}
+
+#include "testtlshandshaker.moc"
+QTEST_MAIN(TestTlsHandshaker)
@@ -0,0 +1,6 @@
+TARGET = nymeatesttlshandshaker
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testtlshandshaker.cpp
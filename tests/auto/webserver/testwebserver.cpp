@@ -30,6 +30,8 @@
 
 #include "nymeatestbase.h"
 #include "nymeacore.h"
+#include "servers/httprequest.h"
+#include "servers/webserver.h"
 
 #include <QXmlReader>
 
@@ -65,6 +67,29 @@ private slots:
     void getDebugServer_data();
     void getDebugServer();
 
+    void parseChunkedRequest();
+    void parsePipelinedRequests();
+
+    void pipelinedRequests();
+
+    void precompressedFile();
+
+    void streamLargeFile_data();
+    void streamLargeFile();
+    void streamToSlowClient();
+    void pipelineLimit();
+
+    void keepAliveBenchmark_data();
+    void keepAliveBenchmark();
+
+    void manyConnectionsBenchmark_data();
+    void manyConnectionsBenchmark();
+
+private:
+    QSslSocket *connectEncrypted();
+    QList<QSslSocket *> connectPlain(WebServer *server, int count, int firstIndex = 0);
+    QList<int> readReplies(QSslSocket *socket, int count);
+
 public slots:
     void onSslErrors(const QList<QSslError> &errors) {
         qCWarning(dcTests()) << "SSL errors:" << errors;
@@ -628,5 +653,521 @@ void TestWebserver::getDebugServer()
     QCOMPARE(statusCode, expectedStatusCode);
 }
 
+void TestWebserver::parseChunkedRequest()
+{
+    QByteArray requestData;
+    requestData.append("POST /upload HTTP/1.1\r\n");
+    requestData.append("User-Agent: nymea webserver test\r\n");
+    requestData.append("transfer-encoding: chunked\r\n");
+    requestData.append("\r\n");
+    requestData.append("5\r\nHello\r\n");
+    requestData.append("7;name=value\r\n nymea!\r\n");
+    requestData.append("0\r\n");
+    requestData.append("X-Trailer: ignored\r\n");
+    requestData.append("\r\n");
+
+    // Feed the request in small pieces, it must not be complete before the last chunk and trailers arrived
+    HttpRequest request;
+    for (int i = 0; i < requestData.size(); i += 3) {
+        QVERIFY2(!request.isComplete(), "request complete too early");
+        request.appendData(requestData.mid(i, 3));
+    }
+
+    QVERIFY(request.isComplete());
+    QVERIFY(request.isValid());
+    QVERIFY(request.isChunked());
+    QCOMPARE(request.payload(), QByteArray("Hello nymea!"));
+    QVERIFY(request.remainingData().isEmpty());
+
+    HttpRequest invalidRequest(QByteArray("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nxyz\r\n"));
+    QVERIFY(invalidRequest.isComplete());
+    QVERIFY(!invalidRequest.isValid());
+
+    // Chunk size and trailer lines are bounded, even before their line end arrived
+    HttpRequest longChunkLine(QByteArray("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5;") + QByteArray(2048, 'x'));
+    QVERIFY(longChunkLine.isComplete());
+    QVERIFY(!longChunkLine.isValid());
+
+    HttpRequest longTrailer(QByteArray("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\nX-Trailer: ") + QByteArray(2048, 'x') + "\r\n\r\n");
+    QVERIFY(longTrailer.isComplete());
+    QVERIFY(!longTrailer.isValid());
+
+    // Without Content-Length or chunked transfer coding a request has no payload
+    HttpRequest noLength(QByteArray("POST / HTTP/1.1\r\nUser-Agent: nymea webserver test\r\n\r\n"));
+    QVERIFY(noLength.isComplete());
+    QVERIFY(noLength.isValid());
+    QVERIFY(noLength.payload().isEmpty());
+}
+
+void TestWebserver::parsePipelinedRequests()
+{
+    QByteArray requestData;
+    requestData.append("GET /index.html HTTP/1.1\r\nUser-Agent: nymea webserver test\r\n\r\n");
+    requestData.append("PUT /data HTTP/1.1\r\nUser-Agent: nymea webserver test\r\nContent-Length: 5\r\n\r\nnymea");
+    requestData.append("GET /server.xml HTTP/1.0\r\nUser-Agent: nymea webserver test\r\n\r\n");
+
+    HttpRequest first(requestData);
+    QVERIFY(first.isComplete());
+    QVERIFY(first.isValid());
+    QCOMPARE(first.url().path(), QString("/index.html"));
+    QVERIFY(first.keepAlive());
+
+    HttpRequest second(first.remainingData());
+    QVERIFY(second.isComplete());
+    QVERIFY(second.isValid());
+    QCOMPARE(second.method(), HttpRequest::Put);
+    QCOMPARE(second.payload(), QByteArray("nymea"));
+
+    HttpRequest third(second.remainingData());
+    QVERIFY(third.isComplete());
+    QVERIFY(third.isValid());
+    QCOMPARE(third.url().path(), QString("/server.xml"));
+    QVERIFY2(!third.keepAlive(), "HTTP/1.0 without keep-alive header must not be persistent");
+    QVERIFY(third.remainingData().isEmpty());
+
+    // A request cut off in the middle of the method token is still a pipelined request
+    HttpRequest partial(QByteArray("GET / HTTP/1.1\r\nConnection: close\r\n\r\nGE"));
+    QVERIFY(partial.isValid());
+    QVERIFY(!partial.keepAlive());
+    QCOMPARE(partial.remainingData(), QByteArray("GE"));
+}
+
+void TestWebserver::pipelinedRequests()
+{
+    QSslSocket *socket = connectEncrypted();
+    QVERIFY2(socket, "could not created encrypted webserver connection.");
+
+    QSignalSpy disconnectedSpy(socket, SIGNAL(disconnected()));
+
+    // Send all requests at once, the replies must come back in order on the same connection
+    QByteArray requestData;
+    requestData.append("GET /server.xml HTTP/1.1\r\nUser-Agent: nymea webserver test\r\n\r\n");
+    requestData.append("GET /hello/nymea HTTP/1.1\r\nUser-Agent: nymea webserver test\r\n\r\n");
+    requestData.append("PUT / HTTP/1.1\r\nUser-Agent: nymea webserver test\r\nTransfer-Encoding: chunked\r\n\r\n4\r\ntest\r\n0\r\n\r\n");
+    requestData.append("GET /server.xml HTTP/1.1\r\nUser-Agent: nymea webserver test\r\nConnection: close\r\n\r\n");
+    socket->write(requestData);
+
+    QList<int> statusCodes = readReplies(socket, 4);
+    QCOMPARE(statusCodes, QList<int>() << 200 << 404 << 501 << 200);
+
+    // The last request asked to close the connection
+    if (disconnectedSpy.isEmpty())
+        disconnectedSpy.wait();
+    QCOMPARE(disconnectedSpy.count(), 1);
+
+    socket->deleteLater();
+}
+
+void TestWebserver::precompressedFile()
+{
+    QString fileName = QCoreApplication::applicationDirPath() + "/precompressed.js";
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write("plain");
+    file.close();
+    QFile gzipFile(fileName + ".gz");
+    QVERIFY(gzipFile.open(QFile::WriteOnly | QFile::Truncate));
+    gzipFile.write("gzipped");
+    gzipFile.close();
+
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, this, [](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    // Header names are case-insensitive
+    QNetworkRequest request(QUrl("https://localhost:3333/precompressed.js"));
+    request.setRawHeader("accept-encoding", "gzip");
+    QNetworkReply *reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() > 0, "expected response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->rawHeader("Content-Encoding"), QByteArray("gzip"));
+    QCOMPARE(reply->readAll(), QByteArray("gzipped"));
+    QByteArray etag = reply->rawHeader("ETag");
+    QVERIFY(!etag.isEmpty());
+    reply->deleteLater();
+
+    clientSpy.clear();
+    request.setRawHeader("if-none-match", etag);
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() > 0, "expected response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 304);
+    reply->deleteLater();
+
+    // A coding with q=0 is refused by the client
+    clientSpy.clear();
+    request = QNetworkRequest(QUrl("https://localhost:3333/precompressed.js"));
+    request.setRawHeader("Accept-Encoding", "gzip;q=0");
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() > 0, "expected response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QVERIFY(reply->rawHeader("Content-Encoding").isEmpty());
+    QCOMPARE(reply->readAll(), QByteArray("plain"));
+    reply->deleteLater();
+
+    QFile::remove(fileName);
+    QFile::remove(fileName + ".gz");
+}
+
+void TestWebserver::streamLargeFile_data()
+{
+    QTest::addColumn<QByteArray>("range");
+    QTest::addColumn<QByteArray>("ifRange");
+    QTest::addColumn<int>("expectedStatusCode");
+    QTest::addColumn<qint64>("expectedOffset");
+    QTest::addColumn<qint64>("expectedLength");
+    QTest::addColumn<bool>("lowerCaseHeaders");
+
+    const qint64 size = 3 * 1024 * 1024;
+
+    QTest::newRow("whole file") << QByteArray() << QByteArray() << 200 << qint64(0) << size << false;
+    QTest::newRow("range") << QByteArray("bytes=100-199") << QByteArray() << 206 << qint64(100) << qint64(100) << false;
+    QTest::newRow("open range") << QByteArray("bytes=3000000-") << QByteArray() << 206 << qint64(3000000) << size - 3000000 << false;
+    QTest::newRow("suffix range") << QByteArray("bytes=-10") << QByteArray() << 206 << size - 10 << qint64(10) << false;
+    QTest::newRow("range beyond end") << QByteArray("bytes=3145000-9999999") << QByteArray() << 206 << qint64(3145000) << size - 3145000 << false;
+    QTest::newRow("not satisfiable") << QByteArray("bytes=99999999-") << QByteArray() << 416 << qint64(0) << qint64(0) << false;
+    QTest::newRow("multiple ranges") << QByteArray("bytes=0-9,20-29") << QByteArray() << 200 << qint64(0) << size << false;
+    QTest::newRow("if-range mismatch") << QByteArray("bytes=100-199") << QByteArray("\"outdated\"") << 200 << qint64(0) << size << false;
+    QTest::newRow("lower case range") << QByteArray("bytes=100-199") << QByteArray() << 206 << qint64(100) << qint64(100) << true;
+    QTest::newRow("lower case if-range mismatch") << QByteArray("bytes=100-199") << QByteArray("\"outdated\"") << 200 << qint64(0) << size << true;
+}
+
+void TestWebserver::streamLargeFile()
+{
+    QFETCH(QByteArray, range);
+    QFETCH(QByteArray, ifRange);
+    QFETCH(int, expectedStatusCode);
+    QFETCH(qint64, expectedOffset);
+    QFETCH(qint64, expectedLength);
+    QFETCH(bool, lowerCaseHeaders);
+
+    // Bigger than the static file cache accepts, so the web server has to stream it
+    QByteArray content;
+    content.resize(3 * 1024 * 1024);
+    for (int i = 0; i < content.size(); i++) {
+        content[i] = static_cast<char>(i % 251);
+    }
+    QFile file(QCoreApplication::applicationDirPath() + "/largefile.bin");
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    QCOMPARE(file.write(content), qint64(content.size()));
+    file.close();
+
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, this, [](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    QNetworkRequest request(QUrl("https://localhost:3333/largefile.bin"));
+    // Header names are case-insensitive
+    if (!range.isEmpty())
+        request.setRawHeader(lowerCaseHeaders ? "range" : "Range", range);
+    if (!ifRange.isEmpty())
+        request.setRawHeader(lowerCaseHeaders ? "if-range" : "If-Range", ifRange);
+
+    QNetworkReply *reply = nam.get(request);
+    clientSpy.wait(10000);
+    QVERIFY2(clientSpy.count() > 0, "expected response from webserver");
+
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), expectedStatusCode);
+    if (expectedStatusCode == 416) {
+        QCOMPARE(reply->rawHeader("Content-Range"), QByteArray("bytes */") + QByteArray::number(content.size()));
+    } else {
+        QCOMPARE(reply->rawHeader("Accept-Ranges"), QByteArray("bytes"));
+        QByteArray data = reply->readAll();
+        QCOMPARE(data.size(), static_cast<int>(expectedLength));
+        QVERIFY2(data == content.mid(static_cast<int>(expectedOffset), static_cast<int>(expectedLength)), "streamed content does not match the file");
+        if (expectedStatusCode == 206) {
+            QCOMPARE(reply->rawHeader("Content-Range"), QString("bytes %1-%2/%3").arg(expectedOffset).arg(expectedOffset + expectedLength - 1).arg(content.size()).toUtf8());
+        }
+    }
+
+    reply->deleteLater();
+    QFile::remove(file.fileName());
+}
+
+void TestWebserver::streamToSlowClient()
+{
+    // More than the kernel buffers on both ends hold, so the server is still streaming when the idle timeout passes
+    QByteArray content(20 * 1024 * 1024, 'n');
+    QFile file(QCoreApplication::applicationDirPath() + "/slowfile.bin");
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    QCOMPARE(file.write(content), qint64(content.size()));
+    file.close();
+
+    WebServerConfiguration config;
+    config.address = "127.0.0.1";
+    config.port = 3334;
+    config.sslEnabled = false;
+    WebServer server(config, QSslConfiguration());
+    server.setConnectionIdleTimeout(500);
+    QVERIFY(server.startServer());
+
+    QTcpSocket socket;
+    socket.setReadBufferSize(64 * 1024);
+    QSignalSpy connectedSpy(&socket, &QTcpSocket::connected);
+    socket.connectToHost("127.0.0.1", 3334);
+    QVERIFY(connectedSpy.wait());
+    socket.write("GET /slowfile.bin HTTP/1.1\r\nUser-Agent: nymea webserver test\r\n\r\n");
+
+    // Read about 6 MB per second, the download takes a few times the idle timeout
+    QByteArray received;
+    QElapsedTimer timer;
+    timer.start();
+    while (socket.state() == QAbstractSocket::ConnectedState && timer.elapsed() < 30000) {
+        QTest::qWait(10);
+        received.append(socket.read(64 * 1024));
+        int headerEnd = received.indexOf("\r\n\r\n");
+        if (headerEnd >= 0 && received.size() - headerEnd - 4 >= content.size()) {
+            break;
+        }
+    }
+    received.append(socket.readAll());
+    QVERIFY2(timer.elapsed() > 1000, "The download finished before the idle timeout could hit");
+
+    int headerEnd = received.indexOf("\r\n\r\n");
+    QVERIFY(headerEnd > 0);
+    QVERIFY(received.startsWith("HTTP/1.1 200"));
+    QCOMPARE(received.size() - headerEnd - 4, content.size());
+
+    // Once the download is done, the idle timeout applies again
+    QSignalSpy disconnectedSpy(&socket, &QTcpSocket::disconnected);
+    QVERIFY(disconnectedSpy.wait(3000));
+
+    QFile::remove(file.fileName());
+}
+
+void TestWebserver::pipelineLimit()
+{
+    // The download blocks the requests pipelined behind it as long as the client doesn't read
+    QByteArray content(20 * 1024 * 1024, 'n');
+    QFile file(QCoreApplication::applicationDirPath() + "/pipelinefile.bin");
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    QCOMPARE(file.write(content), qint64(content.size()));
+    file.close();
+
+    WebServerConfiguration config;
+    config.address = "127.0.0.1";
+    config.port = 3334;
+    config.sslEnabled = false;
+    WebServer server(config, QSslConfiguration());
+    QVERIFY(server.startServer());
+
+    QTcpSocket socket;
+    socket.setReadBufferSize(64 * 1024);
+    QSignalSpy connectedSpy(&socket, &QTcpSocket::connected);
+    socket.connectToHost("127.0.0.1", 3334);
+    QVERIFY(connectedSpy.wait());
+    QSignalSpy disconnectedSpy(&socket, &QTcpSocket::disconnected);
+    socket.write("GET /pipelinefile.bin HTTP/1.1\r\nUser-Agent: nymea webserver test\r\n\r\n");
+    QTest::qWait(200);
+
+    // Less than the largest request accepted is kept until the download is done
+    QByteArray requestData("GET /server.xml HTTP/1.1\r\nUser-Agent: nymea webserver test\r\n\r\n");
+    socket.write(requestData.repeated(1024));
+    QTest::qWait(500);
+    QCOMPARE(disconnectedSpy.count(), 0);
+
+    // More than that closes the connection
+    socket.write(requestData.repeated(17 * 1024 * 1024 / requestData.size()));
+    QVERIFY(disconnectedSpy.wait(10000));
+
+    QFile::remove(file.fileName());
+}
+
+void TestWebserver::keepAliveBenchmark_data()
+{
+    QTest::addColumn<QString>("mode");
+
+    QTest::newRow("new connection") << "new connection";
+    QTest::newRow("keep-alive") << "keep-alive";
+    QTest::newRow("pipelined") << "pipelined";
+}
+
+void TestWebserver::keepAliveBenchmark()
+{
+    QFETCH(QString, mode);
+
+    // Each iteration fetches the same number of resources, like a page loading its assets
+    const int requestsPerIteration = 20;
+    QByteArray requestData("GET /server.xml HTTP/1.1\r\nUser-Agent: nymea webserver test\r\n\r\n");
+
+    QSslSocket *socket = nullptr;
+    if (mode != "new connection") {
+        socket = connectEncrypted();
+        QVERIFY2(socket, "could not created encrypted webserver connection.");
+    }
+
+    int replyCount = 0;
+    QElapsedTimer timer;
+    timer.start();
+
+    QBENCHMARK {
+        if (mode == "new connection") {
+            for (int i = 0; i < requestsPerIteration; i++) {
+                QSslSocket *connection = connectEncrypted();
+                QVERIFY2(connection, "could not created encrypted webserver connection.");
+                connection->write(requestData);
+                replyCount += readReplies(connection, 1).count();
+                connection->abort();
+                delete connection;
+            }
+        } else if (mode == "keep-alive") {
+            for (int i = 0; i < requestsPerIteration; i++) {
+                socket->write(requestData);
+                replyCount += readReplies(socket, 1).count();
+            }
+        } else {
+            socket->write(requestData.repeated(requestsPerIteration));
+            replyCount += readReplies(socket, requestsPerIteration).count();
+        }
+    }
+
+    qCDebug(dcTests()).noquote() << QString("%1: %2 requests/s").arg(mode).arg(replyCount * 1000.0 / qMax<qint64>(timer.elapsed(), 1), 0, 'f', 1);
+
+    if (socket) {
+        socket->close();
+        socket->deleteLater();
+    }
+}
+
+void TestWebserver::manyConnectionsBenchmark_data()
+{
+    QTest::addColumn<QString>("mode");
+    QTest::addColumn<int>("connections");
+
+    foreach (const QString &mode, QStringList() << "requests" << "accept and disconnect") {
+        QTest::newRow(QString("%1, no other connections").arg(mode).toUtf8()) << mode << 0;
+        QTest::newRow(QString("%1, 100 other connections").arg(mode).toUtf8()) << mode << 100;
+        QTest::newRow(QString("%1, 180 other connections").arg(mode).toUtf8()) << mode << 180;
+    }
+}
+
+void TestWebserver::manyConnectionsBenchmark()
+{
+    QFETCH(QString, mode);
+    QFETCH(int, connections);
+
+    WebServerConfiguration config;
+    config.address = "127.0.0.1";
+    config.port = 3334;
+    config.sslEnabled = false;
+    WebServer server(config, QSslConfiguration());
+    QVERIFY(server.startServer());
+
+    // Idle keep-alive connections. Neither serving a request nor accepting or dropping
+    // a connection should depend on how many of those are open.
+    QList<QSslSocket *> sockets = connectPlain(&server, connections);
+    QCOMPARE(sockets.count(), connections);
+
+    QByteArray requestData("GET /server.xml HTTP/1.1\r\nUser-Agent: nymea webserver test\r\n\r\n");
+    QSslSocket *socket = nullptr;
+    if (mode == "requests") {
+        QList<QSslSocket *> requestSockets = connectPlain(&server, 1, connections);
+        QCOMPARE(requestSockets.count(), 1);
+        socket = requestSockets.first();
+    }
+
+    QSignalSpy disconnectedSpy(&server, SIGNAL(clientDisconnected(QUuid)));
+    QBENCHMARK {
+        if (mode == "requests") {
+            for (int i = 0; i < 20; i++) {
+                socket->write(requestData);
+                QCOMPARE(readReplies(socket, 1).count(), 1);
+            }
+        } else {
+            QList<QSslSocket *> newSockets = connectPlain(&server, 10, connections);
+            QCOMPARE(newSockets.count(), 10);
+
+            disconnectedSpy.clear();
+            foreach (QSslSocket *newSocket, newSockets) {
+                newSocket->disconnectFromHost();
+            }
+            while (disconnectedSpy.count() < newSockets.count() && disconnectedSpy.wait()) { }
+            QCOMPARE(disconnectedSpy.count(), newSockets.count());
+            qDeleteAll(newSockets);
+        }
+    }
+
+    delete socket;
+    qDeleteAll(sockets);
+}
+
+QList<QSslSocket *> TestWebserver::connectPlain(WebServer *server, int count, int firstIndex)
+{
+    // The server accepts 50 connections per client address. Connect from different loopback
+    // addresses to get past that.
+    QSignalSpy connectedSpy(server, SIGNAL(clientConnected(QUuid)));
+    QList<QSslSocket *> sockets;
+    for (int i = firstIndex; i < firstIndex + count; i++) {
+        QSslSocket *socket = new QSslSocket(this);
+        socket->bind(QHostAddress(QString("127.0.0.%1").arg(2 + i / 40)));
+        socket->connectToHost("127.0.0.1", 3334);
+        sockets.append(socket);
+    }
+    while (connectedSpy.count() < count) {
+        if (!connectedSpy.wait()) {
+            break;
+        }
+    }
+    if (connectedSpy.count() < count) {
+        qDeleteAll(sockets);
+        sockets.clear();
+    }
+    return sockets;
+}
+
+QSslSocket *TestWebserver::connectEncrypted()
+{
+    QSslSocket *socket = new QSslSocket(this);
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    connect(socket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &TestWebserver::onSslErrors);
+    QSignalSpy encryptedSpy(socket, SIGNAL(encrypted()));
+    socket->connectToHostEncrypted("127.0.0.1", 3333);
+    if (!encryptedSpy.wait()) {
+        delete socket;
+        return nullptr;
+    }
+    return socket;
+}
+
+QList<int> TestWebserver::readReplies(QSslSocket *socket, int count)
+{
+    // Split the reply stream using the Content-Length of each reply
+    QList<int> statusCodes;
+    QByteArray buffer;
+    while (statusCodes.count() < count) {
+        int headerEndIndex = buffer.indexOf("\r\n\r\n");
+        if (headerEndIndex >= 0) {
+            QByteArray header = buffer.left(headerEndIndex);
+            int contentLength = 0;
+            foreach (const QByteArray &line, header.split('\n')) {
+                if (line.toLower().startsWith("content-length:")) {
+                    contentLength = line.mid(line.indexOf(':') + 1).trimmed().toInt();
+                }
+            }
+            if (buffer.size() >= headerEndIndex + 4 + contentLength) {
+                statusCodes.append(header.split(' ').value(1).toInt());
+                buffer.remove(0, headerEndIndex + 4 + contentLength);
+                continue;
+            }
+        }
+
+        // The server runs in this event loop, so wait with a spy instead of blocking
+        if (!socket->bytesAvailable()) {
+            QSignalSpy readyReadSpy(socket, SIGNAL(readyRead()));
+            if (!readyReadSpy.wait(5000))
+                break;
+        }
+
+        buffer.append(socket->readAll());
+    }
+    return statusCodes;
+}
+
 #include "testwebserver.moc"
 QTEST_MAIN(TestWebserver)
@@ -30,9 +30,13 @@
 
 #include "nymeatestbase.h"
 #include "nymeacore.h"
+#include "jsonrpc/jsonrpcserverimplementation.h"
 #include "version.h"
 
 #include <QWebSocket>
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#endif
 
 using namespace nymeaserver;
 
@@ -52,6 +56,10 @@ private slots:
 
     void introspect();
 
+    void binaryMessages();
+
+    void slowClient();
+
 public slots:
     void sslErrors(const QList<QSslError> &) {
         QWebSocket *socket = static_cast<QWebSocket*>(sender());
@@ -63,6 +71,7 @@ private:
 
     QVariant injectSocketAndWait(const QString &method, const QVariantMap &params = QVariantMap());
     QVariant injectSocketData(const QByteArray &data);
+    QVariantMap sendQueueStatistics(const QUuid &clientId);
 };
 
 
@@ -172,6 +181,105 @@ void TestWebSocketServer::introspect()
 
 }
 
+void TestWebSocketServer::binaryMessages()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+    QSKIP("CBOR encoding requires Qt 5.12");
+#else
+    QWebSocket *socket = new QWebSocket("nymea tests", QWebSocketProtocol::Version13);
+    connect(socket, &QWebSocket::sslErrors, this, &TestWebSocketServer::sslErrors);
+    QSignalSpy connectedSpy(socket, &QWebSocket::connected);
+    socket->open(QUrl(QStringLiteral("wss://localhost:4444")));
+    connectedSpy.wait();
+    QVERIFY2(connectedSpy.count() > 0, "not connected");
+
+    QSignalSpy textSpy(socket, &QWebSocket::textMessageReceived);
+    QSignalSpy binarySpy(socket, &QWebSocket::binaryMessageReceived);
+    socket->sendTextMessage("{\"id\":0, \"method\": \"JSONRPC.Hello\"}");
+    textSpy.wait();
+    QCOMPARE(textSpy.count(), 1);
+
+    // Binary messages are ignored from clients still speaking JSON
+    textSpy.clear();
+    socket->sendBinaryMessage("{\"id\":1, \"method\": \"JSONRPC.Version\"}");
+    QVERIFY(!textSpy.wait(500));
+    QCOMPARE(binarySpy.count(), 0);
+
+    // Once switched to CBOR, binary messages are processed
+    socket->sendTextMessage("{\"id\":2, \"method\": \"JSONRPC.Hello\", \"params\": {\"encoding\": \"EncodingCbor\"}}");
+    textSpy.wait();
+    QCOMPARE(textSpy.count(), 1);
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(textSpy.first().first().toByteArray());
+    QCOMPARE(jsonDoc.toVariant().toMap().value("params").toMap().value("encoding").toString(), QString("EncodingCbor"));
+
+    QVariantMap request;
+    request.insert("id", 3);
+    request.insert("method", "JSONRPC.Version");
+    socket->sendBinaryMessage(QCborValue::fromVariant(request).toCbor());
+    binarySpy.wait();
+    QCOMPARE(binarySpy.count(), 1);
+    QCborParserError error;
+    QVariantMap response = QCborValue::fromCbor(binarySpy.first().first().toByteArray(), &error).toVariant().toMap();
+    QCOMPARE(error.error, QCborError::NoError);
+    QCOMPARE(response.value("id").toInt(), 3);
+    QCOMPARE(response.value("status").toString(), QString("success"));
+
+    socket->close();
+    socket->deleteLater();
+#endif
+}
+
+void TestWebSocketServer::slowClient()
+{
+    QList<QUuid> existingClients;
+    foreach (const QVariant &entry, NymeaCore::instance()->jsonRPCServer()->sendQueueStatistics()) {
+        existingClients.append(entry.toMap().value("clientId").toUuid());
+    }
+
+    QWebSocket *socket = new QWebSocket("nymea tests", QWebSocketProtocol::Version13);
+    connect(socket, &QWebSocket::sslErrors, this, &TestWebSocketServer::sslErrors);
+    QSignalSpy connectedSpy(socket, &QWebSocket::connected);
+    socket->open(QUrl(QStringLiteral("wss://localhost:4444")));
+    connectedSpy.wait();
+    QVERIFY2(connectedSpy.count() > 0, "not connected");
+
+    QSignalSpy textSpy(socket, &QWebSocket::textMessageReceived);
+    socket->sendTextMessage("{\"id\":0, \"method\": \"JSONRPC.Hello\"}");
+    textSpy.wait();
+    QCOMPARE(textSpy.count(), 1);
+    textSpy.clear();
+
+    QUuid clientId;
+    foreach (const QVariant &entry, NymeaCore::instance()->jsonRPCServer()->sendQueueStatistics()) {
+        if (!existingClients.contains(entry.toMap().value("clientId").toUuid())) {
+            clientId = entry.toMap().value("clientId").toUuid();
+        }
+    }
+    QVERIFY(!clientId.isNull());
+
+    // Stop reading, the messages pile up in the server side socket and the bytes to write are tracked per client
+    socket->setReadBufferSize(1024);
+    // Enough to exceed the kernel buffers on both ends
+    int count = 200;
+    for (int i = 1; i <= count; i++) {
+        socket->sendTextMessage(QString("{\"id\":%1, \"method\": \"JSONRPC.Introspect\"}").arg(i));
+    }
+    QVariantMap statistics;
+    QTRY_VERIFY_WITH_TIMEOUT((statistics = sendQueueStatistics(clientId)).value("queuedReplies").toInt() > 0, 10000);
+    QVERIFY(statistics.value("bytesToWrite").toLongLong() >= 64 * 1024);
+
+    // Once the client reads again, all replies arrive and the counter drops back to 0
+    socket->setReadBufferSize(0);
+    while (textSpy.count() < count && textSpy.wait()) { }
+    QCOMPARE(textSpy.count(), count);
+    QCOMPARE(QJsonDocument::fromJson(textSpy.last().first().toByteArray()).toVariant().toMap().value("id").toInt(), count);
+    QTRY_COMPARE_WITH_TIMEOUT(sendQueueStatistics(clientId).value("bytesToWrite").toLongLong(), qint64(0), 5000);
+    QCOMPARE(sendQueueStatistics(clientId).value("queuedBytes").toLongLong(), qint64(0));
+
+    socket->close();
+    socket->deleteLater();
+}
+
 QVariant TestWebSocketServer::injectSocketAndWait(const QString &method, const QVariantMap &params)
 {
     QVariantMap call;
@@ -260,5 +368,15 @@ QVariant TestWebSocketServer::injectSocketData(const QByteArray &data)
     return QVariant();
 }
 
+QVariantMap TestWebSocketServer::sendQueueStatistics(const QUuid &clientId)
+{
+    foreach (const QVariant &entry, NymeaCore::instance()->jsonRPCServer()->sendQueueStatistics()) {
+        if (entry.toMap().value("clientId").toUuid() == clientId) {
+            return entry.toMap();
+        }
+    }
+    return QVariantMap();
+}
+
 #include "testwebsocketserver.moc"
 QTEST_MAIN(TestWebSocketServer)